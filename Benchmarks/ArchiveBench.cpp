@@ -0,0 +1,161 @@
+#include "Benchmark.h"
+#include "Archive.h"
+#include "FileIo.h"
+#include "Lz4.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Loading a few thousand small assets from loose files against from one
+// archive, and what LZ4 costs on the way.
+//
+// LooseFiles opens, reads and closes every file. Archive/Open maps the
+// archive and validates its table; Archive/Lookup resolves every name
+// without reading; the Read variants also copy or decompress the data.
+// Everything is in the page cache after the first round, so the numbers
+// are per-asset overhead, not disk speed.
+
+namespace
+{
+	namespace fs = std::filesystem;
+
+	constexpr std::uint32_t assetCount = 4096;
+	constexpr std::uint32_t assetSize = 8 * 1024;
+
+	// Mesh-like data: repetitive, but not trivially so.
+	std::vector<std::uint8_t> AssetData(std::uint32_t seed)
+	{
+		std::vector<std::uint8_t> data(assetSize);
+		std::uint32_t state = seed * 2654435761u + 1;
+		for (std::uint32_t i = 0; i < assetSize; i += 16)
+		{
+			state = state * 1664525u + 1013904223u;
+			for (std::uint32_t j = 0; j < 16; j++)
+			{
+				data[i + j] = (std::uint8_t)(j < 12 ? (state >> (j % 4 * 8)) & 0x0f : j);
+			}
+		}
+		return data;
+	}
+
+	std::string AssetName(std::uint32_t i)
+	{
+		return "meshes/asset" + std::to_string(i) + ".mesh";
+	}
+
+	class TempDirectory
+	{
+	public:
+		TempDirectory()
+			: path(fs::temp_directory_path() / "bkmz_bench_archive")
+		{
+			fs::create_directories(path / "meshes");
+		}
+
+		~TempDirectory()
+		{
+			std::error_code error;
+			fs::remove_all(path, error);
+		}
+
+		fs::path path;
+	};
+}
+
+BKMZ_BENCHMARK(AssetArchive)
+{
+	TempDirectory temp;
+	std::vector<std::string> names;
+	ArchiveWriter stored;
+	ArchiveWriter compressed;
+	for (std::uint32_t i = 0; i < assetCount; i++)
+	{
+		names.push_back(AssetName(i));
+		const std::vector<std::uint8_t> data = AssetData(i);
+
+		std::ofstream out(temp.path / names.back(), std::ios::binary);
+		out.write((const char *)data.data(), data.size());
+
+		stored.Add(names.back(), data, ArchiveCompression::None);
+		compressed.Add(names.back(), data, ArchiveCompression::Lz4);
+	}
+
+	const std::string storedPath = (temp.path / "stored.pak").string();
+	const std::string compressedPath = (temp.path / "lz4.pak").string();
+	stored.Write(storedPath);
+	const ArchiveWriter::Stats compressedStats = compressed.Write(compressedPath);
+
+	std::vector<std::uint8_t> destination(assetSize);
+
+	state.Variant("LooseFiles").Run(assetCount, [&]()
+	{
+		for (const std::string &name : names)
+		{
+			File file((temp.path / name).string());
+			file.ReadAt(0, destination.data(), destination.size());
+		}
+		bkmz::bench::DoNotOptimize(destination.data());
+	});
+
+	state.Variant("Archive/Open").Run(1, [&]()
+	{
+		Archive archive(storedPath);
+		bkmz::bench::DoNotOptimize(&archive);
+	});
+
+	Archive storedArchive(storedPath);
+	Archive compressedArchive(compressedPath);
+
+	state.Variant("Archive/Lookup").Run(assetCount, [&]()
+	{
+		for (const std::string &name : names)
+		{
+			bkmz::bench::DoNotOptimize(storedArchive.Find(name));
+		}
+	});
+
+	state.Variant("Archive/ReadStored").Run(assetCount, [&]()
+	{
+		for (const std::string &name : names)
+		{
+			storedArchive.Read(*storedArchive.Find(name), destination);
+		}
+		bkmz::bench::DoNotOptimize(destination.data());
+	});
+
+	state.Variant("Archive/ReadLz4").Run(assetCount, [&]()
+	{
+		for (const std::string &name : names)
+		{
+			compressedArchive.Read(*compressedArchive.Find(name), destination);
+		}
+		bkmz::bench::DoNotOptimize(destination.data());
+	});
+	state.Counter("ratio", (double)compressedStats.storedBytes / (double)compressedStats.rawBytes);
+	state.Counter("MB_per_s", state.Results().back().itemsPerSecond * assetSize / (1024.0 * 1024.0));
+}
+
+BKMZ_BENCHMARK(Lz4)
+{
+	const std::vector<std::uint8_t> data = AssetData(1);
+	std::vector<std::uint8_t> compressed(bkmz::lz4::CompressBound(data.size()));
+	std::vector<std::uint8_t> decompressed(data.size());
+	std::size_t compressedSize = 0;
+
+	state.Variant("Compress").Run(data.size(), [&]()
+	{
+		compressedSize = bkmz::lz4::Compress(data.data(), data.size(), compressed.data());
+		bkmz::bench::DoNotOptimize(compressed.data());
+	});
+	state.Counter("MB_per_s", state.Results().back().itemsPerSecond / (1024.0 * 1024.0));
+	state.Counter("ratio", (double)compressedSize / (double)data.size());
+
+	state.Variant("Decompress").Run(data.size(), [&]()
+	{
+		bkmz::lz4::Decompress(compressed.data(), compressedSize, decompressed.data(), decompressed.size());
+		bkmz::bench::DoNotOptimize(decompressed.data());
+	});
+	state.Counter("MB_per_s", state.Results().back().itemsPerSecond / (1024.0 * 1024.0));
+	state.Counter("matches_input", decompressed == data ? 1 : 0);
+}
@@ -0,0 +1,119 @@
+#include "Benchmark.h"
+#include "BenchReport.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+// Usage: BkmzBench [filter] [--min-time <seconds>] [--json <path>]
+//                  [--baseline <path>] [--threshold <fraction>]
+// Runs every benchmark whose name contains the filter. --json also writes
+// the results to a file, and --baseline compares them with such a file
+// from an earlier run: the exit code is 2 if anything got slower than
+// its baseline by more than the threshold (default 0.1, i.e. 10%). It is
+// 3 if a benchmark found its own results wrong, see State::Fail.
+int main(int argc, char **argv)
+{
+	std::string filter;
+	std::string jsonPath;
+	std::string baselinePath;
+	double threshold = 0.1;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+		{
+			bkmz::bench::State::minTime = std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+		{
+			jsonPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+		{
+			baselinePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+		{
+			threshold = std::atof(argv[++i]);
+		}
+		else
+		{
+			filter = argv[i];
+		}
+	}
+
+	try
+	{
+		// Read first, so a bad baseline fails before the long run.
+		const std::vector<bkmz::bench::Result> baseline = baselinePath.empty()
+			? std::vector<bkmz::bench::Result>()
+			: bkmz::bench::ReadJson(baselinePath);
+
+		std::printf("clock: %s\n", Clock::BackendName());
+		std::printf("%-48s %14s %16s\n", "benchmark", "ns/item", "items/s");
+
+		std::vector<bkmz::bench::Result> results;
+		std::size_t failures = 0;
+		for (const auto &registration : bkmz::bench::Registry())
+		{
+			if (!filter.empty() && std::string(registration.name).find(filter) == std::string::npos)
+			{
+				continue;
+			}
+
+			bkmz::bench::State state(registration.name);
+			registration.function(state);
+
+			for (const auto &result : state.Results())
+			{
+				std::printf("%-48s %14.3f %16.0f", result.name.c_str(), result.nsPerItem, result.itemsPerSecond);
+				for (const auto &[counter, value] : result.counters)
+				{
+					std::printf("  %s: %g", counter.c_str(), value);
+				}
+				std::printf("\n");
+				if (!result.failure.empty())
+				{
+					std::printf("FAILED %s: %s\n", result.name.c_str(), result.failure.c_str());
+					failures++;
+				}
+				results.push_back(result);
+			}
+			std::fflush(stdout);
+		}
+
+		if (!jsonPath.empty())
+		{
+			bkmz::bench::WriteJson(jsonPath, results);
+		}
+
+		if (!baselinePath.empty())
+		{
+			const auto regressions = bkmz::bench::FindRegressions(baseline, results, threshold);
+			for (const auto &regression : regressions)
+			{
+				std::printf("REGRESSION %s: %.3f -> %.3f ns/item (+%.0f%%)\n", regression.name.c_str(),
+					regression.baselineNs, regression.currentNs, (regression.currentNs / regression.baselineNs - 1.0) * 100.0);
+			}
+			std::printf("%zu regression(s) over %.0f%% against %s\n", regressions.size(), threshold * 100.0, baselinePath.c_str());
+			if (!regressions.empty())
+			{
+				return 2;
+			}
+		}
+
+		if (failures != 0)
+		{
+			std::printf("%zu benchmark(s) produced wrong results\n", failures);
+			return 3;
+		}
+	}
+	catch (const std::exception &error)
+	{
+		std::fprintf(stderr, "BkmzBench: %s\n", error.what());
+		return 1;
+	}
+
+	return 0;
+}
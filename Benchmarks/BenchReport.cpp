@@ -0,0 +1,254 @@
+#include "BenchReport.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+namespace bkmz::bench
+{
+	namespace
+	{
+		std::string Quoted(const std::string &text)
+		{
+			std::string quoted = "\"";
+			for (char c : text)
+			{
+				if (c == '"' || c == '\\')
+				{
+					quoted += '\\';
+					quoted += c;
+				}
+				else if ((unsigned char)c < 0x20)
+				{
+					char escape[8];
+					std::snprintf(escape, sizeof(escape), "\\u%04x", (unsigned)c);
+					quoted += escape;
+				}
+				else
+				{
+					quoted += c;
+				}
+			}
+			return quoted + "\"";
+		}
+
+		// JSON has no infinity or NaN.
+		std::string Number(double value)
+		{
+			if (!std::isfinite(value))
+			{
+				return "null";
+			}
+			char text[32];
+			std::snprintf(text, sizeof(text), "%.17g", value);
+			return text;
+		}
+
+		// Just enough of a JSON reader for what WriteJson writes: finds
+		// each "key": value pair in order, not caring about nesting.
+		class Scanner
+		{
+		public:
+			explicit Scanner(std::string_view text) : text(text) {}
+
+			// Moves past the next "key": and returns true, or false at the end.
+			bool NextKey(std::string_view key)
+			{
+				const std::string pattern = "\"" + std::string(key) + "\"";
+				const std::size_t found = text.find(pattern);
+				if (found == std::string_view::npos)
+				{
+					return false;
+				}
+				text.remove_prefix(found + pattern.size());
+				SkipSpace();
+				Expect(':');
+				return true;
+			}
+
+			std::string String()
+			{
+				SkipSpace();
+				Expect('"');
+				std::string value;
+				while (!text.empty() && text[0] != '"')
+				{
+					if (text[0] == '\\' && text.size() > 1)
+					{
+						text.remove_prefix(1);
+						value += Escaped();
+						continue;
+					}
+					value += text[0];
+					text.remove_prefix(1);
+				}
+				Expect('"');
+				return value;
+			}
+
+			// WriteJson writes null for values JSON can't hold, they read back as NaN.
+			double Number()
+			{
+				SkipSpace();
+				if (text.substr(0, 4) == "null")
+				{
+					text.remove_prefix(4);
+					return std::numeric_limits<double>::quiet_NaN();
+				}
+				double value;
+				const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+				if (error != std::errc())
+				{
+					throw std::runtime_error("Benchmark results: number expected.");
+				}
+				text.remove_prefix(end - text.data());
+				return value;
+			}
+
+		private:
+			// The character after a backslash, with \uXXXX as UTF-8.
+			std::string Escaped()
+			{
+				const char c = text[0];
+				text.remove_prefix(1);
+				switch (c)
+				{
+				case 'b': return "\b";
+				case 'f': return "\f";
+				case 'n': return "\n";
+				case 'r': return "\r";
+				case 't': return "\t";
+				case 'u': break;
+				default: return std::string(1, c);
+				}
+
+				unsigned code = 0;
+				const auto [end, error] = std::from_chars(text.data(), text.data() + (std::min)(text.size(), (std::size_t)4), code, 16);
+				if (error != std::errc() || end != text.data() + 4)
+				{
+					throw std::runtime_error("Benchmark results: bad \\u escape.");
+				}
+				text.remove_prefix(4);
+
+				std::string utf8;
+				if (code < 0x80)
+				{
+					utf8 += (char)code;
+				}
+				else if (code < 0x800)
+				{
+					utf8 += (char)(0xc0 | (code >> 6));
+					utf8 += (char)(0x80 | (code & 0x3f));
+				}
+				else
+				{
+					utf8 += (char)(0xe0 | (code >> 12));
+					utf8 += (char)(0x80 | ((code >> 6) & 0x3f));
+					utf8 += (char)(0x80 | (code & 0x3f));
+				}
+				return utf8;
+			}
+
+			void SkipSpace()
+			{
+				while (!text.empty() && (text[0] == ' ' || text[0] == '\t' || text[0] == '\r' || text[0] == '\n'))
+				{
+					text.remove_prefix(1);
+				}
+			}
+
+			void Expect(char c)
+			{
+				if (text.empty() || text[0] != c)
+				{
+					throw std::runtime_error(std::string("Benchmark results: '") + c + "' expected.");
+				}
+				text.remove_prefix(1);
+			}
+
+		private:
+			std::string_view text;
+		};
+	}
+
+	void WriteJson(const std::string &path, const std::vector<Result> &results)
+	{
+		std::ofstream out(path, std::ios::trunc);
+		out << "{\n  \"clock\": " << Quoted(Clock::BackendName()) << ",\n  \"benchmarks\": [";
+		for (std::size_t i = 0; i < results.size(); i++)
+		{
+			const Result &result = results[i];
+			out << (i == 0 ? "\n" : ",\n");
+			out << "    { \"name\": " << Quoted(result.name)
+				<< ", \"ns_per_item\": " << Number(result.nsPerItem)
+				<< ", \"items_per_second\": " << Number(result.itemsPerSecond)
+				<< ", \"iterations\": " << result.iterations
+				<< ", \"counters\": {";
+			for (std::size_t j = 0; j < result.counters.size(); j++)
+			{
+				out << (j == 0 ? " " : ", ") << Quoted(result.counters[j].first) << ": " << Number(result.counters[j].second);
+			}
+			out << (result.counters.empty() ? "} }" : " } }");
+		}
+		out << "\n  ]\n}\n";
+		if (!out.flush())
+		{
+			throw std::runtime_error("Can't write " + path);
+		}
+	}
+
+	std::vector<Result> ReadJson(const std::string &path)
+	{
+		std::ifstream in(path);
+		if (!in)
+		{
+			throw std::runtime_error("Can't read " + path);
+		}
+		std::stringstream text;
+		text << in.rdbuf();
+		const std::string contents = text.str();
+
+		// Every result has its name first and ns_per_item right after.
+		std::vector<Result> results;
+		Scanner scanner(contents);
+		while (scanner.NextKey("name"))
+		{
+			Result result;
+			result.name = scanner.String();
+			if (!scanner.NextKey("ns_per_item"))
+			{
+				throw std::runtime_error("Benchmark results: ns_per_item expected after " + result.name);
+			}
+			result.nsPerItem = scanner.Number();
+			result.itemsPerSecond = 1e9 / result.nsPerItem;
+			results.push_back(result);
+		}
+		return results;
+	}
+
+	std::vector<Regression> FindRegressions(const std::vector<Result> &baseline, const std::vector<Result> &current, double threshold)
+	{
+		std::unordered_map<std::string, double> baselineNs;
+		for (const Result &result : baseline)
+		{
+			baselineNs[result.name] = result.nsPerItem;
+		}
+
+		std::vector<Regression> regressions;
+		for (const Result &result : current)
+		{
+			const auto found = baselineNs.find(result.name);
+			if (found != baselineNs.end() && result.nsPerItem > found->second * (1.0 + threshold))
+			{
+				regressions.push_back({ result.name, found->second, result.nsPerItem });
+			}
+		}
+		return regressions;
+	}
+}
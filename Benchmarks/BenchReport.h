@@ -0,0 +1,31 @@
+#pragma once
+#include "Benchmark.h"
+#include <string>
+#include <vector>
+
+// Machine-readable benchmark results, and comparing them against a
+// baseline from an earlier run to catch slowdowns in CI.
+namespace bkmz::bench
+{
+	// Writes every result as JSON:
+	//   { "clock": "...", "benchmarks": [ { "name": "...", "ns_per_item": ...,
+	//     "items_per_second": ..., "iterations": ..., "counters": { ... } } ] }
+	// Throws if the file can't be written.
+	void WriteJson(const std::string &path, const std::vector<Result> &results);
+
+	// Reads the names and ns/item back from a file written by WriteJson.
+	// Other fields are ignored. Throws if the file can't be read or isn't
+	// in that form.
+	std::vector<Result> ReadJson(const std::string &path);
+
+	struct Regression
+	{
+		std::string name;
+		double baselineNs = 0.0;
+		double currentNs = 0.0;
+	};
+
+	// Results that take more than (1 + threshold) times their baseline's
+	// ns/item. Benchmarks missing from either side are skipped.
+	std::vector<Regression> FindRegressions(const std::vector<Result> &baseline, const std::vector<Result> &current, double threshold);
+}
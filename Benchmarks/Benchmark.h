@@ -0,0 +1,153 @@
+#pragma once
+#include "Clock.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal benchmark harness for the CPU side of the engine.
+//
+// Benchmarks register themselves with BKMZ_BENCHMARK and call State::Run
+// with the body to time. The body is repeated until it has run for at
+// least minTime, and the best of a few such rounds is reported, which
+// filters out most scheduler noise.
+namespace bkmz::bench
+{
+	struct Result
+	{
+		std::string name;
+		double nsPerItem = 0.0;
+		double itemsPerSecond = 0.0;
+		std::uint64_t iterations = 0;
+
+		// Extra measurements that aren't timings, like accuracy.
+		std::vector<std::pair<std::string, double>> counters;
+
+		// Why the variant's results were wrong, empty if they weren't.
+		std::string failure;
+	};
+
+	class State
+	{
+	public:
+		explicit State(std::string name) : name(std::move(name)) {}
+
+		// Times body(), each call of which processes `items` units of work.
+		template <typename F>
+		void Run(std::uint64_t items, F &&body)
+		{
+			body(); // warm up caches and lazy initialisation
+
+			double best = 0.0;
+			std::uint64_t bestIterations = 0;
+			for (int round = 0; round < rounds; round++)
+			{
+				std::uint64_t iterations = 0;
+				const std::int64_t start = Clock::Now();
+				std::int64_t end;
+				do
+				{
+					body();
+					iterations++;
+					end = Clock::Now();
+				} while (Clock::ToSeconds(end - start) < minTime);
+
+				const double nsPerItem = Clock::ToSeconds(end - start) * 1e9 / (double)(iterations * items);
+				if (round == 0 || nsPerItem < best)
+				{
+					best = nsPerItem;
+					bestIterations = iterations;
+				}
+			}
+
+			Result result;
+			result.name = name;
+			result.nsPerItem = best;
+			result.itemsPerSecond = 1e9 / best;
+			result.iterations = bestIterations;
+			results.push_back(result);
+		}
+
+		// Benchmarks that time several variants report each under its own name.
+		State &Variant(const std::string &variant)
+		{
+			name = BaseName() + "/" + variant;
+			return *this;
+		}
+
+		// Attaches a named value to the variant that ran last.
+		void Counter(const std::string &counter, double value)
+		{
+			if (!results.empty())
+			{
+				results.back().counters.emplace_back(counter, value);
+			}
+		}
+
+		// Marks the variant that ran last as having produced wrong results,
+		// which fails the whole run once every benchmark has finished.
+		void Fail(const std::string &message)
+		{
+			if (!results.empty())
+			{
+				results.back().failure = message;
+			}
+		}
+
+		const std::vector<Result> &Results() const { return results; }
+
+		static inline double minTime = 0.2;
+		static inline int rounds = 3;
+
+	private:
+		std::string BaseName() const
+		{
+			const auto slash = name.find('/');
+			return slash == std::string::npos ? name : name.substr(0, slash);
+		}
+
+	private:
+		std::string name;
+		std::vector<Result> results;
+	};
+
+	using BenchmarkFunction = void (*)(State &);
+
+	struct Registration
+	{
+		const char *name;
+		BenchmarkFunction function;
+	};
+
+	inline std::vector<Registration> &Registry()
+	{
+		static std::vector<Registration> registry;
+		return registry;
+	}
+
+	struct Registrar
+	{
+		Registrar(const char *name, BenchmarkFunction function)
+		{
+			Registry().push_back({ name, function });
+		}
+	};
+
+	// Keeps the optimiser from discarding a value that is otherwise unused.
+	template <typename T>
+	inline void DoNotOptimize(const T &value)
+	{
+#if defined(_MSC_VER)
+		const volatile void *sink = &value;
+		(void)sink;
+#else
+		asm volatile("" : : "r,m"(value) : "memory");
+#endif
+	}
+}
+
+#define BKMZ_BENCHMARK(name) \
+	static void name(bkmz::bench::State &state); \
+	static bkmz::bench::Registrar name##Registrar(#name, name); \
+	static void name(bkmz::bench::State &state)
@@ -0,0 +1,125 @@
+#include "Benchmark.h"
+#include "Broadphase.h"
+#include "JobSystem.h"
+#include <random>
+#include <string>
+#include <vector>
+
+// Broadphase over 100k dynamic bodies of mixed sizes in a box, with both
+// methods, on one thread and on every thread. Items are pairs found, so
+// the rate is pairs per second.
+//
+// Move: every body moves a little each update, which sweep and prune
+// repairs its order for. Scatter: every body jumps to a new place, which
+// makes it sort from scratch.
+
+namespace
+{
+	using namespace bkmz::math;
+
+	constexpr std::uint32_t bodyCount = 100000;
+	constexpr float worldSize = 80.0f;
+	constexpr float stepTime = 1.0f / 60.0f;
+
+	struct Bodies
+	{
+		std::vector<Float3> positions;
+		std::vector<Float3> velocities;
+		std::vector<Float3> extents;
+		std::vector<Float3> scattered; // another position for every body
+
+		Bodies()
+		{
+			std::mt19937 random(7);
+			std::uniform_real_distribution<float> place(0.0f, worldSize);
+			std::uniform_real_distribution<float> speed(-2.0f, 2.0f);
+			std::uniform_real_distribution<float> size(0.25f, 0.75f);
+			for (std::uint32_t i = 0; i < bodyCount; i++)
+			{
+				positions.push_back({ place(random), place(random), place(random) });
+				velocities.push_back({ speed(random), speed(random), speed(random) });
+				extents.push_back({ size(random), size(random), size(random) });
+				scattered.push_back({ place(random), place(random), place(random) });
+			}
+		}
+
+		// Moves every body by one step, bouncing off the walls.
+		void Step()
+		{
+			for (std::uint32_t i = 0; i < bodyCount; i++)
+			{
+				Float3 &p = positions[i];
+				Float3 &v = velocities[i];
+				p += v * stepTime;
+				float *position = &p.x;
+				float *velocity = &v.x;
+				for (int k = 0; k < 3; k++)
+				{
+					if (position[k] < 0.0f || position[k] > worldSize)
+					{
+						velocity[k] = -velocity[k];
+					}
+				}
+			}
+		}
+
+		Aabb Bounds(std::uint32_t i) const
+		{
+			return { positions[i] - extents[i], positions[i] + extents[i] };
+		}
+	};
+}
+
+BKMZ_BENCHMARK(BroadphasePairs)
+{
+	Bodies bodies;
+
+	JobSystem serial(0);
+	JobSystem parallel;
+
+	for (JobSystem *jobs : { &serial, &parallel })
+	{
+		if (jobs == &parallel && parallel.ThreadCount() == 1)
+		{
+			continue;
+		}
+		const std::string threads = std::to_string(jobs->ThreadCount()) + "t";
+		for (BroadphaseMethod method : { BroadphaseMethod::SweepAndPrune, BroadphaseMethod::Grid })
+		{
+			const std::string prefix = std::string(method == BroadphaseMethod::Grid ? "Grid" : "SweepAndPrune") + "/" + threads + "/";
+
+			Broadphase broadphase(method);
+			for (std::uint32_t i = 0; i < bodyCount; i++)
+			{
+				broadphase.Add(bodies.Bounds(i));
+			}
+			broadphase.Update(*jobs);
+
+			state.Variant(prefix + "Move").Run(broadphase.Stats().pairs, [&]()
+			{
+				bodies.Step();
+				for (std::uint32_t i = 0; i < bodyCount; i++)
+				{
+					broadphase.Move(i, bodies.Bounds(i));
+				}
+				broadphase.Update(*jobs);
+				bkmz::bench::DoNotOptimize(broadphase.Pairs().data());
+			});
+			state.Counter("pairs", broadphase.Stats().pairs);
+			state.Counter("tests_per_pair", (double)broadphase.Stats().tests / (std::max)(broadphase.Stats().pairs, 1u));
+			state.Counter("added", broadphase.Stats().added);
+
+			state.Variant(prefix + "Scatter").Run(broadphase.Stats().pairs, [&]()
+			{
+				std::swap(bodies.positions, bodies.scattered);
+				for (std::uint32_t i = 0; i < bodyCount; i++)
+				{
+					broadphase.Move(i, bodies.Bounds(i));
+				}
+				broadphase.Update(*jobs);
+				bkmz::bench::DoNotOptimize(broadphase.Pairs().data());
+			});
+			state.Counter("pairs", broadphase.Stats().pairs);
+		}
+	}
+}
@@ -0,0 +1,198 @@
+#include "Benchmark.h"
+#include "ConstantBuffer.h"
+#include "FramePacer.h"
+#include "FrameTimer.h"
+#include "GameTimer.h"
+#include "Transform.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// The small per-frame CPU work around the renderer: building and packing
+// object transforms the way MyApp does each frame, and what reading the
+// timers costs. String conversions are in StringBench.cpp.
+//
+// ConstantBufferPack writes transposed world matrices either one per
+// 256-byte constant buffer slot, or tightly into a structured buffer,
+// which is what the engine uses now. MB_per_s counts the bytes written,
+// padding included.
+//
+// FramePacerJitter paces real frames, so it takes about a second of wall
+// time. It fails the run if the p99 wake-up lands 100us or more past its
+// deadline, the bound FramePacer promises. The max is reported but not
+// checked: one preemption of the spinning thread is enough to blow it, and
+// the pacer can't do anything about that.
+
+namespace
+{
+	using namespace bkmz::math;
+
+	constexpr std::uint32_t objectCount = 10000;
+
+	// Same layout as DefaultMaterial::ObjectData.
+	struct ObjectData
+	{
+		Float4x4 world;
+		std::uint32_t materialIndex;
+		std::uint32_t padding[3];
+	};
+
+	std::vector<Transform> MakeTransforms()
+	{
+		std::vector<Transform> transforms(objectCount);
+		for (std::uint32_t i = 0; i < objectCount; i++)
+		{
+			transforms[i].position = { (float)(i % 100), 0.0f, (float)(i / 100) };
+			transforms[i].rotation = QuaternionRotationRollPitchYaw(0.1f * i, 0.2f * i, 0.0f);
+			transforms[i].scale = { 1.0f, 1.0f + 0.001f * i, 1.0f };
+		}
+		return transforms;
+	}
+
+	template <typename F>
+	void RunPack(bkmz::bench::State &state, const char *variant, const std::vector<Float4x4> &worlds, std::uint32_t stride, F &&write)
+	{
+		std::vector<std::uint8_t> buffer((std::size_t)objectCount * stride);
+		state.Variant(variant).Run(objectCount, [&]()
+		{
+			for (std::uint32_t i = 0; i < objectCount; i++)
+			{
+				write(buffer.data() + (std::size_t)i * stride, worlds[i], i);
+			}
+			bkmz::bench::DoNotOptimize(buffer.data());
+		});
+		state.Counter("bytes_per_object", stride);
+		state.Counter("MB_per_s", state.Results().back().itemsPerSecond * stride / (1024.0 * 1024.0));
+	}
+}
+
+BKMZ_BENCHMARK(TransformMatrix)
+{
+	const std::vector<Transform> transforms = MakeTransforms();
+	std::vector<Float4x4> worlds(objectCount);
+	const Float4x4 parent = Translation({ 1.0f, 2.0f, 3.0f });
+
+	state.Variant("Local").Run(objectCount, [&]()
+	{
+		for (std::uint32_t i = 0; i < objectCount; i++)
+		{
+			worlds[i] = transforms[i].Matrix();
+		}
+		bkmz::bench::DoNotOptimize(worlds.data());
+	});
+
+	state.Variant("World").Run(objectCount, [&]()
+	{
+		for (std::uint32_t i = 0; i < objectCount; i++)
+		{
+			worlds[i] = transforms[i].Matrix() * parent;
+		}
+		bkmz::bench::DoNotOptimize(worlds.data());
+	});
+
+	state.Variant("Interpolated").Run(objectCount, [&]()
+	{
+		for (std::uint32_t i = 0; i < objectCount; i++)
+		{
+			worlds[i] = Transform::Lerp(transforms[i], transforms[objectCount - 1 - i], 0.5f).Matrix();
+		}
+		bkmz::bench::DoNotOptimize(worlds.data());
+	});
+}
+
+BKMZ_BENCHMARK(ConstantBufferPack)
+{
+	std::vector<Float4x4> worlds(objectCount);
+	const std::vector<Transform> transforms = MakeTransforms();
+	for (std::uint32_t i = 0; i < objectCount; i++)
+	{
+		worlds[i] = transforms[i].Matrix();
+	}
+
+	RunPack(state, "PerObjectCb", worlds, bkmz::utl::ConstantBufferByteSize(sizeof(Float4x4)),
+		[](std::uint8_t *slot, const Float4x4 &world, std::uint32_t)
+	{
+		const Float4x4 transposed = Transpose(world);
+		std::memcpy(slot, &transposed, sizeof(transposed));
+	});
+
+	RunPack(state, "Structured", worlds, sizeof(ObjectData),
+		[](std::uint8_t *slot, const Float4x4 &world, std::uint32_t i)
+	{
+		ObjectData data = {};
+		data.world = Transpose(world);
+		data.materialIndex = i % 4;
+		std::memcpy(slot, &data, sizeof(data));
+	});
+}
+
+BKMZ_BENCHMARK(TimerOverhead)
+{
+	constexpr std::uint32_t calls = 1000;
+
+	state.Variant("ClockNow").Run(calls, [&]()
+	{
+		for (std::uint32_t i = 0; i < calls; i++)
+		{
+			bkmz::bench::DoNotOptimize(Clock::Now());
+		}
+	});
+
+	GameTimer gameTimer;
+	gameTimer.Reset();
+	state.Variant("GameTimerTick").Run(calls, [&]()
+	{
+		for (std::uint32_t i = 0; i < calls; i++)
+		{
+			gameTimer.Tick();
+		}
+		bkmz::bench::DoNotOptimize(gameTimer.DeltaTime());
+	});
+
+	FrameTimer frameTimer;
+	state.Variant("FrameTimerMark").Run(calls, [&]()
+	{
+		for (std::uint32_t i = 0; i < calls; i++)
+		{
+			bkmz::bench::DoNotOptimize(frameTimer.Mark());
+		}
+	});
+}
+
+BKMZ_BENCHMARK(FramePacerJitter)
+{
+	constexpr double fps = 240.0;
+	constexpr std::uint32_t frames = 60;
+	constexpr double bound = 100e-6;
+
+	FramePacer pacer;
+	pacer.SetTargetFrameRate(fps);
+
+	// Lateness is how far past the requested deadline each Wait() returned.
+	std::vector<double> lateness;
+	state.Variant("240Hz").Run(frames, [&]()
+	{
+		for (std::uint32_t i = 0; i < frames; i++)
+		{
+			pacer.Wait();
+			lateness.push_back(pacer.LastLateness());
+		}
+	});
+
+	std::sort(lateness.begin(), lateness.end());
+	const auto percentile = [&](double p)
+	{
+		return lateness[(std::size_t)(p * (double)(lateness.size() - 1))];
+	};
+
+	state.Counter("frames", (double)lateness.size());
+	state.Counter("p50_us", percentile(0.5) * 1e6);
+	state.Counter("p99_us", percentile(0.99) * 1e6);
+	state.Counter("max_us", lateness.back() * 1e6);
+
+	if (percentile(0.99) >= bound)
+	{
+		state.Fail("p99 wake-up was " + std::to_string((int)(percentile(0.99) * 1e6)) + "us late, bound is 100us");
+	}
+}
@@ -0,0 +1,125 @@
+#include "Benchmark.h"
+#include "DrawList.h"
+#include <vector>
+
+// CPU side of submitting 100k draws: one set of calls per draw versus
+// packing a DrawList and one ExecuteIndirect per material. The calls go to
+// a null command list that only checksums its arguments, so this measures
+// the engine's side of submission, not a driver's. The packed arguments
+// must checksum the same as the direct calls.
+
+namespace
+{
+	constexpr std::uint32_t drawCount = 100000;
+	constexpr std::uint32_t meshCount = 16;
+
+	// Stands in for ID3D12GraphicsCommandList, virtual like the real one.
+	class NullCommandList
+	{
+	public:
+		virtual ~NullCommandList() = default;
+
+		virtual void SetGeometry(const GeometryView &geometry)
+		{
+			checksum = checksum * 31 + geometry.vertexBufferLocation + geometry.indexBufferLocation;
+			calls += 2;
+		}
+
+		virtual void SetObjectIndex(std::uint32_t objectIndex)
+		{
+			checksum = checksum * 31 + objectIndex;
+			calls++;
+		}
+
+		virtual void DrawIndexed(std::uint32_t indexCount)
+		{
+			checksum = checksum * 31 + indexCount;
+			calls++;
+		}
+
+		// The arguments are only read by the GPU, see Checksum().
+		virtual void ExecuteIndirect(const IndirectDrawCommand *, std::uint32_t)
+		{
+			calls++;
+		}
+
+		std::uint64_t checksum = 0;
+		std::uint64_t calls = 0;
+	};
+
+	// What the GPU would make of an argument buffer, in the same terms as
+	// the direct calls.
+	std::uint64_t Checksum(const IndirectDrawCommand *commands, std::uint32_t count)
+	{
+		std::uint64_t checksum = 0;
+		for (std::uint32_t i = 0; i < count; i++)
+		{
+			checksum = checksum * 31 + commands[i].vertexBufferLocation + commands[i].indexBufferLocation;
+			checksum = checksum * 31 + commands[i].objectIndex;
+			checksum = checksum * 31 + commands[i].indexCountPerInstance;
+		}
+		return checksum;
+	}
+
+	struct Draw
+	{
+		std::uint32_t material;
+		std::uint32_t mesh;
+		std::uint32_t objectIndex;
+	};
+
+	void RunBoth(bkmz::bench::State &state, const char *direct, const char *indirect, std::uint32_t materialCount)
+	{
+		std::vector<GeometryView> meshes(meshCount);
+		for (std::uint32_t i = 0; i < meshCount; i++)
+		{
+			meshes[i] = { 0x10000ull * (i + 1), 4096, 28, 0x20000000ull + 0x10000ull * i, 2048, 57, 36 + i };
+		}
+
+		// Already sorted by material, as the direct path wants them.
+		std::vector<Draw> draws(drawCount);
+		for (std::uint32_t i = 0; i < drawCount; i++)
+		{
+			draws[i] = { i * materialCount / drawCount, i % meshCount, i };
+		}
+
+		NullCommandList directList;
+		state.Variant(direct).Run(drawCount, [&]()
+		{
+			directList = {};
+			for (const Draw &draw : draws)
+			{
+				directList.SetGeometry(meshes[draw.mesh]);
+				directList.SetObjectIndex(draw.objectIndex);
+				directList.DrawIndexed(meshes[draw.mesh].indexCount);
+			}
+			bkmz::bench::DoNotOptimize(directList.checksum);
+		});
+		state.Counter("api_calls", (double)directList.calls);
+
+		DrawList drawList;
+		std::vector<IndirectDrawCommand> arguments(drawCount);
+		NullCommandList indirectList;
+		state.Variant(indirect).Run(drawCount, [&]()
+		{
+			indirectList = {};
+			drawList.Clear();
+			for (const Draw &draw : draws)
+			{
+				drawList.Add(draw.material, meshes[draw.mesh], draw.objectIndex);
+			}
+			for (const DrawList::Bucket &bucket : drawList.Pack(arguments.data()))
+			{
+				indirectList.ExecuteIndirect(arguments.data() + bucket.first, bucket.count);
+			}
+		});
+		state.Counter("api_calls", (double)indirectList.calls);
+		state.Counter("checksum_match", directList.checksum == Checksum(arguments.data(), drawCount) ? 1.0 : 0.0);
+	}
+}
+
+BKMZ_BENCHMARK(DrawSubmit)
+{
+	RunBoth(state, "Direct/1Material", "Indirect/1Material", 1);
+	RunBoth(state, "Direct/4Materials", "Indirect/4Materials", 4);
+}
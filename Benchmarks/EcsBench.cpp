@@ -0,0 +1,159 @@
+#include "Benchmark.h"
+#include "Ecs.h"
+#include "Transform.h"
+#include <memory>
+#include <vector>
+
+// Compares the ECS against the GameObject layout it replaced: a vector of
+// objects each holding two transforms and a unique_ptr to its mesh.
+
+namespace
+{
+	using namespace bkmz::ecs;
+
+	// Stand-ins for the engine components, which need D3D12 for the mesh.
+	struct PreviousTransform
+	{
+		Transform value;
+	};
+
+	struct Spin
+	{
+		float speed;
+	};
+
+	struct MeshStub
+	{
+		std::vector<float> vertices;
+		std::vector<std::uint16_t> indexes;
+		std::byte views[64];
+		void *resources[4];
+	};
+
+	struct MeshRenderer
+	{
+		const MeshStub *mesh;
+		std::uint32_t constantsIndex;
+	};
+
+	struct LegacyGameObject
+	{
+		Transform transform;
+		Transform previousTransform;
+		std::unique_ptr<MeshStub> mesh;
+	};
+
+	constexpr std::uint32_t entityCount = 100000;
+	constexpr float stepTime = 1.0f / 60.0f;
+
+	void FillWorld(World &world, const MeshStub &mesh)
+	{
+		for (std::uint32_t i = 0; i < entityCount; i++)
+		{
+			Transform transform = {};
+			transform.position = { (float)i, 0.0f, 3.0f };
+			world.Create(transform, PreviousTransform{ transform }, Spin{ 0.5f }, MeshRenderer{ &mesh, i });
+		}
+	}
+}
+
+BKMZ_BENCHMARK(EcsIterate)
+{
+	// Every entity spins at the same speed, so the step is built once.
+	const bkmz::math::Quaternion spinStep = bkmz::math::QuaternionRotationAxis({ 0.0f, 1.0f, 0.0f }, stepTime * 0.5f);
+
+	std::vector<LegacyGameObject> objects(entityCount);
+	for (auto &object : objects)
+	{
+		object.mesh = std::make_unique<MeshStub>();
+	}
+
+	state.Variant("GameObjectVector").Run(entityCount, [&]()
+	{
+		for (auto &object : objects)
+		{
+			object.previousTransform = object.transform;
+			object.transform.rotation = bkmz::math::Multiply(spinStep, object.transform.rotation);
+		}
+		bkmz::bench::DoNotOptimize(objects.back().transform);
+	});
+
+	MeshStub mesh;
+	World world;
+	FillWorld(world, mesh);
+
+	Query<Transform, PreviousTransform, Spin> query(world);
+	state.Variant("ForEach").Run(entityCount, [&]()
+	{
+		query.ForEach([&spinStep](Transform &transform, PreviousTransform &previous, const Spin &)
+		{
+			previous.value = transform;
+			transform.rotation = bkmz::math::Multiply(spinStep, transform.rotation);
+		});
+	});
+
+	state.Variant("ForEachChunk").Run(entityCount, [&]()
+	{
+		query.ForEachChunk([&spinStep](std::uint32_t rows, const Entity *, Transform *transforms, PreviousTransform *previous, Spin *)
+		{
+			for (std::uint32_t i = 0; i < rows; i++)
+			{
+				previous[i].value = transforms[i];
+				transforms[i].rotation = bkmz::math::Multiply(spinStep, transforms[i].rotation);
+			}
+		});
+	});
+}
+
+BKMZ_BENCHMARK(EcsCreateDestroy)
+{
+	state.Variant("GameObjectVector").Run(entityCount, [&]()
+	{
+		std::vector<LegacyGameObject> objects;
+		for (std::uint32_t i = 0; i < entityCount; i++)
+		{
+			objects.push_back({});
+			objects.back().mesh = std::make_unique<MeshStub>();
+			objects.back().transform.position = { (float)i, 0.0f, 3.0f };
+		}
+		bkmz::bench::DoNotOptimize(objects.data());
+	});
+
+	MeshStub mesh;
+	World world;
+	std::vector<Entity> entities(entityCount);
+
+	state.Variant("World").Run(entityCount, [&]()
+	{
+		for (std::uint32_t i = 0; i < entityCount; i++)
+		{
+			Transform transform = {};
+			transform.position = { (float)i, 0.0f, 3.0f };
+			entities[i] = world.Create(transform, PreviousTransform{ transform }, MeshRenderer{ &mesh, i });
+		}
+		for (std::uint32_t i = 0; i < entityCount; i++)
+		{
+			world.Destroy(entities[i]);
+		}
+	});
+
+	CommandBuffer commands;
+	Query<Transform> all(world);
+
+	state.Variant("CommandBuffer").Run(entityCount, [&]()
+	{
+		for (std::uint32_t i = 0; i < entityCount; i++)
+		{
+			Transform transform = {};
+			transform.position = { (float)i, 0.0f, 3.0f };
+			commands.Create(transform, PreviousTransform{ transform }, MeshRenderer{ &mesh, i });
+		}
+		commands.Playback(world);
+
+		all.ForEachEntity([&](Entity entity, Transform &)
+		{
+			commands.Destroy(entity);
+		});
+		commands.Playback(world);
+	});
+}
@@ -0,0 +1,186 @@
+#include "Benchmark.h"
+#include "FileIo.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Reading assets through AsyncFileReader with each backend, against plain
+// blocking reads on the calling thread.
+//
+// SmallFiles reads many small files, one read each, all submitted as one
+// batch: what a level load full of loose assets does. Pack reads one large
+// packed file in big chunks, through the page cache and around it with
+// direct I/O. Buffered reads are page cache hits after the first round, so
+// they measure the per-read overhead; direct reads go to the device every
+// time. latency_us is from submission to the completion callback, averaged
+// over the reads of a batch.
+
+namespace
+{
+	namespace fs = std::filesystem;
+
+	constexpr std::uint32_t smallFileCount = 1024;
+	constexpr std::uint32_t smallFileSize = 16 * 1024;
+	constexpr std::uint64_t packSize = 64ull * 1024 * 1024;
+	constexpr std::uint32_t packChunk = 1024 * 1024;
+
+	// Files written for one benchmark, deleted again afterwards.
+	class TempFiles
+	{
+	public:
+		explicit TempFiles(const char *name)
+			: directory(fs::temp_directory_path() / name)
+		{
+			fs::create_directories(directory);
+		}
+
+		~TempFiles()
+		{
+			std::error_code error;
+			fs::remove_all(directory, error);
+		}
+
+		std::string Write(const std::string &name, std::uint64_t size)
+		{
+			const fs::path path = directory / name;
+			std::vector<char> block(64 * 1024);
+			for (std::size_t i = 0; i < block.size(); i++)
+			{
+				block[i] = (char)(i * 31 + size);
+			}
+
+			std::ofstream out(path, std::ios::binary);
+			for (std::uint64_t written = 0; written < size; written += block.size())
+			{
+				out.write(block.data(), (std::streamsize)(std::min)((std::uint64_t)block.size(), size - written));
+			}
+			return path.string();
+		}
+
+	private:
+		fs::path directory;
+	};
+
+	struct BatchStats
+	{
+		double latencySum = 0.0;
+		std::uint32_t reads = 0;
+		std::uint32_t failed = 0;
+	};
+
+	// Submits every request as one batch and waits for all of them.
+	void ReadBatch(AsyncFileReader &reader, std::vector<AsyncFileReader::Request> &requests, BatchStats &stats)
+	{
+		const std::int64_t start = Clock::Now();
+		for (AsyncFileReader::Request &request : requests)
+		{
+			request.callback = [&stats, start](const ReadResult &result)
+			{
+				stats.latencySum += Clock::ToSeconds(Clock::Now() - start);
+				stats.reads++;
+				stats.failed += result.Ok() ? 0 : 1;
+			};
+		}
+		reader.Submit(requests);
+		reader.WaitAll();
+	}
+
+	// For the variant that ran last, whose items are reads of readSize bytes.
+	void Report(bkmz::bench::State &state, std::uint32_t readSize, const BatchStats &stats)
+	{
+		state.Counter("MB_per_s", state.Results().back().itemsPerSecond * readSize / (1024.0 * 1024.0));
+		if (stats.reads != 0)
+		{
+			state.Counter("latency_us", stats.latencySum / stats.reads * 1e6);
+			state.Counter("failed", stats.failed);
+		}
+	}
+
+	void RunBackend(bkmz::bench::State &state, const std::string &variant, AsyncFileReader::Backend backend,
+		const std::vector<File> &files, std::uint64_t fileSize, std::uint32_t readSize, std::uint8_t *buffer)
+	{
+		AsyncFileReader reader(backend, 64);
+		if (reader.GetBackend() != backend)
+		{
+			return; // io_uring not available here
+		}
+
+		std::vector<AsyncFileReader::Request> requests;
+		for (std::size_t i = 0; i < files.size(); i++)
+		{
+			for (std::uint64_t offset = 0; offset < fileSize; offset += readSize)
+			{
+				std::uint8_t *destination = buffer + requests.size() * readSize;
+				requests.push_back({ &files[i], offset, destination, readSize, nullptr });
+			}
+		}
+
+		BatchStats stats;
+		state.Variant(variant + "/" + AsyncFileReader::BackendName(backend)).Run(requests.size(), [&]()
+		{
+			stats = {};
+			ReadBatch(reader, requests, stats);
+		});
+		Report(state, readSize, stats);
+	}
+
+	void RunBlocking(bkmz::bench::State &state, const std::string &variant,
+		const std::vector<File> &files, std::uint64_t fileSize, std::uint32_t readSize, std::uint8_t *buffer)
+	{
+		const std::uint64_t readsPerFile = fileSize / readSize;
+		state.Variant(variant + "/blocking").Run(files.size() * readsPerFile, [&]()
+		{
+			std::uint8_t *destination = buffer;
+			for (const File &file : files)
+			{
+				for (std::uint64_t offset = 0; offset < fileSize; offset += readSize)
+				{
+					file.ReadAt(offset, destination, readSize);
+					destination += readSize;
+				}
+			}
+			bkmz::bench::DoNotOptimize(buffer);
+		});
+		Report(state, readSize, {});
+	}
+}
+
+BKMZ_BENCHMARK(FileReadSmallFiles)
+{
+	TempFiles temp("bkmz_bench_small");
+	std::vector<File> files;
+	for (std::uint32_t i = 0; i < smallFileCount; i++)
+	{
+		files.emplace_back(temp.Write("asset" + std::to_string(i), smallFileSize));
+	}
+	AlignedBuffer buffer((std::size_t)smallFileCount * smallFileSize);
+
+	RunBlocking(state, "Buffered", files, smallFileSize, smallFileSize, buffer.Data());
+	RunBackend(state, "Buffered", AsyncFileReader::Backend::ThreadPool, files, smallFileSize, smallFileSize, buffer.Data());
+	RunBackend(state, "Buffered", AsyncFileReader::Backend::IoUring, files, smallFileSize, smallFileSize, buffer.Data());
+}
+
+BKMZ_BENCHMARK(FileReadPack)
+{
+	TempFiles temp("bkmz_bench_pack");
+	const std::string path = temp.Write("assets.pack", packSize);
+	AlignedBuffer buffer((std::size_t)packSize);
+
+	for (File::Mode mode : { File::Mode::Buffered, File::Mode::Direct })
+	{
+		std::vector<File> files;
+		files.emplace_back(path, mode);
+		if (mode == File::Mode::Direct && !files[0].IsDirect())
+		{
+			continue; // the file system doesn't do direct I/O
+		}
+
+		const std::string variant = mode == File::Mode::Direct ? "Direct" : "Buffered";
+		RunBlocking(state, variant, files, packSize, packChunk, buffer.Data());
+		RunBackend(state, variant, AsyncFileReader::Backend::ThreadPool, files, packSize, packChunk, buffer.Data());
+		RunBackend(state, variant, AsyncFileReader::Backend::IoUring, files, packSize, packChunk, buffer.Data());
+	}
+}
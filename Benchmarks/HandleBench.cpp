@@ -0,0 +1,151 @@
+#include "Benchmark.h"
+#include "HandlePool.h"
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Resource lookups the way draws do them: a frame's worth of references
+// into a few thousand meshes, through unique_ptrs indexed by id (what
+// MyApp had), shared_ptrs held by each draw, and generational handles
+// into a HandlePool. Iterate visits every live resource once; Churn
+// destroys and recreates resources, like streaming in and out.
+
+namespace
+{
+	constexpr std::uint32_t resourceCount = 4096;
+	constexpr std::uint32_t drawCount = 1 << 18;
+
+	// The size of a Mesh's views and buffer pointers.
+	struct Resource
+	{
+		std::uint64_t vertexBufferLocation;
+		std::uint64_t indexBufferLocation;
+		std::uint32_t indexCount;
+		std::uint32_t padding[11];
+	};
+
+	Resource MakeResource(std::uint32_t i)
+	{
+		Resource resource = {};
+		resource.vertexBufferLocation = 0x10000ull * i;
+		resource.indexBufferLocation = resource.vertexBufferLocation + 0x8000;
+		resource.indexCount = 36 + i % 7;
+		return resource;
+	}
+
+	std::vector<std::uint32_t> DrawOrder()
+	{
+		std::mt19937 random(7);
+		std::uniform_int_distribution<std::uint32_t> pick(0, resourceCount - 1);
+		std::vector<std::uint32_t> order(drawCount);
+		for (std::uint32_t &i : order)
+		{
+			i = pick(random);
+		}
+		return order;
+	}
+}
+
+BKMZ_BENCHMARK(ResourceLookup)
+{
+	const std::vector<std::uint32_t> order = DrawOrder();
+
+	std::vector<std::unique_ptr<Resource>> owned;
+	std::vector<std::shared_ptr<Resource>> shared;
+	HandlePool<Resource> pool;
+	std::vector<Handle<Resource>> handles;
+	for (std::uint32_t i = 0; i < resourceCount; i++)
+	{
+		owned.push_back(std::make_unique<Resource>(MakeResource(i)));
+		shared.push_back(std::make_shared<Resource>(MakeResource(i)));
+		handles.push_back(pool.Create(MakeResource(i)));
+	}
+
+	std::vector<std::uint32_t> ids(order.begin(), order.end());
+	std::vector<std::shared_ptr<Resource>> sharedDraws;
+	std::vector<Handle<Resource>> handleDraws;
+	for (std::uint32_t i : order)
+	{
+		sharedDraws.push_back(shared[i]);
+		handleDraws.push_back(handles[i]);
+	}
+
+	state.Variant("UniquePtr/Lookup").Run(drawCount, [&]()
+	{
+		std::uint64_t sum = 0;
+		for (std::uint32_t id : ids)
+		{
+			if (const Resource *resource = owned[id].get())
+			{
+				sum += resource->indexCount;
+			}
+		}
+		bkmz::bench::DoNotOptimize(sum);
+	});
+
+	state.Variant("SharedPtr/Lookup").Run(drawCount, [&]()
+	{
+		std::uint64_t sum = 0;
+		for (const std::shared_ptr<Resource> &resource : sharedDraws)
+		{
+			sum += resource->indexCount;
+		}
+		bkmz::bench::DoNotOptimize(sum);
+	});
+
+	state.Variant("Handle/Lookup").Run(drawCount, [&]()
+	{
+		std::uint64_t sum = 0;
+		for (Handle<Resource> handle : handleDraws)
+		{
+			if (const Resource *resource = pool.Get(handle))
+			{
+				sum += resource->indexCount;
+			}
+		}
+		bkmz::bench::DoNotOptimize(sum);
+	});
+
+	state.Variant("UniquePtr/Iterate").Run(resourceCount, [&]()
+	{
+		std::uint64_t sum = 0;
+		for (const std::unique_ptr<Resource> &resource : owned)
+		{
+			sum += resource->indexCount;
+		}
+		bkmz::bench::DoNotOptimize(sum);
+	});
+
+	state.Variant("Handle/Iterate").Run(resourceCount, [&]()
+	{
+		std::uint64_t sum = 0;
+		for (const Resource &resource : pool.Values())
+		{
+			sum += resource.indexCount;
+		}
+		bkmz::bench::DoNotOptimize(sum);
+	});
+
+	std::uint32_t next = 0;
+	state.Variant("SharedPtr/Churn").Run(1, [&]()
+	{
+		const std::uint32_t i = order[next++ % drawCount];
+		shared[i] = std::make_shared<Resource>(MakeResource(i));
+		bkmz::bench::DoNotOptimize(shared[i].get());
+	});
+
+	std::uint64_t stale = 0;
+	state.Variant("Handle/Churn").Run(1, [&]()
+	{
+		const std::uint32_t i = order[next++ % drawCount];
+		pool.Destroy(handles[i]);
+		handles[i] = pool.Create(MakeResource(i));
+		bkmz::bench::DoNotOptimize(&handles[i]);
+	});
+	for (Handle<Resource> handle : handleDraws)
+	{
+		stale += pool.Get(handle) == nullptr;
+	}
+	state.Counter("stale_draws_detected", (double)stale / drawCount);
+}
@@ -0,0 +1,54 @@
+#include "Benchmark.h"
+#include "LightClusters.h"
+#include "MathBatch.h"
+#include "StressScene.h"
+#include <string>
+#include <vector>
+
+// Light binning as MyApp does it every frame, on every backend this machine
+// supports: the stress scene's lights, a quarter of them spot lights, seen
+// from a camera above the scene. Counters are the light index list entries
+// per light, which should match across backends, and how many were dropped
+// for going past the index list's cap.
+
+namespace
+{
+	using namespace bkmz::math;
+
+	const SimdBackend backends[] = { SimdBackend::Scalar, SimdBackend::Sse4, SimdBackend::Avx2 };
+}
+
+BKMZ_BENCHMARK(LightBinning)
+{
+	const Float4x4 view = LookAtLH({ 0.0f, 12.0f, -24.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+	const SimdBackend previous = ActiveBackend();
+
+	for (std::uint32_t lightCount : { 1024u, 4096u, 16384u })
+	{
+		StressSceneOptions options;
+		options.objectCount = 10000;
+		options.lightCount = lightCount;
+		const std::vector<Light> lights = MakeStressLights(options);
+
+		LightClusters clusters;
+		clusters.SetProjection(piOver4, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+		for (SimdBackend backend : backends)
+		{
+			if (!SetBackend(backend))
+			{
+				continue;
+			}
+
+			state.Variant(std::string(BackendName(backend)) + "/" + std::to_string(lightCount)).Run(lightCount, [&]()
+			{
+				clusters.Build(lights, view);
+				bkmz::bench::DoNotOptimize(clusters.Indices().data());
+			});
+			state.Counter("indices_per_light", (double)clusters.Stats().indices / lightCount);
+			state.Counter("dropped", clusters.Stats().dropped);
+		}
+	}
+
+	SetBackend(previous);
+}
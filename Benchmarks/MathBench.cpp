@@ -0,0 +1,157 @@
+#include "Benchmark.h"
+#include "MathBatch.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+// Throughput of the batched math kernels on every backend this machine
+// supports, plus the largest difference from the scalar results, which is
+// what the SIMD versions are checked against. A backend further off than
+// rounding explains fails the run.
+
+namespace
+{
+	using namespace bkmz::math;
+
+	constexpr std::size_t matrixCount = 4096;
+	constexpr std::size_t pointCount = 16384;
+
+	// Allowed difference from the scalar result, relative to its size, or
+	// absolute below 1. Rounding differences stay well under it, a wrong
+	// lane or shuffle is far over it.
+	constexpr float tolerance = 1e-5f;
+
+	const SimdBackend backends[] = { SimdBackend::Scalar, SimdBackend::Sse4, SimdBackend::Avx2, SimdBackend::Neon };
+
+	std::mt19937 &Random()
+	{
+		static std::mt19937 random(1234);
+		return random;
+	}
+
+	float RandomFloat(float range)
+	{
+		return std::uniform_real_distribution<float>(-range, range)(Random());
+	}
+
+	Quaternion RandomRotation()
+	{
+		return Normalize(Quaternion{ RandomFloat(1.0f), RandomFloat(1.0f), RandomFloat(1.0f), RandomFloat(1.0f) });
+	}
+
+	Float4x4 RandomTransform()
+	{
+		const Float3 scale = { 1.0f + RandomFloat(0.5f), 1.0f + RandomFloat(0.5f), 1.0f + RandomFloat(0.5f) };
+		const Float3 translation = { RandomFloat(100.0f), RandomFloat(100.0f), RandomFloat(100.0f) };
+		return AffineTransformation(scale, RandomRotation(), translation);
+	}
+
+	// Runs body() on each available backend. body() writes `count` floats
+	// to `out`, and the largest difference from the scalar output is
+	// reported next to the timing.
+	template <typename F>
+	void RunBackends(bkmz::bench::State &state, std::uint64_t items, const float *out, std::size_t count, F &&body)
+	{
+		const SimdBackend previous = ActiveBackend();
+		std::vector<float> reference;
+
+		for (SimdBackend backend : backends)
+		{
+			if (!SetBackend(backend))
+			{
+				continue;
+			}
+
+			state.Variant(BackendName(backend)).Run(items, body);
+
+			if (backend == SimdBackend::Scalar)
+			{
+				reference.assign(out, out + count);
+				continue;
+			}
+
+			float error = 0.0f;
+			std::size_t wrong = 0;
+			for (std::size_t i = 0; i < count; i++)
+			{
+				const float difference = std::fabs(out[i] - reference[i]);
+				error = (std::max)(error, difference);
+				wrong += !(difference <= tolerance * (std::max)(1.0f, std::fabs(reference[i])));
+			}
+			state.Counter("max_abs_err", error);
+			if (wrong != 0)
+			{
+				state.Fail(std::to_string(wrong) + " of " + std::to_string(count) + " values differ from scalar");
+			}
+		}
+
+		SetBackend(previous);
+	}
+}
+
+BKMZ_BENCHMARK(MathMultiplyMatrices)
+{
+	std::vector<Float4x4> a(matrixCount), b(matrixCount), out(matrixCount);
+	for (std::size_t i = 0; i < matrixCount; i++)
+	{
+		a[i] = RandomTransform();
+		b[i] = RandomTransform();
+	}
+
+	RunBackends(state, matrixCount, &out[0].m[0][0], matrixCount * 16, [&]()
+	{
+		MultiplyMatrices(a.data(), b.data(), out.data(), matrixCount);
+		bkmz::bench::DoNotOptimize(out.back());
+	});
+}
+
+BKMZ_BENCHMARK(MathMultiplyMatricesShared)
+{
+	std::vector<Float4x4> a(matrixCount), out(matrixCount);
+	for (auto &matrix : a)
+	{
+		matrix = RandomTransform();
+	}
+	const Float4x4 viewProj = LookAtLH({ 0.0f, 0.0f, -2.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f })
+		* PerspectiveFovLH(piOver4, 4.0f / 3.0f, 0.1f, 1000.0f);
+
+	RunBackends(state, matrixCount, &out[0].m[0][0], matrixCount * 16, [&]()
+	{
+		MultiplyMatrices(a.data(), viewProj, out.data(), matrixCount);
+		bkmz::bench::DoNotOptimize(out.back());
+	});
+}
+
+BKMZ_BENCHMARK(MathTransformPoints)
+{
+	std::vector<Float3> points(pointCount), out(pointCount);
+	for (auto &point : points)
+	{
+		point = { RandomFloat(10.0f), RandomFloat(10.0f), RandomFloat(10.0f) };
+	}
+	const Float4x4 transform = RandomTransform();
+
+	RunBackends(state, pointCount, &out[0].x, pointCount * 3, [&]()
+	{
+		TransformPoints(points.data(), transform, out.data(), pointCount);
+		bkmz::bench::DoNotOptimize(out.back());
+	});
+}
+
+BKMZ_BENCHMARK(MathRotationQuaternions)
+{
+	std::vector<Quaternion> rotations(matrixCount);
+	std::vector<Float4x4> out(matrixCount);
+	for (auto &rotation : rotations)
+	{
+		rotation = RandomRotation();
+	}
+
+	RunBackends(state, matrixCount, &out[0].m[0][0], matrixCount * 16, [&]()
+	{
+		RotationQuaternions(rotations.data(), out.data(), matrixCount);
+		bkmz::bench::DoNotOptimize(out.back());
+	});
+}
@@ -0,0 +1,189 @@
+#include "Benchmark.h"
+#include "DeferredRelease.h"
+#include "Memory.h"
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Per-frame scratch containers and short-lived objects, from the general
+// heap versus the frame arena and object pools, and handing GPU objects to
+// the deferred release queue from several threads against a locked vector.
+
+namespace
+{
+	struct DrawItem
+	{
+		float worldViewProj[16];
+		std::uint32_t constantsIndex;
+	};
+
+	constexpr std::uint32_t itemCount = 4096;
+	constexpr std::uint32_t objectCount = 10000;
+
+	constexpr std::uint32_t releaseThreads = 4;
+	constexpr std::uint32_t releasesPerThread = 1024;
+
+	// Stands in for a COM object.
+	struct Releasable
+	{
+		std::uint32_t references = 1;
+
+		void Release()
+		{
+			references--;
+		}
+	};
+
+	template <typename F>
+	void OnThreads(std::uint32_t count, F &&f)
+	{
+		std::vector<std::thread> threads;
+		for (std::uint32_t t = 0; t < count; t++)
+		{
+			threads.emplace_back([&f, t]() { f(t); });
+		}
+		for (std::thread &thread : threads)
+		{
+			thread.join();
+		}
+	}
+}
+
+BKMZ_BENCHMARK(MemoryFrameScratch)
+{
+	state.Variant("std::vector").Run(itemCount, [&]()
+	{
+		std::vector<DrawItem> items;
+		for (std::uint32_t i = 0; i < itemCount; i++)
+		{
+			items.push_back({ {}, i });
+		}
+		bkmz::bench::DoNotOptimize(items.data());
+	});
+
+	FrameArena arena;
+	state.Variant("FrameVector").Run(itemCount, [&]()
+	{
+		{
+			FrameVector<DrawItem> items{ ArenaAllocator<DrawItem>(arena) };
+			for (std::uint32_t i = 0; i < itemCount; i++)
+			{
+				items.push_back({ {}, i });
+			}
+			bkmz::bench::DoNotOptimize(items.data());
+		}
+		arena.Reset();
+	});
+
+	state.Variant("FrameArena::NewArray").Run(itemCount, [&]()
+	{
+		DrawItem *items = arena.NewArray<DrawItem>(itemCount);
+		for (std::uint32_t i = 0; i < itemCount; i++)
+		{
+			items[i].constantsIndex = i;
+		}
+		bkmz::bench::DoNotOptimize(items);
+		arena.Reset();
+	});
+}
+
+BKMZ_BENCHMARK(MemoryObjects)
+{
+	std::vector<DrawItem *> objects(objectCount);
+
+	state.Variant("new/delete").Run(objectCount, [&]()
+	{
+		for (auto &object : objects)
+		{
+			object = new DrawItem();
+		}
+		for (auto *object : objects)
+		{
+			delete object;
+		}
+	});
+
+	ObjectPool<DrawItem> pool;
+	state.Variant("ObjectPool").Run(objectCount, [&]()
+	{
+		for (auto &object : objects)
+		{
+			object = pool.Create();
+		}
+		for (auto *object : objects)
+		{
+			pool.Destroy(object);
+		}
+	});
+}
+
+BKMZ_BENCHMARK(DeferredRelease)
+{
+	// One frame's releases, then the collect. Uncontended, a mutex is
+	// cheaper than the ring's compare-exchange; with producers on several
+	// threads the ring never makes one wait for another or for Collect.
+	constexpr std::uint32_t total = releaseThreads * releasesPerThread;
+	std::vector<Releasable> objects(total);
+
+	DeferredReleaseQueue queue(total);
+	state.Variant("LockFree").Run(total, [&]()
+	{
+		for (Releasable &object : objects)
+		{
+			queue.PushRelease(&object);
+		}
+		queue.Collect(queue.NextFenceValue());
+	});
+
+	struct Locked
+	{
+		Releasable *object;
+		std::uint64_t fenceValue;
+	};
+	std::mutex mutex;
+	std::vector<Locked> locked;
+	state.Variant("Mutex").Run(total, [&]()
+	{
+		for (Releasable &object : objects)
+		{
+			std::lock_guard lock(mutex);
+			locked.push_back({ &object, 1 });
+		}
+		for (const Locked &entry : locked)
+		{
+			entry.object->Release();
+		}
+		locked.clear();
+	});
+
+	state.Variant("LockFree/Threads").Run(total, [&]()
+	{
+		OnThreads(releaseThreads, [&](std::uint32_t t)
+		{
+			for (std::uint32_t i = 0; i < releasesPerThread; i++)
+			{
+				queue.PushRelease(&objects[t * releasesPerThread + i]);
+			}
+		});
+		queue.Collect(queue.NextFenceValue());
+	});
+
+	state.Variant("Mutex/Threads").Run(total, [&]()
+	{
+		OnThreads(releaseThreads, [&](std::uint32_t t)
+		{
+			for (std::uint32_t i = 0; i < releasesPerThread; i++)
+			{
+				std::lock_guard lock(mutex);
+				locked.push_back({ &objects[t * releasesPerThread + i], 1 });
+			}
+		});
+		for (const Locked &entry : locked)
+		{
+			entry.object->Release();
+		}
+		locked.clear();
+	});
+	state.Counter("overflows", (double)queue.Overflows());
+}
@@ -0,0 +1,93 @@
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "MathBatch.h"
+#include "ParticleSystem.h"
+#include <string>
+#include <vector>
+
+// A particle system's frame at a million particles: Update (integrate, kill,
+// emit), Sort (depth keys and radix sort) and WriteInstances, on one thread
+// and on every thread, with the scalar and AVX2 loops. Emitters are set up
+// to keep the count steady, and run in coarse steps until it is.
+
+namespace
+{
+	using namespace bkmz::math;
+
+	constexpr std::uint32_t particleCount = 1 << 20;
+	constexpr float lifetime = 2.0f;
+	constexpr float frameTime = 1.0f / 60.0f;
+
+	void AddEmitters(ParticleSystem &particles)
+	{
+		constexpr int side = 8;
+		for (int i = 0; i < side * side; i++)
+		{
+			ParticleEmitter emitter;
+			emitter.position = { (float)(i % side) * 4.0f - 14.0f, 0.0f, (float)(i / side) * 4.0f - 14.0f };
+			emitter.rate = (float)particleCount / lifetime / (side * side);
+			emitter.velocity = { 0.0f, 6.0f, 0.0f };
+			emitter.spread = 2.0f;
+			emitter.lifetime = lifetime;
+			particles.emitters.push_back(emitter);
+		}
+	}
+}
+
+BKMZ_BENCHMARK(ParticleFrame)
+{
+	const Float4x4 view = LookAtLH({ 0.0f, 10.0f, -40.0f }, { 0.0f, 5.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+	std::vector<ParticleInstance> instances(particleCount * 2);
+	const SimdBackend previous = ActiveBackend();
+
+	JobSystem serial(0);
+	JobSystem parallel;
+
+	for (JobSystem *jobs : { &serial, &parallel })
+	{
+		if (jobs == &parallel && parallel.ThreadCount() == 1)
+		{
+			continue;
+		}
+		const std::string threads = std::to_string(jobs->ThreadCount()) + "t";
+		for (SimdBackend backend : { SimdBackend::Scalar, SimdBackend::Avx2 })
+		{
+			if (!SetBackend(backend))
+			{
+				continue;
+			}
+			const std::string prefix = std::string(BackendName(backend)) + "/" + threads + "/";
+
+			ParticleSystem particles(particleCount * 2);
+			AddEmitters(particles);
+			for (float time = 0.0f; time < lifetime * 1.5f; time += 0.1f)
+			{
+				particles.Update(0.1f, *jobs);
+			}
+
+			state.Variant(prefix + "Update").Run(particles.Size(), [&]()
+			{
+				particles.Update(frameTime, *jobs);
+			});
+			state.Counter("live", particles.Size());
+			state.Counter("killed", particles.Stats().killed);
+
+			state.Variant(prefix + "Sort").Run(particles.Size(), [&]()
+			{
+				particles.Sort(view, *jobs);
+				bkmz::bench::DoNotOptimize(particles.Order().data());
+			});
+
+			state.Variant(prefix + "Frame").Run(particles.Size(), [&]()
+			{
+				particles.Update(frameTime, *jobs);
+				particles.Sort(view, *jobs);
+				particles.WriteInstances(instances.data(), *jobs);
+				bkmz::bench::DoNotOptimize(instances.data());
+			});
+			state.Counter("frame_ms", particles.Size() / state.Results().back().itemsPerSecond * 1e3);
+		}
+	}
+
+	SetBackend(previous);
+}
@@ -0,0 +1,134 @@
+#include "Benchmark.h"
+#include "SceneGraph.h"
+#include <random>
+#include <vector>
+
+// World matrix updates for a large hierarchy: recomputing every node each
+// frame with no change tracking, against SceneGraph with everything, nothing
+// or a few subtrees moving. Items are scene nodes in every variant, so the
+// static and partial cases show what the tracking itself costs per node.
+
+namespace
+{
+	using namespace bkmz::math;
+
+	constexpr std::uint32_t rootCount = 1024;
+	constexpr std::uint32_t childCount = 8;
+	constexpr std::uint32_t grandchildCount = 12;
+	constexpr std::uint32_t nodeCount = rootCount * (1 + childCount * (1 + grandchildCount));
+
+	Transform RandomTransform(std::mt19937 &random)
+	{
+		std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+		Transform transform;
+		transform.position = { distribution(random) * 10.0f, distribution(random) * 10.0f, distribution(random) * 10.0f };
+		transform.rotation = QuaternionRotationAxis({ 0.0f, 1.0f, 0.0f }, distribution(random) * pi);
+		return transform;
+	}
+
+	// Roots, each with children, each with grandchildren. Also fills flat
+	// parent-first arrays of the same hierarchy for the naive version.
+	struct TestScene
+	{
+		SceneGraph graph;
+		std::vector<SceneGraph::NodeId> roots;
+		std::vector<SceneGraph::NodeId> nodes;
+
+		std::vector<std::uint32_t> parents;
+		std::vector<Transform> locals;
+		std::vector<Float4x4> worlds;
+
+		TestScene()
+		{
+			std::mt19937 random(1234);
+			for (std::uint32_t r = 0; r < rootCount; r++)
+			{
+				const SceneGraph::NodeId root = Add(RandomTransform(random), SceneGraph::noNode, ~0u);
+				roots.push_back(root);
+				const std::uint32_t rootIndex = (std::uint32_t)nodes.size() - 1;
+
+				for (std::uint32_t c = 0; c < childCount; c++)
+				{
+					const SceneGraph::NodeId child = Add(RandomTransform(random), root, rootIndex);
+					const std::uint32_t childIndex = (std::uint32_t)nodes.size() - 1;
+
+					for (std::uint32_t g = 0; g < grandchildCount; g++)
+					{
+						Add(RandomTransform(random), child, childIndex);
+					}
+				}
+			}
+			worlds.resize(locals.size());
+			graph.Update();
+		}
+
+		SceneGraph::NodeId Add(const Transform &local, SceneGraph::NodeId parent, std::uint32_t parentIndex)
+		{
+			const SceneGraph::NodeId node = graph.Create(local, parent);
+			nodes.push_back(node);
+			parents.push_back(parentIndex);
+			locals.push_back(local);
+			return node;
+		}
+	};
+}
+
+BKMZ_BENCHMARK(SceneUpdate)
+{
+	TestScene scene;
+
+	state.Variant("RecomputeAll").Run(nodeCount, [&]()
+	{
+		for (std::size_t i = 0; i < scene.locals.size(); i++)
+		{
+			const Float4x4 local = scene.locals[i].Matrix();
+			scene.worlds[i] = scene.parents[i] == ~0u ? local : Multiply(local, scene.worlds[scene.parents[i]]);
+		}
+		bkmz::bench::DoNotOptimize(scene.worlds.back());
+	});
+	state.Counter("nodes_recomputed", (double)nodeCount);
+
+	std::size_t recomputed = 0;
+	state.Variant("Tracked/AllDirty").Run(nodeCount, [&]()
+	{
+		for (std::size_t i = 0; i < scene.nodes.size(); i++)
+		{
+			scene.graph.SetLocal(scene.nodes[i], scene.locals[i]);
+		}
+		recomputed = scene.graph.Update().size();
+	});
+	state.Counter("nodes_recomputed", (double)recomputed);
+
+	state.Variant("Tracked/Static").Run(nodeCount, [&]()
+	{
+		recomputed = scene.graph.Update().size();
+	});
+	state.Counter("nodes_recomputed", (double)recomputed);
+
+	// About 1% of the roots, each dragging its whole subtree along.
+	const Quaternion step = QuaternionRotationAxis({ 0.0f, 1.0f, 0.0f }, 0.01f);
+	state.Variant("Tracked/OnePercentRoots").Run(nodeCount, [&]()
+	{
+		for (std::size_t r = 0; r < scene.roots.size(); r += 100)
+		{
+			Transform local = scene.graph.Local(scene.roots[r]);
+			local.rotation = Multiply(step, local.rotation);
+			scene.graph.SetLocal(scene.roots[r], local);
+		}
+		recomputed = scene.graph.Update().size();
+	});
+	state.Counter("nodes_recomputed", (double)recomputed);
+
+	// One leaf per iteration, the smallest change there is.
+	std::size_t leaf = 0;
+	state.Variant("Tracked/OneLeaf").Run(nodeCount, [&]()
+	{
+		const SceneGraph::NodeId node = scene.nodes[scene.nodes.size() - 1 - leaf];
+		leaf = (leaf + 1) % grandchildCount;
+		Transform local = scene.graph.Local(node);
+		local.rotation = Multiply(step, local.rotation);
+		scene.graph.SetLocal(node, local);
+		recomputed = scene.graph.Update().size();
+	});
+	state.Counter("nodes_recomputed", (double)recomputed);
+}
@@ -0,0 +1,102 @@
+#include "Benchmark.h"
+#include "SceneFile.h"
+#include "SceneGraph.h"
+#include <filesystem>
+#include <string>
+
+// Loading a million-object scene. Map opens the compiled file and
+// validates it; Load also appends every object to an empty SceneGraph,
+// which is what the app does at startup. The graph is cleared and reused
+// between rounds, like a level change; first_load_ms is the very first
+// load, which also pays for faulting in the graph's memory. ParseText is
+// the text form of a smaller scene, for comparison per object. load_ms is
+// one whole load.
+
+namespace
+{
+	namespace fs = std::filesystem;
+
+	constexpr std::uint32_t objectCount = 1'000'000;
+	constexpr std::uint32_t textObjectCount = 100'000;
+
+	// A grid of roots with a child on every fourth one.
+	SceneDescription MakeScene(std::uint32_t count)
+	{
+		SceneDescription scene;
+		const char *meshNames[] = { "Cube.mesh", "Sphere.mesh", "Rock.mesh" };
+		for (std::uint32_t i = 0; scene.Size() < count; i++)
+		{
+			Transform local;
+			local.position = { (float)(i % 1000), 0.0f, (float)(i / 1000) };
+			const std::uint32_t root = scene.Add(local, meshNames[i % 3], "Default");
+			if (i % 4 == 0 && scene.Size() < count)
+			{
+				Transform child;
+				child.position = { 0.0f, 1.0f, 0.0f };
+				child.scale = { 0.5f, 0.5f, 0.5f };
+				scene.Add(child, "Cube.mesh", "Default", root);
+			}
+		}
+		return scene;
+	}
+
+	std::string SceneText(const SceneDescription &scene)
+	{
+		std::string text;
+		for (std::uint32_t i = 0; i < scene.Size(); i++)
+		{
+			const Transform &local = scene.transforms[i];
+			text += "object " + scene.meshNames[scene.meshes[i]] + " " + scene.materialNames[scene.materials[i]];
+			text += " position " + std::to_string(local.position.x) + " " + std::to_string(local.position.y) + " " + std::to_string(local.position.z);
+			text += " rotation 0 45 0 scale " + std::to_string(local.scale.x);
+			if (scene.parents[i] != SceneDescription::noParent)
+			{
+				text += " parent " + std::to_string(scene.parents[i]);
+			}
+			text += "\n";
+		}
+		return text;
+	}
+}
+
+BKMZ_BENCHMARK(SceneLoad)
+{
+	const fs::path path = fs::temp_directory_path() / "bkmz_bench.bscene";
+	WriteCompiledScene(MakeScene(objectCount), path.string());
+
+	state.Variant("Map").Run(objectCount, [&]()
+	{
+		SceneFile file(path.string());
+		bkmz::bench::DoNotOptimize(&file);
+	});
+	state.Counter("load_ms", state.Results().back().nsPerItem * objectCount / 1e6);
+
+	SceneGraph graph;
+	const std::int64_t firstStart = Clock::Now();
+	{
+		SceneFile file(path.string());
+		graph.CreateBatch(file.View().Transforms(), file.View().Parents());
+	}
+	const double firstLoad = Clock::ToSeconds(Clock::Now() - firstStart);
+
+	state.Variant("Load").Run(objectCount, [&]()
+	{
+		SceneFile file(path.string());
+		graph.Clear();
+		graph.CreateBatch(file.View().Transforms(), file.View().Parents());
+		bkmz::bench::DoNotOptimize(&graph);
+	});
+	state.Counter("load_ms", state.Results().back().nsPerItem * objectCount / 1e6);
+	state.Counter("first_load_ms", firstLoad * 1e3);
+
+	const std::string text = SceneText(MakeScene(textObjectCount));
+	state.Variant("ParseText").Run(textObjectCount, [&]()
+	{
+		SceneDescription scene = ParseSceneText(text);
+		bkmz::bench::DoNotOptimize(&scene);
+	});
+	state.Counter("load_ms", state.Results().back().nsPerItem * textObjectCount / 1e6);
+
+	std::error_code error;
+	fs::remove(path, error);
+}
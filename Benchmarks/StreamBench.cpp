@@ -0,0 +1,126 @@
+#include "Benchmark.h"
+#include "AssetStreamer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Streaming a batch of assets through AssetStreamer with different
+// per-frame byte budgets. Every Update() is one frame; the completion
+// callbacks copy their data into a staging area the way an upload would.
+// worst_frame_ms is the most any frame spent in Update, which the budget
+// is there to bound, and frames is how many frames the batch took.
+//
+// Reprioritize: a frame's worth of new priorities for thousands of queued
+// requests, one SetPriority call each against one SetPriorities batch.
+
+namespace
+{
+	constexpr std::uint32_t assetCount = 512;
+	constexpr std::size_t assetSize = 64 * 1024;
+
+	void RunBudget(bkmz::bench::State &state, const char *variant, std::uint64_t budget)
+	{
+		std::vector<std::uint8_t> source(assetSize, 0x5a);
+		std::vector<std::uint8_t> staging(assetSize);
+
+		AssetStreamer streamer(2);
+		StreamingFrameStats worst;
+		std::uint32_t frames = 0;
+
+		state.Variant(variant).Run(assetCount, [&]()
+		{
+			for (std::uint32_t i = 0; i < assetCount; i++)
+			{
+				streamer.Load(
+					[&source]() { return source; },
+					[&staging](AssetStreamer::Completion &&completion) { std::memcpy(staging.data(), completion.data.data(), completion.data.size()); },
+					(float)(i % 8)
+				);
+			}
+
+			worst = {};
+			frames = 0;
+			while (streamer.PendingCount() != 0)
+			{
+				const StreamingFrameStats frame = streamer.Update(budget);
+				if (frame.time > worst.time)
+				{
+					worst = frame;
+				}
+				frames++;
+				std::this_thread::yield();
+			}
+			bkmz::bench::DoNotOptimize(staging.data());
+		});
+
+		state.Counter("frames", frames);
+		state.Counter("worst_frame_ms", worst.time * 1000.0);
+		state.Counter("worst_frame_bytes", (double)worst.bytes);
+	}
+
+	constexpr std::uint32_t queuedCount = 4096;
+}
+
+BKMZ_BENCHMARK(StreamAssets)
+{
+	RunBudget(state, "Budget/256KiB", 256 * 1024);
+	RunBudget(state, "Budget/1MiB", 1024 * 1024);
+	RunBudget(state, "Unbudgeted", ~0ull);
+}
+
+BKMZ_BENCHMARK(StreamReprioritize)
+{
+	// The one worker is kept busy with a load that waits for the end of the
+	// run, first by priority, so everything else stays queued.
+	std::atomic<bool> release{ false };
+	AssetStreamer streamer(1);
+	streamer.Load([&release]()
+	{
+		while (!release.load())
+		{
+			std::this_thread::yield();
+		}
+		return std::vector<std::uint8_t>();
+	}, [](AssetStreamer::Completion &&) {}, 1000.0f);
+
+	std::vector<AssetStreamer::PriorityUpdate> updates;
+	for (std::uint32_t i = 0; i < queuedCount; i++)
+	{
+		const AssetStreamer::RequestId id = streamer.Load([]() { return std::vector<std::uint8_t>(); }, [](AssetStreamer::Completion &&) {}, 1.0f);
+		updates.push_back({ id, 1.0f });
+	}
+
+	std::uint32_t frame = 0;
+	const auto nextPriorities = [&]()
+	{
+		frame++;
+		for (std::uint32_t i = 0; i < queuedCount; i++)
+		{
+			updates[i].priority = (float)((i * 7 + frame) % 64);
+		}
+	};
+
+	state.Variant("SetPriority").Run(queuedCount, [&]()
+	{
+		nextPriorities();
+		for (const AssetStreamer::PriorityUpdate &update : updates)
+		{
+			streamer.SetPriority(update.id, update.priority);
+		}
+	});
+
+	state.Variant("SetPriorities").Run(queuedCount, [&]()
+	{
+		nextPriorities();
+		streamer.SetPriorities(updates);
+	});
+
+	release = true;
+	while (streamer.PendingCount() != 0)
+	{
+		streamer.Update(~0ull);
+		std::this_thread::yield();
+	}
+}
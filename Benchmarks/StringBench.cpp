@@ -0,0 +1,146 @@
+#include "Benchmark.h"
+#include "MathBatch.h"
+#include "String.h"
+#include <clocale>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// UTF-8 to UTF-16/32 and back on ASCII and on multilingual text, on each
+// SIMD backend, against the C library's locale-dependent conversions the
+// engine used before (mbstowcs/wcstombs in a UTF-8 locale). Items are
+// UTF-8 bytes; GB_per_s is UTF-8 bytes per second. The conversions into
+// preallocated buffers are the non-allocating overloads, ToWide/ToNarrow
+// also size and allocate the result.
+
+namespace
+{
+	using namespace bkmz::utl;
+	using bkmz::math::SimdBackend;
+
+	constexpr std::size_t textSize = 1 << 16;
+
+	// Paths and identifiers, the engine's common case.
+	std::string AsciiText()
+	{
+		const std::string line = "Assets/Meshes/Environment/Rock_03.mesh fps: 144 mspf: 6.944 ";
+		std::string text;
+		while (text.size() < textSize)
+		{
+			text += line;
+		}
+		return text;
+	}
+
+	// Short runs of Latin, Cyrillic, Greek, CJK and emoji, separated by
+	// ASCII spaces and punctuation.
+	std::string MultilingualText()
+	{
+		const std::string line = "Caf\xc3\xa9 na\xc3\xafve \xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 "
+			"\xce\x9a\xce\xb1\xce\xbb\xce\xb7\xce\xbc\xce\xad\xcf\x81\xce\xb1, "
+			"\xe4\xbd\xa0\xe5\xa5\xbd\xe4\xb8\x96\xe7\x95\x8c \xe3\x81\x93\xe3\x82\x93\xe3\x81\xab\xe3\x81\xa1\xe3\x81\xaf "
+			"\xf0\x9f\x8e\xae\xf0\x9f\x9a\x80 level_01 ";
+		std::string text;
+		while (text.size() < textSize)
+		{
+			text += line;
+		}
+		return text;
+	}
+
+	// Restores the C locale when done.
+	class Utf8Locale
+	{
+	public:
+		Utf8Locale()
+		{
+			ok = std::setlocale(LC_CTYPE, "C.UTF-8") != nullptr || std::setlocale(LC_CTYPE, ".UTF-8") != nullptr;
+		}
+
+		~Utf8Locale()
+		{
+			std::setlocale(LC_CTYPE, "C");
+		}
+
+		bool ok;
+	};
+
+	void Run(bkmz::bench::State &state, const char *textName, const std::string &text)
+	{
+		const std::string prefix = std::string(textName) + "/";
+		const std::wstring wide = ToWide(text);
+		const std::u16string utf16 = ToUtf16(text);
+		std::vector<wchar_t> wideOut(wide.size() + 1);
+		std::vector<char16_t> utf16Out(utf16.size());
+		std::vector<char> narrowOut(text.size() * 4 + 1);
+
+		auto gbPerSecond = [&state]() { state.Counter("GB_per_s", state.Results().back().itemsPerSecond / 1e9); };
+
+		{
+			Utf8Locale locale;
+			if (locale.ok)
+			{
+				state.Variant(prefix + "mbstowcs").Run(text.size(), [&]()
+				{
+					bkmz::bench::DoNotOptimize(std::mbstowcs(wideOut.data(), text.c_str(), wideOut.size()));
+				});
+				gbPerSecond();
+				state.Variant(prefix + "wcstombs").Run(text.size(), [&]()
+				{
+					bkmz::bench::DoNotOptimize(std::wcstombs(narrowOut.data(), wide.c_str(), narrowOut.size()));
+				});
+				gbPerSecond();
+			}
+		}
+
+		const SimdBackend previous = bkmz::math::ActiveBackend();
+		for (SimdBackend backend : { SimdBackend::Scalar, SimdBackend::Sse4, SimdBackend::Avx2 })
+		{
+			if (!bkmz::math::SetBackend(backend))
+			{
+				continue;
+			}
+			const std::string name = prefix + (backend == SimdBackend::Sse4 ? "sse2" : bkmz::math::BackendName(backend)) + "/";
+
+			state.Variant(name + "Utf8ToUtf16").Run(text.size(), [&]()
+			{
+				bkmz::bench::DoNotOptimize(Utf8ToUtf16(text, utf16Out));
+			});
+			gbPerSecond();
+
+			state.Variant(name + "Utf16ToUtf8").Run(text.size(), [&]()
+			{
+				bkmz::bench::DoNotOptimize(Utf16ToUtf8(utf16, narrowOut));
+			});
+			gbPerSecond();
+
+			state.Variant(name + "ToWide").Run(text.size(), [&]()
+			{
+				std::wstring converted = ToWide(text);
+				bkmz::bench::DoNotOptimize(converted.data());
+			});
+			gbPerSecond();
+
+			state.Variant(name + "ToNarrow").Run(text.size(), [&]()
+			{
+				std::string converted = ToNarrow(wide);
+				bkmz::bench::DoNotOptimize(converted.data());
+			});
+			gbPerSecond();
+			state.Counter("round_trips", ToNarrow(wide) == text ? 1 : 0);
+
+			state.Variant(name + "Validate").Run(text.size(), [&]()
+			{
+				bkmz::bench::DoNotOptimize(IsValidUtf8(text));
+			});
+			gbPerSecond();
+		}
+		bkmz::math::SetBackend(previous);
+	}
+}
+
+BKMZ_BENCHMARK(Utf8)
+{
+	Run(state, "Ascii", AsciiText());
+	Run(state, "Multilingual", MultilingualText());
+}
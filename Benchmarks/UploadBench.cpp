@@ -0,0 +1,197 @@
+#include "Benchmark.h"
+#include "TrackedBuffer.h"
+#include "UploadQueue.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+// Staging per-object data for upload: rewriting every object each frame
+// versus gathering only the changed ones with TrackedBuffer, for different
+// amounts of change. bytes_uploaded is what would be copied to the GPU,
+// runs the number of CopyBufferRegion calls.
+//
+// UploadQueue runs a frame's worth of small mesh-sized copies against a
+// stand-in copy queue that copies on the CPU and finishes a batch a few
+// submissions late, to show what batching saves in submissions. With the
+// lag below the allocator count nothing should wait; the Stalled variant
+// lags by the allocator count, so every submission past the first ring
+// has to. The stand-in also checks that no allocator is handed back
+// before its previous batch has completed.
+
+namespace
+{
+	// Same layout as DefaultMaterial::ObjectData.
+	struct ObjectData
+	{
+		float world[16];
+		std::uint32_t materialIndex;
+		std::uint32_t padding[3];
+	};
+
+	constexpr std::uint32_t objectCount = 100000;
+
+	// `count` distinct random object indices.
+	std::vector<std::uint32_t> RandomIndices(std::uint32_t count)
+	{
+		std::vector<std::uint32_t> indices(objectCount);
+		std::iota(indices.begin(), indices.end(), 0u);
+		std::shuffle(indices.begin(), indices.end(), std::mt19937(1234));
+		indices.resize(count);
+		return indices;
+	}
+
+	void RunTracked(bkmz::bench::State &state, const char *variant, const std::vector<std::uint32_t> &indices)
+	{
+		TrackedBuffer<ObjectData> objects;
+		objects.Resize(objectCount);
+		std::vector<ObjectData> staging(objectCount);
+		objects.Gather(staging.data());
+
+		ObjectData data = {};
+		std::uint64_t bytes = 0;
+		std::size_t runs = 0;
+		state.Variant(variant).Run(objectCount, [&]()
+		{
+			data.materialIndex++;
+			for (std::uint32_t index : indices)
+			{
+				objects.Set(index, data);
+			}
+
+			const auto gathered = objects.Gather(staging.data());
+			runs = gathered.size();
+			bytes = runs == 0 ? 0 : (std::uint64_t)(gathered.back().stagingFirst + gathered.back().count) * sizeof(ObjectData);
+			bkmz::bench::DoNotOptimize(staging.data());
+		});
+		state.Counter("bytes_uploaded", (double)bytes);
+		state.Counter("runs", (double)runs);
+	}
+
+	// Copies between plain memory. A batch completes `latency` submissions
+	// after it went out, or when waited for.
+	class LaggingCopyQueue : public CopyQueueBackend
+	{
+	public:
+		explicit LaggingCopyQueue(std::uint64_t latency) : latency(latency) {}
+
+		void Submit(std::uint32_t allocator, std::span<const CopyCommand> copies, std::uint64_t fenceValue) override
+		{
+			if (allocator >= allocatorValues.size())
+			{
+				allocatorValues.resize(allocator + 1, 0);
+			}
+			if (allocatorValues[allocator] > completed)
+			{
+				earlyReuses++;
+			}
+			allocatorValues[allocator] = fenceValue;
+
+			for (const CopyCommand &copy : copies)
+			{
+				std::memcpy(static_cast<std::uint8_t *>(copy.destination) + copy.destinationOffset,
+					static_cast<const std::uint8_t *>(copy.source) + copy.sourceOffset, copy.size);
+			}
+			submitted = fenceValue;
+			completed = (std::max)(completed, submitted > latency ? submitted - latency : 0);
+		}
+
+		std::uint64_t CompletedValue() override { return completed; }
+
+		// Submissions whose allocator still had a batch in flight.
+		std::uint64_t EarlyReuses() const { return earlyReuses; }
+
+		void Wait(std::uint64_t fenceValue) override
+		{
+			completed = (std::max)(completed, fenceValue);
+		}
+
+	private:
+		std::uint64_t latency;
+		std::uint64_t submitted = 0;
+		std::uint64_t completed = 0;
+		std::vector<std::uint64_t> allocatorValues; // last value submitted with each
+		std::uint64_t earlyReuses = 0;
+	};
+
+	constexpr std::uint32_t meshCount = 4096;
+	constexpr std::uint32_t meshBytes = 512;
+
+	void RunUploads(bkmz::bench::State &state, const char *variant, std::uint32_t batchSize, std::uint64_t latency)
+	{
+		std::vector<std::uint8_t> staging(meshCount * meshBytes, 1), gpu(meshCount * meshBytes);
+		LaggingCopyQueue backend(latency);
+		UploadQueue uploads(backend, UploadQueue::defaultAllocatorCount, batchSize);
+
+		state.Variant(variant).Run(meshCount, [&]()
+		{
+			std::uint64_t last = 0;
+			for (std::uint32_t i = 0; i < meshCount; i++)
+			{
+				last = uploads.Copy({ gpu.data(), (std::uint64_t)i * meshBytes, staging.data(), (std::uint64_t)i * meshBytes, meshBytes });
+			}
+			uploads.Flush();
+			uploads.Poll();
+			bkmz::bench::DoNotOptimize(uploads.IsComplete(last));
+		});
+		const UploadQueueStats &stats = uploads.Stats();
+		state.Counter("submissions_per_frame", (double)stats.batches * meshCount / (double)stats.copies);
+		state.Counter("allocator_waits_per_frame", (double)stats.allocatorWaits * meshCount / (double)stats.copies);
+
+		if (backend.EarlyReuses() != 0)
+		{
+			state.Fail(std::to_string(backend.EarlyReuses()) + " submissions reused an allocator before its fence completed");
+		}
+
+		// Each batch frees its allocator `latency` submissions later, so once
+		// the ring has gone round once every submission waits if that's not
+		// sooner than the allocator comes back, and none does otherwise.
+		const std::uint64_t ring = UploadQueue::defaultAllocatorCount;
+		const std::uint64_t expectedWaits = latency >= ring && stats.batches > ring ? stats.batches - ring : 0;
+		if (stats.allocatorWaits != expectedWaits)
+		{
+			state.Fail(std::to_string(stats.allocatorWaits) + " allocator waits, expected " + std::to_string(expectedWaits));
+		}
+	}
+}
+
+BKMZ_BENCHMARK(UploadObjectData)
+{
+	// What MyApp did before: every object's data written every frame.
+	std::vector<ObjectData> objects(objectCount), staging(objectCount);
+	state.Variant("RewriteAll").Run(objectCount, [&]()
+	{
+		objects[0].materialIndex++;
+		std::copy(objects.begin(), objects.end(), staging.begin());
+		bkmz::bench::DoNotOptimize(staging.data());
+	});
+	state.Counter("bytes_uploaded", (double)objectCount * sizeof(ObjectData));
+	state.Counter("runs", 1);
+
+	std::vector<std::uint32_t> all(objectCount);
+	std::iota(all.begin(), all.end(), 0u);
+	RunTracked(state, "Tracked/All", all);
+	RunTracked(state, "Tracked/Random10Percent", RandomIndices(objectCount / 10));
+	RunTracked(state, "Tracked/Random1Percent", RandomIndices(objectCount / 100));
+
+	// Objects created together sit next to each other, so a moving subtree
+	// tends to be one run.
+	std::vector<std::uint32_t> block(objectCount / 100);
+	std::iota(block.begin(), block.end(), objectCount / 2);
+	RunTracked(state, "Tracked/Block1Percent", block);
+
+	RunTracked(state, "Tracked/None", {});
+}
+
+BKMZ_BENCHMARK(UploadQueue)
+{
+	// The copy queue lags one submission less than the allocator ring is
+	// long, so the ring absorbs it.
+	const std::uint64_t latency = UploadQueue::defaultAllocatorCount - 1;
+	RunUploads(state, "Batch1", 1, latency);
+	RunUploads(state, "Batch16", 16, latency);
+	RunUploads(state, "Batch256", UploadQueue::defaultBatchSize, latency);
+	RunUploads(state, "Batch256Stalled", UploadQueue::defaultBatchSize, UploadQueue::defaultAllocatorCount);
+}
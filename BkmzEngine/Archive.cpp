@@ -0,0 +1,327 @@
+#include "Archive.h"
+#include "Hash.h"
+#include "Lz4.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	constexpr std::uint32_t maxBucketBits = 24;
+
+	std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	std::uint32_t BucketOf(std::uint64_t nameHash, std::uint32_t bucketBits)
+	{
+		return bucketBits == 0 ? 0 : (std::uint32_t)(nameHash >> (64 - bucketBits));
+	}
+
+	// Where the entries start, 8 byte aligned after the bucket table.
+	std::uint64_t EntriesOffset(std::uint32_t bucketBits)
+	{
+		return AlignUp(sizeof(ArchiveHeader) + ((std::uint64_t(1) << bucketBits) + 1) * sizeof(std::uint32_t), 8);
+	}
+}
+
+Archive::Archive(const std::string &path)
+	: file(path)
+{
+	const std::uint8_t *data = file.Data();
+	const std::uint64_t size = file.Size();
+
+	ArchiveHeader header;
+	if (size < sizeof(header))
+	{
+		throw std::runtime_error(path + " isn't an asset archive.");
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (header.magic != ArchiveHeader::magicValue || header.version != ArchiveHeader::currentVersion)
+	{
+		throw std::runtime_error(path + " isn't an asset archive, or one from another version.");
+	}
+	if (header.fileSize != size || header.bucketBits > maxBucketBits)
+	{
+		throw std::runtime_error(path + " is damaged.");
+	}
+
+	const std::uint64_t entriesOffset = EntriesOffset(header.bucketBits);
+	const std::uint64_t namesOffset = entriesOffset + (std::uint64_t)header.entryCount * sizeof(ArchiveEntry);
+	if (namesOffset + header.namesSize > size)
+	{
+		throw std::runtime_error(path + " is damaged.");
+	}
+
+	bucketBits = header.bucketBits;
+	buckets = { reinterpret_cast<const std::uint32_t *>(data + sizeof(header)), (std::size_t(1) << bucketBits) + 1 };
+	entries = { reinterpret_cast<const ArchiveEntry *>(data + entriesOffset), header.entryCount };
+	names = reinterpret_cast<const char *>(data + namesOffset);
+
+	// Checked once here so lookups and reads can trust the tables.
+	if (buckets.back() != header.entryCount || !std::is_sorted(buckets.begin(), buckets.end()))
+	{
+		throw std::runtime_error(path + " is damaged.");
+	}
+	for (const ArchiveEntry &entry : entries)
+	{
+		const bool badName = (std::uint64_t)entry.nameOffset + entry.nameLength > header.namesSize;
+		const bool badData = entry.offset > size || entry.storedSize > size - entry.offset;
+		const bool badSize = entry.compression == ArchiveCompression::None ? entry.size != entry.storedSize : entry.compression != ArchiveCompression::Lz4;
+		if (badName || badData || badSize)
+		{
+			throw std::runtime_error(path + " is damaged.");
+		}
+	}
+}
+
+std::string_view Archive::Name(const ArchiveEntry &entry) const
+{
+	return { names + entry.nameOffset, entry.nameLength };
+}
+
+const ArchiveEntry *Archive::Find(std::string_view name) const
+{
+	if (entries.empty())
+	{
+		return nullptr;
+	}
+
+	const std::uint64_t hash = bkmz::utl::Hash64(name);
+	const std::uint32_t bucket = BucketOf(hash, bucketBits);
+	for (std::uint32_t i = buckets[bucket]; i < buckets[bucket + 1]; i++)
+	{
+		if (entries[i].nameHash == hash && Name(entries[i]) == name)
+		{
+			return &entries[i];
+		}
+	}
+	return nullptr;
+}
+
+std::span<const std::uint8_t> Archive::View(const ArchiveEntry &entry) const
+{
+	if (entry.compression != ArchiveCompression::None)
+	{
+		return {};
+	}
+	return { file.Data() + entry.offset, (std::size_t)entry.size };
+}
+
+void Archive::Read(const ArchiveEntry &entry, std::span<std::uint8_t> destination) const
+{
+	if (destination.size() != entry.size)
+	{
+		throw std::runtime_error("Wrong buffer size for archive entry.");
+	}
+
+	const std::uint8_t *stored = file.Data() + entry.offset;
+	switch (entry.compression)
+	{
+	case ArchiveCompression::None:
+		std::memcpy(destination.data(), stored, destination.size());
+		break;
+	case ArchiveCompression::Lz4:
+		if (!bkmz::lz4::Decompress(stored, (std::size_t)entry.storedSize, destination.data(), destination.size()))
+		{
+			throw std::runtime_error("Archive entry " + std::string(Name(entry)) + " is damaged.");
+		}
+		break;
+	}
+}
+
+std::vector<std::uint8_t> Archive::Read(std::string_view name) const
+{
+	const ArchiveEntry *entry = Find(name);
+	if (!entry)
+	{
+		throw std::runtime_error("Asset " + std::string(name) + " isn't in the archive.");
+	}
+
+	std::vector<std::uint8_t> data((std::size_t)entry->size);
+	Read(*entry, data);
+	return data;
+}
+
+ArchiveWriter::ArchiveWriter(std::uint32_t alignment)
+	: alignment((std::max)(alignment, 8u))
+{
+	if ((this->alignment & (this->alignment - 1)) != 0)
+	{
+		throw std::runtime_error("Archive alignment must be a power of two.");
+	}
+}
+
+void ArchiveWriter::Add(std::string name, std::vector<std::uint8_t> data, ArchiveCompression compression)
+{
+	if (name.size() > 0xffff)
+	{
+		throw std::runtime_error("Asset name too long: " + name);
+	}
+
+	const std::uint64_t nameHash = bkmz::utl::Hash64(name);
+	const std::uint64_t contentHash = bkmz::utl::Hash64(data.data(), data.size());
+	const std::uint64_t size = data.size();
+
+	std::uint32_t blob = ~0u;
+	auto [first, last] = blobsByHash.equal_range(contentHash);
+	for (auto it = first; it != last; ++it)
+	{
+		if (originals[it->second] == data)
+		{
+			blob = it->second;
+			break;
+		}
+	}
+
+	if (blob == ~0u)
+	{
+		Blob stored{ {}, ArchiveCompression::None };
+		if (compression == ArchiveCompression::Lz4 && !data.empty())
+		{
+			std::vector<std::uint8_t> compressed(bkmz::lz4::CompressBound(data.size()));
+			compressed.resize(bkmz::lz4::Compress(data.data(), data.size(), compressed.data()));
+			// Not worth decoding for less than an eighth saved.
+			if (compressed.size() < data.size() - data.size() / 8)
+			{
+				stored = { std::move(compressed), ArchiveCompression::Lz4 };
+			}
+		}
+		if (stored.compression == ArchiveCompression::None)
+		{
+			stored.stored = data;
+		}
+
+		blob = (std::uint32_t)blobs.size();
+		blobs.push_back(std::move(stored));
+		originals.push_back(std::move(data));
+		blobsByHash.emplace(contentHash, blob);
+	}
+
+	pending.push_back({ std::move(name), nameHash, contentHash, blob, size });
+}
+
+ArchiveWriter::Stats ArchiveWriter::Write(const std::string &path) const
+{
+	std::vector<const Pending *> sorted;
+	for (const Pending &item : pending)
+	{
+		sorted.push_back(&item);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const Pending *a, const Pending *b)
+	{
+		return a->nameHash != b->nameHash ? a->nameHash < b->nameHash : a->name < b->name;
+	});
+	for (std::size_t i = 1; i < sorted.size(); i++)
+	{
+		if (sorted[i]->name == sorted[i - 1]->name)
+		{
+			throw std::runtime_error("Asset " + sorted[i]->name + " added twice.");
+		}
+	}
+
+	// About one entry per bucket.
+	std::uint32_t bucketBits = 0;
+	while (bucketBits < maxBucketBits && (std::size_t(1) << bucketBits) < sorted.size())
+	{
+		bucketBits++;
+	}
+
+	std::vector<std::uint32_t> buckets((std::size_t(1) << bucketBits) + 1, 0);
+	for (const Pending *item : sorted)
+	{
+		buckets[BucketOf(item->nameHash, bucketBits) + 1]++;
+	}
+	for (std::size_t i = 1; i < buckets.size(); i++)
+	{
+		buckets[i] += buckets[i - 1];
+	}
+
+	std::string names;
+	std::vector<ArchiveEntry> entries;
+	for (const Pending *item : sorted)
+	{
+		ArchiveEntry entry = {};
+		entry.nameHash = item->nameHash;
+		entry.contentHash = item->contentHash;
+		entry.storedSize = blobs[item->blob].stored.size();
+		entry.size = item->size;
+		entry.nameOffset = (std::uint32_t)names.size();
+		entry.nameLength = (std::uint16_t)item->name.size();
+		entry.compression = blobs[item->blob].compression;
+		entries.push_back(entry);
+		names += item->name;
+	}
+
+	const std::uint64_t entriesOffset = EntriesOffset(bucketBits);
+	const std::uint64_t namesOffset = entriesOffset + entries.size() * sizeof(ArchiveEntry);
+
+	Stats stats;
+	std::vector<std::uint64_t> blobOffsets;
+	std::uint64_t offset = namesOffset + names.size();
+	for (const Blob &blob : blobs)
+	{
+		offset = AlignUp(offset, alignment);
+		blobOffsets.push_back(offset);
+		offset += blob.stored.size();
+		stats.storedBytes += blob.stored.size();
+	}
+	stats.fileSize = offset;
+	stats.entries = (std::uint32_t)entries.size();
+	stats.blobs = (std::uint32_t)blobs.size();
+
+	for (std::size_t i = 0; i < entries.size(); i++)
+	{
+		entries[i].offset = blobOffsets[sorted[i]->blob];
+		stats.rawBytes += entries[i].size;
+	}
+
+	ArchiveHeader header = {};
+	header.magic = ArchiveHeader::magicValue;
+	header.version = ArchiveHeader::currentVersion;
+	header.entryCount = (std::uint32_t)entries.size();
+	header.bucketBits = bucketBits;
+	header.alignment = alignment;
+	header.namesSize = (std::uint32_t)names.size();
+	header.fileSize = stats.fileSize;
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		throw std::runtime_error("Can't create " + path);
+	}
+
+	std::uint64_t written = 0;
+	auto write = [&out, &written](const void *data, std::size_t size)
+	{
+		out.write(static_cast<const char *>(data), (std::streamsize)size);
+		written += size;
+	};
+	auto padTo = [&write, &written](std::uint64_t target)
+	{
+		static const char zeros[4096] = {};
+		while (written < target)
+		{
+			write(zeros, (std::size_t)(std::min)(target - written, (std::uint64_t)sizeof(zeros)));
+		}
+	};
+
+	write(&header, sizeof(header));
+	write(buckets.data(), buckets.size() * sizeof(std::uint32_t));
+	padTo(entriesOffset);
+	write(entries.data(), entries.size() * sizeof(ArchiveEntry));
+	write(names.data(), names.size());
+	for (std::size_t i = 0; i < blobs.size(); i++)
+	{
+		padTo(blobOffsets[i]);
+		write(blobs[i].stored.data(), blobs[i].stored.size());
+	}
+
+	if (!out.flush())
+	{
+		throw std::runtime_error("Can't write " + path);
+	}
+	return stats;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include "FileIo.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Single-file asset archive.
+//
+// Layout, all little endian:
+//
+//   ArchiveHeader
+//   bucket table   (1 << bucketBits) + 1 entry indices
+//   ArchiveEntry   entryCount of them, sorted by name hash
+//   names          entryCount names, not null terminated
+//   data           every blob starts at a multiple of the alignment
+//
+// The archive is memory mapped as a whole and used in place. The top
+// bucketBits of a name's hash pick a bucket, whose few entries are the only
+// ones compared, so a lookup costs the same however many assets there are.
+// Entries with identical content share one blob.
+
+enum class ArchiveCompression : std::uint8_t
+{
+	None,
+	Lz4,
+};
+
+struct ArchiveHeader
+{
+	static constexpr std::uint32_t magicValue = 0x4b504b42; // "BKPK"
+	static constexpr std::uint32_t currentVersion = 1;
+
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint32_t entryCount;
+	std::uint32_t bucketBits;
+	std::uint32_t alignment;
+	std::uint32_t namesSize;
+	std::uint64_t fileSize;
+};
+
+struct ArchiveEntry
+{
+	std::uint64_t nameHash;
+	std::uint64_t contentHash; // of the uncompressed data
+	std::uint64_t offset;      // of the stored blob, from the archive start
+	std::uint64_t storedSize;
+	std::uint64_t size;        // uncompressed
+	std::uint32_t nameOffset;  // into the names
+	std::uint16_t nameLength;
+	ArchiveCompression compression;
+	std::uint8_t padding;
+};
+
+static_assert(sizeof(ArchiveHeader) == 32);
+static_assert(sizeof(ArchiveEntry) == 48);
+
+class Archive
+{
+public:
+	Archive() = default;
+
+	// Throws if the file is missing or isn't a valid archive.
+	explicit Archive(const std::string &path);
+
+	bool IsOpen() const { return file.IsOpen(); }
+
+	std::span<const ArchiveEntry> Entries() const { return entries; }
+	std::string_view Name(const ArchiveEntry &entry) const;
+
+	// nullptr when there is no such asset.
+	const ArchiveEntry *Find(std::string_view name) const;
+	bool Contains(std::string_view name) const { return Find(name) != nullptr; }
+
+	// The data of an uncompressed entry, straight from the mapping. Empty
+	// for compressed entries.
+	std::span<const std::uint8_t> View(const ArchiveEntry &entry) const;
+
+	// Decompresses into `destination`, which must hold entry.size bytes.
+	void Read(const ArchiveEntry &entry, std::span<std::uint8_t> destination) const;
+
+	// Throws when the asset doesn't exist.
+	std::vector<std::uint8_t> Read(std::string_view name) const;
+
+private:
+	MappedFile file;
+	std::span<const std::uint32_t> buckets;
+	std::span<const ArchiveEntry> entries;
+	const char *names = nullptr;
+	std::uint32_t bucketBits = 0;
+};
+
+// Builds archives, see BkmzPack.
+class ArchiveWriter
+{
+public:
+	struct Stats
+	{
+		std::uint32_t entries = 0;
+		std::uint32_t blobs = 0; // after deduplication
+		std::uint64_t rawBytes = 0;
+		std::uint64_t storedBytes = 0;
+		std::uint64_t fileSize = 0;
+	};
+
+	// Blobs are aligned to `alignment` bytes, a power of two. File::directAlignment
+	// lets blobs be read with direct I/O, smaller ones waste less space.
+	explicit ArchiveWriter(std::uint32_t alignment = 64);
+
+	// LZ4 is only kept where it actually saves space, the rest is stored
+	// as is and read without any decoding.
+	void Add(std::string name, std::vector<std::uint8_t> data, ArchiveCompression compression = ArchiveCompression::Lz4);
+
+	// Throws if a name was added twice.
+	Stats Write(const std::string &path) const;
+
+private:
+	struct Pending
+	{
+		std::string name;
+		std::uint64_t nameHash;
+		std::uint64_t contentHash;
+		std::uint32_t blob;
+		std::uint64_t size;
+	};
+
+	struct Blob
+	{
+		std::vector<std::uint8_t> stored;
+		ArchiveCompression compression;
+	};
+
+private:
+	std::uint32_t alignment;
+	std::vector<Pending> pending;
+	std::vector<Blob> blobs;
+	std::vector<std::vector<std::uint8_t>> originals; // by blob, for deduplication
+	std::unordered_multimap<std::uint64_t, std::uint32_t> blobsByHash;
+};
@@ -0,0 +1,288 @@
+#include "AssetStreamer.h"
+#include "Clock.h"
+#include <algorithm>
+#include <exception>
+
+AssetStreamer::AssetStreamer(unsigned workerCount)
+{
+	workerCount = (std::max)(workerCount, 1u);
+	for (unsigned i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(&AssetStreamer::WorkerThread, this);
+	}
+}
+
+AssetStreamer::~AssetStreamer()
+{
+	Stop();
+}
+
+AssetStreamer::RequestId AssetStreamer::Load(LoadFunction load, CompleteFunction complete, float priority)
+{
+	RequestId id;
+	{
+		std::lock_guard lock(mutex);
+		id = nextId++;
+		queue.push_back({ id, priority, std::move(load), std::move(complete) });
+		if (!queueDirty)
+		{
+			std::push_heap(queue.begin(), queue.end(), HeapOrder);
+		}
+	}
+	wake.notify_one();
+	return id;
+}
+
+void AssetStreamer::SetPriority(RequestId id, float priority)
+{
+	std::lock_guard lock(mutex);
+	for (Job &job : queue)
+	{
+		if (job.id == id)
+		{
+			if (job.priority != priority)
+			{
+				job.priority = priority;
+				queueDirty = true;
+			}
+			return;
+		}
+	}
+
+	for (Loading &entry : loading)
+	{
+		if (entry.id == id)
+		{
+			entry.priority = priority;
+			return;
+		}
+	}
+
+	for (Finished &entry : finished)
+	{
+		if (entry.completion.id == id)
+		{
+			entry.priority = priority;
+			return;
+		}
+	}
+
+	for (Finished &entry : ready)
+	{
+		if (entry.completion.id == id)
+		{
+			entry.priority = priority;
+			return;
+		}
+	}
+}
+
+void AssetStreamer::SetPriorities(std::span<const PriorityUpdate> updates)
+{
+	// Sorted by id, so each request finds its update with a binary search
+	// rather than every update scanning every list.
+	const auto byId = [](const PriorityUpdate &a, const PriorityUpdate &b) { return a.id < b.id; };
+	sortedUpdates.assign(updates.begin(), updates.end());
+	if (!std::is_sorted(sortedUpdates.begin(), sortedUpdates.end(), byId))
+	{
+		std::sort(sortedUpdates.begin(), sortedUpdates.end(), byId);
+	}
+
+	const auto find = [this, &byId](RequestId id) -> const PriorityUpdate *
+	{
+		const auto update = std::lower_bound(sortedUpdates.begin(), sortedUpdates.end(), PriorityUpdate{ id, 0.0f }, byId);
+		return update != sortedUpdates.end() && update->id == id ? &*update : nullptr;
+	};
+
+	for (Finished &entry : ready)
+	{
+		if (const PriorityUpdate *update = find(entry.completion.id))
+		{
+			entry.priority = update->priority;
+		}
+	}
+
+	std::lock_guard lock(mutex);
+	for (Job &job : queue)
+	{
+		const PriorityUpdate *update = find(job.id);
+		if (update && job.priority != update->priority)
+		{
+			job.priority = update->priority;
+			queueDirty = true;
+		}
+	}
+
+	for (Loading &entry : loading)
+	{
+		if (const PriorityUpdate *update = find(entry.id))
+		{
+			entry.priority = update->priority;
+		}
+	}
+
+	for (Finished &entry : finished)
+	{
+		if (const PriorityUpdate *update = find(entry.completion.id))
+		{
+			entry.priority = update->priority;
+		}
+	}
+}
+
+void AssetStreamer::Cancel(RequestId id)
+{
+	// ready is only touched by the main thread, like this call.
+	std::erase_if(ready, [id](const Finished &entry) { return entry.completion.id == id; });
+
+	std::lock_guard lock(mutex);
+	const auto job = std::find_if(queue.begin(), queue.end(), [id](const Job &job) { return job.id == id; });
+	if (job != queue.end())
+	{
+		queue.erase(job);
+		queueDirty = true;
+		return;
+	}
+
+	for (Loading &entry : loading)
+	{
+		if (entry.id == id)
+		{
+			entry.cancelled = true;
+			return;
+		}
+	}
+
+	std::erase_if(finished, [id](const Finished &entry) { return entry.completion.id == id; });
+}
+
+StreamingFrameStats AssetStreamer::Update(std::uint64_t byteBudget)
+{
+	const std::int64_t start = Clock::Now();
+
+	{
+		std::lock_guard lock(mutex);
+		for (Finished &entry : finished)
+		{
+			ready.push_back(std::move(entry));
+		}
+		finished.clear();
+	}
+
+	StreamingFrameStats stats;
+	if (!ready.empty())
+	{
+		std::stable_sort(ready.begin(), ready.end(), [](const Finished &a, const Finished &b) { return a.priority > b.priority; });
+
+		std::size_t count = 0;
+		while (count < ready.size() && (count == 0 || stats.bytes + ready[count].completion.data.size() <= byteBudget))
+		{
+			stats.bytes += ready[count].completion.data.size();
+			count++;
+		}
+
+		// Callbacks may call back into the streamer, so take the entries out
+		// of ready first.
+		handOut.assign(std::make_move_iterator(ready.begin()), std::make_move_iterator(ready.begin() + count));
+		ready.erase(ready.begin(), ready.begin() + count);
+
+		for (Finished &entry : handOut)
+		{
+			entry.complete(std::move(entry.completion));
+		}
+		handOut.clear();
+		stats.completed = (std::uint32_t)count;
+	}
+
+	stats.time = (float)Clock::ToSeconds(Clock::Now() - start);
+	if (stats.time > worstFrame.time)
+	{
+		worstFrame = stats;
+	}
+	return stats;
+}
+
+std::size_t AssetStreamer::PendingCount() const
+{
+	std::lock_guard lock(mutex);
+	return queue.size() + loading.size() + finished.size() + ready.size();
+}
+
+void AssetStreamer::Stop()
+{
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+
+	queue.clear();
+	finished.clear();
+	ready.clear();
+}
+
+bool AssetStreamer::HeapOrder(const Job &a, const Job &b)
+{
+	return a.priority < b.priority;
+}
+
+void AssetStreamer::WorkerThread()
+{
+	std::unique_lock lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+		if (stopping)
+		{
+			return;
+		}
+
+		if (queueDirty)
+		{
+			std::make_heap(queue.begin(), queue.end(), HeapOrder);
+			queueDirty = false;
+		}
+		std::pop_heap(queue.begin(), queue.end(), HeapOrder);
+		Job job = std::move(queue.back());
+		queue.pop_back();
+		loading.push_back({ job.id, job.priority, false });
+		lock.unlock();
+
+		Completion completion;
+		completion.id = job.id;
+		try
+		{
+			completion.data = job.load();
+		}
+		catch (const std::exception &e)
+		{
+			completion.data.clear();
+			completion.error = e.what();
+			if (completion.error.empty())
+			{
+				completion.error = "Asset load failed.";
+			}
+		}
+
+		lock.lock();
+		const auto entry = std::find_if(loading.begin(), loading.end(), [&job](const Loading &entry) { return entry.id == job.id; });
+		if (!entry->cancelled)
+		{
+			finished.push_back({ entry->priority, std::move(job.complete), std::move(completion) });
+		}
+		loading.erase(entry);
+	}
+}
+
+float StreamingPriority(float distance, bool visible)
+{
+	// Maps distance into (0, 1], visibility adds a whole step on top.
+	const float nearness = 1.0f / (1.0f + (std::max)(distance, 0.0f));
+	return visible ? 1.0f + nearness : nearness;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What one Update() call cost the main thread.
+struct StreamingFrameStats
+{
+	float time = 0.0f;        // seconds spent in Update, callbacks included
+	std::uint64_t bytes = 0;  // handed to completion callbacks
+	std::uint32_t completed = 0;
+};
+
+// Loads assets on I/O worker threads and hands the results back on the
+// main thread.
+//
+// Workers always start the most urgent queued request first; priorities can
+// change at any time while a request is queued, typically every frame from
+// camera distance and visibility (see StreamingPriority). Finished loads
+// wait until Update(), which runs their completion callbacks, most urgent
+// first, until the frame's byte budget is used up. Callbacks are where new
+// data enters the GPU upload path, so the budget bounds what streaming can
+// add to any single frame.
+class AssetStreamer
+{
+public:
+	using RequestId = std::uint64_t;
+	static constexpr RequestId noRequest = 0;
+
+	struct Completion
+	{
+		RequestId id = noRequest;
+		std::vector<std::uint8_t> data;
+		std::string error; // empty when the load succeeded
+
+		bool Ok() const { return error.empty(); }
+	};
+
+	// Runs on a worker. Throwing fails the request with the exception's
+	// message.
+	using LoadFunction = std::function<std::vector<std::uint8_t>()>;
+
+	// Runs on the main thread, inside Update().
+	using CompleteFunction = std::function<void(Completion &&completion)>;
+
+	explicit AssetStreamer(unsigned workerCount = 2);
+	~AssetStreamer();
+
+	AssetStreamer(const AssetStreamer &) = delete;
+	AssetStreamer &operator=(const AssetStreamer &) = delete;
+
+	// Higher priority loads first.
+	RequestId Load(LoadFunction load, CompleteFunction complete, float priority);
+
+	// Only affects requests no worker has picked up yet, and the order in
+	// which finished ones are handed out.
+	void SetPriority(RequestId id, float priority);
+
+	struct PriorityUpdate
+	{
+		RequestId id;
+		float priority;
+	};
+
+	// SetPriority for many requests under one lock, with the queue reordered
+	// once for all of them. Main thread only.
+	void SetPriorities(std::span<const PriorityUpdate> updates);
+
+	// The completion callback won't run. A load already in progress still
+	// runs to the end, its result is dropped.
+	void Cancel(RequestId id);
+
+	// Main thread only. Always hands out at least one finished load, so an
+	// asset bigger than the budget still arrives.
+	StreamingFrameStats Update(std::uint64_t byteBudget);
+
+	// Queued, loading, or finished but not yet handed out.
+	std::size_t PendingCount() const;
+
+	// The most expensive Update() so far, by time.
+	const StreamingFrameStats &WorstFrame() const { return worstFrame; }
+
+	// Joins the workers. Requests that haven't finished are dropped.
+	void Stop();
+
+private:
+	struct Job
+	{
+		RequestId id;
+		float priority;
+		LoadFunction load;
+		CompleteFunction complete;
+	};
+
+	struct Loading
+	{
+		RequestId id;
+		float priority;
+		bool cancelled;
+	};
+
+	struct Finished
+	{
+		float priority;
+		CompleteFunction complete;
+		Completion completion;
+	};
+
+	static bool HeapOrder(const Job &a, const Job &b);
+	void WorkerThread();
+
+private:
+	std::vector<std::thread> workers;
+
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	RequestId nextId = 1;
+
+	std::vector<Job> queue; // max heap by priority, unless queueDirty
+	bool queueDirty = false;
+	std::vector<Loading> loading;
+	std::vector<Finished> finished;
+
+	// Main thread only.
+	std::vector<PriorityUpdate> sortedUpdates;
+	std::vector<Finished> ready;
+	std::vector<Finished> handOut;
+	StreamingFrameStats worstFrame;
+};
+
+// Priority for StreamingPriority-ordered loads: anything visible comes
+// before anything that isn't, and nearer before farther within each group.
+float StreamingPriority(float distance, bool visible);
@@ -0,0 +1,860 @@
+#include "Broadphase.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iterator>
+
+using namespace bkmz::math;
+
+namespace
+{
+	// Cell and tile coordinates are clamped to 21 bits each so three pack
+	// into one key. Bodies past that share the border cells, which costs
+	// tests but loses no pairs.
+	constexpr std::int64_t cellLimit = (1 << 20) - 1;
+
+	// The grid buckets its entries by this many partitions first.
+	constexpr std::uint32_t partitionCount = 256;
+
+	// Chunks of `order` for splitting it into columns. Every chunk counts
+	// into its own histogram over the buckets, so they're larger than
+	// Broadphase::grain to keep those few.
+	constexpr std::uint32_t partitionGrain = 1 << 14;
+
+	std::int64_t CellOf(float value, float inverseSize)
+	{
+		const double cell = std::floor((double)value * inverseSize);
+		return (std::int64_t)(std::max)((double)-cellLimit, (std::min)(cell, (double)cellLimit));
+	}
+
+	std::uint64_t PackCell(std::int64_t x, std::int64_t y, std::int64_t z)
+	{
+		constexpr std::int64_t bias = cellLimit + 1;
+		return (std::uint64_t)(x + bias) | (std::uint64_t)(y + bias) << 21 | (std::uint64_t)(z + bias) << 42;
+	}
+
+	// MurmurHash3's finalizer, cells next to each other land far apart.
+	std::uint32_t Bucket(std::uint64_t cell, std::uint32_t mask)
+	{
+		cell ^= cell >> 33;
+		cell *= 0xff51afd7ed558ccdull;
+		cell ^= cell >> 33;
+		cell *= 0xc4ceb9fe1a85ec53ull;
+		cell ^= cell >> 33;
+		return (std::uint32_t)cell & mask;
+	}
+
+	std::uint32_t BucketCount(std::uint32_t wanted)
+	{
+		std::uint32_t count = 256;
+		while (count < wanted)
+		{
+			count *= 2;
+		}
+		return count;
+	}
+
+	BroadphasePair MakePair(std::uint32_t a, std::uint32_t b)
+	{
+		return a < b ? BroadphasePair{ a, b } : BroadphasePair{ b, a };
+	}
+
+	bool PairLess(const BroadphasePair &left, const BroadphasePair &right)
+	{
+		return left.a != right.a ? left.a < right.a : left.b < right.b;
+	}
+
+	// Cell ranges of one body, on the axes a cell or tile key packs.
+	struct CellRange
+	{
+		std::int64_t low[3];
+		std::int64_t high[3];
+
+		std::uint64_t Count() const
+		{
+			return (std::uint64_t)(high[0] - low[0] + 1) * (high[1] - low[1] + 1) * (high[2] - low[2] + 1);
+		}
+
+		template <typename F>
+		void ForEach(F &&f) const
+		{
+			for (std::int64_t z = low[2]; z <= high[2]; z++)
+			{
+				for (std::int64_t y = low[1]; y <= high[1]; y++)
+				{
+					for (std::int64_t x = low[0]; x <= high[0]; x++)
+					{
+						f(PackCell(x, y, z));
+					}
+				}
+			}
+		}
+	};
+}
+
+Aabb TransformAabb(const Aabb &local, const Float4x4 &world)
+{
+	// The center moves as a point, the extents grow by the absolute values
+	// of the rotation and scale.
+	const Float3 center = TransformPoint((local.min + local.max) * 0.5f, world);
+	const Float3 extent = (local.max - local.min) * 0.5f;
+	Float3 reach;
+	reach.x = std::abs(world.m[0][0]) * extent.x + std::abs(world.m[1][0]) * extent.y + std::abs(world.m[2][0]) * extent.z;
+	reach.y = std::abs(world.m[0][1]) * extent.x + std::abs(world.m[1][1]) * extent.y + std::abs(world.m[2][1]) * extent.z;
+	reach.z = std::abs(world.m[0][2]) * extent.x + std::abs(world.m[1][2]) * extent.y + std::abs(world.m[2][2]) * extent.z;
+	return { center - reach, center + reach };
+}
+
+Broadphase::Broadphase(BroadphaseMethod method)
+	: method(method)
+{
+}
+
+Broadphase::BodyId Broadphase::Add(const Aabb &bounds)
+{
+	BodyId body;
+	if (!freeIds.empty())
+	{
+		body = freeIds.back();
+		freeIds.pop_back();
+	}
+	else
+	{
+		body = (BodyId)alive.size();
+		boxes.emplace_back();
+		alive.push_back(0);
+		inOrder.push_back(0);
+		isOversized.push_back(0);
+	}
+
+	alive[body] = 1;
+	bodyCount++;
+	addedIds.push_back(body);
+	SetBounds(body, bounds);
+	return body;
+}
+
+void Broadphase::Remove(BodyId body)
+{
+	if (!IsAlive(body))
+	{
+		return;
+	}
+	alive[body] = 0;
+	bodyCount--;
+	freeIds.push_back(body);
+	removedAny = true;
+	changed = true;
+}
+
+void Broadphase::Move(BodyId body, const Aabb &bounds)
+{
+	if (!IsAlive(body))
+	{
+		return;
+	}
+	SetBounds(body, bounds);
+	movedCount++;
+}
+
+void Broadphase::SetBounds(BodyId body, const Aabb &bounds)
+{
+	boxes[body] = { { bounds.min.x, bounds.min.y, bounds.min.z }, { bounds.max.x, bounds.max.y, bounds.max.z } };
+	changed = true;
+}
+
+Aabb Broadphase::Bounds(BodyId body) const
+{
+	if (!IsAlive(body))
+	{
+		return {};
+	}
+	const Box &box = boxes[body];
+	return { { box.lower[0], box.lower[1], box.lower[2] }, { box.upper[0], box.upper[1], box.upper[2] } };
+}
+
+void Broadphase::SetMethod(BroadphaseMethod method)
+{
+	if (method != this->method)
+	{
+		this->method = method;
+		axis = -1;
+		changed = true;
+	}
+}
+
+std::span<const BroadphasePair> Broadphase::PairsOf(BodyId body) const
+{
+	if ((std::size_t)body + 1 >= rowStarts.size())
+	{
+		return {};
+	}
+	return { pairs.data() + rowStarts[body], rowStarts[body + 1] - rowStarts[body] };
+}
+
+void Broadphase::Update(JobSystem &jobs)
+{
+	stats.moved = movedCount;
+	movedCount = 0;
+	stats.tests = 0;
+	stats.resorted = false;
+	if (!changed)
+	{
+		added.clear();
+		removed.clear();
+		stats.added = 0;
+		stats.removed = 0;
+		return;
+	}
+	changed = false;
+
+	chunksUsed = 0;
+	oversized.clear();
+	if (method == BroadphaseMethod::SweepAndPrune)
+	{
+		SweepAndPrune(jobs);
+	}
+	else
+	{
+		Grid(jobs);
+	}
+	TestOversized(jobs);
+	Collect(jobs);
+
+	stats.bodies = bodyCount;
+	stats.oversized = (std::uint32_t)oversized.size();
+	stats.pairs = (std::uint32_t)pairs.size();
+	stats.added = (std::uint32_t)added.size();
+	stats.removed = (std::uint32_t)removed.size();
+}
+
+Broadphase::Chunk &Broadphase::ChunkAt(std::uint32_t index)
+{
+	return chunks[chunksUsed + index];
+}
+
+Broadphase::Spread Broadphase::MeasureSpread(JobSystem &jobs)
+{
+	// Per chunk: count, then the sum and the sum of squares of the centers
+	// per axis, then the sum of the largest extents.
+	constexpr std::uint32_t fields = 8;
+	const std::uint32_t ids = (std::uint32_t)alive.size();
+	chunkSums.assign((std::size_t)JobSystem::ChunkCount(ids, grain) * fields, 0.0);
+	jobs.ParallelFor(ids, grain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		double sums[fields] = {};
+		for (BodyId body = begin; body < end; body++)
+		{
+			if (!alive[body])
+			{
+				continue;
+			}
+			const Box &box = boxes[body];
+			float largest = 0.0f;
+			for (int k = 0; k < 3; k++)
+			{
+				const double center = 0.5 * ((double)box.lower[k] + box.upper[k]);
+				sums[1 + k] += center;
+				sums[4 + k] += center * center;
+				largest = (std::max)(largest, box.upper[k] - box.lower[k]);
+			}
+			sums[0] += 1.0;
+			sums[7] += largest;
+		}
+		std::copy(sums, sums + fields, chunkSums.begin() + (std::size_t)(begin / grain) * fields);
+	});
+
+	double sums[fields] = {};
+	for (std::size_t i = 0; i < chunkSums.size(); i++)
+	{
+		sums[i % fields] += chunkSums[i];
+	}
+
+	Spread spread = {};
+	const double count = (std::max)(sums[0], 1.0);
+	for (int k = 0; k < 3; k++)
+	{
+		const double mean = sums[1 + k] / count;
+		spread.variance[k] = (float)(std::max)(sums[4 + k] / count - mean * mean, 0.0);
+	}
+	spread.meanExtent = (float)(sums[7] / count);
+	return spread;
+}
+
+void Broadphase::GatherOrder(JobSystem &jobs)
+{
+	orderBoxes.resize(order.size());
+	jobs.ParallelFor((std::uint32_t)order.size(), grain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (std::uint32_t i = begin; i < end; i++)
+		{
+			orderBoxes[i] = boxes[order[i]];
+		}
+	});
+}
+
+void Broadphase::SortOrder(JobSystem &jobs)
+{
+	order.clear();
+	for (BodyId body = 0; body < alive.size(); body++)
+	{
+		inOrder[body] = alive[body];
+		if (alive[body])
+		{
+			order.push_back(body);
+		}
+	}
+
+	const int k = axis;
+	std::sort(order.begin(), order.end(), [this, k](BodyId a, BodyId b)
+	{
+		const float left = boxes[a].lower[k];
+		const float right = boxes[b].lower[k];
+		return left != right ? left < right : a < b;
+	});
+	GatherOrder(jobs);
+	stats.resorted = true;
+}
+
+bool Broadphase::RepairOrder(JobSystem &jobs)
+{
+	if (removedAny)
+	{
+		std::size_t kept = 0;
+		for (BodyId body : order)
+		{
+			if (alive[body])
+			{
+				order[kept++] = body;
+			}
+			else
+			{
+				inOrder[body] = 0;
+			}
+		}
+		order.resize(kept);
+	}
+	for (BodyId body : addedIds)
+	{
+		if (alive[body] && !inOrder[body])
+		{
+			inOrder[body] = 1;
+			order.push_back(body);
+		}
+	}
+	GatherOrder(jobs);
+
+	// Insertion sort, giving up once it has moved bodies further in total
+	// than a few times their number.
+	const std::uint32_t count = (std::uint32_t)order.size();
+	std::uint64_t budget = (std::uint64_t)count * 4 + 1024;
+	for (std::uint32_t i = 1; i < count; i++)
+	{
+		const float key = orderBoxes[i].lower[axis];
+		if (!(key < orderBoxes[i - 1].lower[axis]))
+		{
+			continue;
+		}
+		const BodyId body = order[i];
+		const Box box = orderBoxes[i];
+		std::uint32_t j = i;
+		for (; j > 0 && key < orderBoxes[j - 1].lower[axis]; j--)
+		{
+			orderBoxes[j] = orderBoxes[j - 1];
+			order[j] = order[j - 1];
+		}
+		orderBoxes[j] = box;
+		order[j] = body;
+
+		if (budget < i - j)
+		{
+			return false;
+		}
+		budget -= i - j;
+	}
+	return true;
+}
+
+void Broadphase::SweepAndPrune(JobSystem &jobs)
+{
+	const Spread spread = MeasureSpread(jobs);
+
+	// Sweep along the axis the centers spread out most on. Switching costs
+	// a full sort, so only for a clearly better one.
+	int best = 0;
+	for (int k = 1; k < 3; k++)
+	{
+		if (spread.variance[k] > spread.variance[best])
+		{
+			best = k;
+		}
+	}
+	if (axis >= 0 && spread.variance[axis] * 1.5f >= spread.variance[best])
+	{
+		best = axis;
+	}
+	if (best != axis || !RepairOrder(jobs))
+	{
+		axis = best;
+		SortOrder(jobs);
+	}
+	addedIds.clear();
+	removedAny = false;
+
+	const int axes[3] = { axis, (axis + 1) % 3, (axis + 2) % 3 };
+	const float tileSize = cellSize > 0.0f ? cellSize : (std::max)(spread.meanExtent * 4.0f, 1e-3f);
+	const float inverseTile = 1.0f / tileSize;
+	auto tilesOf = [&](const Box &box)
+	{
+		CellRange range;
+		for (int k = 0; k < 2; k++)
+		{
+			range.low[k] = CellOf(box.lower[axes[1 + k]], inverseTile);
+			range.high[k] = CellOf(box.upper[axes[1 + k]], inverseTile);
+		}
+		range.low[2] = range.high[2] = 0;
+		return range;
+	};
+
+	// Split `order` into columns with a counting sort on the columns'
+	// buckets. Chunks count separately and write in turn, so each column's
+	// bodies stay in sweep order.
+	const std::uint32_t count = (std::uint32_t)order.size();
+	const std::uint32_t partitionChunks = JobSystem::ChunkCount(count, partitionGrain);
+	const std::uint32_t bucketCount = BucketCount(count / 16);
+	const std::uint32_t mask = bucketCount - 1;
+	histograms.assign((std::size_t)partitionChunks * bucketCount, 0);
+	chunkOversized.assign(partitionChunks, 0);
+	jobs.ParallelFor(count, partitionGrain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		const std::uint32_t chunk = begin / partitionGrain;
+		std::uint32_t *histogram = histograms.data() + (std::size_t)chunk * bucketCount;
+		for (std::uint32_t i = begin; i < end; i++)
+		{
+			const CellRange tiles = tilesOf(orderBoxes[i]);
+			if (tiles.Count() > maxCellsPerBody)
+			{
+				chunkOversized[chunk]++;
+				continue;
+			}
+			tiles.ForEach([&](std::uint64_t tile) { histogram[Bucket(tile, mask)]++; });
+		}
+	});
+
+	bucketStarts.resize(bucketCount + 1);
+	std::uint32_t offset = 0;
+	for (std::uint32_t bucket = 0; bucket < bucketCount; bucket++)
+	{
+		bucketStarts[bucket] = offset;
+		for (std::uint32_t chunk = 0; chunk < partitionChunks; chunk++)
+		{
+			std::uint32_t &slot = histograms[(std::size_t)chunk * bucketCount + bucket];
+			const std::uint32_t start = offset;
+			offset += slot;
+			slot = start;
+		}
+	}
+	bucketStarts[bucketCount] = offset;
+	std::uint32_t oversizedCount = 0;
+	for (std::uint32_t &chunkCount : chunkOversized)
+	{
+		const std::uint32_t start = oversizedCount;
+		oversizedCount += chunkCount;
+		chunkCount = start;
+	}
+
+	const std::uint32_t entryCount = offset;
+	bucketed.resize(entryCount);
+	oversized.resize(oversizedCount);
+	jobs.ParallelFor(count, partitionGrain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		const std::uint32_t chunk = begin / partitionGrain;
+		std::uint32_t *cursor = histograms.data() + (std::size_t)chunk * bucketCount;
+		for (std::uint32_t i = begin; i < end; i++)
+		{
+			const Box &box = orderBoxes[i];
+			const CellRange tiles = tilesOf(box);
+			if (tiles.Count() > maxCellsPerBody)
+			{
+				oversized[chunkOversized[chunk]++] = order[i];
+				continue;
+			}
+			Entry entry;
+			entry.body = order[i];
+			for (int k = 0; k < 3; k++)
+			{
+				entry.box.lower[k] = box.lower[axes[k]];
+				entry.box.upper[k] = box.upper[axes[k]];
+			}
+			tiles.ForEach([&](std::uint64_t tile)
+			{
+				entry.cell = tile;
+				bucketed[cursor[Bucket(tile, mask)]++] = entry;
+			});
+		}
+	});
+
+	// The sweep. A bucket can hold several columns whose hashes collide,
+	// interleaved but each still in order, so other columns' entries are
+	// skipped rather than ending the walk.
+	const std::uint32_t sweepChunks = JobSystem::ChunkCount(entryCount, grain);
+	if (chunks.size() < sweepChunks)
+	{
+		chunks.resize(sweepChunks);
+	}
+	jobs.ParallelFor(entryCount, grain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		Chunk &chunk = ChunkAt(begin / grain);
+		chunk.pairs.clear();
+		std::uint32_t tests = 0;
+		for (std::uint32_t i = begin; i < end; i++)
+		{
+			const Entry &first = bucketed[i];
+			const std::uint32_t last = bucketStarts[Bucket(first.cell, mask) + 1];
+			for (std::uint32_t j = i + 1; j < last && bucketed[j].box.lower[0] <= first.box.upper[0]; j++)
+			{
+				const Entry &second = bucketed[j];
+				if (second.cell != first.cell)
+				{
+					continue;
+				}
+				tests++;
+				const Box &a = first.box;
+				const Box &b = second.box;
+				if (OverlapsOn(a, b, 1) & OverlapsOn(a, b, 2)
+					&& PackCell(CellOf((std::max)(a.lower[1], b.lower[1]), inverseTile), CellOf((std::max)(a.lower[2], b.lower[2]), inverseTile), 0) == first.cell)
+				{
+					chunk.pairs.push_back(MakePair(first.body, second.body));
+				}
+			}
+		}
+		chunk.tests = tests;
+	});
+	chunksUsed += sweepChunks;
+}
+
+void Broadphase::Grid(JobSystem &jobs)
+{
+	// The sweep's order isn't kept up while the grid is in use.
+	axis = -1;
+	addedIds.clear();
+	removedAny = false;
+
+	float size = cellSize;
+	if (size <= 0.0f)
+	{
+		size = (std::max)(MeasureSpread(jobs).meanExtent * 2.0f, 1e-3f);
+	}
+	const float inverseSize = 1.0f / size;
+	auto cellsOf = [&](const Box &box)
+	{
+		CellRange range;
+		for (int k = 0; k < 3; k++)
+		{
+			range.low[k] = CellOf(box.lower[k], inverseSize);
+			range.high[k] = CellOf(box.upper[k], inverseSize);
+		}
+		return range;
+	};
+
+	// Every body's cells, in id order.
+	const std::uint32_t ids = (std::uint32_t)alive.size();
+	const std::uint32_t idChunks = JobSystem::ChunkCount(ids, grain);
+	chunkCounts.assign(idChunks, 0);
+	chunkOversized.assign(idChunks, 0);
+	jobs.ParallelFor(ids, grain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		const std::uint32_t chunk = begin / grain;
+		for (BodyId body = begin; body < end; body++)
+		{
+			if (!alive[body])
+			{
+				continue;
+			}
+			const std::uint64_t cells = cellsOf(boxes[body]).Count();
+			if (cells > maxCellsPerBody)
+			{
+				chunkOversized[chunk]++;
+			}
+			else
+			{
+				chunkCounts[chunk] += (std::uint32_t)cells;
+			}
+		}
+	});
+
+	std::uint32_t entryCount = 0;
+	std::uint32_t oversizedCount = 0;
+	for (std::uint32_t chunk = 0; chunk < idChunks; chunk++)
+	{
+		const std::uint32_t entryStart = entryCount;
+		const std::uint32_t oversizedStart = oversizedCount;
+		entryCount += chunkCounts[chunk];
+		oversizedCount += chunkOversized[chunk];
+		chunkCounts[chunk] = entryStart;
+		chunkOversized[chunk] = oversizedStart;
+	}
+
+	entries.resize(entryCount);
+	oversized.resize(oversizedCount);
+	jobs.ParallelFor(ids, grain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		const std::uint32_t chunk = begin / grain;
+		std::uint32_t at = chunkCounts[chunk];
+		for (BodyId body = begin; body < end; body++)
+		{
+			if (!alive[body])
+			{
+				continue;
+			}
+			const CellRange cells = cellsOf(boxes[body]);
+			if (cells.Count() > maxCellsPerBody)
+			{
+				oversized[chunkOversized[chunk]++] = body;
+				continue;
+			}
+			cells.ForEach([&](std::uint64_t cell) { entries[at++] = { cell, boxes[body], body }; });
+		}
+	});
+
+	// Bucket the entries by cell hash, in two passes so the writes stay in
+	// cache: by the hash's top bits into a few partitions, then each
+	// partition by the rest. Chunks count separately and write in turn, so
+	// either way the order doesn't depend on the threads.
+	const std::uint32_t bucketCount = BucketCount(entryCount);
+	const std::uint32_t mask = bucketCount - 1;
+	std::uint32_t lowBits = 0;
+	while ((partitionCount << lowBits) < bucketCount)
+	{
+		lowBits++;
+	}
+	const std::uint32_t entryChunks = JobSystem::ChunkCount(entryCount, grain);
+	histograms.assign((std::size_t)entryChunks * partitionCount, 0);
+	jobs.ParallelFor(entryCount, grain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		std::uint32_t *histogram = histograms.data() + (std::size_t)(begin / grain) * partitionCount;
+		for (std::uint32_t i = begin; i < end; i++)
+		{
+			histogram[Bucket(entries[i].cell, mask) >> lowBits]++;
+		}
+	});
+	std::uint32_t partitionStarts[partitionCount + 1];
+	std::uint32_t offset = 0;
+	for (std::uint32_t partition = 0; partition < partitionCount; partition++)
+	{
+		partitionStarts[partition] = offset;
+		for (std::uint32_t chunk = 0; chunk < entryChunks; chunk++)
+		{
+			std::uint32_t &slot = histograms[(std::size_t)chunk * partitionCount + partition];
+			const std::uint32_t start = offset;
+			offset += slot;
+			slot = start;
+		}
+	}
+	partitionStarts[partitionCount] = offset;
+	bucketed.resize(entryCount);
+	jobs.ParallelFor(entryCount, grain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		std::uint32_t *cursor = histograms.data() + (std::size_t)(begin / grain) * partitionCount;
+		for (std::uint32_t i = begin; i < end; i++)
+		{
+			bucketed[cursor[Bucket(entries[i].cell, mask) >> lowBits]++] = entries[i];
+		}
+	});
+
+	bucketStarts.resize(bucketCount + 1);
+	bucketCursors.resize(bucketCount);
+	jobs.ParallelFor(partitionCount, 1, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		const std::uint32_t span = 1u << lowBits;
+		for (std::uint32_t partition = begin; partition < end; partition++)
+		{
+			std::uint32_t *starts = bucketStarts.data() + ((std::size_t)partition << lowBits);
+			std::uint32_t *cursors = bucketCursors.data() + ((std::size_t)partition << lowBits);
+			std::fill(cursors, cursors + span, 0u);
+			for (std::uint32_t i = partitionStarts[partition]; i < partitionStarts[partition + 1]; i++)
+			{
+				cursors[Bucket(bucketed[i].cell, mask) & (span - 1)]++;
+			}
+			std::uint32_t at = partitionStarts[partition];
+			for (std::uint32_t bucket = 0; bucket < span; bucket++)
+			{
+				starts[bucket] = at;
+				at += cursors[bucket];
+				cursors[bucket] = starts[bucket];
+			}
+			for (std::uint32_t i = partitionStarts[partition]; i < partitionStarts[partition + 1]; i++)
+			{
+				entries[cursors[Bucket(bucketed[i].cell, mask) & (span - 1)]++] = bucketed[i];
+			}
+		}
+	});
+	bucketStarts[bucketCount] = entryCount;
+	std::swap(entries, bucketed);
+
+	// Every pair of bodies in the same cell.
+	const std::uint32_t bucketChunks = JobSystem::ChunkCount(bucketCount, grain);
+	if (chunks.size() < bucketChunks)
+	{
+		chunks.resize(bucketChunks);
+	}
+	jobs.ParallelFor(bucketCount, grain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		Chunk &chunk = ChunkAt(begin / grain);
+		chunk.pairs.clear();
+		std::uint32_t tests = 0;
+		for (std::uint32_t bucket = begin; bucket < end; bucket++)
+		{
+			const std::uint32_t last = bucketStarts[bucket + 1];
+			for (std::uint32_t i = bucketStarts[bucket]; i < last; i++)
+			{
+				const Entry &first = bucketed[i];
+				for (std::uint32_t j = i + 1; j < last; j++)
+				{
+					const Entry &second = bucketed[j];
+					if (second.cell != first.cell)
+					{
+						continue;
+					}
+					tests++;
+					const Box &a = first.box;
+					const Box &b = second.box;
+					if (Overlaps(a, b)
+						&& PackCell(CellOf((std::max)(a.lower[0], b.lower[0]), inverseSize),
+							CellOf((std::max)(a.lower[1], b.lower[1]), inverseSize),
+							CellOf((std::max)(a.lower[2], b.lower[2]), inverseSize)) == first.cell)
+					{
+						chunk.pairs.push_back(MakePair(first.body, second.body));
+					}
+				}
+			}
+		}
+		chunk.tests = tests;
+	});
+	chunksUsed += bucketChunks;
+}
+
+void Broadphase::TestOversized(JobSystem &jobs)
+{
+	if (oversized.empty())
+	{
+		return;
+	}
+
+	// Against every body. A pair of oversized bodies is reported by the
+	// one with the larger id.
+	for (BodyId body : oversized)
+	{
+		isOversized[body] = 1;
+	}
+	const std::uint32_t ids = (std::uint32_t)alive.size();
+	const std::uint32_t idChunks = JobSystem::ChunkCount(ids, grain);
+	if (chunks.size() < chunksUsed + idChunks)
+	{
+		chunks.resize(chunksUsed + idChunks);
+	}
+	jobs.ParallelFor(ids, grain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		Chunk &chunk = ChunkAt(begin / grain);
+		chunk.pairs.clear();
+		std::uint32_t tests = 0;
+		for (BodyId body = begin; body < end; body++)
+		{
+			if (!alive[body])
+			{
+				continue;
+			}
+			const Box &a = boxes[body];
+			for (BodyId large : oversized)
+			{
+				if (large == body || (isOversized[body] && body < large))
+				{
+					continue;
+				}
+				tests++;
+				const Box &b = boxes[large];
+				if (Overlaps(a, b))
+				{
+					chunk.pairs.push_back(MakePair(large, body));
+				}
+			}
+		}
+		chunk.tests = tests;
+	});
+	chunksUsed += idChunks;
+	for (BodyId body : oversized)
+	{
+		isOversized[body] = 0;
+	}
+}
+
+void Broadphase::Collect(JobSystem &jobs)
+{
+	std::swap(pairs, previousPairs);
+
+	// A counting sort on a, rows are then sorted on b. The chunks' pairs
+	// land in their rows in an order that depends on the threads, sorting
+	// the rows is what makes the result not.
+	const std::uint32_t ids = (std::uint32_t)alive.size();
+	rowStarts.assign((std::size_t)ids + 1, 0);
+	jobs.ParallelFor(chunksUsed, 1, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (std::uint32_t c = begin; c < end; c++)
+		{
+			for (const BroadphasePair &pair : chunks[c].pairs)
+			{
+				std::atomic_ref<std::uint32_t>(rowStarts[pair.a + 1]).fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	});
+	for (std::uint32_t body = 0; body < ids; body++)
+	{
+		rowStarts[body + 1] += rowStarts[body];
+	}
+
+	pairs.resize(rowStarts[ids]);
+	rowCursors.assign(rowStarts.begin(), rowStarts.end() - 1);
+	jobs.ParallelFor(chunksUsed, 1, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (std::uint32_t c = begin; c < end; c++)
+		{
+			for (const BroadphasePair &pair : chunks[c].pairs)
+			{
+				pairs[std::atomic_ref<std::uint32_t>(rowCursors[pair.a]).fetch_add(1, std::memory_order_relaxed)] = pair;
+			}
+		}
+	});
+	jobs.ParallelFor(ids, grain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (std::uint32_t body = begin; body < end; body++)
+		{
+			BroadphasePair *row = pairs.data() + rowStarts[body];
+			BroadphasePair *rowEnd = pairs.data() + rowStarts[body + 1];
+			if (rowEnd - row > 16)
+			{
+				std::sort(row, rowEnd, PairLess);
+				continue;
+			}
+			for (BroadphasePair *i = row + 1; i < rowEnd; i++)
+			{
+				const BroadphasePair pair = *i;
+				BroadphasePair *j = i;
+				for (; j > row && pair.b < j[-1].b; j--)
+				{
+					*j = j[-1];
+				}
+				*j = pair;
+			}
+		}
+	});
+
+	for (std::uint32_t c = 0; c < chunksUsed; c++)
+	{
+		stats.tests += chunks[c].tests;
+	}
+
+	added.clear();
+	removed.clear();
+	std::set_difference(pairs.begin(), pairs.end(), previousPairs.begin(), previousPairs.end(), std::back_inserter(added), PairLess);
+	std::set_difference(previousPairs.begin(), previousPairs.end(), pairs.begin(), pairs.end(), std::back_inserter(removed), PairLess);
+}
@@ -0,0 +1,240 @@
+#pragma once
+#include "JobSystem.h"
+#include "Math.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Collision broadphase: finds the pairs of bodies whose world space bounding
+// boxes overlap, the candidates a narrowphase then tests exactly, without
+// testing every body against every other.
+//
+// Two methods, picked per Broadphase:
+//
+// - Sweep and prune keeps the bodies sorted by their lower bound along the
+//   axis their centers spread out most on. The other two axes are cut into
+//   square tiles, making columns along the sweep axis, and a stable pass
+//   splits the sorted bodies into the columns they reach, still sorted. A
+//   body's overlaps are then found by walking forward from it in each of
+//   its columns until the lower bounds pass its upper bound, checking the
+//   other two axes as it goes. The order is kept between updates and
+//   repaired with an insertion sort, close to linear while bodies move a
+//   little each frame; only a change of axis, or motion so large the repair
+//   would cost more, sorts from scratch.
+// - The hashed grid drops each body into the uniform grid cells it covers,
+//   bucketed by a hash of the cell's coordinates, and tests the bodies
+//   sharing a cell.
+//
+// A pair sharing several columns or cells is only reported by the one
+// holding the corner of their overlap. Bodies covering too many of them
+// are kept out and tested against every body instead.
+//
+// Sweep and prune tiles only two axes, so bodies bunched up along the third
+// cost it little, and most of its sorting carries over between frames. The
+// grid keeps nothing between frames, which suits bodies that jump around or
+// are mostly new each update. Both split their work into chunks on a
+// JobSystem, and produce the same pairs.
+//
+// Pairs are reported as a < b and ordered by a then b whatever the method
+// or thread count, so a narrowphase can walk them deterministically and
+// match them against the last update's with Added() and Removed().
+
+struct Aabb
+{
+	bkmz::math::Float3 min;
+	bkmz::math::Float3 max;
+};
+
+// `local` transformed by `world`, a row vector matrix like SceneGraph::World:
+// the smallest box around the transformed box.
+Aabb TransformAabb(const Aabb &local, const bkmz::math::Float4x4 &world);
+
+enum class BroadphaseMethod : std::uint8_t
+{
+	SweepAndPrune,
+	Grid,
+};
+
+// Bodies a and b overlap, a < b.
+struct BroadphasePair
+{
+	std::uint32_t a;
+	std::uint32_t b;
+
+	bool operator==(const BroadphasePair &) const = default;
+};
+
+struct BroadphaseStats
+{
+	std::uint32_t bodies = 0;
+	std::uint32_t moved = 0;     // Move calls since the previous Update
+	std::uint32_t tests = 0;     // box tests during the last Update
+	std::uint32_t pairs = 0;
+	std::uint32_t added = 0;
+	std::uint32_t removed = 0;
+	std::uint32_t oversized = 0; // bodies tested against every body
+	bool resorted = false;       // sweep and prune: sorted from scratch
+};
+
+class Broadphase
+{
+public:
+	using BodyId = std::uint32_t;
+
+	explicit Broadphase(BroadphaseMethod method = BroadphaseMethod::SweepAndPrune);
+
+	// Ids are small and reused after Remove, so callers can keep per body
+	// data in arrays indexed by them.
+	BodyId Add(const Aabb &bounds);
+	void Remove(BodyId body);
+
+	// New world bounds for the body, for instance after its transform
+	// changed. Nothing is searched until the next Update.
+	void Move(BodyId body, const Aabb &bounds);
+
+	bool IsAlive(BodyId body) const { return body < alive.size() && alive[body]; }
+	Aabb Bounds(BodyId body) const;
+	std::uint32_t Size() const { return bodyCount; }
+
+	BroadphaseMethod Method() const { return method; }
+	void SetMethod(BroadphaseMethod method);
+
+	// Edge length of the grid's cells and of the sweep's tiles. Zero, the
+	// default, sizes them at each update from the bodies' mean largest
+	// extent: twice it for cells, four times for tiles.
+	float cellSize = 0.0f;
+
+	// Finds the pairs overlapping now. Costs nothing when no body was added,
+	// removed or moved since the last Update.
+	void Update(JobSystem &jobs);
+
+	// Every overlapping pair, ordered by a then b. Valid until the next
+	// Update, like the rest.
+	std::span<const BroadphasePair> Pairs() const { return pairs; }
+
+	// The pairs whose a is `body`.
+	std::span<const BroadphasePair> PairsOf(BodyId body) const;
+
+	// Pairs that started and stopped overlapping in the last Update, in the
+	// same order. Pairs of removed bodies count as stopped.
+	std::span<const BroadphasePair> Added() const { return added; }
+	std::span<const BroadphasePair> Removed() const { return removed; }
+
+	const BroadphaseStats &Stats() const { return stats; }
+
+	// Work is split into chunks of this many bodies, entries or grid buckets.
+	static constexpr std::uint32_t grain = 1 << 12;
+
+	// Bodies covering more columns or grid cells than this are tested
+	// against every body instead.
+	static constexpr std::uint32_t maxCellsPerBody = 27;
+
+private:
+	struct Box
+	{
+		float lower[3];
+		float upper[3];
+	};
+
+	// Most tests fail on one axis or another at random, so all axes are
+	// tested without branching.
+	static bool OverlapsOn(const Box &a, const Box &b, int k)
+	{
+		return (b.lower[k] <= a.upper[k]) & (a.lower[k] <= b.upper[k]);
+	}
+
+	static bool Overlaps(const Box &a, const Box &b)
+	{
+		return OverlapsOn(a, b, 0) & OverlapsOn(a, b, 1) & OverlapsOn(a, b, 2);
+	}
+
+	// A body in one sweep column or grid cell, with its bounds so the
+	// searches read entries in order rather than bodies all over. `cell`
+	// packs the column's or cell's coordinates. Sweep entries have their
+	// bounds' axes rotated to put the sweep axis first.
+	struct Entry
+	{
+		std::uint64_t cell;
+		Box box;
+		BodyId body;
+	};
+
+	// Per chunk results of a pair search, merged by Collect.
+	struct Chunk
+	{
+		std::vector<BroadphasePair> pairs;
+		std::uint32_t tests = 0;
+	};
+
+	// Where the bodies' centers are, and how large the bodies are.
+	struct Spread
+	{
+		float variance[3];
+		float meanExtent; // of each body's largest extent
+	};
+
+	void SetBounds(BodyId body, const Aabb &bounds);
+
+	Spread MeasureSpread(JobSystem &jobs);
+	void SortOrder(JobSystem &jobs);
+	bool RepairOrder(JobSystem &jobs);
+	void GatherOrder(JobSystem &jobs);
+
+	void SweepAndPrune(JobSystem &jobs);
+	void Grid(JobSystem &jobs);
+	void TestOversized(JobSystem &jobs);
+
+	Chunk &ChunkAt(std::uint32_t index);
+
+	// Orders the chunks' pairs by a then b into `pairs`, and compares them
+	// with the previous ones.
+	void Collect(JobSystem &jobs);
+
+private:
+	BroadphaseMethod method;
+
+	// By body id.
+	std::vector<Box> boxes;
+	std::vector<std::uint8_t> alive;
+	std::vector<BodyId> freeIds;
+	std::uint32_t bodyCount = 0;
+	std::uint32_t movedCount = 0;
+	bool changed = false;
+
+	// Sweep and prune, kept between updates. `order` holds body ids by
+	// their lower bound along `axis`, -1 when it has to be rebuilt, and
+	// `inOrder` whether an id is in it. `orderBoxes` are their bounds, in
+	// the same order.
+	int axis = -1;
+	std::vector<BodyId> order;
+	std::vector<Box> orderBoxes;
+	std::vector<std::uint8_t> inOrder;
+	std::vector<BodyId> addedIds;
+	bool removedAny = false;
+
+	// Grid, the entries in body order before they're bucketed.
+	std::vector<Entry> entries;
+	std::vector<std::uint32_t> bucketCursors;
+
+	// Both. Buckets are a power of two, entries of bucket i are
+	// [bucketStarts[i], bucketStarts[i + 1]).
+	std::vector<Entry> bucketed;
+	std::vector<std::uint32_t> bucketStarts;
+	std::vector<std::uint32_t> histograms; // per chunk, of buckets or partitions
+	std::vector<std::uint32_t> chunkCounts;
+	std::vector<std::uint32_t> chunkOversized;
+	std::vector<BodyId> oversized;
+	std::vector<std::uint8_t> isOversized;
+	std::vector<double> chunkSums;
+	std::vector<Chunk> chunks;
+	std::uint32_t chunksUsed = 0;
+
+	// Results. rowStarts[a] is where the pairs whose a is `a` start.
+	std::vector<BroadphasePair> pairs;
+	std::vector<BroadphasePair> previousPairs;
+	std::vector<std::uint32_t> rowStarts;
+	std::vector<std::uint32_t> rowCursors;
+	std::vector<BroadphasePair> added;
+	std::vector<BroadphasePair> removed;
+	BroadphaseStats stats;
+};
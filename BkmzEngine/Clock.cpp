@@ -0,0 +1,171 @@
+#include "Clock.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+#if !defined(BKMZ_CLOCK_NO_TSC) && (defined(_M_X64) || defined(__x86_64__))
+#define BKMZ_CLOCK_HAS_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace
+{
+	std::int64_t OsNow()
+	{
+#if defined(_WIN32)
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter(&counter);
+		return counter.QuadPart;
+#else
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (std::int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+	}
+
+	std::int64_t OsTicksPerSecond()
+	{
+#if defined(_WIN32)
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		return frequency.QuadPart;
+#else
+		return 1000000000;
+#endif
+	}
+
+#if defined(BKMZ_CLOCK_HAS_TSC)
+	bool HasInvariantTsc()
+	{
+		// CPUID.80000007H:EDX[8] is set when the TSC ticks at a constant rate
+		// across P-states and C-states and is synchronised between cores.
+#if defined(_MSC_VER)
+		int regs[4];
+		__cpuid(regs, 0x80000000);
+		if ((unsigned)regs[0] < 0x80000007)
+		{
+			return false;
+		}
+		__cpuid(regs, 0x80000007);
+		return (regs[3] & (1 << 8)) != 0;
+#else
+		unsigned eax, ebx, ecx, edx;
+		if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+		{
+			return false;
+		}
+		return (edx & (1u << 8)) != 0;
+#endif
+	}
+
+	// Measures the TSC rate against the OS clock over a short busy wait.
+	// 20ms keeps the startup cost low while getting well under 0.1% error.
+	std::int64_t CalibrateTsc()
+	{
+		const std::int64_t osFrequency = OsTicksPerSecond();
+		const std::int64_t window = osFrequency / 50;
+
+		const std::int64_t osStart = OsNow();
+		const std::uint64_t tscStart = __rdtsc();
+
+		std::int64_t osEnd;
+		do
+		{
+			osEnd = OsNow();
+		} while (osEnd - osStart < window);
+
+		const std::uint64_t tscEnd = __rdtsc();
+
+		const double seconds = (double)(osEnd - osStart) / osFrequency;
+		return (std::int64_t)((tscEnd - tscStart) / seconds);
+	}
+#endif
+
+	struct ClockState
+	{
+		Clock::Backend backend;
+		std::int64_t ticksPerSecond;
+		double secondsPerTick;
+
+		ClockState()
+		{
+#if defined(BKMZ_CLOCK_HAS_TSC)
+			if (HasInvariantTsc())
+			{
+				backend = Clock::Backend::Tsc;
+				ticksPerSecond = CalibrateTsc();
+				secondsPerTick = 1.0 / (double)ticksPerSecond;
+				return;
+			}
+#endif
+
+#if defined(_WIN32)
+			backend = Clock::Backend::QueryPerformanceCounter;
+#else
+			backend = Clock::Backend::ClockGettime;
+#endif
+			ticksPerSecond = OsTicksPerSecond();
+			secondsPerTick = 1.0 / (double)ticksPerSecond;
+		}
+	};
+
+	const ClockState &State()
+	{
+		static const ClockState state;
+		return state;
+	}
+}
+
+std::int64_t Clock::Now()
+{
+	const ClockState &state = State();
+#if defined(BKMZ_CLOCK_HAS_TSC)
+	if (state.backend == Backend::Tsc)
+	{
+		return (std::int64_t)__rdtsc();
+	}
+#endif
+	return OsNow();
+}
+
+std::int64_t Clock::TicksPerSecond()
+{
+	return State().ticksPerSecond;
+}
+
+double Clock::ToSeconds(std::int64_t ticks)
+{
+	return ticks * State().secondsPerTick;
+}
+
+std::int64_t Clock::FromSeconds(double seconds)
+{
+	return (std::int64_t)(seconds * State().ticksPerSecond);
+}
+
+Clock::Backend Clock::GetBackend()
+{
+	return State().backend;
+}
+
+const char *Clock::BackendName()
+{
+	switch (GetBackend())
+	{
+	case Backend::Tsc:
+		return "rdtsc";
+	case Backend::QueryPerformanceCounter:
+		return "QueryPerformanceCounter";
+	case Backend::ClockGettime:
+		return "clock_gettime";
+	}
+	return "unknown";
+}
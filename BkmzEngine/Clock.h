@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+
+// Process-wide monotonic clock shared by all engine timers.
+//
+// On x86 with an invariant TSC the clock reads rdtsc directly, calibrated
+// once against the OS clock at startup. Elsewhere it falls back to
+// QueryPerformanceCounter on Windows and clock_gettime(CLOCK_MONOTONIC) on
+// Linux. Define BKMZ_CLOCK_NO_TSC to always use the OS clock.
+class Clock
+{
+public:
+	enum class Backend
+	{
+		Tsc,
+		QueryPerformanceCounter,
+		ClockGettime,
+	};
+
+	static std::int64_t Now(); // in ticks
+	static std::int64_t TicksPerSecond();
+
+	static double ToSeconds(std::int64_t ticks);
+	static std::int64_t FromSeconds(double seconds);
+
+	static Backend GetBackend();
+	static const char *BackendName();
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include "Transform.h"
+#include "ResourceHandles.h"
+#include "SceneGraph.h"
+#include <cstdint>
+
+// ECS components used by SceneWorld. Components are plain data, see Ecs.h.
+
+// Simulation state before the last fixed step, for render interpolation.
+struct PreviousTransform
+{
+	Transform value;
+};
+
+// Constant rotation around the Y axis, in radians per second.
+struct Spin
+{
+	float speed;
+};
+
+// The render side scene graph node that shows this entity. Transform is
+// the node's local transform.
+struct SceneNode
+{
+	SceneGraph::NodeId id;
+};
+
+struct MeshRenderer
+{
+	MeshHandle mesh;           // MyApp's meshes, drawn once it has streamed in
+	std::uint32_t objectIndex; // slot in MyApp's scene buffer
+	MaterialHandle material;   // MyApp's materials
+};
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+
+namespace bkmz::utl
+{
+	// Constant buffers must be a multiple of the minimum hardware
+	// allocation size, 256 bytes (D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT).
+	constexpr std::uint32_t constantBufferAlignment = 256;
+
+	// Rounds up to the next multiple of 256 by adding 255 and masking off
+	// the bits below it. For example (300 + 255) & ~255 = 512.
+	constexpr std::uint32_t ConstantBufferByteSize(std::uint32_t byteSize)
+	{
+		return (byteSize + constantBufferAlignment - 1) & ~(constantBufferAlignment - 1);
+	}
+
+	static_assert(ConstantBufferByteSize(1) == 256 && ConstantBufferByteSize(256) == 256 && ConstantBufferByteSize(300) == 512);
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+#include <stdexcept>
+#include <vector>
+#include "DXErrors.h"
+#include "UploadQueue.h"
+
+// The D3D12 side of UploadQueue: a copy queue with its own allocators,
+// command list and fence.
+//
+// Buffers copied into must be in D3D12_RESOURCE_STATE_COMMON. They are
+// promoted to COPY_DEST by the copy and decay back to COMMON once it has
+// run, and the direct queue promotes them again to whatever read state it
+// uses them in, so no queue records barriers for another.
+class D3D12CopyQueue : public CopyQueueBackend
+{
+public:
+	D3D12CopyQueue(ID3D12Device *device, std::uint32_t allocatorCount = UploadQueue::defaultAllocatorCount)
+	{
+		D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+		queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+		queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+		DX_CALL(device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&queue)));
+
+		allocators.resize(allocatorCount);
+		for (auto &allocator : allocators)
+		{
+			DX_CALL(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&allocator)));
+		}
+		DX_CALL(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, allocators[0].Get(), nullptr, IID_PPV_ARGS(&commandList)));
+		DX_CALL(commandList->Close());
+
+		DX_CALL(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
+		event = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+		if (event == nullptr)
+		{
+			throw std::runtime_error("Unable to create the copy fence event.");
+		}
+	}
+
+	~D3D12CopyQueue()
+	{
+		CloseHandle(event);
+	}
+
+	void Submit(std::uint32_t allocator, std::span<const CopyCommand> copies, std::uint64_t fenceValue) override
+	{
+		DX_CALL(allocators[allocator]->Reset());
+		DX_CALL(commandList->Reset(allocators[allocator].Get(), nullptr));
+		for (const CopyCommand &copy : copies)
+		{
+			commandList->CopyBufferRegion(
+				static_cast<ID3D12Resource *>(copy.destination), copy.destinationOffset,
+				static_cast<ID3D12Resource *>(copy.source), copy.sourceOffset,
+				copy.size);
+		}
+		DX_CALL(commandList->Close());
+
+		ID3D12CommandList *lists[] = { commandList.Get() };
+		queue->ExecuteCommandLists(_countof(lists), lists);
+		DX_CALL(queue->Signal(fence.Get(), fenceValue));
+	}
+
+	std::uint64_t CompletedValue() override
+	{
+		return fence->GetCompletedValue();
+	}
+
+	void Wait(std::uint64_t fenceValue) override
+	{
+		if (fence->GetCompletedValue() < fenceValue)
+		{
+			DX_CALL(fence->SetEventOnCompletion(fenceValue, event));
+			WaitForSingleObject(event, INFINITE);
+		}
+	}
+
+	// For another queue to wait on, see ID3D12CommandQueue::Wait.
+	ID3D12Fence *Fence() const { return fence.Get(); }
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> queue;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> allocators;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList;
+	Microsoft::WRL::ComPtr<ID3D12Fence> fence;
+	HANDLE event = nullptr;
+};
@@ -1,14 +1,16 @@
 #pragma once
-#include "Mesh.h"
 #include "DefaultMaterial.h"
-#include "d3d12.h"
 
-class Cube : public Mesh<DefaultMaterial::Vertex>
+// Unit cube with a different colour at each corner.
+struct Cube
 {
-public:
-	Cube(ID3D12Device* device, ID3D12GraphicsCommandList* commandList, Material* mat)
+	// Overrides the built-in data when an asset archive has it, in
+	// Mesh::Pack layout.
+	static constexpr const char *assetName = "Cube.mesh";
+
+	static std::span<const DefaultMaterial::AuthoredVertex> Vertices()
 	{
-		std::vector<DefaultMaterial::Vertex> verts = {
+		static const DefaultMaterial::AuthoredVertex verts[] = {
 		{{-0.5f, 0.5f, 0.5f}, {1.0f, 0.0f, 0.0f, 1.0f}},
 		{{0.5f, 0.5f, 0.5f}, {0.0f, 1.0f, 0.0f, 1.0f}},
 		{{-0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, 1.0f, 1.0f}},
@@ -19,8 +21,12 @@ public:
 		{{-0.5f, -0.5f, -0.5f}, {1.0f, 0.0f, 0.0f, 1.0f}},
 		{{0.5f, -0.5f, -0.5f}, {1.0f, 1.0f, 0.0f, 1.0f}},
 		};
+		return verts;
+	}
 
-		std::vector<std::uint16_t> indexes = {
+	static std::span<const std::uint16_t> Indexes()
+	{
+		static const std::uint16_t indexes[] = {
 			2, 3, 6,
 			6, 3, 7,
 			1, 0, 5,
@@ -34,11 +40,12 @@ public:
 			6, 7, 4,
 			4, 7, 5
 		};
+		return indexes;
+	}
 
-		SetVertices(verts);
-		SetIndexes(indexes);
-		InitBuffers(device, commandList);
-
-		mat->objectCount += 1;
+	// In the streamed mesh layout, see Mesh::Pack.
+	static std::vector<std::uint8_t> Data()
+	{
+		return DefaultMesh::Pack(Vertices(), Indexes());
 	}
 };
\ No newline at end of file
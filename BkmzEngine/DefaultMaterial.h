@@ -1,26 +1,99 @@
 #pragma once
 #include "Material.h"
 #include "d3d12.h"
-#include <DirectXMath.h>
+#include "Math.h"
+#include "Mesh.h"
+#include "VertexLayout.h"
+#include <array>
+#include <cstdint>
 
 class DefaultMaterial : public Material
 {
 public:
 
+	// What the vertex buffer holds. The colour is four bytes, the shader
+	// still reads a float4.
 	struct Vertex
 	{
-		DirectX::XMFLOAT3 Position;
-		DirectX::XMFLOAT4 Color;
+		bkmz::math::Float3 Position;
+		Unorm8x4 Color;
+
+		static constexpr auto Layout()
+		{
+			return MakeVertexLayout<Vertex>(
+				BKMZ_VERTEX_ATTRIBUTE(Vertex, Position, "POSITION"),
+				BKMZ_VERTEX_ATTRIBUTE(Vertex, Color, "COLOR"));
+		}
 	};
 
-	struct ObjectConstants
+	// What mesh data holds, converted to Vertex on load.
+	struct AuthoredVertex
 	{
-		DirectX::XMFLOAT4X4 worldViewProj;
+		bkmz::math::Float3 Position;
+		bkmz::math::Float4 Color;
+
+		static constexpr auto Layout()
+		{
+			return MakeVertexLayout<AuthoredVertex>(
+				BKMZ_VERTEX_ATTRIBUTE(AuthoredVertex, Position, "POSITION"),
+				BKMZ_VERTEX_ATTRIBUTE(AuthoredVertex, Color, "COLOR"));
+		}
+	};
+
+	// VertexIn in VertexShader.hlsl; keep the two in step.
+	static constexpr std::array<ShaderInput, 2> shaderInputs = { {
+		{ "POSITION", 0, 3 },
+		{ "COLOR", 0, 4 },
+	} };
+
+	// PassConstants in the shaders. Matrices are stored transposed, HLSL
+	// reads them column major. Laid out in 16 byte rows, as HLSL packs it.
+	struct PassConstants
+	{
+		bkmz::math::Float4x4 viewProj;
+
+		// View space depth is dot(float4(posW, 1), viewDepth).
+		bkmz::math::Float4 viewDepth;
+
+		// Finding a pixel's cluster, see LightClusters: tile is
+		// floor(pixel * clusterTileScale), slice
+		// floor(log(depth) * clusterSliceScale + clusterSliceBias).
+		float clusterTileScale[2];
+		float clusterSliceScale;
+		float clusterSliceBias;
+		std::uint32_t clusterTilesX;
+		std::uint32_t clusterTilesY;
+		std::uint32_t clusterSlices;
+		std::uint32_t lightCount;
+
+		// Registry indices of LightBuffers' views.
+		std::uint32_t lightsIndex;
+		std::uint32_t clusterRangesIndex;
+		std::uint32_t lightIndicesIndex;
+		std::uint32_t padding;
+
+		bkmz::math::Float3 ambient;
+		float padding2;
+	};
+
+	// One element of the structured buffer of object data.
+	struct ObjectData
+	{
+		bkmz::math::Float4x4 world;
+		std::uint32_t materialIndex;
+		std::uint32_t padding[3];
 	};
 
 	void CreatePSO(ID3D12Device *device, DXGI_FORMAT backBufferFormat, 
-		DXGI_FORMAT depthStencilFormat, UINT cbvSrvUavDescriptorSize) override
+		DXGI_FORMAT depthStencilFormat, ResourceRegistry &resources, PipelinePool &pipelines, DeferredReleaseQueue &releases) override
 	{
-		Material::CreatePSO(device, backBufferFormat, depthStencilFormat, cbvSrvUavDescriptorSize, sizeof(ObjectConstants));
+		Material::CreatePSO(device, backBufferFormat, depthStencilFormat, resources, pipelines, releases, sizeof(PassConstants));
 	}
-};
\ No newline at end of file
+};
+
+static_assert(LayoutSatisfies(DefaultMaterial::Vertex::Layout(), DefaultMaterial::shaderInputs),
+	"DefaultMaterial::Vertex doesn't feed VertexShader.hlsl.");
+static_assert(sizeof(DefaultMaterial::Vertex) == 16);
+static_assert(sizeof(DefaultMaterial::PassConstants) == 144);
+
+using DefaultMesh = Mesh<DefaultMaterial::Vertex, DefaultMaterial::AuthoredVertex>;
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "DeferredRelease.h"
+#include <algorithm>
+#include <bit>
+
+DeferredReleaseQueue::DeferredReleaseQueue(std::uint32_t capacity)
+{
+	const std::uint64_t size = std::bit_ceil((std::uint64_t)(std::max)(capacity, 2u));
+	cells = std::make_unique<Cell[]>(size);
+	mask = size - 1;
+	for (std::uint64_t i = 0; i < size; i++)
+	{
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+DeferredReleaseQueue::~DeferredReleaseQueue()
+{
+	ReleaseAll();
+}
+
+void DeferredReleaseQueue::Push(void *object, ReleaseFunction release, std::uint64_t fenceValue)
+{
+	const Entry entry = { object, release, fenceValue };
+	if (TryPush(entry))
+	{
+		return;
+	}
+
+	std::lock_guard lock(overflowMutex);
+	overflow.push_back(entry);
+	overflowSize.store((std::uint32_t)overflow.size(), std::memory_order_relaxed);
+	overflows.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool DeferredReleaseQueue::TryPush(const Entry &entry)
+{
+	std::uint64_t position = pushPosition.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Cell &cell = cells[position & mask];
+		const std::uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+		const std::int64_t difference = (std::int64_t)(sequence - position);
+		if (difference == 0)
+		{
+			if (pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				cell.entry = entry;
+				cell.sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			// Full: the consumer hasn't emptied this cell since the last lap.
+			return false;
+		}
+		else
+		{
+			position = pushPosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+std::uint32_t DeferredReleaseQueue::Collect(std::uint64_t completedValue)
+{
+	std::uint32_t released = 0;
+	auto retire = [&](const Entry &entry)
+	{
+		if (entry.fenceValue <= completedValue)
+		{
+			entry.release(entry.object);
+			released++;
+			return true;
+		}
+		return false;
+	};
+
+	std::erase_if(pending, retire);
+
+	// Most entries pushed since the last collect are already retired, they
+	// are released straight from the ring.
+	for (;;)
+	{
+		Cell &cell = cells[popPosition & mask];
+		if (cell.sequence.load(std::memory_order_acquire) != popPosition + 1)
+		{
+			// Empty, or the producer that claimed this cell is still writing
+			// it; that entry waits for the next collect.
+			break;
+		}
+		const Entry entry = cell.entry;
+		cell.sequence.store(popPosition + mask + 1, std::memory_order_release);
+		popPosition++;
+		if (!retire(entry))
+		{
+			pending.push_back(entry);
+		}
+	}
+
+	// Only take the lock when something is waiting there. A push that
+	// lands after this check is picked up by the next collect.
+	if (overflowSize.load(std::memory_order_relaxed) != 0)
+	{
+		std::vector<Entry> taken;
+		{
+			std::lock_guard lock(overflowMutex);
+			taken.swap(overflow);
+			overflowSize.store(0, std::memory_order_relaxed);
+		}
+		for (const Entry &entry : taken)
+		{
+			if (!retire(entry))
+			{
+				pending.push_back(entry);
+			}
+		}
+	}
+	return released;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Releases objects the GPU may still be using once a fence says it is done
+// with them, instead of flushing the queue before dropping a reference.
+//
+// Any thread pushes. Pushes go into a fixed ring of cells with a sequence
+// number each (a bounded multi-producer queue), so a push is one atomic
+// compare-exchange with no lock and no allocation. When more than the
+// ring's capacity is pushed between two collects, the rest goes to a
+// locked overflow list rather than failing. The owner collects once per
+// frame with the fence's completed value and releases whatever it has
+// retired. Nothing here touches a graphics API: an object is a pointer and
+// a function that releases it.
+class DeferredReleaseQueue
+{
+public:
+	using ReleaseFunction = void (*)(void *object);
+
+	// capacity is rounded up to a power of two.
+	explicit DeferredReleaseQueue(std::uint32_t capacity = 4096);
+	DeferredReleaseQueue(const DeferredReleaseQueue &) = delete;
+	DeferredReleaseQueue &operator=(const DeferredReleaseQueue &) = delete;
+
+	// Releases everything still queued, the GPU must be idle by then.
+	~DeferredReleaseQueue();
+
+	// Any thread. `object` is released once the fence reaches fenceValue.
+	void Push(void *object, ReleaseFunction release, std::uint64_t fenceValue);
+
+	// Any thread. Released once the fence reaches the value the owner will
+	// signal next, which covers all work recorded so far.
+	void Push(void *object, ReleaseFunction release)
+	{
+		Push(object, release, NextFenceValue());
+	}
+
+	// For COM objects and anything else with a Release().
+	template <typename T>
+	void PushRelease(T *object)
+	{
+		if (object != nullptr)
+		{
+			Push(object, [](void *released) { static_cast<T *>(released)->Release(); });
+		}
+	}
+
+	// Owner thread, after each fence signal: the value the next signal
+	// will use.
+	void SetNextFenceValue(std::uint64_t value)
+	{
+		nextFenceValue.store(value, std::memory_order_release);
+	}
+
+	std::uint64_t NextFenceValue() const
+	{
+		return nextFenceValue.load(std::memory_order_acquire);
+	}
+
+	// Owner thread, once per frame. Releases everything whose fence value
+	// completedValue has reached and returns how many.
+	std::uint32_t Collect(std::uint64_t completedValue);
+
+	// Owner thread. Releases everything, for when the GPU is idle.
+	std::uint32_t ReleaseAll() { return Collect(~0ull); }
+
+	// Owner thread. Objects collected but not yet retired.
+	std::uint32_t Pending() const { return (std::uint32_t)pending.size(); }
+
+	// Pushes that didn't fit in the ring since the queue was created.
+	std::uint64_t Overflows() const { return overflows.load(std::memory_order_relaxed); }
+
+private:
+	struct Entry
+	{
+		void *object;
+		ReleaseFunction release;
+		std::uint64_t fenceValue;
+	};
+
+	// sequence == position: free for the producer that claims position.
+	// sequence == position + 1: written, ready for the consumer.
+	struct Cell
+	{
+		std::atomic<std::uint64_t> sequence;
+		Entry entry;
+	};
+
+	bool TryPush(const Entry &entry);
+
+private:
+	std::unique_ptr<Cell[]> cells;
+	std::uint64_t mask;
+	alignas(64) std::atomic<std::uint64_t> pushPosition = 0;
+	alignas(64) std::uint64_t popPosition = 0; // owner thread only
+	std::atomic<std::uint64_t> nextFenceValue = 1;
+
+	std::mutex overflowMutex;
+	std::vector<Entry> overflow;
+	std::atomic<std::uint32_t> overflowSize = 0; // overflow.size(), read without the lock
+	std::atomic<std::uint64_t> overflows = 0;
+
+	// Owner thread only.
+	std::vector<Entry> pending;
+};
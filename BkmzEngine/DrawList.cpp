@@ -0,0 +1,70 @@
+#include "DrawList.h"
+#include <algorithm>
+
+void DrawList::Clear()
+{
+	commands.clear();
+	commandBuckets.clear();
+	bucketCounts.assign(bucketCounts.size(), 0);
+}
+
+void DrawList::Add(std::uint32_t bucket, const GeometryView &geometry, std::uint32_t objectIndex)
+{
+	IndirectDrawCommand command;
+	command.vertexBufferLocation = geometry.vertexBufferLocation;
+	command.vertexBufferSize = geometry.vertexBufferSize;
+	command.vertexStride = geometry.vertexStride;
+	command.indexBufferLocation = geometry.indexBufferLocation;
+	command.indexBufferSize = geometry.indexBufferSize;
+	command.indexFormat = geometry.indexFormat;
+	command.objectIndex = objectIndex;
+	command.indexCountPerInstance = geometry.indexCount;
+	command.instanceCount = 1;
+	command.startIndexLocation = 0;
+	command.baseVertexLocation = 0;
+	command.startInstanceLocation = 0;
+
+	commands.push_back(command);
+	commandBuckets.push_back(bucket);
+
+	if (bucketCounts.size() <= bucket)
+	{
+		bucketCounts.resize(bucket + 1, 0);
+	}
+	bucketCounts[bucket]++;
+}
+
+std::span<const DrawList::Bucket> DrawList::Pack(IndirectDrawCommand *out)
+{
+	// Counting sort, there are only a handful of buckets.
+	buckets.clear();
+	std::uint32_t first = 0;
+	for (std::uint32_t id = 0; id < bucketCounts.size(); id++)
+	{
+		if (bucketCounts[id] != 0)
+		{
+			buckets.push_back({ id, first, 0 });
+			first += bucketCounts[id];
+		}
+	}
+
+	if (buckets.size() == 1)
+	{
+		std::copy(commands.begin(), commands.end(), out);
+		buckets[0].count = Count();
+		return buckets;
+	}
+
+	bucketSlots.resize(bucketCounts.size());
+	for (std::uint32_t i = 0; i < buckets.size(); i++)
+	{
+		bucketSlots[buckets[i].id] = i;
+	}
+
+	for (std::uint32_t i = 0; i < commands.size(); i++)
+	{
+		Bucket &bucket = buckets[bucketSlots[commandBuckets[i]]];
+		out[bucket.first + bucket.count++] = commands[i];
+	}
+	return buckets;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Vertex and index buffers of a mesh, as GPU addresses. Same fields as
+// D3D12_VERTEX_BUFFER_VIEW and D3D12_INDEX_BUFFER_VIEW.
+struct GeometryView
+{
+	std::uint64_t vertexBufferLocation;
+	std::uint32_t vertexBufferSize;
+	std::uint32_t vertexStride;
+	std::uint64_t indexBufferLocation;
+	std::uint32_t indexBufferSize;
+	std::uint32_t indexFormat; // DXGI_FORMAT
+	std::uint32_t indexCount;
+};
+
+// One command of an indirect argument buffer. The order matches the
+// command signature Material builds: vertex buffer view, index buffer view,
+// the object index root constant, then the indexed draw. No padding, the
+// GPU reads it with a stride of sizeof(IndirectDrawCommand).
+struct IndirectDrawCommand
+{
+	std::uint64_t vertexBufferLocation;
+	std::uint32_t vertexBufferSize;
+	std::uint32_t vertexStride;
+	std::uint64_t indexBufferLocation;
+	std::uint32_t indexBufferSize;
+	std::uint32_t indexFormat;
+	std::uint32_t objectIndex;
+	std::uint32_t indexCountPerInstance;
+	std::uint32_t instanceCount;
+	std::uint32_t startIndexLocation;
+	std::int32_t baseVertexLocation;
+	std::uint32_t startInstanceLocation;
+};
+
+static_assert(sizeof(IndirectDrawCommand) == 56, "IndirectDrawCommand must be tightly packed");
+
+// Draws collected for one frame and packed into indirect commands grouped
+// by bucket, one ExecuteIndirect per bucket. Buckets are small dense ids,
+// one per material.
+//
+// Has no graphics API dependency, so the packing can be checked without a
+// device.
+class DrawList
+{
+public:
+	struct Bucket
+	{
+		std::uint32_t id;
+		std::uint32_t first; // first command in the packed buffer
+		std::uint32_t count;
+	};
+
+	void Clear();
+	void Add(std::uint32_t bucket, const GeometryView &geometry, std::uint32_t objectIndex);
+
+	std::uint32_t Count() const { return (std::uint32_t)commands.size(); }
+
+	// Writes every command to `out`, which must have room for Count(), in
+	// bucket order and in the order they were added within a bucket. Empty
+	// buckets are left out. Valid until the next Pack().
+	std::span<const Bucket> Pack(IndirectDrawCommand *out);
+
+private:
+	std::vector<IndirectDrawCommand> commands;
+	std::vector<std::uint32_t> commandBuckets;
+	std::vector<std::uint32_t> bucketCounts; // by bucket id
+	std::vector<std::uint32_t> bucketSlots;  // bucket id -> index in buckets
+	std::vector<Bucket> buckets;
+};
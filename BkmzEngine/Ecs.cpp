@@ -0,0 +1,365 @@
+#include "Ecs.h"
+#include "Memory.h"
+#include <mutex>
+#include <stdexcept>
+
+namespace bkmz::ecs
+{
+	namespace
+	{
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<ComponentInfo> infos;
+		};
+
+		Registry &GetRegistry()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		std::uint32_t AlignUp(std::uint32_t value, std::uint32_t alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		// Columns start on cache line boundaries so chunk loops can use
+		// aligned vector loads.
+		constexpr std::uint32_t columnAlignment = 64;
+	}
+
+	ComponentId ComponentRegistry::Register(std::uint32_t size, std::uint32_t alignment)
+	{
+		Registry &registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+
+		if (registry.infos.size() >= maxComponents)
+		{
+			throw std::runtime_error("Too many ECS component types.");
+		}
+		if (alignment > columnAlignment)
+		{
+			throw std::runtime_error("ECS component alignment is larger than the chunk column alignment.");
+		}
+
+		registry.infos.push_back({ size, alignment });
+		return (ComponentId)registry.infos.size() - 1;
+	}
+
+	const ComponentInfo &ComponentRegistry::Info(ComponentId id)
+	{
+		Registry &registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		return registry.infos[id];
+	}
+
+	Archetype::Archetype(ComponentMask mask, ChunkPool &pool)
+		: mask(mask), pool(&pool)
+	{
+		column.fill(noColumn);
+
+		std::uint32_t rowBytes = sizeof(Entity);
+		for (ComponentId id = 0; id < maxComponents; id++)
+		{
+			if (mask & (ComponentMask(1) << id))
+			{
+				column[id] = (std::uint16_t)components.size();
+				components.push_back(id);
+				sizes.push_back(ComponentRegistry::Info(id).size);
+				rowBytes += sizes.back();
+			}
+		}
+
+		// Start from the unpadded estimate and back off until the columns,
+		// each padded to its alignment, fit in the chunk.
+		offsets.resize(components.size());
+		for (capacity = (std::uint32_t)(chunkSize / rowBytes); capacity > 0; capacity--)
+		{
+			std::uint32_t end = capacity * (std::uint32_t)sizeof(Entity);
+			for (std::size_t i = 0; i < components.size(); i++)
+			{
+				offsets[i] = AlignUp(end, columnAlignment);
+				end = offsets[i] + capacity * sizes[i];
+			}
+
+			if (end <= chunkSize)
+			{
+				break;
+			}
+		}
+
+		if (capacity == 0)
+		{
+			throw std::runtime_error("ECS archetype row doesn't fit in a chunk.");
+		}
+	}
+
+	Archetype::~Archetype()
+	{
+		for (Chunk *chunk : chunks)
+		{
+			pool->Destroy(chunk);
+		}
+	}
+
+	std::uint32_t Archetype::AddRow(Entity entity)
+	{
+		if (count == chunks.size() * capacity)
+		{
+			MemoryTagScope scope(MemoryTag::Ecs);
+			chunks.push_back(pool->Create());
+		}
+
+		const std::uint32_t row = count++;
+		Chunk &chunk = *chunks[row / capacity];
+		const std::uint32_t slot = row % capacity;
+
+		std::memcpy(chunk.data + slot * sizeof(Entity), &entity, sizeof(Entity));
+		for (std::size_t i = 0; i < components.size(); i++)
+		{
+			std::memset(chunk.data + offsets[i] + (std::size_t)slot * sizes[i], 0, sizes[i]);
+		}
+
+		return row;
+	}
+
+	Entity Archetype::RemoveRow(std::uint32_t row)
+	{
+		const std::uint32_t last = --count;
+		Entity moved = {};
+
+		if (row != last)
+		{
+			Chunk &to = *chunks[row / capacity];
+			Chunk &from = *chunks[last / capacity];
+			const std::uint32_t toSlot = row % capacity;
+			const std::uint32_t fromSlot = last % capacity;
+
+			std::memcpy(&moved, from.data + fromSlot * sizeof(Entity), sizeof(Entity));
+			std::memcpy(to.data + toSlot * sizeof(Entity), &moved, sizeof(Entity));
+			for (std::size_t i = 0; i < components.size(); i++)
+			{
+				std::memcpy(
+					to.data + offsets[i] + (std::size_t)toSlot * sizes[i],
+					from.data + offsets[i] + (std::size_t)fromSlot * sizes[i],
+					sizes[i]);
+			}
+		}
+
+		// Keep one empty chunk around so an entity bouncing across a chunk
+		// boundary doesn't allocate and free every time.
+		while (chunks.size() > ChunkCount() + 1)
+		{
+			pool->Destroy(chunks.back());
+			chunks.pop_back();
+		}
+
+		return moved;
+	}
+
+	Entity World::CreateRaw(ComponentMask mask)
+	{
+		std::uint32_t index;
+		if (!freeIndices.empty())
+		{
+			index = freeIndices.back();
+			freeIndices.pop_back();
+		}
+		else
+		{
+			index = (std::uint32_t)records.size();
+			records.push_back({});
+			records.back().generation = 1;
+		}
+
+		Record &record = records[index];
+		const Entity entity = { index, record.generation };
+
+		record.archetype = &GetArchetype(mask);
+		record.row = record.archetype->AddRow(entity);
+		return entity;
+	}
+
+	void World::Destroy(Entity entity)
+	{
+		if (!IsAlive(entity))
+		{
+			return;
+		}
+
+		Record &record = records[entity.index];
+		const Entity moved = record.archetype->RemoveRow(record.row);
+		if (moved)
+		{
+			records[moved.index].row = record.row;
+		}
+
+		record.archetype = nullptr;
+		// Skip 0 on wrap-around, it marks invalid handles.
+		record.generation = record.generation + 1 == 0 ? 1 : record.generation + 1;
+		freeIndices.push_back(entity.index);
+	}
+
+	bool World::IsAlive(Entity entity) const
+	{
+		return entity.index < records.size()
+			&& records[entity.index].generation == entity.generation
+			&& records[entity.index].archetype != nullptr;
+	}
+
+	void *World::GetRaw(Entity entity, ComponentId id)
+	{
+		if (!IsAlive(entity))
+		{
+			return nullptr;
+		}
+
+		const Record &record = records[entity.index];
+		const int col = record.archetype->ColumnOf(id);
+		return col < 0 ? nullptr : record.archetype->Component(record.row, col);
+	}
+
+	void World::AddRaw(Entity entity, ComponentId id, const void *data)
+	{
+		if (!IsAlive(entity))
+		{
+			return;
+		}
+
+		Archetype &from = *records[entity.index].archetype;
+		if ((from.Mask() & (ComponentMask(1) << id)) == 0)
+		{
+			MoveEntity(entity, GetArchetype(from.Mask() | (ComponentMask(1) << id)));
+		}
+
+		std::memcpy(GetRaw(entity, id), data, ComponentRegistry::Info(id).size);
+	}
+
+	void World::RemoveRaw(Entity entity, ComponentId id)
+	{
+		if (!IsAlive(entity))
+		{
+			return;
+		}
+
+		Archetype &from = *records[entity.index].archetype;
+		if (from.Mask() & (ComponentMask(1) << id))
+		{
+			MoveEntity(entity, GetArchetype(from.Mask() & ~(ComponentMask(1) << id)));
+		}
+	}
+
+	Archetype &World::GetArchetype(ComponentMask mask)
+	{
+		auto it = archetypeLookup.find(mask);
+		if (it != archetypeLookup.end())
+		{
+			return *it->second;
+		}
+
+		archetypes.push_back(std::make_unique<Archetype>(mask, chunkPool));
+		archetypeLookup[mask] = archetypes.back().get();
+		return *archetypes.back();
+	}
+
+	void World::MoveEntity(Entity entity, Archetype &to)
+	{
+		Record &record = records[entity.index];
+		Archetype &from = *record.archetype;
+
+		const std::uint32_t newRow = to.AddRow(entity);
+		for (ComponentId id : to.Components())
+		{
+			const int fromCol = from.ColumnOf(id);
+			if (fromCol >= 0)
+			{
+				std::memcpy(
+					to.Component(newRow, to.ColumnOf(id)),
+					from.Component(record.row, fromCol),
+					ComponentRegistry::Info(id).size);
+			}
+		}
+
+		const Entity moved = from.RemoveRow(record.row);
+		if (moved)
+		{
+			records[moved.index].row = record.row;
+		}
+
+		record.archetype = &to;
+		record.row = newRow;
+	}
+
+	void CommandBuffer::WriteHeader(Op op, Entity entity, ComponentMask mask, std::uint32_t componentCount)
+	{
+		const Header header = { op, componentCount, entity, mask };
+		Write(&header, sizeof(header));
+	}
+
+	void CommandBuffer::WriteComponent(ComponentId id, const void *data, std::uint32_t size)
+	{
+		const ComponentHeader header = { id, size };
+		Write(&header, sizeof(header));
+		Write(data, size);
+	}
+
+	void CommandBuffer::Write(const void *data, std::size_t size)
+	{
+		const std::size_t offset = stream.size();
+		stream.resize(offset + size);
+		std::memcpy(stream.data() + offset, data, size);
+	}
+
+	void CommandBuffer::Playback(World &world)
+	{
+		std::size_t cursor = 0;
+		while (cursor < stream.size())
+		{
+			// The stream is unaligned, so read everything through memcpy.
+			Header header;
+			std::memcpy(&header, stream.data() + cursor, sizeof(header));
+			cursor += sizeof(header);
+
+			Entity target = header.entity;
+			if (header.op == Op::Create)
+			{
+				target = world.CreateRaw(header.mask);
+			}
+
+			for (std::uint32_t i = 0; i < header.componentCount; i++)
+			{
+				ComponentHeader component;
+				std::memcpy(&component, stream.data() + cursor, sizeof(component));
+				cursor += sizeof(component);
+
+				if (header.op == Op::Create)
+				{
+					std::memcpy(world.GetRaw(target, component.id), stream.data() + cursor, component.size);
+				}
+				else
+				{
+					world.AddRaw(target, component.id, stream.data() + cursor);
+				}
+				cursor += component.size;
+			}
+
+			if (header.op == Op::Destroy)
+			{
+				world.Destroy(target);
+			}
+			else if (header.op == Op::Remove)
+			{
+				for (ComponentId id = 0; id < maxComponents; id++)
+				{
+					if (header.mask & (ComponentMask(1) << id))
+					{
+						world.RemoveRaw(target, id);
+					}
+				}
+			}
+		}
+
+		stream.clear();
+	}
+}
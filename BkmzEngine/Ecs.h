@@ -0,0 +1,390 @@
+#pragma once
+#include "Memory.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Archetype based entity-component system.
+//
+// Entities with the same set of components share an archetype. An archetype
+// stores its entities in 16KB chunks, and inside a chunk every component
+// type has its own tightly packed column (structure of arrays), so a query
+// that only touches transforms streams through transforms and nothing else.
+//
+// Components are plain data: they must be trivially copyable, they are
+// moved around with memcpy and zero-initialised when not given a value.
+namespace bkmz::ecs
+{
+	using ComponentId = std::uint32_t;
+	using ComponentMask = std::uint64_t;
+
+	constexpr ComponentId maxComponents = 64;
+	constexpr std::size_t chunkSize = 16 * 1024;
+
+	// Index into the world's entity table plus the generation of that slot.
+	// Destroying an entity bumps the generation, so stale copies of the
+	// handle are detected instead of silently aliasing a new entity.
+	struct Entity
+	{
+		std::uint32_t index = 0;
+		std::uint32_t generation = 0; // 0 is never alive
+
+		bool operator==(const Entity &other) const = default;
+
+		explicit operator bool() const
+		{
+			return generation != 0;
+		}
+	};
+
+	struct ComponentInfo
+	{
+		std::uint32_t size;
+		std::uint32_t alignment;
+	};
+
+	class ComponentRegistry
+	{
+	public:
+		static ComponentId Register(std::uint32_t size, std::uint32_t alignment);
+		static const ComponentInfo &Info(ComponentId id);
+	};
+
+	template <typename T>
+	ComponentId ComponentTypeId()
+	{
+		using Component = std::remove_cv_t<T>;
+		if constexpr (!std::is_same_v<T, Component>)
+		{
+			// Queries name read-only components as const T, which must be
+			// the same component as T.
+			return ComponentTypeId<Component>();
+		}
+		else
+		{
+			static_assert(std::is_trivially_copyable_v<Component>, "Components are moved with memcpy.");
+			static const ComponentId id = ComponentRegistry::Register(sizeof(Component), alignof(Component));
+			return id;
+		}
+	}
+
+	template <typename... Ts>
+	ComponentMask MaskOf()
+	{
+		return (ComponentMask(0) | ... | (ComponentMask(1) << ComponentTypeId<Ts>()));
+	}
+
+	struct alignas(64) Chunk
+	{
+		std::byte data[chunkSize];
+	};
+
+	// Chunks are all the same size, so the world keeps one pool for every
+	// archetype and a chunk freed by one is reused by the next that grows.
+	using ChunkPool = ObjectPool<Chunk, 16>;
+
+	// All entities with exactly one combination of components. Rows are kept
+	// dense: every chunk is full except the last one.
+	class Archetype
+	{
+	public:
+		static constexpr std::uint16_t noColumn = 0xffff;
+
+		Archetype(ComponentMask mask, ChunkPool &pool);
+		~Archetype();
+
+		Archetype(const Archetype &) = delete;
+		Archetype &operator=(const Archetype &) = delete;
+
+		ComponentMask Mask() const { return mask; }
+		std::uint32_t Count() const { return count; }
+		std::uint32_t Capacity() const { return capacity; }
+		std::uint32_t ChunkCount() const { return (count + capacity - 1) / capacity; }
+
+		std::uint32_t ChunkRows(std::uint32_t chunk) const
+		{
+			const std::uint32_t begin = chunk * capacity;
+			return count - begin < capacity ? count - begin : capacity;
+		}
+
+		Entity *Entities(std::uint32_t chunk)
+		{
+			return reinterpret_cast<Entity *>(chunks[chunk]->data);
+		}
+
+		int ColumnOf(ComponentId id) const
+		{
+			return column[id] == noColumn ? -1 : column[id];
+		}
+
+		void *Column(std::uint32_t chunk, int col)
+		{
+			return chunks[chunk]->data + offsets[col];
+		}
+
+		void *Component(std::uint32_t row, int col)
+		{
+			return chunks[row / capacity]->data + offsets[col] + (std::size_t)(row % capacity) * sizes[col];
+		}
+
+		const std::vector<ComponentId> &Components() const { return components; }
+
+		// Appends a zero-initialised row and returns its index.
+		std::uint32_t AddRow(Entity entity);
+
+		// Fills the hole with the last row. Returns the entity that moved into
+		// `row`, or an invalid entity if `row` was the last one.
+		Entity RemoveRow(std::uint32_t row);
+
+	private:
+		ComponentMask mask;
+		std::vector<ComponentId> components; // ascending
+		std::array<std::uint16_t, maxComponents> column;
+		std::vector<std::uint32_t> offsets;
+		std::vector<std::uint32_t> sizes;
+		std::uint32_t capacity = 0;
+		std::uint32_t count = 0;
+		ChunkPool *pool;
+		std::vector<Chunk *> chunks;
+	};
+
+	class World
+	{
+	public:
+		template <typename... Ts>
+		Entity Create(const Ts &...components)
+		{
+			const Entity entity = CreateRaw(MaskOf<Ts...>());
+			(std::memcpy(GetRaw(entity, ComponentTypeId<Ts>()), &components, sizeof(Ts)), ...);
+			return entity;
+		}
+
+		// Creates an entity with zero-initialised components.
+		Entity CreateRaw(ComponentMask mask);
+		void Destroy(Entity entity);
+		bool IsAlive(Entity entity) const;
+
+		template <typename T>
+		T *Get(Entity entity)
+		{
+			return static_cast<T *>(GetRaw(entity, ComponentTypeId<T>()));
+		}
+
+		template <typename T>
+		bool Has(Entity entity) const
+		{
+			return IsAlive(entity) && (records[entity.index].archetype->Mask() & MaskOf<T>()) != 0;
+		}
+
+		// Adding a component that is already present just overwrites it.
+		template <typename T>
+		void Add(Entity entity, const T &component)
+		{
+			AddRaw(entity, ComponentTypeId<T>(), &component);
+		}
+
+		template <typename T>
+		void Remove(Entity entity)
+		{
+			RemoveRaw(entity, ComponentTypeId<T>());
+		}
+
+		// Returns nullptr if the entity is dead or doesn't have the component.
+		void *GetRaw(Entity entity, ComponentId id);
+		void AddRaw(Entity entity, ComponentId id, const void *data);
+		void RemoveRaw(Entity entity, ComponentId id);
+
+		std::size_t EntityCount() const { return records.size() - freeIndices.size(); }
+
+		std::size_t ArchetypeCount() const { return archetypes.size(); }
+		Archetype &ArchetypeAt(std::size_t i) { return *archetypes[i]; }
+
+	private:
+		struct Record
+		{
+			Archetype *archetype = nullptr;
+			std::uint32_t row = 0;
+			std::uint32_t generation = 0;
+		};
+
+		Archetype &GetArchetype(ComponentMask mask);
+		void MoveEntity(Entity entity, Archetype &to);
+
+	private:
+		std::vector<Record> records;
+		std::vector<std::uint32_t> freeIndices;
+
+		// Declared before the archetypes, which give their chunks back to it.
+		ChunkPool chunkPool{ MemoryTag::Ecs };
+
+		// Archetypes are never destroyed, so pointers into this stay valid and
+		// queries can cache them.
+		std::vector<std::unique_ptr<Archetype>> archetypes;
+		std::unordered_map<ComponentMask, Archetype *> archetypeLookup;
+	};
+
+	// Iterates all entities that have at least the components Ts. The list of
+	// matching archetypes is cached and only extended when new archetypes
+	// appear, so keeping a Query around makes iteration free of lookups.
+	template <typename... Ts>
+	class Query
+	{
+	public:
+		explicit Query(World &world) : world(&world), mask(MaskOf<Ts...>()) {}
+
+		// f(Ts &...)
+		template <typename F>
+		void ForEach(F &&f)
+		{
+			ForEachChunk([&](std::uint32_t rows, const Entity *, Ts *...columns)
+			{
+				for (std::uint32_t i = 0; i < rows; i++)
+				{
+					f(columns[i]...);
+				}
+			});
+		}
+
+		// f(Entity, Ts &...)
+		template <typename F>
+		void ForEachEntity(F &&f)
+		{
+			ForEachChunk([&](std::uint32_t rows, const Entity *entities, Ts *...columns)
+			{
+				for (std::uint32_t i = 0; i < rows; i++)
+				{
+					f(entities[i], columns[i]...);
+				}
+			});
+		}
+
+		// f(rows, const Entity *entities, Ts *...columns), once per chunk.
+		// This is the form to use for vectorised loops.
+		template <typename F>
+		void ForEachChunk(F &&f)
+		{
+			ForEachChunkImpl(f, std::index_sequence_for<Ts...>{});
+		}
+
+		std::size_t Count()
+		{
+			Refresh();
+			std::size_t total = 0;
+			for (Archetype *archetype : matches)
+			{
+				total += archetype->Count();
+			}
+			return total;
+		}
+
+	private:
+		template <typename F, std::size_t... I>
+		void ForEachChunkImpl(F &f, std::index_sequence<I...>)
+		{
+			Refresh();
+			for (Archetype *archetype : matches)
+			{
+				const int columns[] = { archetype->ColumnOf(ComponentTypeId<Ts>())..., 0 };
+				const std::uint32_t chunkCount = archetype->ChunkCount();
+				for (std::uint32_t c = 0; c < chunkCount; c++)
+				{
+					f(archetype->ChunkRows(c), archetype->Entities(c),
+						static_cast<Ts *>(archetype->Column(c, columns[I]))...);
+				}
+			}
+		}
+
+		void Refresh()
+		{
+			for (; scanned < world->ArchetypeCount(); scanned++)
+			{
+				Archetype &archetype = world->ArchetypeAt(scanned);
+				if ((archetype.Mask() & mask) == mask)
+				{
+					matches.push_back(&archetype);
+				}
+			}
+		}
+
+	private:
+		World *world;
+		ComponentMask mask;
+		std::vector<Archetype *> matches;
+		std::size_t scanned = 0;
+	};
+
+	// Records structural changes (create, destroy, add, remove) while the
+	// world is being iterated, to be applied later in recording order with
+	// Playback(). Components are copied into a flat byte stream, so
+	// recording doesn't allocate once the buffer has grown to its working size.
+	class CommandBuffer
+	{
+	public:
+		template <typename... Ts>
+		void Create(const Ts &...components)
+		{
+			WriteHeader(Op::Create, {}, MaskOf<Ts...>(), sizeof...(Ts));
+			(WriteComponent(ComponentTypeId<Ts>(), &components, sizeof(Ts)), ...);
+		}
+
+		void Destroy(Entity entity)
+		{
+			WriteHeader(Op::Destroy, entity, 0, 0);
+		}
+
+		template <typename T>
+		void Add(Entity entity, const T &component)
+		{
+			WriteHeader(Op::Add, entity, MaskOf<T>(), 1);
+			WriteComponent(ComponentTypeId<T>(), &component, sizeof(T));
+		}
+
+		template <typename T>
+		void Remove(Entity entity)
+		{
+			WriteHeader(Op::Remove, entity, MaskOf<T>(), 0);
+		}
+
+		bool Empty() const { return stream.empty(); }
+
+		// Applies and clears all recorded commands. Commands on entities that
+		// died in the meantime are skipped.
+		void Playback(World &world);
+
+	private:
+		enum class Op : std::uint32_t
+		{
+			Create,
+			Destroy,
+			Add,
+			Remove,
+		};
+
+		struct Header
+		{
+			Op op;
+			std::uint32_t componentCount;
+			Entity entity;
+			ComponentMask mask;
+		};
+
+		struct ComponentHeader
+		{
+			ComponentId id;
+			std::uint32_t size;
+		};
+
+		void WriteHeader(Op op, Entity entity, ComponentMask mask, std::uint32_t componentCount);
+		void WriteComponent(ComponentId id, const void *data, std::uint32_t size);
+		void Write(const void *data, std::size_t size);
+
+	private:
+		std::vector<std::byte, TaggedAllocator<std::byte, MemoryTag::Ecs>> stream;
+	};
+}
@@ -0,0 +1,749 @@
+#include "FileIo.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include "String.h"
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define BKMZ_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+namespace
+{
+	// One positional read, repeated until `size` bytes or the end of the
+	// file. Returns the bytes read or a negative error code.
+	std::int64_t ReadAt(std::intptr_t handle, std::uint64_t offset, void *buffer, std::size_t size)
+	{
+		std::size_t total = 0;
+		while (total < size)
+		{
+#if defined(_WIN32)
+			OVERLAPPED overlapped = {};
+			overlapped.Offset = (DWORD)(offset + total);
+			overlapped.OffsetHigh = (DWORD)((offset + total) >> 32);
+
+			const DWORD chunk = (DWORD)(std::min)(size - total, (std::size_t)1 << 30);
+			DWORD read = 0;
+			if (!ReadFile((HANDLE)handle, (std::uint8_t *)buffer + total, chunk, &read, &overlapped))
+			{
+				const DWORD error = GetLastError();
+				if (error == ERROR_HANDLE_EOF)
+				{
+					break;
+				}
+				return -(std::int64_t)error;
+			}
+#else
+			const ssize_t read = pread((int)handle, (std::uint8_t *)buffer + total, size - total, (off_t)(offset + total));
+			if (read < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return -(std::int64_t)errno;
+			}
+#endif
+			if (read == 0)
+			{
+				break;
+			}
+			total += (std::size_t)read;
+		}
+		return (std::int64_t)total;
+	}
+}
+
+File::File(const std::string &path, Mode mode)
+{
+#if defined(_WIN32)
+	const std::wstring widePath = bkmz::utl::ToWide(path);
+	auto open = [&widePath](DWORD flags)
+	{
+		return CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+	};
+
+	HANDLE file = INVALID_HANDLE_VALUE;
+	if (mode == Mode::Direct)
+	{
+		file = open(FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING);
+		direct = file != INVALID_HANDLE_VALUE;
+	}
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = open(FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN);
+	}
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Can't open " + path);
+	}
+	handle = (std::intptr_t)file;
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	size = (std::uint64_t)fileSize.QuadPart;
+#else
+	int fd = -1;
+#if defined(O_DIRECT)
+	// Not every file system takes O_DIRECT, tmpfs for one. Those files are
+	// read through the page cache instead.
+	if (mode == Mode::Direct)
+	{
+		fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+		direct = fd >= 0;
+	}
+#endif
+	if (fd < 0)
+	{
+		fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	}
+	if (fd < 0)
+	{
+		throw std::runtime_error("Can't open " + path);
+	}
+	handle = fd;
+
+	struct stat info;
+	fstat(fd, &info);
+	size = (std::uint64_t)info.st_size;
+#endif
+}
+
+File::~File()
+{
+	Close();
+}
+
+File::File(File &&other) noexcept
+	: handle(other.handle), size(other.size), direct(other.direct)
+{
+	other.handle = -1;
+}
+
+File &File::operator=(File &&other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		handle = other.handle;
+		size = other.size;
+		direct = other.direct;
+		other.handle = -1;
+	}
+	return *this;
+}
+
+bool File::IsOpen() const
+{
+	return handle != -1;
+}
+
+std::size_t File::ReadAt(std::uint64_t offset, void *buffer, std::size_t size) const
+{
+	const std::int64_t read = ::ReadAt(handle, offset, buffer, size);
+	if (read < 0)
+	{
+		throw std::runtime_error("File read failed.");
+	}
+	return (std::size_t)read;
+}
+
+std::vector<std::uint8_t> File::ReadAll(const std::string &path)
+{
+	File file(path);
+	std::vector<std::uint8_t> data((std::size_t)file.Size());
+	data.resize(file.ReadAt(0, data.data(), data.size()));
+	return data;
+}
+
+void File::Close()
+{
+	if (handle == -1)
+	{
+		return;
+	}
+#if defined(_WIN32)
+	CloseHandle((HANDLE)handle);
+#else
+	close((int)handle);
+#endif
+	handle = -1;
+}
+
+AlignedBuffer::AlignedBuffer(std::size_t size, std::size_t alignment)
+	: size((size + alignment - 1) / alignment * alignment), alignment(alignment)
+{
+	data = (std::uint8_t *)::operator new(this->size, std::align_val_t(alignment));
+}
+
+AlignedBuffer::~AlignedBuffer()
+{
+	if (data)
+	{
+		::operator delete(data, std::align_val_t(alignment));
+	}
+}
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer &&other) noexcept
+	: data(other.data), size(other.size), alignment(other.alignment)
+{
+	other.data = nullptr;
+	other.size = 0;
+}
+
+AlignedBuffer &AlignedBuffer::operator=(AlignedBuffer &&other) noexcept
+{
+	if (this != &other)
+	{
+		this->~AlignedBuffer();
+		data = other.data;
+		size = other.size;
+		alignment = other.alignment;
+		other.data = nullptr;
+		other.size = 0;
+	}
+	return *this;
+}
+
+MappedFile::MappedFile(const std::string &path)
+{
+	// The mapping keeps the file alive, the handle isn't needed past this.
+	File file(path);
+	size = (std::size_t)file.Size();
+	if (size != 0)
+	{
+#if defined(_WIN32)
+		HANDLE mapping = CreateFileMappingW((HANDLE)file.Handle(), nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping)
+		{
+			data = (const std::uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+		}
+#else
+		void *memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, (int)file.Handle(), 0);
+		data = memory == MAP_FAILED ? nullptr : (const std::uint8_t *)memory;
+#endif
+		if (!data)
+		{
+			throw std::runtime_error("Can't map " + path);
+		}
+	}
+	open = true;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+	: data(other.data), size(other.size), open(other.open)
+{
+	other.data = nullptr;
+	other.size = 0;
+	other.open = false;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		data = other.data;
+		size = other.size;
+		open = other.open;
+		other.data = nullptr;
+		other.size = 0;
+		other.open = false;
+	}
+	return *this;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+	{
+#if defined(_WIN32)
+		UnmapViewOfFile(data);
+#else
+		munmap((void *)data, size);
+#endif
+	}
+	data = nullptr;
+	size = 0;
+	open = false;
+}
+
+#if defined(BKMZ_IO_URING)
+
+// Talks to the kernel directly instead of through liburing, the engine only
+// needs plain reads. The rings are shared with the kernel: we own the SQ
+// tail and the CQ head, the kernel the other two.
+class AsyncFileReader::UringEngine : public AsyncFileReader::Engine
+{
+public:
+	explicit UringEngine(unsigned entries)
+	{
+		io_uring_params params = {};
+		ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+		if (ringFd < 0)
+		{
+			throw std::runtime_error("io_uring isn't available.");
+		}
+
+		// IORING_OP_READ came with the same kernel as this feature.
+		if (!(params.features & IORING_FEAT_RW_CUR_POS))
+		{
+			Release();
+			throw std::runtime_error("io_uring doesn't support plain reads.");
+		}
+
+		sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+		if (singleMap)
+		{
+			sqRingSize = cqRingSize = (std::max)(sqRingSize, cqRingSize);
+		}
+
+		sqRing = Map(sqRingSize, IORING_OFF_SQ_RING);
+		cqRing = singleMap ? sqRing : Map(cqRingSize, IORING_OFF_CQ_RING);
+		sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		sqes = (io_uring_sqe *)Map(sqesSize, IORING_OFF_SQES);
+
+		auto *sq = (std::uint8_t *)sqRing;
+		sqHead = (unsigned *)(sq + params.sq_off.head);
+		sqTail = (unsigned *)(sq + params.sq_off.tail);
+		sqMask = *(unsigned *)(sq + params.sq_off.ring_mask);
+		sqArray = (unsigned *)(sq + params.sq_off.array);
+		sqEntries = params.sq_entries;
+
+		auto *cq = (std::uint8_t *)cqRing;
+		cqHead = (unsigned *)(cq + params.cq_off.head);
+		cqTail = (unsigned *)(cq + params.cq_off.tail);
+		cqMask = *(unsigned *)(cq + params.cq_off.ring_mask);
+		cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+	}
+
+	~UringEngine() override
+	{
+		Release();
+	}
+
+	void Submit(std::span<const Operation> operations) override
+	{
+		unsigned queued = 0;
+		for (const Operation &operation : operations)
+		{
+			if (operation.slot >= reads.size())
+			{
+				reads.resize(operation.slot + 1);
+			}
+			reads[operation.slot] = { operation, 0 };
+			Queue(operation, queued);
+		}
+
+		if (queued != 0)
+		{
+			Enter(queued, 0, 0);
+		}
+	}
+
+	// A read can complete short, like pread, without being at the end of
+	// the file. The rest goes back in as a new read, and only a full read,
+	// the end of the file or an error is handed out.
+	void Reap(std::vector<Finished> &out, bool wait) override
+	{
+		const std::size_t before = out.size();
+		do
+		{
+			unsigned head = *cqHead;
+			unsigned tail = std::atomic_ref(*cqTail).load(std::memory_order_acquire);
+			if (head == tail && wait)
+			{
+				Enter(0, 1, IORING_ENTER_GETEVENTS);
+				tail = std::atomic_ref(*cqTail).load(std::memory_order_acquire);
+			}
+
+			unsigned queued = 0;
+			for (; head != tail; head++)
+			{
+				const io_uring_cqe &cqe = cqes[head & cqMask];
+				const std::uint32_t slot = (std::uint32_t)cqe.user_data;
+				PartialRead &read = reads[slot];
+				if (cqe.res > 0)
+				{
+					read.bytes += (std::uint32_t)cqe.res;
+					if (read.bytes < read.operation.size)
+					{
+						Operation rest = read.operation;
+						rest.offset += read.bytes;
+						rest.buffer = (std::uint8_t *)rest.buffer + read.bytes;
+						rest.size -= read.bytes;
+						Queue(rest, queued);
+						continue;
+					}
+				}
+				out.push_back({ slot, { cqe.res < 0 ? (std::int64_t)cqe.res : (std::int64_t)read.bytes } });
+			}
+			std::atomic_ref(*cqHead).store(head, std::memory_order_release);
+
+			if (queued != 0)
+			{
+				Enter(queued, 0, 0);
+			}
+		} while (wait && out.size() == before);
+	}
+
+private:
+	struct PartialRead
+	{
+		Operation operation;
+		std::uint32_t bytes; // read so far
+	};
+
+	// Fills in the next SQE, submitting the `queued` ones first if the ring
+	// is full.
+	void Queue(const Operation &operation, unsigned &queued)
+	{
+		unsigned tail = *sqTail;
+		if (tail - std::atomic_ref(*sqHead).load(std::memory_order_acquire) == sqEntries)
+		{
+			Enter(queued, 0, 0);
+			queued = 0;
+		}
+
+		const unsigned index = tail & sqMask;
+		io_uring_sqe &sqe = sqes[index];
+		sqe = {};
+		sqe.opcode = IORING_OP_READ;
+		sqe.fd = (int)operation.handle;
+		sqe.off = operation.offset;
+		sqe.addr = (std::uint64_t)(std::uintptr_t)operation.buffer;
+		sqe.len = operation.size;
+		sqe.user_data = operation.slot;
+		sqArray[index] = index;
+
+		std::atomic_ref(*sqTail).store(tail + 1, std::memory_order_release);
+		queued++;
+	}
+
+	void *Map(std::size_t size, off_t offset)
+	{
+		void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, offset);
+		if (memory == MAP_FAILED)
+		{
+			Release();
+			throw std::runtime_error("Can't map the io_uring.");
+		}
+		return memory;
+	}
+
+	void Enter(unsigned submit, unsigned minComplete, unsigned flags)
+	{
+		while (syscall(__NR_io_uring_enter, ringFd, submit, minComplete, flags, nullptr, 0) < 0)
+		{
+			if (errno != EINTR)
+			{
+				throw std::runtime_error("io_uring_enter failed.");
+			}
+		}
+	}
+
+	void Release()
+	{
+		if (sqes)
+		{
+			munmap(sqes, sqesSize);
+		}
+		if (cqRing && cqRing != sqRing)
+		{
+			munmap(cqRing, cqRingSize);
+		}
+		if (sqRing)
+		{
+			munmap(sqRing, sqRingSize);
+		}
+		if (ringFd >= 0)
+		{
+			close(ringFd);
+		}
+		sqes = nullptr;
+		sqRing = cqRing = nullptr;
+		ringFd = -1;
+	}
+
+private:
+	int ringFd = -1;
+	void *sqRing = nullptr;
+	void *cqRing = nullptr;
+	std::size_t sqRingSize = 0;
+	std::size_t cqRingSize = 0;
+	std::size_t sqesSize = 0;
+
+	io_uring_sqe *sqes = nullptr;
+	unsigned *sqHead = nullptr;
+	unsigned *sqTail = nullptr;
+	unsigned *sqArray = nullptr;
+	unsigned sqMask = 0;
+	unsigned sqEntries = 0;
+
+	io_uring_cqe *cqes = nullptr;
+	unsigned *cqHead = nullptr;
+	unsigned *cqTail = nullptr;
+	unsigned cqMask = 0;
+
+	std::vector<PartialRead> reads; // by slot
+};
+
+#endif
+
+// Blocking positional reads on worker threads.
+class AsyncFileReader::PoolEngine : public AsyncFileReader::Engine
+{
+public:
+	explicit PoolEngine(unsigned threadCount)
+	{
+		threadCount = (std::max)(threadCount, 1u);
+		for (unsigned i = 0; i < threadCount; i++)
+		{
+			workers.emplace_back(&PoolEngine::WorkerThread, this);
+		}
+	}
+
+	~PoolEngine() override
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread &worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	void Submit(std::span<const Operation> operations) override
+	{
+		{
+			std::lock_guard lock(mutex);
+			queue.insert(queue.end(), operations.begin(), operations.end());
+		}
+		if (operations.size() == 1)
+		{
+			wake.notify_one();
+		}
+		else
+		{
+			wake.notify_all();
+		}
+	}
+
+	void Reap(std::vector<Finished> &out, bool wait) override
+	{
+		std::unique_lock lock(mutex);
+		if (wait)
+		{
+			done.wait(lock, [this]() { return !completed.empty(); });
+		}
+		out.insert(out.end(), completed.begin(), completed.end());
+		completed.clear();
+	}
+
+private:
+	void WorkerThread()
+	{
+		std::unique_lock lock(mutex);
+		while (true)
+		{
+			wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+			if (stopping)
+			{
+				return;
+			}
+
+			const Operation operation = queue.front();
+			queue.pop_front();
+
+			lock.unlock();
+			const std::int64_t read = ReadAt(operation.handle, operation.offset, operation.buffer, operation.size);
+			lock.lock();
+
+			completed.push_back({ operation.slot, { read } });
+			done.notify_one();
+		}
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool stopping = false;
+	std::deque<Operation> queue;
+	std::vector<Finished> completed;
+};
+
+AsyncFileReader::AsyncFileReader(Backend preferred, unsigned queueDepth, unsigned threadCount)
+	: queueDepth((std::max)(queueDepth, 1u))
+{
+#if defined(BKMZ_IO_URING)
+	if (preferred == Backend::IoUring)
+	{
+		try
+		{
+			engine = std::make_unique<UringEngine>(this->queueDepth);
+			backend = Backend::IoUring;
+		}
+		catch (const std::runtime_error &)
+		{
+			// Old kernel, or io_uring disabled by policy.
+		}
+	}
+#endif
+	if (!engine)
+	{
+		engine = std::make_unique<PoolEngine>(threadCount);
+		backend = Backend::ThreadPool;
+	}
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	// The kernel or a worker may still be writing into caller buffers.
+	while (inFlight != 0)
+	{
+		Reap(true);
+	}
+}
+
+const char *AsyncFileReader::BackendName(Backend backend)
+{
+	switch (backend)
+	{
+	case Backend::IoUring:
+		return "io_uring";
+	case Backend::ThreadPool:
+		return "thread pool";
+	}
+	return "unknown";
+}
+
+void AsyncFileReader::Read(const File &file, std::uint64_t offset, void *buffer, std::uint32_t size, Callback callback)
+{
+	Request request{ &file, offset, buffer, size, std::move(callback) };
+	Submit({ &request, 1 });
+}
+
+void AsyncFileReader::Submit(std::span<Request> requests)
+{
+	while (!requests.empty())
+	{
+		// Reaping doesn't run callbacks, so a callback that submits more
+		// reads can't end up running inside another one.
+		while (inFlight == queueDepth)
+		{
+			Reap(true);
+		}
+
+		const std::size_t count = (std::min)(requests.size(), queueDepth - inFlight);
+		operations.clear();
+		for (Request &request : requests.first(count))
+		{
+			std::uint32_t slot;
+			if (!freeSlots.empty())
+			{
+				slot = freeSlots.back();
+				freeSlots.pop_back();
+				callbacks[slot] = std::move(request.callback);
+			}
+			else
+			{
+				slot = (std::uint32_t)callbacks.size();
+				callbacks.push_back(std::move(request.callback));
+			}
+			operations.push_back({ request.file->Handle(), request.offset, request.buffer, request.size, slot });
+		}
+
+		engine->Submit(operations);
+		inFlight += count;
+		requests = requests.subspan(count);
+	}
+}
+
+std::size_t AsyncFileReader::Poll()
+{
+	if (inFlight != 0)
+	{
+		Reap(false);
+	}
+	return RunCallbacks();
+}
+
+std::size_t AsyncFileReader::Wait()
+{
+	if (finished.empty() && inFlight != 0)
+	{
+		Reap(true);
+	}
+	return RunCallbacks();
+}
+
+void AsyncFileReader::WaitAll()
+{
+	while (InFlight() != 0)
+	{
+		Wait();
+	}
+}
+
+void AsyncFileReader::Reap(bool wait)
+{
+	const std::size_t before = finished.size();
+	engine->Reap(finished, wait);
+	inFlight -= finished.size() - before;
+}
+
+std::size_t AsyncFileReader::RunCallbacks()
+{
+	// Callbacks may submit reads or even Poll again, which must not see the
+	// reads being handed out here.
+	std::vector<Finished> batch;
+	batch.swap(finished);
+	for (const Finished &read : batch)
+	{
+		Callback callback = std::move(callbacks[read.slot]);
+		callbacks[read.slot] = nullptr;
+		freeSlots.push_back(read.slot);
+		if (callback)
+		{
+			callback(read.result);
+		}
+	}
+
+	const std::size_t count = batch.size();
+	if (finished.empty())
+	{
+		batch.clear();
+		finished.swap(batch);
+	}
+	return count;
+}
@@ -0,0 +1,249 @@
+#pragma once
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// An open file for reading, closed on destruction.
+//
+// Direct files bypass the OS page cache (O_DIRECT, FILE_FLAG_NO_BUFFERING),
+// which is what large packs want: they are read once, straight into their
+// destination. Every read from a direct file needs its buffer, offset and
+// size aligned to directAlignment, see AlignedBuffer.
+class File
+{
+public:
+	static constexpr std::size_t directAlignment = 4096;
+
+	enum class Mode
+	{
+		Buffered,
+		Direct,
+	};
+
+	File() = default;
+	explicit File(const std::string &path, Mode mode = Mode::Buffered);
+	~File();
+
+	File(File &&other) noexcept;
+	File &operator=(File &&other) noexcept;
+	File(const File &) = delete;
+	File &operator=(const File &) = delete;
+
+	bool IsOpen() const;
+	bool IsDirect() const { return direct; }
+	std::uint64_t Size() const { return size; }
+
+	// File descriptor, or HANDLE on Windows.
+	std::intptr_t Handle() const { return handle; }
+
+	// Blocking, returns the number of bytes read, less than size only at the
+	// end of the file.
+	std::size_t ReadAt(std::uint64_t offset, void *buffer, std::size_t size) const;
+
+	// The whole file, read on the calling thread.
+	static std::vector<std::uint8_t> ReadAll(const std::string &path);
+
+private:
+	void Close();
+
+private:
+	std::intptr_t handle = -1;
+	std::uint64_t size = 0;
+	bool direct = false;
+};
+
+// Heap block with the alignment direct reads need. The size is rounded up
+// to a multiple of the alignment.
+class AlignedBuffer
+{
+public:
+	AlignedBuffer() = default;
+	explicit AlignedBuffer(std::size_t size, std::size_t alignment = File::directAlignment);
+	~AlignedBuffer();
+
+	AlignedBuffer(AlignedBuffer &&other) noexcept;
+	AlignedBuffer &operator=(AlignedBuffer &&other) noexcept;
+	AlignedBuffer(const AlignedBuffer &) = delete;
+	AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+	std::uint8_t *Data() const { return data; }
+	std::size_t Size() const { return size; }
+
+private:
+	std::uint8_t *data = nullptr;
+	std::size_t size = 0;
+	std::size_t alignment = 0;
+};
+
+// A whole file mapped read-only into memory, for formats that are used in
+// place rather than parsed. Several threads can read the mapping at once.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string &path);
+	~MappedFile();
+
+	MappedFile(MappedFile &&other) noexcept;
+	MappedFile &operator=(MappedFile &&other) noexcept;
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool IsOpen() const { return open; }
+	const std::uint8_t *Data() const { return data; }
+	std::size_t Size() const { return size; }
+	std::span<const std::uint8_t> Bytes() const { return { data, size }; }
+
+private:
+	void Close();
+
+private:
+	const std::uint8_t *data = nullptr;
+	std::size_t size = 0;
+	bool open = false;
+};
+
+struct ReadResult
+{
+	std::int64_t bytes = 0; // read, or a negative system error code on failure
+
+	bool Ok() const { return bytes >= 0; }
+};
+
+// Reads file ranges into caller-provided buffers without blocking the
+// caller.
+//
+// On Linux the reads go through an io_uring: a whole batch is queued with a
+// single system call and the kernel does the rest. Everywhere else, or when
+// the kernel doesn't allow io_uring, a small thread pool does blocking
+// positional reads instead. Either way completion callbacks only run on the
+// thread calling Poll() or Wait(), so the reader is meant to be owned and
+// driven by one thread, like AssetStreamer::Update.
+//
+// Files and buffers must stay alive until their read completes.
+class AsyncFileReader
+{
+public:
+	enum class Backend
+	{
+		IoUring,
+		ThreadPool,
+	};
+
+	using Callback = std::function<void(const ReadResult &result)>;
+
+	struct Request
+	{
+		const File *file = nullptr;
+		std::uint64_t offset = 0;
+		void *buffer = nullptr;
+		std::uint32_t size = 0;
+		Callback callback;
+	};
+
+	// queueDepth bounds the reads in flight at once, Submit() waits for
+	// earlier ones to finish past that. threadCount is only used by the
+	// thread pool.
+	explicit AsyncFileReader(Backend preferred = Backend::IoUring, unsigned queueDepth = 256, unsigned threadCount = 4);
+	~AsyncFileReader();
+
+	AsyncFileReader(const AsyncFileReader &) = delete;
+	AsyncFileReader &operator=(const AsyncFileReader &) = delete;
+
+	Backend GetBackend() const { return backend; }
+	static const char *BackendName(Backend backend);
+
+	void Read(const File &file, std::uint64_t offset, void *buffer, std::uint32_t size, Callback callback);
+	void Submit(std::span<Request> requests);
+
+	// Runs the callbacks of finished reads and returns how many ran. Poll()
+	// never blocks, Wait() blocks until at least one read finished, unless
+	// none are in flight.
+	std::size_t Poll();
+	std::size_t Wait();
+
+	// Waits for everything in flight.
+	void WaitAll();
+
+	// Reads whose callback hasn't run yet.
+	std::size_t InFlight() const { return inFlight + finished.size(); }
+
+	struct ReadAwaiter
+	{
+		AsyncFileReader &reader;
+		const File &file;
+		std::uint64_t offset;
+		void *buffer;
+		std::uint32_t size;
+		ReadResult result;
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			reader.Read(file, offset, buffer, size, [this, handle](const ReadResult &finished)
+			{
+				result = finished;
+				handle.resume();
+			});
+		}
+
+		ReadResult await_resume() const noexcept { return result; }
+	};
+
+	// `co_await reader.ReadAsync(...)` gives the ReadResult. The coroutine
+	// resumes inside Poll() or Wait().
+	ReadAwaiter ReadAsync(const File &file, std::uint64_t offset, void *buffer, std::uint32_t size)
+	{
+		return { *this, file, offset, buffer, size, {} };
+	}
+
+private:
+	// What the backends see, a read tagged with its callback slot.
+	struct Operation
+	{
+		std::intptr_t handle;
+		std::uint64_t offset;
+		void *buffer;
+		std::uint32_t size;
+		std::uint32_t slot;
+	};
+
+	struct Finished
+	{
+		std::uint32_t slot;
+		ReadResult result;
+	};
+
+	class Engine
+	{
+	public:
+		virtual ~Engine() = default;
+		virtual void Submit(std::span<const Operation> operations) = 0;
+		// Appends finished reads, blocking for at least one if wait is set.
+		virtual void Reap(std::vector<Finished> &out, bool wait) = 0;
+	};
+
+	class UringEngine;
+	class PoolEngine;
+
+	// Moves finished reads to `finished`, callbacks don't run yet.
+	void Reap(bool wait);
+	std::size_t RunCallbacks();
+
+private:
+	std::unique_ptr<Engine> engine;
+	Backend backend = Backend::ThreadPool;
+	unsigned queueDepth = 0;
+
+	std::vector<Callback> callbacks; // by slot
+	std::vector<std::uint32_t> freeSlots;
+	std::vector<Operation> operations;
+	std::vector<Finished> finished; // reaped, callback not run yet
+	std::size_t inFlight = 0;       // submitted, not reaped
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+// Accumulator for running the simulation at a fixed rate independent of the
+// render rate. Each frame Advance() returns how many simulation steps to
+// run, and Alpha() says how far the frame is between the last two
+// simulation states, for interpolating what gets drawn.
+class FixedTimestep
+{
+public:
+	float stepTime = 1.0f / 60.0f;
+
+	// Upper bound on steps per frame. If the simulation can't keep up, the
+	// excess time is dropped instead of piling up more work every frame
+	// (the "spiral of death"), and the game slows down instead.
+	int maxSteps = 5;
+
+	void SetRate(float hz)
+	{
+		stepTime = 1.0f / hz;
+	}
+
+	int Advance(float frameTime)
+	{
+		accumulator += frameTime;
+
+		int steps = (int)(accumulator / stepTime);
+		if (steps > maxSteps)
+		{
+			const double dropped = (steps - maxSteps) * (double)stepTime;
+			accumulator -= dropped;
+			droppedTime += dropped;
+			steps = maxSteps;
+		}
+
+		accumulator -= steps * (double)stepTime;
+		return steps;
+	}
+
+	float Alpha() const
+	{
+		return (float)(accumulator / stepTime);
+	}
+
+	double DroppedTime() const
+	{
+		return droppedTime;
+	}
+
+private:
+	double accumulator = 0.0;
+	double droppedTime = 0.0;
+};
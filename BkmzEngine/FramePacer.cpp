@@ -0,0 +1,148 @@
+#include "FramePacer.h"
+#include "Clock.h"
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sched.h>
+#include <time.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#define BKMZ_CPU_RELAX() _mm_pause()
+#else
+#define BKMZ_CPU_RELAX() ((void)0)
+#endif
+
+FramePacer::FramePacer()
+{
+	// Start with a pessimistic 2ms margin and let the measured sleep
+	// overshoot pull it down. Never go below 200us, the scheduler needs
+	// some slack to wake us up.
+	spinMargin = Clock::FromSeconds(0.002);
+	minSpinMargin = Clock::FromSeconds(0.0002);
+
+#if defined(_WIN32)
+	// High resolution waitable timers wake up within ~0.5ms instead of the
+	// default 15.6ms timer tick. They exist since Windows 10 1803, on older
+	// systems we fall back to Sleep.
+	waitableTimer = CreateWaitableTimerExW(nullptr, nullptr,
+		CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+}
+
+FramePacer::~FramePacer()
+{
+#if defined(_WIN32)
+	if (waitableTimer)
+	{
+		CloseHandle(waitableTimer);
+	}
+#endif
+}
+
+void FramePacer::SetTargetFrameRate(double fps)
+{
+	interval = fps > 0.0 ? Clock::FromSeconds(1.0 / fps) : 0;
+	deadline = 0;
+}
+
+double FramePacer::TargetFrameRate() const
+{
+	return interval > 0 ? 1.0 / Clock::ToSeconds(interval) : 0.0;
+}
+
+double FramePacer::LastLateness() const
+{
+	return Clock::ToSeconds(lateness);
+}
+
+void FramePacer::Wait()
+{
+	if (interval == 0)
+	{
+		return;
+	}
+
+	std::int64_t now = Clock::Now();
+	if (deadline == 0)
+	{
+		deadline = now + interval;
+	}
+
+	// Coarse phase: sleep while we're comfortably early.
+	while (deadline - now > spinMargin)
+	{
+		const std::int64_t sleepTicks = deadline - now - spinMargin;
+		SleepFor(sleepTicks);
+
+		const std::int64_t woke = Clock::Now();
+		const std::int64_t overshoot = (woke - now) - sleepTicks;
+
+		// Grow quickly on a bad wake-up, shrink slowly when sleeps are accurate.
+		// A single preempted sleep shouldn't turn the pacer into a spin loop,
+		// so the margin never exceeds a quarter of the frame.
+		if (overshoot > spinMargin)
+		{
+			spinMargin = (std::min)(overshoot, interval / 4);
+		}
+		else
+		{
+			spinMargin = (std::max)(minSpinMargin, spinMargin - (spinMargin - overshoot) / 16);
+		}
+
+		now = woke;
+	}
+
+	// Fine phase: spin out the remainder.
+	while (now < deadline)
+	{
+		BKMZ_CPU_RELAX();
+		now = Clock::Now();
+	}
+
+	lateness = now - deadline;
+
+	// If we fell more than a frame behind, don't try to catch up with a
+	// burst of short frames, just restart the schedule from now.
+	if (lateness > interval)
+	{
+		deadline = now + interval;
+	}
+	else
+	{
+		deadline += interval;
+	}
+}
+
+void FramePacer::SleepFor(std::int64_t ticks)
+{
+	const double seconds = Clock::ToSeconds(ticks);
+
+#if defined(_WIN32)
+	if (waitableTimer)
+	{
+		// Relative due time in 100ns units.
+		LARGE_INTEGER dueTime;
+		dueTime.QuadPart = -(LONGLONG)(seconds * 1e7);
+		if (SetWaitableTimerEx(waitableTimer, &dueTime, 0, nullptr, nullptr, nullptr, 0))
+		{
+			WaitForSingleObject(waitableTimer, INFINITE);
+			return;
+		}
+	}
+	Sleep((DWORD)(seconds * 1000.0));
+#else
+	timespec ts;
+	ts.tv_sec = (time_t)seconds;
+	ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+	if (ts.tv_sec == 0 && ts.tv_nsec == 0)
+	{
+		sched_yield();
+		return;
+	}
+	nanosleep(&ts, nullptr);
+#endif
+}
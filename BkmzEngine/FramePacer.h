@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+
+// Caps the frame rate by waiting until the next frame deadline.
+//
+// The OS sleep is only accurate to a millisecond or so, so the pacer sleeps
+// until it is spinMargin away from the deadline and spins the rest. The
+// margin adapts to the worst sleep overshoot seen recently, which keeps the
+// jitter well under 100us without spinning for most of the frame.
+class FramePacer
+{
+public:
+	FramePacer();
+	~FramePacer();
+
+	FramePacer(const FramePacer &) = delete;
+	FramePacer &operator=(const FramePacer &) = delete;
+
+	// 0 disables the cap and Wait() returns immediately.
+	void SetTargetFrameRate(double fps);
+	double TargetFrameRate() const;
+
+	// Blocks until the next deadline. Call once per frame.
+	void Wait();
+
+	// How far past its deadline the last Wait() returned, in seconds.
+	double LastLateness() const;
+
+private:
+	void SleepFor(std::int64_t ticks);
+
+private:
+	std::int64_t interval = 0;
+	std::int64_t deadline = 0;
+	std::int64_t spinMargin = 0;
+	std::int64_t minSpinMargin = 0;
+	std::int64_t lateness = 0;
+	void *waitableTimer = nullptr;
+};
@@ -0,0 +1,328 @@
+#include "FrameStats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+namespace
+{
+	int HighestBit(std::uint32_t v)
+	{
+		int bit = 0;
+		while (v >>= 1)
+		{
+			bit++;
+		}
+		return bit;
+	}
+
+	float ToMs(std::uint32_t micros)
+	{
+		return micros / 1000.0f;
+	}
+}
+
+int FrameHistogram::BucketIndex(std::uint32_t micros)
+{
+	if (micros < linearBuckets)
+	{
+		return (int)micros;
+	}
+
+	// Shift so that the value lands in [32, 64), the shift is the octave.
+	const int octave = HighestBit(micros) - 5;
+	const int sub = (int)(micros >> octave) - subBuckets;
+	return linearBuckets + (octave - 1) * subBuckets + sub;
+}
+
+std::uint32_t FrameHistogram::BucketUpperBound(int index)
+{
+	if (index < linearBuckets)
+	{
+		return (std::uint32_t)index;
+	}
+
+	const int octave = (index - linearBuckets) / subBuckets + 1;
+	const std::uint32_t mantissa = (index - linearBuckets) % subBuckets + subBuckets;
+	return ((mantissa + 1) << octave) - 1;
+}
+
+void FrameHistogram::Record(std::uint32_t micros)
+{
+	micros = std::min(micros, maxValue);
+	counts[BucketIndex(micros)]++;
+	count++;
+	max = std::max(max, micros);
+}
+
+void FrameHistogram::Merge(const FrameHistogram &other)
+{
+	for (int i = 0; i < bucketCount; i++)
+	{
+		counts[i] += other.counts[i];
+	}
+	count += other.count;
+	max = std::max(max, other.max);
+}
+
+void FrameHistogram::Reset()
+{
+	counts.fill(0);
+	count = 0;
+	max = 0;
+}
+
+std::uint32_t FrameHistogram::ValueAtPercentile(double p) const
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	const double clamped = std::clamp(p, 0.0, 100.0);
+	const std::uint64_t rank = std::max<std::uint64_t>(1, (std::uint64_t)std::ceil(clamped / 100.0 * count));
+
+	std::uint64_t seen = 0;
+	for (int i = 0; i < bucketCount; i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+		{
+			// The top bucket can be wider than the largest sample.
+			return std::min(BucketUpperBound(i), max);
+		}
+	}
+	return max;
+}
+
+void StdoutStatsSink::Write(const FrameStatsReport &r)
+{
+	std::printf("%s frames: %llu fps: %.1f mean: %.3fms p50: %.3fms p95: %.3fms p99: %.3fms max: %.3fms "
+		"stutters: %u cpu: %.3fms gpu wait: %.3fms heap: %.1f allocs %.0f bytes streaming max: %.3fms %llu bytes\n",
+		r.summary ? "[total]" : "[frame]",
+		(unsigned long long)r.frameCount, r.fps, r.meanMs, r.p50Ms, r.p95Ms, r.p99Ms, r.maxMs,
+		r.stutterCount, r.cpuMs, r.gpuWaitMs, r.heapAllocations, r.heapBytes,
+		r.streamingMaxMs, (unsigned long long)r.streamingMaxBytes);
+
+	// Only the tags anything was allocated under, most frames touch few.
+	bool any = false;
+	for (std::size_t tag = 0; tag < memoryTagCount; tag++)
+	{
+		if (r.tagAllocations[tag] > 0.0f)
+		{
+			std::printf("%s %s: %.1f allocs %.0f bytes", any ? "," : "        memory by tag:", MemoryTagName((MemoryTag)tag), r.tagAllocations[tag], r.tagBytes[tag]);
+			any = true;
+		}
+	}
+	if (any)
+	{
+		std::printf("\n");
+	}
+	std::fflush(stdout);
+}
+
+CsvStatsSink::CsvStatsSink(const std::string &path)
+	: file(path)
+{
+	if (!file)
+	{
+		throw std::runtime_error("Unable to open frame stats file: " + path);
+	}
+	file << "summary,frame_index,frames,elapsed_s,fps,mean_ms,p50_ms,p95_ms,p99_ms,max_ms,stutters,cpu_ms,gpu_wait_ms,heap_allocs,heap_bytes,streaming_max_ms,streaming_max_bytes";
+	for (std::size_t tag = 0; tag < memoryTagCount; tag++)
+	{
+		const char *name = MemoryTagName((MemoryTag)tag);
+		file << ',' << name << "_allocs," << name << "_bytes";
+	}
+	file << '\n';
+}
+
+void CsvStatsSink::Write(const FrameStatsReport &r)
+{
+	file << (r.summary ? 1 : 0) << ','
+		<< r.frameIndex << ','
+		<< r.frameCount << ','
+		<< r.elapsed << ','
+		<< r.fps << ','
+		<< r.meanMs << ','
+		<< r.p50Ms << ','
+		<< r.p95Ms << ','
+		<< r.p99Ms << ','
+		<< r.maxMs << ','
+		<< r.stutterCount << ','
+		<< r.cpuMs << ','
+		<< r.gpuWaitMs << ','
+		<< r.heapAllocations << ','
+		<< r.heapBytes << ','
+		<< r.streamingMaxMs << ','
+		<< r.streamingMaxBytes;
+	for (std::size_t tag = 0; tag < memoryTagCount; tag++)
+	{
+		file << ',' << r.tagAllocations[tag] << ',' << r.tagBytes[tag];
+	}
+	file << '\n';
+	file.flush();
+}
+
+JsonStatsSink::JsonStatsSink(const std::string &path)
+	: file(path)
+{
+	if (!file)
+	{
+		throw std::runtime_error("Unable to open frame stats file: " + path);
+	}
+	file << "[\n";
+}
+
+JsonStatsSink::~JsonStatsSink()
+{
+	file << "\n]\n";
+}
+
+void JsonStatsSink::Write(const FrameStatsReport &r)
+{
+	if (!first)
+	{
+		file << ",\n";
+	}
+	first = false;
+
+	file << "  {\"summary\": " << (r.summary ? "true" : "false")
+		<< ", \"frame_index\": " << r.frameIndex
+		<< ", \"frames\": " << r.frameCount
+		<< ", \"elapsed_s\": " << r.elapsed
+		<< ", \"fps\": " << r.fps
+		<< ", \"mean_ms\": " << r.meanMs
+		<< ", \"p50_ms\": " << r.p50Ms
+		<< ", \"p95_ms\": " << r.p95Ms
+		<< ", \"p99_ms\": " << r.p99Ms
+		<< ", \"max_ms\": " << r.maxMs
+		<< ", \"stutters\": " << r.stutterCount
+		<< ", \"cpu_ms\": " << r.cpuMs
+		<< ", \"gpu_wait_ms\": " << r.gpuWaitMs
+		<< ", \"heap_allocs\": " << r.heapAllocations
+		<< ", \"heap_bytes\": " << r.heapBytes
+		<< ", \"streaming_max_ms\": " << r.streamingMaxMs
+		<< ", \"streaming_max_bytes\": " << r.streamingMaxBytes
+		<< ", \"tags\": {";
+	for (std::size_t tag = 0; tag < memoryTagCount; tag++)
+	{
+		file << (tag == 0 ? "" : ", ") << '"' << MemoryTagName((MemoryTag)tag) << "\": {\"allocs\": " << r.tagAllocations[tag]
+			<< ", \"bytes\": " << r.tagBytes[tag] << '}';
+	}
+	file << "}}";
+	file.flush();
+}
+
+void FrameStats::Window::Reset()
+{
+	histogram.Reset();
+	frameTime = 0.0;
+	gpuWaitTime = 0.0;
+	heapAllocations = 0;
+	heapBytes = 0;
+	tags = {};
+	streamingMaxTime = 0.0f;
+	streamingMaxBytes = 0;
+	stutterCount = 0;
+}
+
+void FrameStats::Window::Add(std::uint32_t micros, const FrameSample &sample, bool stutter)
+{
+	histogram.Record(micros);
+	frameTime += sample.frameTime;
+	gpuWaitTime += sample.gpuWaitTime;
+	heapAllocations += sample.heapAllocations;
+	heapBytes += sample.heapBytes;
+	for (std::size_t tag = 0; tag < memoryTagCount; tag++)
+	{
+		tags[tag].allocations += sample.tags[tag].allocations;
+		tags[tag].bytes += sample.tags[tag].bytes;
+	}
+	streamingMaxTime = (std::max)(streamingMaxTime, sample.streamingTime);
+	streamingMaxBytes = (std::max)(streamingMaxBytes, sample.streamingBytes);
+	stutterCount += stutter ? 1 : 0;
+}
+
+FrameStatsReport FrameStats::Window::Report() const
+{
+	FrameStatsReport r;
+	const std::uint64_t n = histogram.Count();
+	if (n == 0)
+	{
+		return r;
+	}
+
+	r.frameCount = n;
+	r.elapsed = (float)frameTime;
+	r.fps = frameTime > 0.0 ? (float)(n / frameTime) : 0.0f;
+	r.meanMs = (float)(frameTime * 1000.0 / n);
+	r.p50Ms = ToMs(histogram.ValueAtPercentile(50.0));
+	r.p95Ms = ToMs(histogram.ValueAtPercentile(95.0));
+	r.p99Ms = ToMs(histogram.ValueAtPercentile(99.0));
+	r.maxMs = ToMs(histogram.Max());
+	r.stutterCount = stutterCount;
+	r.gpuWaitMs = (float)(gpuWaitTime * 1000.0 / n);
+	r.cpuMs = r.meanMs - r.gpuWaitMs;
+	r.heapAllocations = (float)((double)heapAllocations / n);
+	r.heapBytes = (float)((double)heapBytes / n);
+	for (std::size_t tag = 0; tag < memoryTagCount; tag++)
+	{
+		r.tagAllocations[tag] = (float)((double)tags[tag].allocations / n);
+		r.tagBytes[tag] = (float)((double)tags[tag].bytes / n);
+	}
+	r.streamingMaxMs = streamingMaxTime * 1000.0f;
+	r.streamingMaxBytes = streamingMaxBytes;
+	return r;
+}
+
+void FrameStats::AddSink(std::unique_ptr<FrameStatsSink> sink)
+{
+	sinks.push_back(std::move(sink));
+}
+
+void FrameStats::Record(const FrameSample &sample)
+{
+	const float frameTime = std::max(sample.frameTime, 0.0f);
+	const std::uint32_t micros = (std::uint32_t)std::min(frameTime * 1e6f, (float)FrameHistogram::maxValue);
+
+	// The first frames include startup work, so give the average a moment
+	// to settle before flagging anything.
+	const bool stutter = frameIndex > 8 && frameTime > averageFrameTime * stutterFactor;
+	averageFrameTime = frameIndex == 0 ? frameTime : averageFrameTime * 0.95f + frameTime * 0.05f;
+	frameIndex++;
+
+	window.Add(micros, sample, stutter);
+	total.Add(micros, sample, stutter);
+
+	if (window.frameTime >= reportInterval)
+	{
+		FrameStatsReport report = window.Report();
+		report.frameIndex = frameIndex;
+		Emit(report);
+		window.Reset();
+	}
+}
+
+void FrameStats::Finish()
+{
+	if (finished)
+	{
+		return;
+	}
+	finished = true;
+
+	FrameStatsReport report = total.Report();
+	report.summary = true;
+	report.frameIndex = frameIndex;
+	Emit(report);
+}
+
+void FrameStats::Emit(const FrameStatsReport &report)
+{
+	lastReport = report;
+	for (auto &sink : sinks)
+	{
+		sink->Write(report);
+	}
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include "Memory.h"
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Fixed-size log-linear histogram of frame times in microseconds, in the
+// spirit of HdrHistogram. Values below 64us are stored exactly, above that
+// every power of two is split into 32 linear sub-buckets, so any reported
+// percentile is within ~3% of the real value. Recording never allocates.
+class FrameHistogram
+{
+public:
+	static constexpr int linearBuckets = 64;
+	static constexpr int subBuckets = 32;
+	static constexpr int octaves = 20; // covers up to 2^26 us (~67 s)
+	static constexpr int bucketCount = linearBuckets + octaves * subBuckets;
+	static constexpr std::uint32_t maxValue = (1u << 26) - 1;
+
+	void Record(std::uint32_t micros);
+	void Merge(const FrameHistogram &other);
+	void Reset();
+
+	// p in [0, 100]. Returns the upper bound of the bucket holding the value.
+	std::uint32_t ValueAtPercentile(double p) const;
+
+	std::uint64_t Count() const { return count; }
+	std::uint32_t Max() const { return max; }
+
+	static int BucketIndex(std::uint32_t micros);
+	static std::uint32_t BucketUpperBound(int index);
+
+private:
+	std::array<std::uint32_t, bucketCount> counts = {};
+	std::uint64_t count = 0;
+	std::uint32_t max = 0;
+};
+
+struct FrameSample
+{
+	float frameTime;   // seconds, whole frame
+	float gpuWaitTime; // seconds spent blocked on the GPU fence
+	std::uint64_t heapAllocations = 0; // general heap, needs BKMZ_TRACK_ALLOCATIONS
+	std::uint64_t heapBytes = 0;
+	float streamingTime = 0.0f; // seconds handing finished asset loads to the renderer
+	std::uint64_t streamingBytes = 0;
+	MemoryTagCounters tags = {}; // heap and arenas, by MemoryTag
+};
+
+struct FrameStatsReport
+{
+	bool summary = false; // true for the whole-run report emitted by Finish()
+	std::uint64_t frameIndex = 0; // frames recorded so far
+	std::uint64_t frameCount = 0; // frames in this report
+	float elapsed = 0.0f; // seconds covered by this report
+	float fps = 0.0f;
+	float meanMs = 0.0f;
+	float p50Ms = 0.0f;
+	float p95Ms = 0.0f;
+	float p99Ms = 0.0f;
+	float maxMs = 0.0f;
+	std::uint32_t stutterCount = 0;
+	float cpuMs = 0.0f;     // mean CPU time per frame
+	float gpuWaitMs = 0.0f; // mean GPU wait per frame
+	float heapAllocations = 0.0f; // mean general heap allocations per frame
+	float heapBytes = 0.0f;       // mean general heap bytes per frame
+	float streamingMaxMs = 0.0f;  // worst frame's asset streaming time
+	std::uint64_t streamingMaxBytes = 0; // most bytes streamed in one frame
+
+	// Mean allocations and bytes per frame by MemoryTag. The heap's only
+	// with BKMZ_TRACK_ALLOCATIONS, arenas always.
+	std::array<float, memoryTagCount> tagAllocations = {};
+	std::array<float, memoryTagCount> tagBytes = {};
+};
+
+class FrameStatsSink
+{
+public:
+	virtual ~FrameStatsSink() = default;
+	virtual void Write(const FrameStatsReport &report) = 0;
+};
+
+class StdoutStatsSink : public FrameStatsSink
+{
+public:
+	void Write(const FrameStatsReport &report) override;
+};
+
+class CsvStatsSink : public FrameStatsSink
+{
+public:
+	explicit CsvStatsSink(const std::string &path);
+	void Write(const FrameStatsReport &report) override;
+
+private:
+	std::ofstream file;
+};
+
+// Writes a JSON array of report objects. The array is closed on destruction.
+class JsonStatsSink : public FrameStatsSink
+{
+public:
+	explicit JsonStatsSink(const std::string &path);
+	~JsonStatsSink();
+	void Write(const FrameStatsReport &report) override;
+
+private:
+	std::ofstream file;
+	bool first = true;
+};
+
+// Collects per-frame samples and periodically pushes percentile reports to
+// the attached sinks. A frame is counted as a stutter when it takes longer
+// than stutterFactor times the recent average.
+class FrameStats
+{
+public:
+	float reportInterval = 1.0f;
+	float stutterFactor = 2.0f;
+
+	void AddSink(std::unique_ptr<FrameStatsSink> sink);
+	void Record(const FrameSample &sample);
+
+	// Emits the whole-run summary report. Safe to call more than once.
+	void Finish();
+
+	const FrameStatsReport &LastReport() const { return lastReport; }
+
+private:
+	struct Window
+	{
+		FrameHistogram histogram;
+		double frameTime = 0.0;
+		double gpuWaitTime = 0.0;
+		std::uint64_t heapAllocations = 0;
+		std::uint64_t heapBytes = 0;
+		MemoryTagCounters tags = {};
+		float streamingMaxTime = 0.0f;
+		std::uint64_t streamingMaxBytes = 0;
+		std::uint32_t stutterCount = 0;
+
+		void Reset();
+		void Add(std::uint32_t micros, const FrameSample &sample, bool stutter);
+		FrameStatsReport Report() const;
+	};
+
+	void Emit(const FrameStatsReport &report);
+
+private:
+	std::vector<std::unique_ptr<FrameStatsSink>> sinks;
+	Window window;
+	Window total;
+	FrameStatsReport lastReport;
+	std::uint64_t frameIndex = 0;
+	float averageFrameTime = 0.0f;
+	bool finished = false;
+};
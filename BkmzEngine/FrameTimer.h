@@ -1,30 +1,28 @@
 #pragma once
-#include <chrono>
+#include "Clock.h"
 
 class FrameTimer
 {
 public:
 	FrameTimer()
 	{
-		last = std::chrono::steady_clock::now();
+		last = Clock::Now();
 	}
 
 
 	float Mark()
 	{
 		const auto old = last;
-		last = std::chrono::steady_clock::now();
-		const std::chrono::duration<float> frameTime = last - old;
-		return frameTime.count();
+		last = Clock::Now();
+		return (float)Clock::ToSeconds(last - old);
 	}
 
 	float Peek() const
 	{
-		const auto now = std::chrono::steady_clock::now();
-		const std::chrono::duration<float> frameTime = now - last;
-		return frameTime.count();
+		const auto now = Clock::Now();
+		return (float)Clock::ToSeconds(now - last);
 	}
 
 private:
-	std::chrono::steady_clock::time_point last;
-};
\ No newline at end of file
+	std::int64_t last;
+};
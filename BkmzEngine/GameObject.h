@@ -1,12 +0,0 @@
-#pragma once
-#include "Transform.h"
-#include "Mesh.h"
-#include <memory>
-#include "DefaultMaterial.h"
-
-class GameObject
-{
-public:
-	Transform transform;
-	std::unique_ptr<Mesh<DefaultMaterial::Vertex>> mesh;
-};
\ No newline at end of file
@@ -1,18 +1,16 @@
 #include "GameTimer.h"
-#include <Windows.h>
+#include "Clock.h"
 
 GameTimer::GameTimer()
 	: secondsPerCount(0.0), deltaTime(-1.0), baseTime(0),
 	pausedTime(0), stopTime(0), prevTime(0), currTime(0), stopped(false)
 {
-	__int64 countsPerSec;
-	QueryPerformanceFrequency((LARGE_INTEGER *)&countsPerSec);
-	secondsPerCount = 1.0 / (double)countsPerSec;
+	secondsPerCount = Clock::ToSeconds(1);
 }
 
 float GameTimer::GameTime() const
 {
-	return 0.0f;
+	return TotalTime();
 }
 
 float GameTimer::DeltaTime() const
@@ -22,18 +20,18 @@ float GameTimer::DeltaTime() const
 
 void GameTimer::Reset()
 {
-	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER *)&currTime);
+	std::int64_t currTime = Clock::Now();
 	baseTime = currTime;
 	prevTime = currTime;
+	this->currTime = currTime;
+	pausedTime = 0;
 	stopTime = 0;
 	stopped = false;
 }
 
 void GameTimer::Start()
 {
-	__int64 startTime;
-	QueryPerformanceCounter((LARGE_INTEGER *)&startTime);
+	std::int64_t startTime = Clock::Now();
 
 	// If we are resuming the timer from a stopped state...
 	if (stopped)
@@ -55,8 +53,7 @@ void GameTimer::Stop()
 	// If we are already stopped, then donft do anything.
 	if (!stopped)
 	{
-		__int64 currTime;
-		QueryPerformanceCounter((LARGE_INTEGER *)&currTime);
+		std::int64_t currTime = Clock::Now();
 		// Otherwise, save the time we stopped at, and set
 		// the Boolean flag indicating the timer is stopped.
 		stopTime = currTime;
@@ -73,8 +70,7 @@ void GameTimer::Tick()
 	}
 
 	// Get the time this frame.
-	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER *)&currTime);
+	std::int64_t currTime = Clock::Now();
 	this->currTime = currTime;
 
 	// Time difference between this frame and the previous.
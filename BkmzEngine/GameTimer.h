@@ -1,10 +1,11 @@
 #pragma once
+#include <cstdint>
 
 class GameTimer
 {
 public:
 	GameTimer();
-	float GameTime() const; // in seconds
+	float GameTime() const; // in seconds, excludes time spent stopped
 	float DeltaTime() const; // in seconds
 	void Reset(); // Call before message loop.
 	void Start(); // Call when unpaused.
@@ -14,10 +15,10 @@ public:
 private:
 	double secondsPerCount;
 	double deltaTime;
-	__int64 baseTime;
-	__int64 pausedTime;
-	__int64 stopTime;
-	__int64 prevTime;
-	__int64 currTime;
+	std::int64_t baseTime;
+	std::int64_t pausedTime;
+	std::int64_t stopTime;
+	std::int64_t prevTime;
+	std::int64_t currTime;
 	bool stopped;
 };
\ No newline at end of file
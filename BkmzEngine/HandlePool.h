@@ -0,0 +1,160 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Typed generational handles over densely packed pools, for the resources
+// the renderer owns: meshes, materials and pipelines.
+//
+// A handle is a slot index plus the generation of that slot, like
+// bkmz::ecs::Entity. Destroying a value bumps its slot's generation, so a
+// stale handle is detected in O(1) instead of reaching whatever reused the
+// slot, without reference counting. Values are kept packed at the front of
+// one array, so iterating the live ones streams through memory; destroying
+// one moves the last value into its place.
+
+// Tag only tells handles to different kinds of resource apart, it can be
+// an incomplete type.
+template <typename Tag>
+struct Handle
+{
+	std::uint32_t index = 0;
+	std::uint32_t generation = 0; // 0 is never alive
+
+	bool operator==(const Handle &other) const = default;
+
+	explicit operator bool() const
+	{
+		return generation != 0;
+	}
+};
+
+// T must be movable. Pointers and spans into the pool are invalidated by
+// Create, Destroy and Clear; handles are not.
+template <typename T, typename Tag = T>
+class HandlePool
+{
+public:
+	using HandleType = Handle<Tag>;
+
+	template <typename... Args>
+	HandleType Create(Args &&...args)
+	{
+		values.emplace_back(std::forward<Args>(args)...);
+
+		std::uint32_t index;
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			index = (std::uint32_t)slots.size();
+			slots.push_back({ noSlot, 1 });
+		}
+
+		Slot &slot = slots[index];
+		slot.dense = (std::uint32_t)handles.size();
+		handles.push_back({ index, slot.generation });
+		return handles.back();
+	}
+
+	// Returns false, and does nothing, for a handle that isn't alive.
+	bool Destroy(HandleType handle)
+	{
+		if (!IsValid(handle))
+		{
+			return false;
+		}
+
+		Slot &slot = slots[handle.index];
+		const std::uint32_t last = (std::uint32_t)values.size() - 1;
+		if (slot.dense != last)
+		{
+			values[slot.dense] = std::move(values[last]);
+			handles[slot.dense] = handles[last];
+			slots[handles[last].index].dense = slot.dense;
+		}
+		values.pop_back();
+		handles.pop_back();
+		Free(handle.index);
+		return true;
+	}
+
+	bool IsValid(HandleType handle) const
+	{
+		return handle.index < slots.size() && slots[handle.index].generation == handle.generation && slots[handle.index].dense != noSlot;
+	}
+
+	// Null if the handle isn't alive.
+	T *Get(HandleType handle)
+	{
+		return IsValid(handle) ? &values[slots[handle.index].dense] : nullptr;
+	}
+
+	const T *Get(HandleType handle) const
+	{
+		return IsValid(handle) ? &values[slots[handle.index].dense] : nullptr;
+	}
+
+	// The live handle in slot `index`, or a null one. Slot indices are small
+	// and dense, usable as ids in tables like DrawList's buckets.
+	HandleType At(std::uint32_t index) const
+	{
+		return index < slots.size() && slots[index].dense != noSlot ? HandleType{ index, slots[index].generation } : HandleType{};
+	}
+
+	// Live values, in no particular order, and their handles in the same order.
+	std::span<T> Values() { return values; }
+	std::span<const T> Values() const { return values; }
+	std::span<const HandleType> Handles() const { return handles; }
+
+	std::uint32_t Size() const { return (std::uint32_t)values.size(); }
+
+	// One past the highest slot index handed out.
+	std::uint32_t SlotCount() const { return (std::uint32_t)slots.size(); }
+
+	void Reserve(std::uint32_t count)
+	{
+		values.reserve(count);
+		handles.reserve(count);
+		slots.reserve(count);
+	}
+
+	// Destroys everything. Every handle handed out so far goes stale.
+	void Clear()
+	{
+		for (const HandleType &handle : handles)
+		{
+			Free(handle.index);
+		}
+		values.clear();
+		handles.clear();
+	}
+
+private:
+	static constexpr std::uint32_t noSlot = ~0u;
+
+	struct Slot
+	{
+		std::uint32_t dense; // index into values, noSlot when free
+		std::uint32_t generation;
+	};
+
+	void Free(std::uint32_t index)
+	{
+		Slot &slot = slots[index];
+		slot.dense = noSlot;
+		// Skips 0 when it wraps, which would read as a null handle.
+		slot.generation = slot.generation + 1 != 0 ? slot.generation + 1 : 1;
+		freeSlots.push_back(index);
+	}
+
+private:
+	std::vector<T> values;
+	std::vector<HandleType> handles; // by index into values
+	std::vector<Slot> slots;         // by handle index
+	std::vector<std::uint32_t> freeSlots;
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace bkmz::utl
+{
+	// MurmurHash64A. Not cryptographic, but fast and well distributed, good
+	// for asset names and content deduplication.
+	inline std::uint64_t Hash64(const void *data, std::size_t size, std::uint64_t seed = 0)
+	{
+		constexpr std::uint64_t m = 0xc6a4a7935bd1e995ull;
+		constexpr int r = 47;
+
+		const auto *bytes = static_cast<const std::uint8_t *>(data);
+		std::uint64_t h = seed ^ (size * m);
+
+		const std::size_t blocks = size / 8;
+		for (std::size_t i = 0; i < blocks; i++)
+		{
+			std::uint64_t k;
+			std::memcpy(&k, bytes + i * 8, 8);
+			k *= m;
+			k ^= k >> r;
+			k *= m;
+			h ^= k;
+			h *= m;
+		}
+
+		const std::uint8_t *tail = bytes + blocks * 8;
+		const std::size_t rest = size & 7;
+		if (rest != 0)
+		{
+			std::uint64_t k = 0;
+			for (std::size_t i = 0; i < rest; i++)
+			{
+				k |= (std::uint64_t)tail[i] << (i * 8);
+			}
+			h ^= k;
+			h *= m;
+		}
+
+		h ^= h >> r;
+		h *= m;
+		h ^= h >> r;
+		return h;
+	}
+
+	inline std::uint64_t Hash64(std::string_view text, std::uint64_t seed = 0)
+	{
+		return Hash64(text.data(), text.size(), seed);
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <d3d12.h>
+#include "Utils.h"
+#include "DeferredRelease.h"
+#include "DrawList.h"
+#include <algorithm>
+
+// Upload heap buffer that a DrawList is packed into each frame, read by
+// ExecuteIndirect. Written by the CPU and read straight from the upload
+// heap: every command is used exactly once, so a copy to a default heap
+// buffer wouldn't pay off.
+class IndirectDrawBuffer
+{
+public:
+	// Packs the list into the buffer, growing it first if needed. The
+	// buffer is reused every frame, which relies on Draw waiting for the
+	// GPU at the end of the frame. A buffer it outgrew goes to `releases`,
+	// earlier frames' commands may still be read from it.
+	std::span<const DrawList::Bucket> Write(ID3D12Device *device, DrawList &drawList, DeferredReleaseQueue &releases)
+	{
+		if (drawList.Count() > capacity)
+		{
+			Grow(device, (std::max)(drawList.Count(), capacity * 2), releases);
+		}
+		return drawList.Pack(mappedData);
+	}
+
+	// Hands the buffer to `releases` and starts over empty, for when the
+	// owner goes away before the GPU is done with it.
+	void Release(DeferredReleaseQueue &releases)
+	{
+		if (buffer && mappedData)
+		{
+			buffer->Unmap(0, nullptr);
+			mappedData = nullptr;
+		}
+		releases.PushRelease(buffer.Detach());
+		capacity = 0;
+	}
+
+	ID3D12Resource *Resource() const
+	{
+		return buffer.Get();
+	}
+
+	static UINT64 Offset(const DrawList::Bucket &bucket)
+	{
+		return (UINT64)bucket.first * sizeof(IndirectDrawCommand);
+	}
+
+private:
+	void Grow(ID3D12Device *device, UINT newCapacity, DeferredReleaseQueue &releases)
+	{
+		Release(releases);
+
+		CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+		auto desc = CD3DX12_RESOURCE_DESC::Buffer((UINT64)newCapacity * sizeof(IndirectDrawCommand));
+		DX_CALL(device->CreateCommittedResource(
+			&heapProps,
+			D3D12_HEAP_FLAG_NONE,
+			&desc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&buffer)
+		));
+
+		DX_CALL(buffer->Map(0, nullptr, reinterpret_cast<void **>(&mappedData)));
+		capacity = newCapacity;
+	}
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+	IndirectDrawCommand *mappedData = nullptr;
+	UINT capacity = 0;
+};
@@ -0,0 +1,122 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned workerCount)
+{
+	for (unsigned i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(&JobSystem::WorkerThread, this);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+unsigned JobSystem::DefaultWorkerCount()
+{
+	const unsigned threads = std::thread::hardware_concurrency();
+	return threads > 1 ? threads - 1 : 0;
+}
+
+void JobSystem::Run(std::uint32_t count, std::uint32_t grain, Function function, void *context)
+{
+	std::lock_guard run(runMutex);
+
+	{
+		std::lock_guard lock(mutex);
+		this->function = function;
+		this->context = context;
+		this->count = count;
+		this->grain = grain;
+		next = 0;
+		finished = 0;
+		failed = false;
+		error = nullptr;
+		active = true;
+		generation++;
+	}
+	wake.notify_all();
+
+	RunChunks();
+
+	std::unique_lock lock(mutex);
+	done.wait(lock, [this]() { return busy == 0 && (finished == this->count || failed); });
+	active = false;
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+void JobSystem::RunChunks()
+{
+	while (!failed)
+	{
+		const std::uint32_t begin = next.fetch_add(grain);
+		if (begin >= count)
+		{
+			return;
+		}
+		const std::uint32_t end = (std::min)(count, begin + (std::min)(grain, count - begin));
+
+		try
+		{
+			function(context, begin, end);
+		}
+		catch (...)
+		{
+			std::lock_guard lock(mutex);
+			if (!error)
+			{
+				error = std::current_exception();
+			}
+			failed = true;
+			done.notify_all();
+			return;
+		}
+
+		// The last chunk wakes the caller, under the lock so the wake can't
+		// fall between its check and its wait.
+		if (finished.fetch_add(end - begin) + (end - begin) == count)
+		{
+			std::lock_guard lock(mutex);
+			done.notify_all();
+		}
+	}
+}
+
+void JobSystem::WorkerThread()
+{
+	std::uint64_t seen = 0;
+	std::unique_lock lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this, &seen]() { return stopping || (active && generation != seen); });
+		if (stopping)
+		{
+			return;
+		}
+
+		seen = generation;
+		busy++;
+		lock.unlock();
+		RunChunks();
+		lock.lock();
+		busy--;
+		if (busy == 0)
+		{
+			done.notify_all();
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Worker threads for splitting one frame's work, such as simulating and
+// sorting particles, into chunks that run in parallel.
+//
+// ParallelFor is the whole interface: it hands out [begin, end) ranges of
+// `grain` items, the last one shorter, to the workers and to the calling
+// thread, which helps until every chunk has run, then returns. Chunks are
+// claimed in order from one counter, so which thread runs a chunk varies but
+// the chunks themselves don't, and a body can index per chunk state with
+// begin / grain. One ParallelFor runs at a time; calls from several threads are
+// serialized, and a body must not call ParallelFor on the same JobSystem.
+//
+// An exception thrown by a body stops further chunks from being handed out
+// and is rethrown by ParallelFor once the running ones are done.
+class JobSystem
+{
+public:
+	// Workers besides the calling thread, one less than the hardware's
+	// threads by default. Zero runs everything on the caller.
+	explicit JobSystem(unsigned workerCount = DefaultWorkerCount());
+	~JobSystem();
+
+	JobSystem(const JobSystem &) = delete;
+	JobSystem &operator=(const JobSystem &) = delete;
+
+	static unsigned DefaultWorkerCount();
+
+	// Threads a ParallelFor runs on, the caller included.
+	unsigned ThreadCount() const { return (unsigned)workers.size() + 1; }
+
+	// body(begin, end) for consecutive ranges covering [0, count).
+	template <typename F>
+	void ParallelFor(std::uint32_t count, std::uint32_t grain, F &&body)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		grain = (std::max)(grain, 1u);
+		if (workers.empty() || count <= grain)
+		{
+			for (std::uint32_t begin = 0; begin < count; begin += grain)
+			{
+				body(begin, count - begin > grain ? begin + grain : count);
+			}
+			return;
+		}
+		Run(count, grain, [](void *context, std::uint32_t begin, std::uint32_t end)
+		{
+			(*static_cast<std::remove_reference_t<F> *>(context))(begin, end);
+		}, &body);
+	}
+
+	// Chunks of `grain` items covering `count`, how many ranges ParallelFor
+	// hands out. Callers size per chunk scratch space with it.
+	static std::uint32_t ChunkCount(std::uint32_t count, std::uint32_t grain)
+	{
+		return (count + grain - 1) / grain;
+	}
+
+private:
+	using Function = void (*)(void *context, std::uint32_t begin, std::uint32_t end);
+
+	void Run(std::uint32_t count, std::uint32_t grain, Function function, void *context);
+	void RunChunks();
+	void WorkerThread();
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex runMutex; // one ParallelFor at a time
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool stopping = false;
+
+	// The running ParallelFor. Set under `mutex` while no worker is inside
+	// RunChunks, so workers only ever see one batch's fields.
+	bool active = false;
+	std::uint64_t generation = 0;
+	unsigned busy = 0; // workers inside RunChunks
+	Function function = nullptr;
+	void *context = nullptr;
+	std::uint32_t count = 0;
+	std::uint32_t grain = 1;
+	std::atomic<std::uint32_t> next = 0;
+	std::atomic<std::uint32_t> finished = 0;
+	std::atomic<bool> failed = false;
+	std::exception_ptr error;
+};
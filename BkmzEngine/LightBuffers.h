@@ -0,0 +1,81 @@
+#pragma once
+#include <d3d12.h>
+#include "Utils.h"
+#include "LightClusters.h"
+#include "ResourceRegistry.h"
+#include <algorithm>
+#include <cstring>
+#include <span>
+
+// What the pixel shader reads of LightClusters: the lights, each cluster's
+// range in the light index list, and the list. All three are rewritten
+// every frame and read once, so like IndirectDrawBuffer they stay in
+// upload heap buffers the shader reads directly.
+//
+// Capacities are fixed at Create, so the registry views never change. The
+// buffers are reused every frame, which relies on Draw waiting for the GPU
+// at the end of the frame.
+class LightBuffers
+{
+public:
+	~LightBuffers()
+	{
+		for (Buffer *buffer : { &lights, &ranges, &indices })
+		{
+			if (buffer->resource && buffer->mapped)
+			{
+				buffer->resource->Unmap(0, nullptr);
+			}
+		}
+	}
+
+	void Create(ID3D12Device *device, ResourceRegistry &resources, UINT maxLights, const LightClusters &clusters)
+	{
+		this->maxLights = maxLights;
+		lights.Create(device, (std::max)(maxLights, 1u) * sizeof(Light));
+		ranges.Create(device, clusters.ClusterCount() * sizeof(ClusterRange));
+		indices.Create(device, (std::max)(clusters.MaxIndices(), 1u) * sizeof(std::uint32_t));
+
+		// Ranges and indices are both read as uint buffers, a range is two.
+		lightsIndex = resources.AddStructuredBuffer(lights.resource.Get(), (std::max)(maxLights, 1u), sizeof(Light));
+		rangesIndex = resources.AddStructuredBuffer(ranges.resource.Get(), clusters.ClusterCount() * 2, sizeof(std::uint32_t));
+		indicesIndex = resources.AddStructuredBuffer(indices.resource.Get(), (std::max)(clusters.MaxIndices(), 1u), sizeof(std::uint32_t));
+	}
+
+	// `lights` are the ones `clusters` was built from, at most MaxLights.
+	void Write(std::span<const Light> lights, const LightClusters &clusters)
+	{
+		std::memcpy(this->lights.mapped, lights.data(), (std::min)(lights.size(), (std::size_t)maxLights) * sizeof(Light));
+		std::memcpy(ranges.mapped, clusters.Ranges().data(), clusters.Ranges().size_bytes());
+		std::memcpy(indices.mapped, clusters.Indices().data(), clusters.Indices().size_bytes());
+	}
+
+	UINT MaxLights() const { return maxLights; }
+
+	// Registry indices of the views.
+	UINT LightsIndex() const { return lightsIndex; }
+	UINT RangesIndex() const { return rangesIndex; }
+	UINT IndicesIndex() const { return indicesIndex; }
+
+private:
+	struct Buffer
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+		std::uint8_t *mapped = nullptr;
+
+		void Create(ID3D12Device *device, UINT64 byteSize)
+		{
+			resource = Utils::CreateBuffer(device, D3D12_HEAP_TYPE_UPLOAD, byteSize, D3D12_RESOURCE_STATE_GENERIC_READ);
+			DX_CALL(resource->Map(0, nullptr, reinterpret_cast<void **>(&mapped)));
+		}
+	};
+
+	Buffer lights;
+	Buffer ranges;
+	Buffer indices;
+	UINT maxLights = 0;
+
+	UINT lightsIndex = ResourceRegistry::invalidIndex;
+	UINT rangesIndex = ResourceRegistry::invalidIndex;
+	UINT indicesIndex = ResourceRegistry::invalidIndex;
+};
@@ -0,0 +1,416 @@
+#include "LightClusters.h"
+#include "MathBatch.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(BKMZ_MATH_SCALAR_ONLY)
+#define BKMZ_LIGHTS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace bkmz::math;
+
+namespace
+{
+	// Kernels may read this many clusters past the last.
+	constexpr std::uint32_t boundsPadding = 8;
+
+	float AxisDistance(float value, float low, float high)
+	{
+		return (std::max)((std::max)(low - value, value - high), 0.0f);
+	}
+
+	bool SphereTouches(const LightClusters::ClusterBounds &b, std::uint32_t c, const LightClusters::Volume &light)
+	{
+		const float dx = AxisDistance(light.center.x, b.minX[c], b.maxX[c]);
+		const float dy = AxisDistance(light.center.y, b.minY[c], b.maxY[c]);
+		const float dz = AxisDistance(light.center.z, b.minZ[c], b.maxZ[c]);
+		return dx * dx + dy * dy + dz * dz <= light.radius * light.radius;
+	}
+
+	// Cone against the cluster's bounding sphere: the distance from the
+	// sphere's center to the cone, measured across the axis, and whether it
+	// lies wholly in front of or behind the cone's range.
+	bool ConeTouches(const LightClusters::ClusterBounds &b, std::uint32_t c, const LightClusters::Volume &light)
+	{
+		const Float3 v = { b.centerX[c] - light.apex.x, b.centerY[c] - light.apex.y, b.centerZ[c] - light.apex.z };
+		const float lengthSq = Dot(v, v);
+		const float along = Dot(v, light.direction);
+		const float across = std::sqrt((std::max)(lengthSq - along * along, 0.0f));
+		const float distance = light.cosAngle * across - along * light.sinAngle;
+		const float r = b.radius[c];
+		return distance <= r && along <= r + light.range && along >= -r;
+	}
+
+	std::uint32_t ScalarSphereClusters(const LightClusters::ClusterBounds &bounds, std::uint32_t first, std::uint32_t count,
+		const LightClusters::Volume &light, std::uint32_t *hits)
+	{
+		std::uint32_t found = 0;
+		for (std::uint32_t c = first; c < first + count; c++)
+		{
+			if (SphereTouches(bounds, c, light))
+			{
+				hits[found++] = c;
+			}
+		}
+		return found;
+	}
+
+	std::uint32_t ScalarConeClusters(const LightClusters::ClusterBounds &bounds, std::uint32_t first, std::uint32_t count,
+		const LightClusters::Volume &light, std::uint32_t *hits)
+	{
+		std::uint32_t found = 0;
+		for (std::uint32_t c = first; c < first + count; c++)
+		{
+			if (SphereTouches(bounds, c, light) && ConeTouches(bounds, c, light))
+			{
+				hits[found++] = c;
+			}
+		}
+		return found;
+	}
+
+	const LightClusters::Kernels scalarKernels = {
+		ScalarSphereClusters,
+		ScalarConeClusters,
+	};
+
+#if defined(BKMZ_LIGHTS_SSE2)
+	// Four clusters at a time. Lanes past `count` are masked off.
+	__m128 Sse2AxisDistance(__m128 value, const float *low, const float *high)
+	{
+		const __m128 below = _mm_sub_ps(_mm_loadu_ps(low), value);
+		const __m128 above = _mm_sub_ps(value, _mm_loadu_ps(high));
+		return _mm_max_ps(_mm_max_ps(below, above), _mm_setzero_ps());
+	}
+
+	__m128 Sse2SphereMask(const LightClusters::ClusterBounds &b, std::uint32_t c, const LightClusters::Volume &light)
+	{
+		const __m128 dx = Sse2AxisDistance(_mm_set1_ps(light.center.x), b.minX + c, b.maxX + c);
+		const __m128 dy = Sse2AxisDistance(_mm_set1_ps(light.center.y), b.minY + c, b.maxY + c);
+		const __m128 dz = Sse2AxisDistance(_mm_set1_ps(light.center.z), b.minZ + c, b.maxZ + c);
+		const __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		return _mm_cmple_ps(distanceSq, _mm_set1_ps(light.radius * light.radius));
+	}
+
+	__m128 Sse2ConeMask(const LightClusters::ClusterBounds &b, std::uint32_t c, const LightClusters::Volume &light)
+	{
+		const __m128 vx = _mm_sub_ps(_mm_loadu_ps(b.centerX + c), _mm_set1_ps(light.apex.x));
+		const __m128 vy = _mm_sub_ps(_mm_loadu_ps(b.centerY + c), _mm_set1_ps(light.apex.y));
+		const __m128 vz = _mm_sub_ps(_mm_loadu_ps(b.centerZ + c), _mm_set1_ps(light.apex.z));
+		const __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+		const __m128 along = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(vx, _mm_set1_ps(light.direction.x)),
+			_mm_mul_ps(vy, _mm_set1_ps(light.direction.y))),
+			_mm_mul_ps(vz, _mm_set1_ps(light.direction.z)));
+		const __m128 across = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lengthSq, _mm_mul_ps(along, along)), _mm_setzero_ps()));
+		const __m128 distance = _mm_sub_ps(_mm_mul_ps(across, _mm_set1_ps(light.cosAngle)), _mm_mul_ps(along, _mm_set1_ps(light.sinAngle)));
+		const __m128 r = _mm_loadu_ps(b.radius + c);
+		const __m128 inside = _mm_and_ps(_mm_cmple_ps(distance, r), _mm_cmple_ps(along, _mm_add_ps(r, _mm_set1_ps(light.range))));
+		return _mm_and_ps(inside, _mm_cmpge_ps(along, _mm_sub_ps(_mm_setzero_ps(), r)));
+	}
+
+	std::uint32_t AppendHits(unsigned mask, std::uint32_t first, std::uint32_t *hits, std::uint32_t found)
+	{
+		while (mask != 0)
+		{
+			hits[found++] = first + (std::uint32_t)std::countr_zero(mask);
+			mask &= mask - 1;
+		}
+		return found;
+	}
+
+	unsigned LaneMask(std::uint32_t remaining, std::uint32_t lanes)
+	{
+		return remaining >= lanes ? (1u << lanes) - 1 : (1u << remaining) - 1;
+	}
+
+	std::uint32_t Sse2SphereClusters(const LightClusters::ClusterBounds &bounds, std::uint32_t first, std::uint32_t count,
+		const LightClusters::Volume &light, std::uint32_t *hits)
+	{
+		std::uint32_t found = 0;
+		for (std::uint32_t i = 0; i < count; i += 4)
+		{
+			const unsigned mask = (unsigned)_mm_movemask_ps(Sse2SphereMask(bounds, first + i, light)) & LaneMask(count - i, 4);
+			found = AppendHits(mask, first + i, hits, found);
+		}
+		return found;
+	}
+
+	std::uint32_t Sse2ConeClusters(const LightClusters::ClusterBounds &bounds, std::uint32_t first, std::uint32_t count,
+		const LightClusters::Volume &light, std::uint32_t *hits)
+	{
+		std::uint32_t found = 0;
+		for (std::uint32_t i = 0; i < count; i += 4)
+		{
+			const __m128 touches = _mm_and_ps(Sse2SphereMask(bounds, first + i, light), Sse2ConeMask(bounds, first + i, light));
+			found = AppendHits((unsigned)_mm_movemask_ps(touches) & LaneMask(count - i, 4), first + i, hits, found);
+		}
+		return found;
+	}
+
+	const LightClusters::Kernels sse2Kernels = {
+		Sse2SphereClusters,
+		Sse2ConeClusters,
+	};
+#endif
+
+	const LightClusters::Kernels &ActiveKernels()
+	{
+		const LightClusters::Kernels *kernels = nullptr;
+		switch (ActiveBackend())
+		{
+		case SimdBackend::Avx2:
+			kernels = LightClusters::Avx2Kernels();
+			break;
+		case SimdBackend::Sse4:
+			kernels = LightClusters::Sse2Kernels();
+			break;
+		default:
+			break;
+		}
+		return kernels ? *kernels : scalarKernels;
+	}
+
+	// The smallest sphere around a spot light's cone is the one through the
+	// apex and the rim for narrow cones, and the one around the rim for wide
+	// ones.
+	LightClusters::Volume SpotVolume(Float3 apex, Float3 direction, float range, float cosAngle)
+	{
+		LightClusters::Volume volume;
+		volume.apex = apex;
+		volume.direction = direction;
+		volume.range = range;
+		volume.cosAngle = std::clamp(cosAngle, 0.0f, 1.0f);
+		volume.sinAngle = std::sqrt(1.0f - volume.cosAngle * volume.cosAngle);
+		if (volume.cosAngle >= 0.70710678f)
+		{
+			volume.radius = range / (2.0f * volume.cosAngle);
+			volume.center = apex + direction * volume.radius;
+		}
+		else
+		{
+			volume.radius = range * volume.sinAngle;
+			volume.center = apex + direction * (range * volume.cosAngle);
+		}
+		return volume;
+	}
+}
+
+const LightClusters::Kernels *LightClusters::Sse2Kernels()
+{
+#if defined(BKMZ_LIGHTS_SSE2)
+	return &sse2Kernels;
+#else
+	return nullptr;
+#endif
+}
+
+LightClusters::LightClusters(ClusterGrid grid, std::uint32_t maxIndices)
+	: grid(grid), maxIndices(maxIndices)
+{
+	this->grid.tilesX = (std::max)(grid.tilesX, 1u);
+	this->grid.tilesY = (std::max)(grid.tilesY, 1u);
+	this->grid.slices = (std::max)(grid.slices, 1u);
+	rowHits.resize(this->grid.tilesX + boundsPadding);
+	SetProjection(piOver4, 16.0f / 9.0f, 0.1f, 1000.0f);
+}
+
+void LightClusters::SetProjection(float fovY, float aspectRatio, float nearZ, float farZ)
+{
+	if (fovY == this->fovY && aspectRatio == this->aspectRatio && nearZ == this->nearZ && farZ == this->farZ)
+	{
+		return;
+	}
+	this->fovY = fovY;
+	this->aspectRatio = aspectRatio;
+	this->nearZ = nearZ;
+	this->farZ = farZ;
+
+	tanHalfY = std::tan(fovY * 0.5f);
+	tanHalfX = tanHalfY * aspectRatio;
+	const float logDepthRange = std::log(farZ / nearZ);
+	sliceScale = grid.slices / logDepthRange;
+	sliceBias = -(float)grid.slices * std::log(nearZ) / logDepthRange;
+
+	sliceNear.resize(grid.slices);
+	sliceFar.resize(grid.slices);
+	for (std::uint32_t k = 0; k < grid.slices; k++)
+	{
+		sliceNear[k] = nearZ * std::pow(farZ / nearZ, (float)k / grid.slices);
+		sliceFar[k] = k + 1 == grid.slices ? farZ : nearZ * std::pow(farZ / nearZ, (float)(k + 1) / grid.slices);
+	}
+
+	const std::uint32_t size = ClusterCount() + boundsPadding;
+	for (std::vector<float> *component : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ, &centerX, &centerY, &centerZ, &radius })
+	{
+		component->assign(size, 0.0f);
+	}
+	for (std::uint32_t k = 0; k < grid.slices; k++)
+	{
+		const float z0 = sliceNear[k];
+		const float z1 = sliceFar[k];
+		for (std::uint32_t y = 0; y < grid.tilesY; y++)
+		{
+			// Tile rows count down from the top, where view space y is largest.
+			const float top = (1.0f - 2.0f * y / grid.tilesY) * tanHalfY;
+			const float bottom = (1.0f - 2.0f * (y + 1) / grid.tilesY) * tanHalfY;
+			for (std::uint32_t x = 0; x < grid.tilesX; x++)
+			{
+				const float left = (-1.0f + 2.0f * x / grid.tilesX) * tanHalfX;
+				const float right = (-1.0f + 2.0f * (x + 1) / grid.tilesX) * tanHalfX;
+
+				const std::uint32_t c = ClusterIndex(x, y, k);
+				minX[c] = (std::min)(left * z0, left * z1);
+				maxX[c] = (std::max)(right * z0, right * z1);
+				minY[c] = (std::min)(bottom * z0, bottom * z1);
+				maxY[c] = (std::max)(top * z0, top * z1);
+				minZ[c] = z0;
+				maxZ[c] = z1;
+
+				centerX[c] = (minX[c] + maxX[c]) * 0.5f;
+				centerY[c] = (minY[c] + maxY[c]) * 0.5f;
+				centerZ[c] = (z0 + z1) * 0.5f;
+				radius[c] = Length({ maxX[c] - centerX[c], maxY[c] - centerY[c], z1 - centerZ[c] });
+			}
+		}
+	}
+}
+
+std::uint32_t LightClusters::SliceOf(float z) const
+{
+	const float slice = std::floor(std::log(z) * sliceScale + sliceBias);
+	return (std::uint32_t)std::clamp(slice, 0.0f, (float)(grid.slices - 1));
+}
+
+LightClusters::ClusterBounds LightClusters::Bounds() const
+{
+	return {
+		minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data(),
+		centerX.data(), centerY.data(), centerZ.data(), radius.data(),
+	};
+}
+
+void LightClusters::Build(std::span<const Light> lights, const Float4x4 &view)
+{
+	stats = {};
+	stats.lights = (std::uint32_t)lights.size();
+	hits.clear();
+
+	viewPositions.resize(lights.size());
+	for (std::size_t i = 0; i < lights.size(); i++)
+	{
+		viewPositions[i] = lights[i].position;
+	}
+	TransformPoints(viewPositions.data(), view, viewPositions.data(), viewPositions.size());
+
+	for (std::uint32_t i = 0; i < (std::uint32_t)lights.size(); i++)
+	{
+		const Light &light = lights[i];
+		LightClusters::Volume volume;
+		if (light.type == LightType::Spot)
+		{
+			volume = SpotVolume(viewPositions[i], TransformVector(light.direction, view), light.range, light.cosOuterAngle);
+		}
+		else
+		{
+			volume = {};
+			volume.center = viewPositions[i];
+			volume.radius = light.range;
+		}
+		BinLight(i, volume, light.type == LightType::Spot);
+	}
+
+	// Counting sort by cluster. Hits come light by light, so each cluster's
+	// lights stay in index order.
+	if (hits.size() > maxIndices)
+	{
+		stats.dropped = (std::uint32_t)(hits.size() - maxIndices);
+		hits.resize(maxIndices);
+	}
+	stats.indices = (std::uint32_t)hits.size();
+
+	ranges.assign(ClusterCount(), { 0, 0 });
+	for (const Hit &hit : hits)
+	{
+		ranges[hit.cluster].count++;
+	}
+	cursors.resize(ranges.size());
+	std::uint32_t offset = 0;
+	for (std::size_t c = 0; c < ranges.size(); c++)
+	{
+		ranges[c].offset = offset;
+		cursors[c] = offset;
+		offset += ranges[c].count;
+	}
+	indices.resize(hits.size());
+	for (const Hit &hit : hits)
+	{
+		indices[cursors[hit.cluster]++] = hit.light;
+	}
+}
+
+void LightClusters::BinLight(std::uint32_t light, const Volume &volume, bool cone)
+{
+	const float zMin = volume.center.z - volume.radius;
+	const float zMax = volume.center.z + volume.radius;
+	if (zMax < nearZ || zMin > farZ)
+	{
+		return;
+	}
+
+	const LightClusters::Kernels &kernels = ActiveKernels();
+	const auto test = cone ? kernels.coneClusters : kernels.sphereClusters;
+	const LightClusters::ClusterBounds bounds = Bounds();
+	const std::size_t before = hits.size();
+
+	const float left = volume.center.x - volume.radius;
+	const float right = volume.center.x + volume.radius;
+	const float bottom = volume.center.y - volume.radius;
+	const float top = volume.center.y + volume.radius;
+
+	const std::uint32_t lastSlice = SliceOf((std::min)(zMax, farZ));
+	for (std::uint32_t k = SliceOf((std::max)(zMin, nearZ)); k <= lastSlice; k++)
+	{
+		// The slopes (x / z and y / z) the light's bounding box covers
+		// within this slice narrow it down to a rectangle of tiles.
+		const float z0 = (std::max)(zMin, sliceNear[k]);
+		const float z1 = (std::min)(zMax, sliceFar[k]);
+		if (z0 > z1)
+		{
+			continue;
+		}
+		const float minSlopeX = left / (left < 0.0f ? z0 : z1);
+		const float maxSlopeX = right / (right > 0.0f ? z0 : z1);
+		const float minSlopeY = bottom / (bottom < 0.0f ? z0 : z1);
+		const float maxSlopeY = top / (top > 0.0f ? z0 : z1);
+		if (maxSlopeX < -tanHalfX || minSlopeX > tanHalfX || maxSlopeY < -tanHalfY || minSlopeY > tanHalfY)
+		{
+			continue;
+		}
+
+		auto tile = [](float t, std::uint32_t tiles)
+		{
+			return (std::uint32_t)std::clamp(std::floor(t * tiles), 0.0f, (float)(tiles - 1));
+		};
+		const std::uint32_t x0 = tile((minSlopeX / tanHalfX + 1.0f) * 0.5f, grid.tilesX);
+		const std::uint32_t x1 = tile((maxSlopeX / tanHalfX + 1.0f) * 0.5f, grid.tilesX);
+		const std::uint32_t y0 = tile((1.0f - maxSlopeY / tanHalfY) * 0.5f, grid.tilesY);
+		const std::uint32_t y1 = tile((1.0f - minSlopeY / tanHalfY) * 0.5f, grid.tilesY);
+
+		for (std::uint32_t y = y0; y <= y1; y++)
+		{
+			const std::uint32_t found = test(bounds, ClusterIndex(x0, y, k), x1 - x0 + 1, volume, rowHits.data());
+			for (std::uint32_t h = 0; h < found; h++)
+			{
+				hits.push_back({ rowHits[h], light });
+			}
+		}
+	}
+
+	if (hits.size() > before)
+	{
+		stats.visible++;
+	}
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include "Math.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Clustered forward lighting, the CPU half.
+//
+// The view frustum is cut into a grid of clusters: tilesX by tilesY screen
+// tiles, each split into slices along view space depth, exponentially so
+// near clusters stay small. Build bins every light into the clusters its
+// volume touches, testing spheres (point lights) and cones (spot lights)
+// against the clusters' view space bounds a row of clusters at a time with
+// the SIMD backend bkmz::math picked. The result is one compact list of
+// light indices, sorted by cluster, and each cluster's range in it. The
+// pixel shader finds its cluster from its screen position and view depth
+// and only loops over those lights.
+//
+// Nothing here touches the GPU: LightBuffers uploads what Build produced.
+
+enum class LightType : std::uint32_t
+{
+	Point,
+	Spot,
+};
+
+// Also the layout of the light buffer the pixel shader reads, Light in
+// PixelShader.hlsl.
+struct Light
+{
+	bkmz::math::Float3 position; // world space
+	float range;                 // nothing lit past this distance
+	bkmz::math::Float3 color;    // already scaled by intensity
+	LightType type;
+	bkmz::math::Float3 direction; // spot lights, normalized
+	float cosOuterAngle;          // spot lights, cos of the cone's half angle
+};
+
+static_assert(sizeof(Light) == 48);
+
+struct ClusterGrid
+{
+	std::uint32_t tilesX = 16;
+	std::uint32_t tilesY = 9;
+	std::uint32_t slices = 24;
+};
+
+// A cluster's lights are Indices()[offset, offset + count).
+struct ClusterRange
+{
+	std::uint32_t offset;
+	std::uint32_t count;
+};
+
+struct LightClusterStats
+{
+	std::uint32_t lights = 0;
+	std::uint32_t visible = 0; // lights in at least one cluster
+	std::uint32_t indices = 0; // light index list entries
+	std::uint32_t dropped = 0; // entries past maxIndices, left out
+};
+
+class LightClusters
+{
+public:
+	static constexpr std::uint32_t defaultMaxIndices = 1 << 20;
+
+	// maxIndices caps the light index list, so the GPU buffer holding it
+	// can be sized once. Past it, the lights binned last lose their
+	// clusters, see Stats().dropped.
+	explicit LightClusters(ClusterGrid grid = {}, std::uint32_t maxIndices = defaultMaxIndices);
+
+	// The projection the clusters are laid out for, the arguments of
+	// PerspectiveFovLH. Cluster bounds are only recomputed when it changes.
+	void SetProjection(float fovY, float aspectRatio, float nearZ, float farZ);
+
+	// Bins the lights as seen through `view`, a rigid world to view
+	// transform such as LookAtLH's. Lights are referred to by their index
+	// in `lights`.
+	void Build(std::span<const Light> lights, const bkmz::math::Float4x4 &view);
+
+	// One range per cluster, cluster (x, y, slice) at ClusterIndex. Tile y
+	// counts down from the top of the screen, like pixel coordinates.
+	std::span<const ClusterRange> Ranges() const { return ranges; }
+	std::span<const std::uint32_t> Indices() const { return indices; }
+	const LightClusterStats &Stats() const { return stats; }
+
+	const ClusterGrid &Grid() const { return grid; }
+	std::uint32_t ClusterCount() const { return grid.tilesX * grid.tilesY * grid.slices; }
+	std::uint32_t MaxIndices() const { return maxIndices; }
+
+	std::uint32_t ClusterIndex(std::uint32_t x, std::uint32_t y, std::uint32_t slice) const
+	{
+		return (slice * grid.tilesY + y) * grid.tilesX + x;
+	}
+
+	// A view depth's slice is floor(log(z) * SliceScale() + SliceBias()),
+	// clamped to the grid; the shader uses the same constants.
+	float SliceScale() const { return sliceScale; }
+	float SliceBias() const { return sliceBias; }
+
+	// The rest is for the SIMD backends, LightClusters.cpp and
+	// LightClustersAvx2.cpp.
+
+	// A light's bounding sphere in view space and, for spot lights, its
+	// cone.
+	struct Volume
+	{
+		bkmz::math::Float3 center;
+		float radius;
+		bkmz::math::Float3 apex;
+		float range;
+		bkmz::math::Float3 direction;
+		float cosAngle;
+		float sinAngle;
+	};
+
+	struct ClusterBounds
+	{
+		const float *minX, *minY, *minZ, *maxX, *maxY, *maxZ;
+		const float *centerX, *centerY, *centerZ, *radius;
+	};
+
+	// Write the index of every cluster in [first, first + count) the light
+	// touches to `hits`, in order, and return how many. Bounds arrays are
+	// readable up to 8 clusters past the last one.
+	struct Kernels
+	{
+		std::uint32_t (*sphereClusters)(const ClusterBounds &bounds, std::uint32_t first, std::uint32_t count,
+			const Volume &light, std::uint32_t *hits);
+		std::uint32_t (*coneClusters)(const ClusterBounds &bounds, std::uint32_t first, std::uint32_t count,
+			const Volume &light, std::uint32_t *hits);
+	};
+
+	// nullptr when the backend isn't compiled in.
+	static const Kernels *Sse2Kernels();
+	static const Kernels *Avx2Kernels();
+
+private:
+	struct Hit
+	{
+		std::uint32_t cluster;
+		std::uint32_t light;
+	};
+
+	std::uint32_t SliceOf(float z) const;
+	ClusterBounds Bounds() const;
+	void BinLight(std::uint32_t light, const Volume &volume, bool cone);
+
+	ClusterGrid grid;
+	std::uint32_t maxIndices;
+
+	float fovY = 0.0f;
+	float aspectRatio = 0.0f;
+	float nearZ = 0.0f;
+	float farZ = 0.0f;
+	float tanHalfX = 0.0f;
+	float tanHalfY = 0.0f;
+	float sliceScale = 0.0f;
+	float sliceBias = 0.0f;
+
+	// View space bounds of each cluster, one array per component, with
+	// room for SIMD kernels to read a few clusters past the last.
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> sliceNear, sliceFar;
+
+	std::vector<bkmz::math::Float3> viewPositions;
+	std::vector<std::uint32_t> rowHits;
+	std::vector<Hit> hits;
+
+	std::vector<ClusterRange> ranges;
+	std::vector<std::uint32_t> indices;
+	std::vector<std::uint32_t> cursors;
+	LightClusterStats stats;
+};
@@ -0,0 +1,102 @@
+#include "LightClusters.h"
+
+// Built with -mavx2 -mfma on GCC and Clang, like MathBatchAvx2.cpp, and
+// only called once bkmz::math has found AVX2 on the CPU.
+
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(BKMZ_MATH_SCALAR_ONLY) && !defined(BKMZ_MATH_NO_AVX2)
+#include <immintrin.h>
+#include <bit>
+
+namespace
+{
+	// Eight clusters at a time. Lanes past `count` are masked off.
+	__m256 AxisDistance(__m256 value, const float *low, const float *high)
+	{
+		const __m256 below = _mm256_sub_ps(_mm256_loadu_ps(low), value);
+		const __m256 above = _mm256_sub_ps(value, _mm256_loadu_ps(high));
+		return _mm256_max_ps(_mm256_max_ps(below, above), _mm256_setzero_ps());
+	}
+
+	__m256 SphereMask(const LightClusters::ClusterBounds &b, std::uint32_t c, const LightClusters::Volume &light)
+	{
+		const __m256 dx = AxisDistance(_mm256_set1_ps(light.center.x), b.minX + c, b.maxX + c);
+		const __m256 dy = AxisDistance(_mm256_set1_ps(light.center.y), b.minY + c, b.maxY + c);
+		const __m256 dz = AxisDistance(_mm256_set1_ps(light.center.z), b.minZ + c, b.maxZ + c);
+		const __m256 distanceSq = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+		return _mm256_cmp_ps(distanceSq, _mm256_set1_ps(light.radius * light.radius), _CMP_LE_OQ);
+	}
+
+	__m256 ConeMask(const LightClusters::ClusterBounds &b, std::uint32_t c, const LightClusters::Volume &light)
+	{
+		const __m256 vx = _mm256_sub_ps(_mm256_loadu_ps(b.centerX + c), _mm256_set1_ps(light.apex.x));
+		const __m256 vy = _mm256_sub_ps(_mm256_loadu_ps(b.centerY + c), _mm256_set1_ps(light.apex.y));
+		const __m256 vz = _mm256_sub_ps(_mm256_loadu_ps(b.centerZ + c), _mm256_set1_ps(light.apex.z));
+		const __m256 lengthSq = _mm256_fmadd_ps(vz, vz, _mm256_fmadd_ps(vy, vy, _mm256_mul_ps(vx, vx)));
+		const __m256 along = _mm256_fmadd_ps(vz, _mm256_set1_ps(light.direction.z),
+			_mm256_fmadd_ps(vy, _mm256_set1_ps(light.direction.y), _mm256_mul_ps(vx, _mm256_set1_ps(light.direction.x))));
+		const __m256 across = _mm256_sqrt_ps(_mm256_max_ps(_mm256_fnmadd_ps(along, along, lengthSq), _mm256_setzero_ps()));
+		const __m256 distance = _mm256_fmsub_ps(across, _mm256_set1_ps(light.cosAngle), _mm256_mul_ps(along, _mm256_set1_ps(light.sinAngle)));
+		const __m256 r = _mm256_loadu_ps(b.radius + c);
+		const __m256 inside = _mm256_and_ps(
+			_mm256_cmp_ps(distance, r, _CMP_LE_OQ),
+			_mm256_cmp_ps(along, _mm256_add_ps(r, _mm256_set1_ps(light.range)), _CMP_LE_OQ));
+		return _mm256_and_ps(inside, _mm256_cmp_ps(along, _mm256_sub_ps(_mm256_setzero_ps(), r), _CMP_GE_OQ));
+	}
+
+	std::uint32_t AppendHits(__m256 touches, std::uint32_t first, std::uint32_t remaining, std::uint32_t *hits, std::uint32_t found)
+	{
+		unsigned mask = (unsigned)_mm256_movemask_ps(touches);
+		if (remaining < 8)
+		{
+			mask &= (1u << remaining) - 1;
+		}
+		while (mask != 0)
+		{
+			hits[found++] = first + (std::uint32_t)std::countr_zero(mask);
+			mask &= mask - 1;
+		}
+		return found;
+	}
+
+	std::uint32_t Avx2SphereClusters(const LightClusters::ClusterBounds &bounds, std::uint32_t first, std::uint32_t count,
+		const LightClusters::Volume &light, std::uint32_t *hits)
+	{
+		std::uint32_t found = 0;
+		for (std::uint32_t i = 0; i < count; i += 8)
+		{
+			found = AppendHits(SphereMask(bounds, first + i, light), first + i, count - i, hits, found);
+		}
+		return found;
+	}
+
+	std::uint32_t Avx2ConeClusters(const LightClusters::ClusterBounds &bounds, std::uint32_t first, std::uint32_t count,
+		const LightClusters::Volume &light, std::uint32_t *hits)
+	{
+		std::uint32_t found = 0;
+		for (std::uint32_t i = 0; i < count; i += 8)
+		{
+			const __m256 touches = _mm256_and_ps(SphereMask(bounds, first + i, light), ConeMask(bounds, first + i, light));
+			found = AppendHits(touches, first + i, count - i, hits, found);
+		}
+		return found;
+	}
+
+	const LightClusters::Kernels kernels = {
+		Avx2SphereClusters,
+		Avx2ConeClusters,
+	};
+}
+
+const LightClusters::Kernels *LightClusters::Avx2Kernels()
+{
+	return &kernels;
+}
+
+#else
+
+const LightClusters::Kernels *LightClusters::Avx2Kernels()
+{
+	return nullptr;
+}
+
+#endif
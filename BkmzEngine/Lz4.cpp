@@ -0,0 +1,214 @@
+#include "Lz4.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	constexpr std::size_t minMatch = 4;
+	constexpr std::size_t lastLiterals = 5;  // a block always ends in literals
+	constexpr std::size_t matchFindLimit = 12; // no match starts closer to the end
+	constexpr std::size_t maxOffset = 65535;
+	constexpr int hashBits = 12;
+
+	std::uint32_t Read32(const std::uint8_t *p)
+	{
+		std::uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	std::uint32_t HashSequence(std::uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - hashBits);
+	}
+
+	std::uint8_t *WriteLength(std::uint8_t *out, std::size_t length)
+	{
+		for (; length >= 255; length -= 255)
+		{
+			*out++ = 255;
+		}
+		*out++ = (std::uint8_t)length;
+		return out;
+	}
+
+	std::uint8_t *WriteSequence(std::uint8_t *out, const std::uint8_t *literals, std::size_t literalCount, std::size_t offset, std::size_t matchLength)
+	{
+		std::uint8_t *token = out++;
+		*token = (std::uint8_t)((literalCount < 15 ? literalCount : 15) << 4);
+		if (literalCount >= 15)
+		{
+			out = WriteLength(out, literalCount - 15);
+		}
+		if (literalCount != 0)
+		{
+			std::memcpy(out, literals, literalCount);
+			out += literalCount;
+		}
+
+		if (matchLength == 0)
+		{
+			return out; // the closing literals
+		}
+
+		*out++ = (std::uint8_t)offset;
+		*out++ = (std::uint8_t)(offset >> 8);
+
+		const std::size_t extra = matchLength - minMatch;
+		*token |= (std::uint8_t)(extra < 15 ? extra : 15);
+		if (extra >= 15)
+		{
+			out = WriteLength(out, extra - 15);
+		}
+		return out;
+	}
+
+	// Adds up a length's extension bytes. False when the input ends first.
+	bool ReadLength(const std::uint8_t *&in, const std::uint8_t *end, std::size_t &length)
+	{
+		std::uint8_t byte;
+		do
+		{
+			if (in == end)
+			{
+				return false;
+			}
+			byte = *in++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+}
+
+namespace bkmz::lz4
+{
+	std::size_t Compress(const std::uint8_t *source, std::size_t size, std::uint8_t *destination)
+	{
+		std::uint8_t *out = destination;
+		const std::uint8_t *anchor = source;
+
+		if (size > matchFindLimit)
+		{
+			std::vector<std::uint32_t> table(std::size_t(1) << hashBits, 0);
+			const std::uint8_t *end = source + size;
+			const std::uint8_t *searchEnd = end - matchFindLimit;
+			const std::uint8_t *matchEnd = end - lastLiterals;
+
+			const std::uint8_t *in = source;
+			while (in < searchEnd)
+			{
+				const std::uint32_t sequence = Read32(in);
+				const std::uint32_t hash = HashSequence(sequence);
+				const std::uint8_t *candidate = source + table[hash];
+				table[hash] = (std::uint32_t)(in - source);
+
+				if (candidate >= in || (std::size_t)(in - candidate) > maxOffset || Read32(candidate) != sequence)
+				{
+					in++;
+					continue;
+				}
+
+				std::size_t length = minMatch;
+				while (in + length < matchEnd && candidate[length] == in[length])
+				{
+					length++;
+				}
+
+				out = WriteSequence(out, anchor, (std::size_t)(in - anchor), (std::size_t)(in - candidate), length);
+				in += length;
+				anchor = in;
+			}
+		}
+
+		out = WriteSequence(out, anchor, (std::size_t)(source + size - anchor), 0, 0);
+		return (std::size_t)(out - destination);
+	}
+
+	bool Decompress(const std::uint8_t *source, std::size_t sourceSize, std::uint8_t *destination, std::size_t size)
+	{
+		const std::uint8_t *in = source;
+		const std::uint8_t *inEnd = source + sourceSize;
+		std::uint8_t *out = destination;
+		std::uint8_t *outEnd = destination + size;
+
+		while (true)
+		{
+			if (in == inEnd)
+			{
+				return false;
+			}
+			const std::uint8_t token = *in++;
+
+			std::size_t literalCount = token >> 4;
+			if (literalCount == 15 && !ReadLength(in, inEnd, literalCount))
+			{
+				return false;
+			}
+			if (literalCount > (std::size_t)(inEnd - in) || literalCount > (std::size_t)(outEnd - out))
+			{
+				return false;
+			}
+			if (literalCount <= 16 && inEnd - in >= 16 && outEnd - out >= 16)
+			{
+				// Short runs are the common case, one fixed size copy beats
+				// a call with a variable length.
+				std::memcpy(out, in, 16);
+			}
+			else if (literalCount != 0)
+			{
+				std::memcpy(out, in, literalCount);
+			}
+			in += literalCount;
+			out += literalCount;
+
+			if (in == inEnd)
+			{
+				return out == outEnd;
+			}
+
+			if (inEnd - in < 2)
+			{
+				return false;
+			}
+			const std::size_t offset = in[0] | (std::size_t)in[1] << 8;
+			in += 2;
+			if (offset == 0 || offset > (std::size_t)(out - destination))
+			{
+				return false;
+			}
+
+			std::size_t length = token & 15;
+			if (length == 15 && !ReadLength(in, inEnd, length))
+			{
+				return false;
+			}
+			length += minMatch;
+			if (length > (std::size_t)(outEnd - out))
+			{
+				return false;
+			}
+
+			// Overlapping matches repeat the bytes just written, so copies go
+			// forward in steps no longer than the offset. Steps may run past
+			// the match, as long as they stay inside the output, the bytes
+			// beyond it are written over later.
+			const std::uint8_t *match = out - offset;
+			std::uint8_t *matchEnd = out + length;
+			if (offset >= 8 && outEnd - matchEnd >= 8)
+			{
+				for (; out < matchEnd; out += 8, match += 8)
+				{
+					std::memcpy(out, match, 8);
+				}
+			}
+			else
+			{
+				for (; out < matchEnd; out++, match++)
+				{
+					*out = *match;
+				}
+			}
+			out = matchEnd;
+		}
+	}
+}
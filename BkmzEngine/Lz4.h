@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// LZ4 block format, compatible with the reference implementation's
+// LZ4_compress_default / LZ4_decompress_safe, without the frame format.
+//
+// The compressor is the plain greedy single-pass one, which is all the
+// asset packer needs; decompression speed is what matters at runtime.
+namespace bkmz::lz4
+{
+	// Worst case compressed size for `size` input bytes.
+	constexpr std::size_t CompressBound(std::size_t size)
+	{
+		return size + size / 255 + 16;
+	}
+
+	// `destination` must have room for CompressBound(size) bytes. Returns
+	// the compressed size.
+	std::size_t Compress(const std::uint8_t *source, std::size_t size, std::uint8_t *destination);
+
+	// Decompresses exactly `size` bytes. Returns false for malformed input,
+	// never reading or writing out of bounds.
+	bool Decompress(const std::uint8_t *source, std::size_t sourceSize, std::uint8_t *destination, std::size_t size);
+}
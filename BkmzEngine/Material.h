@@ -2,37 +2,112 @@
 #include <d3d12.h>
 #include "d3dcompiler.h"
 #include <wrl.h>
+#include <cstring>
 #include "Utils.h"
+#include "DeferredRelease.h"
+#include "DrawList.h"
+#include "ResourceRegistry.h"
+#include "Archive.h"
+#include "String.h"
+#include "ResourceHandles.h"
+#include "VertexLayout.h"
+
+// What a draw binds before anything per object. Materials that share one
+// can share its handle.
+struct Pipeline
+{
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> state;
+	ComPtr<ID3D12RootSignature> rootSignature;
 
-class Material
+	// For ExecuteIndirect with IndirectDrawCommand arguments.
+	ComPtr<ID3D12CommandSignature> commandSignature;
+};
+
+using PipelinePool = HandlePool<Pipeline, PipelineResource>;
+
+// Frames already recorded may still use the pipeline, so its objects go to
+// `releases` rather than away with the handle.
+inline void DestroyPipeline(PipelinePool &pipelines, PipelineHandle handle, DeferredReleaseQueue &releases)
 {
-public:
+	if (Pipeline *pipeline = pipelines.Get(handle))
+	{
+		releases.PushRelease(pipeline->state.Detach());
+		releases.PushRelease(pipeline->rootSignature.Detach());
+		releases.PushRelease(pipeline->commandSignature.Detach());
+		pipelines.Destroy(handle);
+	}
+}
 
-	~Material()
+// The input layout for vertices of one layout in slot 0. Semantic names
+// point into the layout's string literals, they outlive the PSO.
+template <std::size_t N>
+std::vector<D3D12_INPUT_ELEMENT_DESC> InputLayout(const VertexLayout<N> &layout)
+{
+	std::vector<D3D12_INPUT_ELEMENT_DESC> elements;
+	elements.reserve(N);
+	for (const VertexAttribute &attribute : layout.attributes)
 	{
-		if (cbufferUploader && cbufferMappedData)
-		{
-			cbufferUploader->Unmap(0, nullptr);
-			cbufferMappedData = nullptr;
-		}
+		elements.push_back({ attribute.semantic.data(), attribute.semanticIndex, (DXGI_FORMAT)VertexFormatDxgi(attribute.format),
+			0, attribute.offset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
 	}
+	return elements;
+}
+
+static_assert(VertexFormatDxgi(VertexFormat::Float) == DXGI_FORMAT_R32_FLOAT);
+static_assert(VertexFormatDxgi(VertexFormat::Float3) == DXGI_FORMAT_R32G32B32_FLOAT);
+static_assert(VertexFormatDxgi(VertexFormat::Float4) == DXGI_FORMAT_R32G32B32A32_FLOAT);
+static_assert(VertexFormatDxgi(VertexFormat::Unorm8x4) == DXGI_FORMAT_R8G8B8A8_UNORM);
+
+// Materials live in a HandlePool and get moved around in it. The pass
+// constants stay mapped for the material's lifetime, D3D12 unmaps a buffer
+// when it is released, so there is nothing to undo on destruction.
+class Material
+{
+public:
 
-	Microsoft::WRL::ComPtr<ID3D12PipelineState> PSO;
+	PipelineHandle pipeline;
 	std::vector<D3D12_INPUT_ELEMENT_DESC> inputLayout;
 
-	ComPtr<ID3D12DescriptorHeap> cbvHeap;
+	// Root signature layout shared by every material: a few 32-bit
+	// constants, mostly indices into the ResourceRegistry, and one table
+	// over the whole registry heap.
+	static constexpr UINT drawConstantsParameter = 0; // cbDraw, b0
+	static constexpr UINT resourceTableParameter = 1;
+
+	// cbDraw in the shaders, in 32-bit values.
+	static constexpr UINT objectIndexConstant = 0;        // set per draw
+	static constexpr UINT passConstantsIndexConstant = 1; // registry index
+	static constexpr UINT objectDataIndexConstant = 2;    // registry index
+	static constexpr UINT drawConstantCount = 3;
+
+	// Per pass constants, rewritten only when they change.
 	ComPtr<ID3D12Resource> cbufferUploader = nullptr;
-	ComPtr<ID3D12RootSignature> rootSignature;
+	UINT passConstantsIndex = ResourceRegistry::invalidIndex;
 
-	UINT cbufferObjectByteSize = 0;
+	UINT cbufferByteSize = 0;
 	UINT8 *cbufferMappedData = nullptr;
 
+	// Number of objects drawn with this material.
 	int objectCount = 0;
 
+	// Shaders come from here when they're in it, set before CreatePSO.
+	const Archive *assets = nullptr;
+
+	// What CreatePSO builds the pipeline from. Alpha blended materials
+	// blend over what's already drawn and don't write depth.
+	std::wstring vertexShaderName = L"VertexShader.cso";
+	std::wstring pixelShaderName = L"PixelShader.cso";
+	bool alphaBlended = false;
+
 	ComPtr<ID3DBlob> LoadShader(const std::wstring &filename)
 	{
+		const std::string name = bkmz::utl::ToNarrow(filename);
+		const ArchiveEntry *entry = assets ? assets->Find(name) : nullptr;
+		const std::vector<std::uint8_t> bytecode = entry ? assets->Read(name) : File::ReadAll(name);
+
 		ComPtr<ID3DBlob> blob;
-		DX_CALL(D3DReadFileToBlob(filename.c_str(), &blob));
+		DX_CALL(D3DCreateBlob(bytecode.size(), &blob));
+		std::memcpy(blob->GetBufferPointer(), bytecode.data(), bytecode.size());
 		return blob;
 	}
 
@@ -40,12 +115,14 @@ public:
 
 protected:
 
-	void CreatePSO(ID3D12Device* device, DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthStencilFormat, UINT cbvSrvUavDescriptorSize, UINT constantsByteSize)
+	void CreatePSO(ID3D12Device* device, DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthStencilFormat, ResourceRegistry &resources, PipelinePool &pipelines, DeferredReleaseQueue &releases, UINT constantsByteSize)
 	{
-		cbufferObjectByteSize = Utils::CalcConstantBufferByteSize(constantsByteSize);
+		Pipeline created;
+
+		cbufferByteSize = Utils::CalcConstantBufferByteSize(constantsByteSize);
 
 		CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
-		auto cbDesc = CD3DX12_RESOURCE_DESC::Buffer(cbufferObjectByteSize * objectCount);
+		auto cbDesc = CD3DX12_RESOURCE_DESC::Buffer(cbufferByteSize);
 
 		DX_CALL(device->CreateCommittedResource(
 			&heapProps,
@@ -57,58 +134,30 @@ protected:
 		));
 
 		DX_CALL(cbufferUploader->Map(0, nullptr, reinterpret_cast<void **>(&cbufferMappedData)));
-
-		D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc = {};
-		cbvHeapDesc.NumDescriptors = objectCount;
-		cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-		cbvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-
-		DX_CALL(device->CreateDescriptorHeap(&cbvHeapDesc, IID_PPV_ARGS(&cbvHeap)));
-
-		// Address to start of the buffer (0th constant buffer).
-		for (int i = 0; i < objectCount; i++)
-		{
-			D3D12_GPU_VIRTUAL_ADDRESS cbAddress = cbufferUploader->GetGPUVirtualAddress() + i * cbufferObjectByteSize;
-
-			auto hCPU = CD3DX12_CPU_DESCRIPTOR_HANDLE(
-				cbvHeap->GetCPUDescriptorHandleForHeapStart(),
-				i,
-				cbvSrvUavDescriptorSize
-			);
-
-
-			D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
-			cbvDesc.BufferLocation = cbAddress;
-			cbvDesc.SizeInBytes = cbufferObjectByteSize;
-
-			device->CreateConstantBufferView(&cbvDesc, hCPU);
-		}
+		passConstantsIndex = resources.AddConstantBuffer(cbufferUploader->GetGPUVirtualAddress(), cbufferByteSize);
+
+		// Bindless: every range covers the whole registry heap, one register
+		// space per resource kind, and shaders index them with the draw
+		// constants. New resources never need a root signature change.
+		// Unbounded CBV ranges need binding tier 3, dxApp::CreateDevice checks.
+		CD3DX12_DESCRIPTOR_RANGE resourceRanges[5];
+		resourceRanges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, UINT_MAX, 0, 1, 0); // constant buffers, space1
+		resourceRanges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 2, 0); // structured buffers, space2
+		resourceRanges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 3, 0); // textures, space3
+		resourceRanges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 4, 0); // light buffers, space4
+		resourceRanges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 5, 0); // uint buffers, space5
 
 		// Root parameter can be a table, root descriptor or root constants.
-		CD3DX12_ROOT_PARAMETER slotRootParameter[1];
-
-		// Create a single descriptor table of CBVs.
-		CD3DX12_DESCRIPTOR_RANGE cbvTable;
-
-		cbvTable.Init(
-			D3D12_DESCRIPTOR_RANGE_TYPE_CBV,
-			1, // Number of descriptors in table
-			0
-		);// base shader register arguments are bound to for this root parameter
-		slotRootParameter[0].InitAsDescriptorTable(
-			1, // Number of ranges
-			&cbvTable // Pointer to array of ranges
-		);
-
+		CD3DX12_ROOT_PARAMETER slotRootParameter[2];
+		slotRootParameter[drawConstantsParameter].InitAsConstants(drawConstantCount, 0);
+		slotRootParameter[resourceTableParameter].InitAsDescriptorTable(_countof(resourceRanges), resourceRanges);
 
 		// A root signature is an array of root parameters.
-		CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(1, slotRootParameter, 0,
+		CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(_countof(slotRootParameter), slotRootParameter, 0,
 			nullptr,
 			D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT
 		);
 
-		// create a root signature with a single slot which points to a
-		// descriptor range consisting of a single constant buffer.
 		ComPtr<ID3DBlob> serializedRootSig = nullptr;
 		ComPtr<ID3DBlob> errorBlob = nullptr;
 
@@ -121,11 +170,30 @@ protected:
 			0,
 			serializedRootSig->GetBufferPointer(),
 			serializedRootSig->GetBufferSize(),
-			IID_PPV_ARGS(&rootSignature))
+			IID_PPV_ARGS(&created.rootSignature))
 		);
 
-		auto vsBytecode = LoadShader(L"VertexShader.cso");
-		auto psBytecode = LoadShader(L"PixelShader.cso");
+		// Each indirect command sets the mesh buffers and the object index,
+		// then draws. Must match the layout of IndirectDrawCommand.
+		D3D12_INDIRECT_ARGUMENT_DESC arguments[4] = {};
+		arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+		arguments[0].VertexBuffer.Slot = 0;
+		arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+		arguments[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+		arguments[2].Constant.RootParameterIndex = drawConstantsParameter;
+		arguments[2].Constant.DestOffsetIn32BitValues = objectIndexConstant;
+		arguments[2].Constant.Num32BitValuesToSet = 1;
+		arguments[3].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+		D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+		signatureDesc.ByteStride = sizeof(IndirectDrawCommand);
+		signatureDesc.NumArgumentDescs = _countof(arguments);
+		signatureDesc.pArgumentDescs = arguments;
+
+		DX_CALL(device->CreateCommandSignature(&signatureDesc, created.rootSignature.Get(), IID_PPV_ARGS(&created.commandSignature)));
+
+		auto vsBytecode = LoadShader(vertexShaderName);
+		auto psBytecode = LoadShader(pixelShaderName);
 
 		CD3DX12_RASTERIZER_DESC rsDesc(D3D12_DEFAULT);
 
@@ -133,7 +201,7 @@ protected:
 		ZeroMemory(&psoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
 
 		psoDesc.InputLayout = { inputLayout.data(), (UINT)inputLayout.size() };
-		psoDesc.pRootSignature = rootSignature.Get();
+		psoDesc.pRootSignature = created.rootSignature.Get();
 		psoDesc.VS = {
 			reinterpret_cast<BYTE *>(vsBytecode->GetBufferPointer()),
 			vsBytecode->GetBufferSize()
@@ -146,6 +214,18 @@ protected:
 		psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
 		psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
 		psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+		if (alphaBlended)
+		{
+			D3D12_RENDER_TARGET_BLEND_DESC &blend = psoDesc.BlendState.RenderTarget[0];
+			blend.BlendEnable = TRUE;
+			blend.SrcBlend = D3D12_BLEND_SRC_ALPHA;
+			blend.DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+			blend.BlendOp = D3D12_BLEND_OP_ADD;
+			blend.SrcBlendAlpha = D3D12_BLEND_ONE;
+			blend.DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA;
+			blend.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+			psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+		}
 		psoDesc.SampleMask = UINT_MAX;
 		psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
 		psoDesc.NumRenderTargets = 1;
@@ -153,10 +233,12 @@ protected:
 		psoDesc.SampleDesc.Count = 1;
 		psoDesc.SampleDesc.Quality = 0;
 		psoDesc.DSVFormat = depthStencilFormat;
-		ComPtr<ID3D12PipelineState> mPSO;
-		DX_CALL(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&PSO)));
+		DX_CALL(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&created.state)));
+
+		DestroyPipeline(pipelines, pipeline, releases);
+		pipeline = pipelines.Create(std::move(created));
 	}
 
 public:
-	virtual void CreatePSO(ID3D12Device *device, DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthStencilFormat, UINT cbvSrvUavDescriptorSize) = 0;
+	virtual void CreatePSO(ID3D12Device *device, DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthStencilFormat, ResourceRegistry &resources, PipelinePool &pipelines, DeferredReleaseQueue &releases) = 0;
 };
\ No newline at end of file
@@ -0,0 +1,356 @@
+#pragma once
+#include <cmath>
+
+// Engine math types and functions, a portable replacement for the parts of
+// DirectXMath the engine uses.
+//
+// Conventions follow DirectX: row vectors multiplied on the left (v * M),
+// matrices stored row-major with the translation in the last row, and a
+// left-handed coordinate system. Transpose before copying a matrix into an
+// HLSL cbuffer, which defaults to column-major packing.
+//
+// The types are plain data so they can go into vertex buffers, cbuffers and
+// ECS components as they are. Functions here work on one value at a time;
+// MathBatch.h has SIMD kernels for arrays.
+namespace bkmz::math
+{
+	constexpr float pi = 3.14159265358979323846f;
+	constexpr float piOver2 = pi / 2.0f;
+	constexpr float piOver4 = pi / 4.0f;
+
+	struct Float3
+	{
+		float x, y, z;
+
+		bool operator==(const Float3 &) const = default;
+	};
+
+	struct Float4
+	{
+		float x, y, z, w;
+
+		bool operator==(const Float4 &) const = default;
+	};
+
+	// Unit quaternion, the vector part first like XMVECTOR quaternions.
+	struct Quaternion
+	{
+		float x = 0.0f, y = 0.0f, z = 0.0f, w = 1.0f;
+
+		bool operator==(const Quaternion &) const = default;
+	};
+
+	struct alignas(16) Float4x4
+	{
+		float m[4][4];
+
+		static constexpr Float4x4 Identity()
+		{
+			return { {
+				{ 1.0f, 0.0f, 0.0f, 0.0f },
+				{ 0.0f, 1.0f, 0.0f, 0.0f },
+				{ 0.0f, 0.0f, 1.0f, 0.0f },
+				{ 0.0f, 0.0f, 0.0f, 1.0f },
+			} };
+		}
+	};
+
+	inline Float3 operator+(Float3 a, Float3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	inline Float3 operator-(Float3 a, Float3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline Float3 operator*(Float3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+	inline Float3 operator*(Float3 a, Float3 b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+	inline Float3 &operator+=(Float3 &a, Float3 b) { return a = a + b; }
+	inline Float3 &operator-=(Float3 &a, Float3 b) { return a = a - b; }
+
+	inline float Dot(Float3 a, Float3 b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	inline Float3 Cross(Float3 a, Float3 b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	inline float Length(Float3 v)
+	{
+		return std::sqrt(Dot(v, v));
+	}
+
+	inline Float3 Normalize(Float3 v)
+	{
+		const float length = Length(v);
+		return length > 0.0f ? v * (1.0f / length) : v;
+	}
+
+	inline Float3 Lerp(Float3 a, Float3 b, float t)
+	{
+		return a + (b - a) * t;
+	}
+
+	// Rotation by a followed by rotation by b, the same order as
+	// XMQuaternionMultiply and as matrix products.
+	inline Quaternion Multiply(Quaternion a, Quaternion b)
+	{
+		return {
+			b.w * a.x + b.x * a.w + b.y * a.z - b.z * a.y,
+			b.w * a.y - b.x * a.z + b.y * a.w + b.z * a.x,
+			b.w * a.z + b.x * a.y - b.y * a.x + b.z * a.w,
+			b.w * a.w - b.x * a.x - b.y * a.y - b.z * a.z,
+		};
+	}
+
+	inline float Dot(Quaternion a, Quaternion b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	}
+
+	inline Quaternion Normalize(Quaternion q)
+	{
+		const float length = std::sqrt(Dot(q, q));
+		if (length <= 0.0f)
+		{
+			return {};
+		}
+		const float inv = 1.0f / length;
+		return { q.x * inv, q.y * inv, q.z * inv, q.w * inv };
+	}
+
+	inline Quaternion Conjugate(Quaternion q)
+	{
+		return { -q.x, -q.y, -q.z, q.w };
+	}
+
+	// axis must be normalized.
+	inline Quaternion QuaternionRotationAxis(Float3 axis, float angle)
+	{
+		const float s = std::sin(angle * 0.5f);
+		return { axis.x * s, axis.y * s, axis.z * s, std::cos(angle * 0.5f) };
+	}
+
+	// Roll around Z, then pitch around X, then yaw around Y, like
+	// XMQuaternionRotationRollPitchYaw.
+	inline Quaternion QuaternionRotationRollPitchYaw(float pitch, float yaw, float roll)
+	{
+		const Quaternion qRoll = QuaternionRotationAxis({ 0.0f, 0.0f, 1.0f }, roll);
+		const Quaternion qPitch = QuaternionRotationAxis({ 1.0f, 0.0f, 0.0f }, pitch);
+		const Quaternion qYaw = QuaternionRotationAxis({ 0.0f, 1.0f, 0.0f }, yaw);
+		return Multiply(Multiply(qRoll, qPitch), qYaw);
+	}
+
+	// Normalized lerp along the shorter arc. Close enough to Slerp for the
+	// small steps between two simulation states, and much cheaper.
+	inline Quaternion Nlerp(Quaternion a, Quaternion b, float t)
+	{
+		const float sign = Dot(a, b) < 0.0f ? -1.0f : 1.0f;
+		return Normalize({
+			a.x + (b.x * sign - a.x) * t,
+			a.y + (b.y * sign - a.y) * t,
+			a.z + (b.z * sign - a.z) * t,
+			a.w + (b.w * sign - a.w) * t,
+		});
+	}
+
+	inline Quaternion Slerp(Quaternion a, Quaternion b, float t)
+	{
+		float cosTheta = Dot(a, b);
+		const float sign = cosTheta < 0.0f ? -1.0f : 1.0f;
+		cosTheta *= sign;
+
+		if (cosTheta > 0.9995f)
+		{
+			return Nlerp(a, b, t);
+		}
+
+		const float theta = std::acos(cosTheta);
+		const float invSin = 1.0f / std::sin(theta);
+		const float wa = std::sin((1.0f - t) * theta) * invSin;
+		const float wb = std::sin(t * theta) * invSin * sign;
+		return {
+			a.x * wa + b.x * wb,
+			a.y * wa + b.y * wb,
+			a.z * wa + b.z * wb,
+			a.w * wa + b.w * wb,
+		};
+	}
+
+	inline Float4x4 Multiply(const Float4x4 &a, const Float4x4 &b)
+	{
+		Float4x4 result;
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				result.m[r][c] = a.m[r][0] * b.m[0][c] + a.m[r][1] * b.m[1][c] + a.m[r][2] * b.m[2][c] + a.m[r][3] * b.m[3][c];
+			}
+		}
+		return result;
+	}
+
+	inline Float4x4 operator*(const Float4x4 &a, const Float4x4 &b)
+	{
+		return Multiply(a, b);
+	}
+
+	inline Float4x4 Transpose(const Float4x4 &a)
+	{
+		Float4x4 result;
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				result.m[r][c] = a.m[c][r];
+			}
+		}
+		return result;
+	}
+
+	inline Float4x4 Translation(Float3 t)
+	{
+		Float4x4 result = Float4x4::Identity();
+		result.m[3][0] = t.x;
+		result.m[3][1] = t.y;
+		result.m[3][2] = t.z;
+		return result;
+	}
+
+	inline Float4x4 Scaling(Float3 s)
+	{
+		Float4x4 result = Float4x4::Identity();
+		result.m[0][0] = s.x;
+		result.m[1][1] = s.y;
+		result.m[2][2] = s.z;
+		return result;
+	}
+
+	inline Float4x4 RotationX(float angle)
+	{
+		const float s = std::sin(angle);
+		const float c = std::cos(angle);
+		Float4x4 result = Float4x4::Identity();
+		result.m[1][1] = c;
+		result.m[1][2] = s;
+		result.m[2][1] = -s;
+		result.m[2][2] = c;
+		return result;
+	}
+
+	inline Float4x4 RotationY(float angle)
+	{
+		const float s = std::sin(angle);
+		const float c = std::cos(angle);
+		Float4x4 result = Float4x4::Identity();
+		result.m[0][0] = c;
+		result.m[0][2] = -s;
+		result.m[2][0] = s;
+		result.m[2][2] = c;
+		return result;
+	}
+
+	inline Float4x4 RotationZ(float angle)
+	{
+		const float s = std::sin(angle);
+		const float c = std::cos(angle);
+		Float4x4 result = Float4x4::Identity();
+		result.m[0][0] = c;
+		result.m[0][1] = s;
+		result.m[1][0] = -s;
+		result.m[1][1] = c;
+		return result;
+	}
+
+	// q must be normalized.
+	inline Float4x4 RotationQuaternion(Quaternion q)
+	{
+		const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		const float xw = q.x * q.w, yw = q.y * q.w, zw = q.z * q.w;
+
+		return { {
+			{ 1.0f - 2.0f * (yy + zz), 2.0f * (xy + zw), 2.0f * (xz - yw), 0.0f },
+			{ 2.0f * (xy - zw), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + xw), 0.0f },
+			{ 2.0f * (xz + yw), 2.0f * (yz - xw), 1.0f - 2.0f * (xx + yy), 0.0f },
+			{ 0.0f, 0.0f, 0.0f, 1.0f },
+		} };
+	}
+
+	// Scaling(scale) * RotationQuaternion(rotation) * Translation(translation)
+	// without the two full matrix products.
+	inline Float4x4 AffineTransformation(Float3 scale, Quaternion rotation, Float3 translation)
+	{
+		Float4x4 result = RotationQuaternion(rotation);
+		const float s[3] = { scale.x, scale.y, scale.z };
+		for (int r = 0; r < 3; r++)
+		{
+			result.m[r][0] *= s[r];
+			result.m[r][1] *= s[r];
+			result.m[r][2] *= s[r];
+		}
+		result.m[3][0] = translation.x;
+		result.m[3][1] = translation.y;
+		result.m[3][2] = translation.z;
+		return result;
+	}
+
+	inline Float4x4 LookToLH(Float3 eye, Float3 direction, Float3 up)
+	{
+		const Float3 r2 = Normalize(direction);
+		const Float3 r0 = Normalize(Cross(up, r2));
+		const Float3 r1 = Cross(r2, r0);
+
+		return { {
+			{ r0.x, r1.x, r2.x, 0.0f },
+			{ r0.y, r1.y, r2.y, 0.0f },
+			{ r0.z, r1.z, r2.z, 0.0f },
+			{ -Dot(r0, eye), -Dot(r1, eye), -Dot(r2, eye), 1.0f },
+		} };
+	}
+
+	inline Float4x4 LookAtLH(Float3 eye, Float3 target, Float3 up)
+	{
+		return LookToLH(eye, target - eye, up);
+	}
+
+	// Maps view space depth [nearZ, farZ] to [0, 1].
+	inline Float4x4 PerspectiveFovLH(float fovY, float aspectRatio, float nearZ, float farZ)
+	{
+		const float h = 1.0f / std::tan(fovY * 0.5f);
+		const float w = h / aspectRatio;
+		const float range = farZ / (farZ - nearZ);
+
+		return { {
+			{ w, 0.0f, 0.0f, 0.0f },
+			{ 0.0f, h, 0.0f, 0.0f },
+			{ 0.0f, 0.0f, range, 1.0f },
+			{ 0.0f, 0.0f, -range * nearZ, 0.0f },
+		} };
+	}
+
+	// p * m with w = 1, dropping the resulting w. For affine matrices, use
+	// TransformCoord when a projection needs the divide.
+	inline Float3 TransformPoint(Float3 p, const Float4x4 &m)
+	{
+		return {
+			p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+			p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+			p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2],
+		};
+	}
+
+	inline Float3 TransformCoord(Float3 p, const Float4x4 &m)
+	{
+		const Float3 result = TransformPoint(p, m);
+		const float w = p.x * m.m[0][3] + p.y * m.m[1][3] + p.z * m.m[2][3] + m.m[3][3];
+		return result * (1.0f / w);
+	}
+
+	// v * m with w = 0, so translation doesn't apply.
+	inline Float3 TransformVector(Float3 v, const Float4x4 &m)
+	{
+		return {
+			v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0],
+			v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1],
+			v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2],
+		};
+	}
+}
@@ -0,0 +1,243 @@
+#include "MathBatch.h"
+#include <atomic>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define BKMZ_MATH_X64 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace bkmz::math
+{
+	namespace
+	{
+		void ScalarMultiplyMatrices(const Float4x4 *a, const Float4x4 *b, std::size_t bStride, Float4x4 *out, std::size_t count)
+		{
+			const Float4x4 shared = *b;
+			for (std::size_t i = 0; i < count; i++)
+			{
+				out[i] = Multiply(a[i], bStride ? b[i] : shared);
+			}
+		}
+
+		void ScalarTransformPoints(const Float3 *points, const Float4x4 &m, Float3 *out, std::size_t count)
+		{
+			const Float4x4 matrix = m;
+			for (std::size_t i = 0; i < count; i++)
+			{
+				out[i] = TransformPoint(points[i], matrix);
+			}
+		}
+
+		void ScalarRotationQuaternions(const Quaternion *rotations, Float4x4 *out, std::size_t count)
+		{
+			for (std::size_t i = 0; i < count; i++)
+			{
+				out[i] = RotationQuaternion(rotations[i]);
+			}
+		}
+
+		const MathKernels scalarKernels = {
+			ScalarMultiplyMatrices,
+			ScalarTransformPoints,
+			ScalarRotationQuaternions,
+		};
+
+#if defined(BKMZ_MATH_X64)
+		struct CpuFeatures
+		{
+			bool sse41 = false;
+			bool avx2 = false;
+		};
+
+		void Cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4])
+		{
+#if defined(_MSC_VER)
+			__cpuidex(reinterpret_cast<int *>(regs), (int)leaf, (int)subleaf);
+#else
+			__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+		}
+
+		unsigned long long Xgetbv()
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			unsigned eax, edx;
+			__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return ((unsigned long long)edx << 32) | eax;
+#endif
+		}
+
+		CpuFeatures DetectCpuFeatures()
+		{
+			CpuFeatures features;
+			unsigned regs[4];
+
+			Cpuid(0, 0, regs);
+			const unsigned maxLeaf = regs[0];
+
+			Cpuid(1, 0, regs);
+			features.sse41 = (regs[2] & (1u << 19)) != 0;
+
+			// AVX needs the OS to save the upper halves of the YMM registers,
+			// which it reports through OSXSAVE and XCR0.
+			const bool osxsave = (regs[2] & (1u << 27)) != 0;
+			const bool avx = (regs[2] & (1u << 28)) != 0;
+			const bool fma = (regs[2] & (1u << 12)) != 0;
+			if (!osxsave || !avx || !fma || maxLeaf < 7 || (Xgetbv() & 0x6) != 0x6)
+			{
+				return features;
+			}
+
+			Cpuid(7, 0, regs);
+			features.avx2 = (regs[1] & (1u << 5)) != 0;
+			return features;
+		}
+
+		const CpuFeatures &GetCpuFeatures()
+		{
+			static const CpuFeatures features = DetectCpuFeatures();
+			return features;
+		}
+#endif
+
+		const MathKernels *KernelsFor(SimdBackend backend)
+		{
+			switch (backend)
+			{
+			case SimdBackend::Scalar:
+				return detail::ScalarKernels();
+#if defined(BKMZ_MATH_X64)
+			case SimdBackend::Sse4:
+				return GetCpuFeatures().sse41 ? detail::Sse4Kernels() : nullptr;
+			case SimdBackend::Avx2:
+				return GetCpuFeatures().avx2 ? detail::Avx2Kernels() : nullptr;
+#endif
+			case SimdBackend::Neon:
+				return detail::NeonKernels();
+			default:
+				return nullptr;
+			}
+		}
+
+		SimdBackend BestBackend()
+		{
+			for (SimdBackend backend : { SimdBackend::Avx2, SimdBackend::Neon, SimdBackend::Sse4 })
+			{
+				if (IsBackendAvailable(backend))
+				{
+					return backend;
+				}
+			}
+			return SimdBackend::Scalar;
+		}
+
+		struct Dispatch
+		{
+			std::atomic<SimdBackend> backend;
+			std::atomic<const MathKernels *> kernels;
+
+			Dispatch()
+				: backend(BestBackend()), kernels(KernelsFor(backend))
+			{
+			}
+		};
+
+		Dispatch &GetDispatch()
+		{
+			static Dispatch dispatch;
+			return dispatch;
+		}
+
+		const MathKernels &Active()
+		{
+			return *GetDispatch().kernels.load(std::memory_order_relaxed);
+		}
+	}
+
+	namespace detail
+	{
+		const MathKernels *ScalarKernels()
+		{
+			return &scalarKernels;
+		}
+	}
+
+	const char *BackendName(SimdBackend backend)
+	{
+		switch (backend)
+		{
+		case SimdBackend::Scalar:
+			return "scalar";
+		case SimdBackend::Sse4:
+			return "sse4";
+		case SimdBackend::Avx2:
+			return "avx2";
+		case SimdBackend::Neon:
+			return "neon";
+		default:
+			return "unknown";
+		}
+	}
+
+	bool IsBackendAvailable(SimdBackend backend)
+	{
+		return KernelsFor(backend) != nullptr;
+	}
+
+	SimdBackend ActiveBackend()
+	{
+		return GetDispatch().backend.load(std::memory_order_relaxed);
+	}
+
+	bool SetBackend(SimdBackend backend)
+	{
+		const MathKernels *kernels = KernelsFor(backend);
+		if (kernels == nullptr)
+		{
+			return false;
+		}
+
+		Dispatch &dispatch = GetDispatch();
+		dispatch.kernels.store(kernels, std::memory_order_relaxed);
+		dispatch.backend.store(backend, std::memory_order_relaxed);
+		return true;
+	}
+
+	void MultiplyMatrices(const Float4x4 *a, const Float4x4 *b, Float4x4 *out, std::size_t count)
+	{
+		if (count != 0)
+		{
+			Active().multiplyMatrices(a, b, 1, out, count);
+		}
+	}
+
+	void MultiplyMatrices(const Float4x4 *a, const Float4x4 &b, Float4x4 *out, std::size_t count)
+	{
+		if (count != 0)
+		{
+			Active().multiplyMatrices(a, &b, 0, out, count);
+		}
+	}
+
+	void TransformPoints(const Float3 *points, const Float4x4 &m, Float3 *out, std::size_t count)
+	{
+		if (count != 0)
+		{
+			Active().transformPoints(points, m, out, count);
+		}
+	}
+
+	void RotationQuaternions(const Quaternion *rotations, Float4x4 *out, std::size_t count)
+	{
+		if (count != 0)
+		{
+			Active().rotationQuaternions(rotations, out, count);
+		}
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "Math.h"
+#include <cstddef>
+
+// SIMD kernels over arrays of math values.
+//
+// Each kernel has a scalar version plus SSE4.1, AVX2/FMA and NEON versions
+// where the target supports them. The fastest backend the CPU supports is
+// picked on first use; SetBackend overrides it, which is how the benchmarks
+// compare them. Define BKMZ_MATH_SCALAR_ONLY to compile only the scalar
+// kernels, or BKMZ_MATH_NO_AVX2 to leave out the AVX2 ones.
+//
+// Results match the scalar path to within rounding: the SIMD versions use
+// FMA where available and may sum in a different order.
+namespace bkmz::math
+{
+	enum class SimdBackend
+	{
+		Scalar,
+		Sse4,
+		Avx2,
+		Neon,
+	};
+
+	const char *BackendName(SimdBackend backend);
+
+	// Compiled in and supported by this CPU.
+	bool IsBackendAvailable(SimdBackend backend);
+
+	SimdBackend ActiveBackend();
+
+	// Returns false and leaves the active backend alone if `backend` isn't
+	// available. Not thread safe against kernels running at the same time.
+	bool SetBackend(SimdBackend backend);
+
+	// out[i] = a[i] * b[i]. out may alias a or b.
+	void MultiplyMatrices(const Float4x4 *a, const Float4x4 *b, Float4x4 *out, std::size_t count);
+
+	// out[i] = a[i] * b, for example world matrices times view-projection.
+	void MultiplyMatrices(const Float4x4 *a, const Float4x4 &b, Float4x4 *out, std::size_t count);
+
+	// out[i] = TransformPoint(points[i], m). out may alias points.
+	void TransformPoints(const Float3 *points, const Float4x4 &m, Float3 *out, std::size_t count);
+
+	// out[i] = RotationQuaternion(rotations[i]).
+	void RotationQuaternions(const Quaternion *rotations, Float4x4 *out, std::size_t count);
+
+	// The function table one backend provides. Only the backend sources and
+	// the dispatcher need this.
+	struct MathKernels
+	{
+		// bStride is 1 to step through b alongside a, 0 to reuse b[0].
+		void (*multiplyMatrices)(const Float4x4 *a, const Float4x4 *b, std::size_t bStride, Float4x4 *out, std::size_t count);
+		void (*transformPoints)(const Float3 *points, const Float4x4 &m, Float3 *out, std::size_t count);
+		void (*rotationQuaternions)(const Quaternion *rotations, Float4x4 *out, std::size_t count);
+	};
+
+	namespace detail
+	{
+		// nullptr when the backend isn't compiled in.
+		const MathKernels *ScalarKernels();
+		const MathKernels *Sse4Kernels();
+		const MathKernels *Avx2Kernels();
+		const MathKernels *NeonKernels();
+	}
+}
@@ -0,0 +1,211 @@
+#include "MathBatch.h"
+
+// Built with -mavx2 -mfma on GCC and Clang. Only called after the
+// dispatcher has checked the CPU, so nothing here may run at static init
+// time. Leftover elements go to the scalar kernels rather than the inline
+// functions in Math.h: an inline function instantiated here would be
+// compiled for AVX2, and the linker may keep that copy for every caller.
+
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(BKMZ_MATH_SCALAR_ONLY) && !defined(BKMZ_MATH_NO_AVX2)
+#include <immintrin.h>
+
+namespace bkmz::math
+{
+	namespace
+	{
+		// _MM_TRANSPOSE4_PS on both 128-bit halves independently.
+		void Transpose4InLanes(__m256 &r0, __m256 &r1, __m256 &r2, __m256 &r3)
+		{
+			const __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+			const __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+			const __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+			const __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+			r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+			r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+			r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+			r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		}
+
+		template <int I>
+		__m256 SplatInLanes(__m256 v)
+		{
+			return _mm256_shuffle_ps(v, v, _MM_SHUFFLE(I, I, I, I));
+		}
+
+		// Two rows of the product at once: each register holds rows r and r+1
+		// of a, and every row of b is broadcast to both halves.
+		__m256 MultiplyRows(__m256 rows, const __m256 b[4])
+		{
+			__m256 result = _mm256_mul_ps(SplatInLanes<0>(rows), b[0]);
+			result = _mm256_fmadd_ps(SplatInLanes<1>(rows), b[1], result);
+			result = _mm256_fmadd_ps(SplatInLanes<2>(rows), b[2], result);
+			result = _mm256_fmadd_ps(SplatInLanes<3>(rows), b[3], result);
+			return result;
+		}
+
+		// One matrix per iteration, two rows per instruction. An 8-wide
+		// kernel would first have to transpose eight AoS matrices, which
+		// costs more than the product itself.
+		void Avx2MultiplyMatrices(const Float4x4 *a, const Float4x4 *b, std::size_t bStride, Float4x4 *out, std::size_t count)
+		{
+			__m256 rows[4] = {};
+			for (std::size_t i = 0; i < count; i++)
+			{
+				if (i == 0 || bStride != 0)
+				{
+					const float *bm = &b[i * bStride].m[0][0];
+					for (int r = 0; r < 4; r++)
+					{
+						rows[r] = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(bm + r * 4));
+					}
+				}
+
+				// Float4x4 is only 16 byte aligned.
+				const float *am = &a[i].m[0][0];
+				const __m256 a01 = _mm256_loadu_ps(am + 0);
+				const __m256 a23 = _mm256_loadu_ps(am + 8);
+
+				float *o = &out[i].m[0][0];
+				_mm256_storeu_ps(o + 0, MultiplyRows(a01, rows));
+				_mm256_storeu_ps(o + 8, MultiplyRows(a23, rows));
+			}
+		}
+
+		__m256 LoadHalves(const float *low, const float *high)
+		{
+			return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+		}
+
+		void StoreHalves(float *low, float *high, __m256 v)
+		{
+			_mm_storeu_ps(low, _mm256_castps256_ps128(v));
+			_mm_storeu_ps(high, _mm256_extractf128_ps(v, 1));
+		}
+
+		void Avx2TransformPoints(const Float3 *points, const Float4x4 &m, Float3 *out, std::size_t count)
+		{
+			const __m256 m00 = _mm256_set1_ps(m.m[0][0]), m01 = _mm256_set1_ps(m.m[0][1]), m02 = _mm256_set1_ps(m.m[0][2]);
+			const __m256 m10 = _mm256_set1_ps(m.m[1][0]), m11 = _mm256_set1_ps(m.m[1][1]), m12 = _mm256_set1_ps(m.m[1][2]);
+			const __m256 m20 = _mm256_set1_ps(m.m[2][0]), m21 = _mm256_set1_ps(m.m[2][1]), m22 = _mm256_set1_ps(m.m[2][2]);
+			const __m256 m30 = _mm256_set1_ps(m.m[3][0]), m31 = _mm256_set1_ps(m.m[3][1]), m32 = _mm256_set1_ps(m.m[3][2]);
+
+			std::size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				// Points 0-3 go in the low halves and 4-7 in the high halves,
+				// so each half of a, b and c holds four packed points:
+				// x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3. The in-lane shuffles
+				// below turn them into x, y and z registers for all eight.
+				const float *p = &points[i].x;
+				const __m256 a = LoadHalves(p + 0, p + 12);
+				const __m256 b = LoadHalves(p + 4, p + 16);
+				const __m256 c = LoadHalves(p + 8, p + 20);
+
+				const __m256 xy = _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+				const __m256 yz = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+				const __m256 x = _mm256_shuffle_ps(a, xy, _MM_SHUFFLE(2, 0, 3, 0));
+				const __m256 y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+				const __m256 z = _mm256_shuffle_ps(yz, c, _MM_SHUFFLE(3, 0, 3, 1));
+
+				const __m256 rx = _mm256_fmadd_ps(x, m00, _mm256_fmadd_ps(y, m10, _mm256_fmadd_ps(z, m20, m30)));
+				const __m256 ry = _mm256_fmadd_ps(x, m01, _mm256_fmadd_ps(y, m11, _mm256_fmadd_ps(z, m21, m31)));
+				const __m256 rz = _mm256_fmadd_ps(x, m02, _mm256_fmadd_ps(y, m12, _mm256_fmadd_ps(z, m22, m32)));
+
+				const __m256 xy0 = _mm256_unpacklo_ps(rx, ry);
+				const __m256 xy1 = _mm256_unpackhi_ps(rx, ry);
+				const __m256 z0x1 = _mm256_shuffle_ps(rz, xy0, _MM_SHUFFLE(2, 2, 0, 0));
+				const __m256 y1z1 = _mm256_shuffle_ps(xy0, rz, _MM_SHUFFLE(1, 1, 3, 3));
+				const __m256 z2x3 = _mm256_shuffle_ps(rz, xy1, _MM_SHUFFLE(2, 2, 2, 2));
+				const __m256 y3z3 = _mm256_shuffle_ps(xy1, rz, _MM_SHUFFLE(3, 3, 3, 3));
+
+				float *o = &out[i].x;
+				StoreHalves(o + 0, o + 12, _mm256_shuffle_ps(xy0, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+				StoreHalves(o + 4, o + 16, _mm256_shuffle_ps(y1z1, xy1, _MM_SHUFFLE(1, 0, 2, 0)));
+				StoreHalves(o + 8, o + 20, _mm256_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+			}
+
+			detail::ScalarKernels()->transformPoints(points + i, m, out + i, count - i);
+		}
+
+		void Avx2RotationQuaternions(const Quaternion *rotations, Float4x4 *out, std::size_t count)
+		{
+			const __m256 one = _mm256_set1_ps(1.0f);
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 lastRow = _mm256_set_ps(1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f);
+
+			std::size_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				// Eight quaternions, one per lane. Pair quaternion k with k + 4
+				// in one register so that transposing each half gives x, y, z, w
+				// for all eight.
+				const float *q = &rotations[i].x;
+				const __m256 q01 = _mm256_loadu_ps(q + 0);
+				const __m256 q23 = _mm256_loadu_ps(q + 8);
+				const __m256 q45 = _mm256_loadu_ps(q + 16);
+				const __m256 q67 = _mm256_loadu_ps(q + 24);
+
+				__m256 x = _mm256_permute2f128_ps(q01, q45, 0x20); // q0 | q4
+				__m256 y = _mm256_permute2f128_ps(q01, q45, 0x31); // q1 | q5
+				__m256 z = _mm256_permute2f128_ps(q23, q67, 0x20); // q2 | q6
+				__m256 w = _mm256_permute2f128_ps(q23, q67, 0x31); // q3 | q7
+				Transpose4InLanes(x, y, z, w);
+
+				const __m256 x2 = _mm256_add_ps(x, x);
+				const __m256 y2 = _mm256_add_ps(y, y);
+				const __m256 z2 = _mm256_add_ps(z, z);
+				const __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+				const __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+				const __m256 xw = _mm256_mul_ps(w, x2), yw = _mm256_mul_ps(w, y2), zw = _mm256_mul_ps(w, z2);
+
+				__m256 r0[4] = { _mm256_sub_ps(one, _mm256_add_ps(yy, zz)), _mm256_add_ps(xy, zw), _mm256_sub_ps(xz, yw), zero };
+				__m256 r1[4] = { _mm256_sub_ps(xy, zw), _mm256_sub_ps(one, _mm256_add_ps(xx, zz)), _mm256_add_ps(yz, xw), zero };
+				__m256 r2[4] = { _mm256_add_ps(xz, yw), _mm256_sub_ps(yz, xw), _mm256_sub_ps(one, _mm256_add_ps(xx, yy)), zero };
+
+				// After this, rN[k] holds row N of matrix k in the low half and of
+				// matrix k + 4 in the high half.
+				Transpose4InLanes(r0[0], r0[1], r0[2], r0[3]);
+				Transpose4InLanes(r1[0], r1[1], r1[2], r1[3]);
+				Transpose4InLanes(r2[0], r2[1], r2[2], r2[3]);
+
+				for (int k = 0; k < 4; k++)
+				{
+					float *low = &out[i + k].m[0][0];
+					float *high = &out[i + k + 4].m[0][0];
+					_mm256_storeu_ps(low + 0, _mm256_permute2f128_ps(r0[k], r1[k], 0x20));
+					_mm256_storeu_ps(low + 8, _mm256_permute2f128_ps(r2[k], lastRow, 0x20));
+					_mm256_storeu_ps(high + 0, _mm256_permute2f128_ps(r0[k], r1[k], 0x31));
+					_mm256_storeu_ps(high + 8, _mm256_permute2f128_ps(r2[k], lastRow, 0x31));
+				}
+			}
+
+			detail::ScalarKernels()->rotationQuaternions(rotations + i, out + i, count - i);
+		}
+
+		const MathKernels kernels = {
+			Avx2MultiplyMatrices,
+			Avx2TransformPoints,
+			Avx2RotationQuaternions,
+		};
+	}
+
+	namespace detail
+	{
+		const MathKernels *Avx2Kernels()
+		{
+			return &kernels;
+		}
+	}
+}
+
+#else
+
+namespace bkmz::math::detail
+{
+	const MathKernels *Avx2Kernels()
+	{
+		return nullptr;
+	}
+}
+
+#endif
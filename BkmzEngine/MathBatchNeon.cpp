@@ -0,0 +1,163 @@
+#include "MathBatch.h"
+
+// NEON is part of the AArch64 baseline, so this needs no runtime check and
+// no special compiler flags. 32-bit ARM uses the scalar kernels.
+
+#if (defined(__aarch64__) || defined(_M_ARM64)) && !defined(BKMZ_MATH_SCALAR_ONLY)
+#include <arm_neon.h>
+
+namespace bkmz::math
+{
+	namespace
+	{
+		void Transpose4(float32x4_t &r0, float32x4_t &r1, float32x4_t &r2, float32x4_t &r3)
+		{
+			const float32x4x2_t t01 = vtrnq_f32(r0, r1); // a0 b0 a2 b2 | a1 b1 a3 b3
+			const float32x4x2_t t23 = vtrnq_f32(r2, r3);
+			r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+			r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+			r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+			r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+		}
+
+		float32x4_t MultiplyRow(float32x4_t row, const float32x4_t b[4])
+		{
+			float32x4_t result = vmulq_laneq_f32(b[0], row, 0);
+			result = vfmaq_laneq_f32(result, b[1], row, 1);
+			result = vfmaq_laneq_f32(result, b[2], row, 2);
+			result = vfmaq_laneq_f32(result, b[3], row, 3);
+			return result;
+		}
+
+		void NeonMultiplyMatrices(const Float4x4 *a, const Float4x4 *b, std::size_t bStride, Float4x4 *out, std::size_t count)
+		{
+			float32x4_t rows[4] = {};
+			for (std::size_t i = 0; i < count; i++)
+			{
+				if (i == 0 || bStride != 0)
+				{
+					const float *bm = &b[i * bStride].m[0][0];
+					for (int r = 0; r < 4; r++)
+					{
+						rows[r] = vld1q_f32(bm + r * 4);
+					}
+				}
+
+				const float *am = &a[i].m[0][0];
+				const float32x4_t a0 = vld1q_f32(am + 0);
+				const float32x4_t a1 = vld1q_f32(am + 4);
+				const float32x4_t a2 = vld1q_f32(am + 8);
+				const float32x4_t a3 = vld1q_f32(am + 12);
+
+				float *o = &out[i].m[0][0];
+				vst1q_f32(o + 0, MultiplyRow(a0, rows));
+				vst1q_f32(o + 4, MultiplyRow(a1, rows));
+				vst1q_f32(o + 8, MultiplyRow(a2, rows));
+				vst1q_f32(o + 12, MultiplyRow(a3, rows));
+			}
+		}
+
+		// Component C of four transformed points, p holding x, y and z of each.
+		template <int C>
+		float32x4_t TransformComponent(const float32x4x3_t &p, const float32x4_t rows[4])
+		{
+			float32x4_t result = vdupq_laneq_f32(rows[3], C);
+			result = vfmaq_laneq_f32(result, p.val[0], rows[0], C);
+			result = vfmaq_laneq_f32(result, p.val[1], rows[1], C);
+			result = vfmaq_laneq_f32(result, p.val[2], rows[2], C);
+			return result;
+		}
+
+		void NeonTransformPoints(const Float3 *points, const Float4x4 &m, Float3 *out, std::size_t count)
+		{
+			const float32x4_t rows[4] = { vld1q_f32(m.m[0]), vld1q_f32(m.m[1]), vld1q_f32(m.m[2]), vld1q_f32(m.m[3]) };
+
+			std::size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				// vld3 deinterleaves the x y z triples for us.
+				const float32x4x3_t p = vld3q_f32(&points[i].x);
+
+				float32x4x3_t result;
+				result.val[0] = TransformComponent<0>(p, rows);
+				result.val[1] = TransformComponent<1>(p, rows);
+				result.val[2] = TransformComponent<2>(p, rows);
+				vst3q_f32(&out[i].x, result);
+			}
+
+			for (; i < count; i++)
+			{
+				out[i] = TransformPoint(points[i], m);
+			}
+		}
+
+		void NeonRotationQuaternions(const Quaternion *rotations, Float4x4 *out, std::size_t count)
+		{
+			const float32x4_t one = vdupq_n_f32(1.0f);
+			const float32x4_t zero = vdupq_n_f32(0.0f);
+			const float lastRowValues[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			const float32x4_t lastRow = vld1q_f32(lastRowValues);
+
+			std::size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				const float32x4x4_t q = vld4q_f32(&rotations[i].x);
+				const float32x4_t x = q.val[0], y = q.val[1], z = q.val[2], w = q.val[3];
+
+				const float32x4_t x2 = vaddq_f32(x, x);
+				const float32x4_t y2 = vaddq_f32(y, y);
+				const float32x4_t z2 = vaddq_f32(z, z);
+				const float32x4_t xx = vmulq_f32(x, x2), yy = vmulq_f32(y, y2), zz = vmulq_f32(z, z2);
+				const float32x4_t xy = vmulq_f32(x, y2), xz = vmulq_f32(x, z2), yz = vmulq_f32(y, z2);
+				const float32x4_t xw = vmulq_f32(w, x2), yw = vmulq_f32(w, y2), zw = vmulq_f32(w, z2);
+
+				float32x4_t r0[4] = { vsubq_f32(one, vaddq_f32(yy, zz)), vaddq_f32(xy, zw), vsubq_f32(xz, yw), zero };
+				float32x4_t r1[4] = { vsubq_f32(xy, zw), vsubq_f32(one, vaddq_f32(xx, zz)), vaddq_f32(yz, xw), zero };
+				float32x4_t r2[4] = { vaddq_f32(xz, yw), vsubq_f32(yz, xw), vsubq_f32(one, vaddq_f32(xx, yy)), zero };
+				Transpose4(r0[0], r0[1], r0[2], r0[3]);
+				Transpose4(r1[0], r1[1], r1[2], r1[3]);
+				Transpose4(r2[0], r2[1], r2[2], r2[3]);
+
+				for (int k = 0; k < 4; k++)
+				{
+					float *o = &out[i + k].m[0][0];
+					vst1q_f32(o + 0, r0[k]);
+					vst1q_f32(o + 4, r1[k]);
+					vst1q_f32(o + 8, r2[k]);
+					vst1q_f32(o + 12, lastRow);
+				}
+			}
+
+			for (; i < count; i++)
+			{
+				out[i] = RotationQuaternion(rotations[i]);
+			}
+		}
+
+		const MathKernels kernels = {
+			NeonMultiplyMatrices,
+			NeonTransformPoints,
+			NeonRotationQuaternions,
+		};
+	}
+
+	namespace detail
+	{
+		const MathKernels *NeonKernels()
+		{
+			return &kernels;
+		}
+	}
+}
+
+#else
+
+namespace bkmz::math::detail
+{
+	const MathKernels *NeonKernels()
+	{
+		return nullptr;
+	}
+}
+
+#endif
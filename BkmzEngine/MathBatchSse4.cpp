@@ -0,0 +1,137 @@
+#include "MathBatch.h"
+
+// Built with -msse4.1 on GCC and Clang. Only called after the dispatcher
+// has checked the CPU, so nothing here may run at static init time, and
+// leftovers go to the scalar kernels for the reason given in
+// MathBatchAvx2.cpp.
+
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(BKMZ_MATH_SCALAR_ONLY)
+#include <smmintrin.h>
+
+namespace bkmz::math
+{
+	namespace
+	{
+		template <int I>
+		__m128 Splat(__m128 v)
+		{
+			return _mm_shuffle_ps(v, v, _MM_SHUFFLE(I, I, I, I));
+		}
+
+		__m128 MultiplyRow(__m128 row, const __m128 b[4])
+		{
+			__m128 result = _mm_mul_ps(Splat<0>(row), b[0]);
+			result = _mm_add_ps(result, _mm_mul_ps(Splat<1>(row), b[1]));
+			result = _mm_add_ps(result, _mm_mul_ps(Splat<2>(row), b[2]));
+			result = _mm_add_ps(result, _mm_mul_ps(Splat<3>(row), b[3]));
+			return result;
+		}
+
+		void Sse4MultiplyMatrices(const Float4x4 *a, const Float4x4 *b, std::size_t bStride, Float4x4 *out, std::size_t count)
+		{
+			__m128 rows[4] = {};
+			for (std::size_t i = 0; i < count; i++)
+			{
+				if (i == 0 || bStride != 0)
+				{
+					const float *bm = &b[i * bStride].m[0][0];
+					for (int r = 0; r < 4; r++)
+					{
+						rows[r] = _mm_load_ps(bm + r * 4);
+					}
+				}
+
+				const float *am = &a[i].m[0][0];
+				const __m128 a0 = _mm_load_ps(am + 0);
+				const __m128 a1 = _mm_load_ps(am + 4);
+				const __m128 a2 = _mm_load_ps(am + 8);
+				const __m128 a3 = _mm_load_ps(am + 12);
+
+				float *o = &out[i].m[0][0];
+				_mm_store_ps(o + 0, MultiplyRow(a0, rows));
+				_mm_store_ps(o + 4, MultiplyRow(a1, rows));
+				_mm_store_ps(o + 8, MultiplyRow(a2, rows));
+				_mm_store_ps(o + 12, MultiplyRow(a3, rows));
+			}
+		}
+
+		// Deinterleaving packed x y z triples into lanes and back takes more
+		// shuffles than SSE saves on the arithmetic, and the scalar loop is
+		// vectorized by the compiler anyway: this measured 1.37 ns a point
+		// against the scalar kernel's 1.14. So the scalar kernel it is.
+		void Sse4TransformPoints(const Float3 *points, const Float4x4 &m, Float3 *out, std::size_t count)
+		{
+			detail::ScalarKernels()->transformPoints(points, m, out, count);
+		}
+
+		void Sse4RotationQuaternions(const Quaternion *rotations, Float4x4 *out, std::size_t count)
+		{
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 lastRow = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+			std::size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				// Four quaternions at a time, one per lane.
+				const float *q = &rotations[i].x;
+				__m128 x = _mm_loadu_ps(q + 0);
+				__m128 y = _mm_loadu_ps(q + 4);
+				__m128 z = _mm_loadu_ps(q + 8);
+				__m128 w = _mm_loadu_ps(q + 12);
+				_MM_TRANSPOSE4_PS(x, y, z, w);
+
+				const __m128 x2 = _mm_add_ps(x, x);
+				const __m128 y2 = _mm_add_ps(y, y);
+				const __m128 z2 = _mm_add_ps(z, z);
+				const __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+				const __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+				const __m128 xw = _mm_mul_ps(w, x2), yw = _mm_mul_ps(w, y2), zw = _mm_mul_ps(w, z2);
+
+				__m128 r0[4] = { _mm_sub_ps(one, _mm_add_ps(yy, zz)), _mm_add_ps(xy, zw), _mm_sub_ps(xz, yw), zero };
+				__m128 r1[4] = { _mm_sub_ps(xy, zw), _mm_sub_ps(one, _mm_add_ps(xx, zz)), _mm_add_ps(yz, xw), zero };
+				__m128 r2[4] = { _mm_add_ps(xz, yw), _mm_sub_ps(yz, xw), _mm_sub_ps(one, _mm_add_ps(xx, yy)), zero };
+				_MM_TRANSPOSE4_PS(r0[0], r0[1], r0[2], r0[3]);
+				_MM_TRANSPOSE4_PS(r1[0], r1[1], r1[2], r1[3]);
+				_MM_TRANSPOSE4_PS(r2[0], r2[1], r2[2], r2[3]);
+
+				for (int k = 0; k < 4; k++)
+				{
+					float *o = &out[i + k].m[0][0];
+					_mm_store_ps(o + 0, r0[k]);
+					_mm_store_ps(o + 4, r1[k]);
+					_mm_store_ps(o + 8, r2[k]);
+					_mm_store_ps(o + 12, lastRow);
+				}
+			}
+
+			detail::ScalarKernels()->rotationQuaternions(rotations + i, out + i, count - i);
+		}
+
+		const MathKernels kernels = {
+			Sse4MultiplyMatrices,
+			Sse4TransformPoints,
+			Sse4RotationQuaternions,
+		};
+	}
+
+	namespace detail
+	{
+		const MathKernels *Sse4Kernels()
+		{
+			return &kernels;
+		}
+	}
+}
+
+#else
+
+namespace bkmz::math::detail
+{
+	const MathKernels *Sse4Kernels()
+	{
+		return nullptr;
+	}
+}
+
+#endif
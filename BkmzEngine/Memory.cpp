@@ -0,0 +1,272 @@
+#include "Memory.h"
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <malloc.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+	struct AtomicCounters
+	{
+		std::atomic<std::uint64_t> allocations{ 0 };
+		std::atomic<std::uint64_t> bytes{ 0 };
+
+		MemoryCounters Exchange()
+		{
+			MemoryCounters counters;
+			counters.allocations = allocations.exchange(0, std::memory_order_relaxed);
+			counters.bytes = bytes.exchange(0, std::memory_order_relaxed);
+			return counters;
+		}
+
+		void Add(std::size_t size)
+		{
+			allocations.fetch_add(1, std::memory_order_relaxed);
+			bytes.fetch_add(size, std::memory_order_relaxed);
+		}
+	};
+
+	AtomicCounters tagCounters[memoryTagCount];
+	AtomicCounters heapCounters;
+
+	thread_local MemoryTag currentTag = MemoryTag::General;
+	thread_local std::uint64_t threadHeapAllocations = 0;
+}
+
+const char *MemoryTagName(MemoryTag tag)
+{
+	switch (tag)
+	{
+	case MemoryTag::General:
+		return "general";
+	case MemoryTag::Frame:
+		return "frame";
+	case MemoryTag::Pool:
+		return "pool";
+	case MemoryTag::Ecs:
+		return "ecs";
+	case MemoryTag::Mesh:
+		return "mesh";
+	case MemoryTag::Stats:
+		return "stats";
+	default:
+		return "unknown";
+	}
+}
+
+void MemoryTracker::Record(MemoryTag tag, std::size_t bytes, bool heap)
+{
+	tagCounters[(std::size_t)tag].Add(bytes);
+	if (heap)
+	{
+		heapCounters.Add(bytes);
+		threadHeapAllocations++;
+	}
+}
+
+MemoryFrameStats MemoryTracker::EndFrame()
+{
+	MemoryFrameStats stats;
+	for (std::size_t i = 0; i < memoryTagCount; i++)
+	{
+		stats.tags[i] = tagCounters[i].Exchange();
+	}
+	stats.heap = heapCounters.Exchange();
+	return stats;
+}
+
+std::uint64_t MemoryTracker::ThreadHeapAllocations()
+{
+	return threadHeapAllocations;
+}
+
+std::uint64_t MemoryTracker::PeakResidentBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	rusage usage = {};
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+		return (std::uint64_t)usage.ru_maxrss * 1024; // in KiB on Linux
+	}
+	return 0;
+#endif
+}
+
+MemoryTag MemoryTracker::CurrentTag()
+{
+	return currentTag;
+}
+
+void MemoryTracker::SetCurrentTag(MemoryTag tag)
+{
+	currentTag = tag;
+}
+
+FrameArena::FrameArena(std::size_t capacity, MemoryTag tag)
+	: tag(tag), capacity(capacity)
+{
+	MemoryTagScope scope(tag);
+	memory = std::make_unique<std::byte[]>(capacity);
+}
+
+std::byte *FrameArena::BumpFrom(std::byte *base, std::size_t blockSize, std::size_t &offset, std::size_t size, std::size_t alignment)
+{
+	const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(base) + offset;
+	const std::uintptr_t aligned = (address + alignment - 1) & ~(std::uintptr_t)(alignment - 1);
+	const std::size_t end = (aligned - reinterpret_cast<std::uintptr_t>(base)) + size;
+	if (end > blockSize)
+	{
+		return nullptr;
+	}
+
+	offset = end;
+	return reinterpret_cast<std::byte *>(aligned);
+}
+
+void *FrameArena::Allocate(std::size_t size, std::size_t alignment)
+{
+	MemoryTracker::Record(tag, size, false);
+
+	if (overflow.empty())
+	{
+		if (std::byte *result = BumpFrom(memory.get(), capacity, used, size, alignment))
+		{
+			highWater = used > highWater ? used : highWater;
+			return result;
+		}
+	}
+	else if (std::byte *result = BumpFrom(overflow.back().memory.get(), overflow.back().size, overflowOffset, size, alignment))
+	{
+		overflowUsed += size;
+		return result;
+	}
+
+	// Out of space: chain another block for the rest of this frame.
+	const std::size_t blockSize = (size + alignment > capacity) ? size + alignment : capacity;
+	{
+		MemoryTagScope scope(tag);
+		overflow.push_back({ std::make_unique<std::byte[]>(blockSize), blockSize });
+	}
+	overflowOffset = 0;
+	overflowUsed += size;
+	return BumpFrom(overflow.back().memory.get(), blockSize, overflowOffset, size, alignment);
+}
+
+void FrameArena::Reset()
+{
+	if (!overflow.empty())
+	{
+		// This frame didn't fit, grow so the next one will.
+		highWater = used + overflowUsed;
+		capacity = highWater + highWater / 4;
+		overflow.clear();
+
+		MemoryTagScope scope(tag);
+		memory = std::make_unique<std::byte[]>(capacity);
+	}
+
+	used = 0;
+	overflowOffset = 0;
+	overflowUsed = 0;
+}
+
+#if defined(BKMZ_TRACK_ALLOCATIONS)
+
+namespace
+{
+	void *AlignedAllocate(std::size_t size, std::size_t alignment)
+	{
+		size = size ? size : 1;
+#if defined(_WIN32)
+		return _aligned_malloc(size, alignment);
+#else
+		void *memory = nullptr;
+		return posix_memalign(&memory, (std::max)(alignment, sizeof(void *)), size) == 0 ? memory : nullptr;
+#endif
+	}
+
+	void AlignedFree(void *memory)
+	{
+#if defined(_WIN32)
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+}
+
+// Replacing the global allocation functions is the only way to see every
+// heap allocation, including the ones the standard library makes. The
+// array and nothrow forms forward to these by default. Types aligned past
+// the default, like ECS chunks, and AlignedBuffer use the align_val_t
+// forms instead, replaced here along with their array forms.
+
+void *operator new(std::size_t size)
+{
+	MemoryTracker::Record(currentTag, size, true);
+	if (void *memory = std::malloc(size ? size : 1))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+	MemoryTracker::Record(currentTag, size, true);
+	if (void *memory = AlignedAllocate(size, (std::size_t)alignment))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+	AlignedFree(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept
+{
+	AlignedFree(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t) noexcept
+{
+	AlignedFree(memory);
+}
+
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept
+{
+	AlignedFree(memory);
+}
+
+#endif
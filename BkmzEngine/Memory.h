@@ -0,0 +1,328 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Engine memory: allocation tracking, per-frame linear arenas, fixed-size
+// object pools and STL allocator adapters for them.
+//
+// Building with BKMZ_TRACK_ALLOCATIONS replaces the global operator new so
+// every general heap allocation is counted against the tag of the
+// innermost MemoryTagScope on the allocating thread. Arenas and pools
+// always report their own allocations under their tag.
+
+enum class MemoryTag : std::uint8_t
+{
+	General,
+	Frame,
+	Pool,
+	Ecs,
+	Mesh,
+	Stats,
+	Count
+};
+
+constexpr std::size_t memoryTagCount = (std::size_t)MemoryTag::Count;
+
+const char *MemoryTagName(MemoryTag tag);
+
+struct MemoryCounters
+{
+	std::uint64_t allocations = 0;
+	std::uint64_t bytes = 0;
+};
+
+using MemoryTagCounters = std::array<MemoryCounters, memoryTagCount>;
+
+struct MemoryFrameStats
+{
+	MemoryTagCounters tags;
+	MemoryCounters heap; // general heap (operator new) only, all tags
+};
+
+class MemoryTracker
+{
+public:
+#if defined(BKMZ_TRACK_ALLOCATIONS)
+	static constexpr bool enabled = true;
+#else
+	static constexpr bool enabled = false;
+#endif
+
+	static void Record(MemoryTag tag, std::size_t bytes, bool heap);
+
+	// Returns the counters accumulated since the previous call, from all
+	// threads, and starts counting the next frame.
+	static MemoryFrameStats EndFrame();
+
+	// Heap allocations made by the calling thread since it started.
+	static std::uint64_t ThreadHeapAllocations();
+
+	// Most memory the process has had resident at once, as the OS reports
+	// it, tracked or not. 0 if the OS can't tell.
+	static std::uint64_t PeakResidentBytes();
+
+	static MemoryTag CurrentTag();
+
+private:
+	friend class MemoryTagScope;
+	static void SetCurrentTag(MemoryTag tag);
+};
+
+// Attributes general heap allocations on this thread to `tag` while alive.
+class MemoryTagScope
+{
+public:
+	explicit MemoryTagScope(MemoryTag tag) : previous(MemoryTracker::CurrentTag())
+	{
+		MemoryTracker::SetCurrentTag(tag);
+	}
+
+	~MemoryTagScope()
+	{
+		MemoryTracker::SetCurrentTag(previous);
+	}
+
+	MemoryTagScope(const MemoryTagScope &) = delete;
+	MemoryTagScope &operator=(const MemoryTagScope &) = delete;
+
+private:
+	MemoryTag previous;
+};
+
+// Counts the calling thread's general heap allocations while the guard is
+// alive. Check Allocations() before it goes: the destructor's assert is
+// only there to stop a debugger on the spot, and release builds drop it.
+// Counts nothing unless allocation tracking is compiled in.
+class HeapAllocationGuard
+{
+public:
+	HeapAllocationGuard() : start(MemoryTracker::ThreadHeapAllocations()) {}
+
+	~HeapAllocationGuard()
+	{
+		assert(Allocations() == 0 && "Heap allocation in a no-allocation scope");
+	}
+
+	std::uint64_t Allocations() const
+	{
+		return MemoryTracker::ThreadHeapAllocations() - start;
+	}
+
+private:
+	std::uint64_t start;
+};
+
+// Bump allocator for data that lives until the end of the frame. Reset()
+// releases everything at once. If a frame needs more than the capacity the
+// arena chains extra blocks, and on the next Reset() it grows to the high
+// water mark so steady-state frames never go to the heap.
+//
+// Destructors are not run, so only trivially destructible types belong here.
+class FrameArena
+{
+public:
+	explicit FrameArena(std::size_t capacity = 1 << 20, MemoryTag tag = MemoryTag::Frame);
+
+	FrameArena(const FrameArena &) = delete;
+	FrameArena &operator=(const FrameArena &) = delete;
+
+	void *Allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+	template <typename T, typename... Args>
+	T *New(Args &&...args)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "FrameArena never runs destructors.");
+		return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	template <typename T>
+	T *NewArray(std::size_t count)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "FrameArena never runs destructors.");
+		T *items = static_cast<T *>(Allocate(sizeof(T) * count, alignof(T)));
+		for (std::size_t i = 0; i < count; i++)
+		{
+			new (items + i) T();
+		}
+		return items;
+	}
+
+	void Reset();
+
+	std::size_t Used() const { return used + overflowUsed; }
+	std::size_t Capacity() const { return capacity; }
+	std::size_t HighWater() const { return highWater; }
+
+private:
+	struct Block
+	{
+		std::unique_ptr<std::byte[]> memory;
+		std::size_t size;
+	};
+
+	std::byte *BumpFrom(std::byte *base, std::size_t blockSize, std::size_t &offset, std::size_t size, std::size_t alignment);
+
+private:
+	MemoryTag tag;
+	std::unique_ptr<std::byte[]> memory;
+	std::size_t capacity;
+	std::size_t used = 0;
+
+	std::vector<Block> overflow;
+	std::size_t overflowOffset = 0;
+	std::size_t overflowUsed = 0;
+	std::size_t highWater = 0;
+};
+
+// Fixed-size allocator for one type. Objects live in blocks of BlockSize
+// slots, freed slots go on an intrusive free list, so Create/Destroy are
+// O(1) and never touch the heap once the pool has grown. All objects must
+// be destroyed before the pool.
+template <typename T, std::size_t BlockSize = 256>
+class ObjectPool
+{
+public:
+	explicit ObjectPool(MemoryTag tag = MemoryTag::Pool) : tag(tag) {}
+
+	ObjectPool(const ObjectPool &) = delete;
+	ObjectPool &operator=(const ObjectPool &) = delete;
+
+	~ObjectPool()
+	{
+		assert(live == 0 && "ObjectPool destroyed with live objects");
+	}
+
+	template <typename... Args>
+	T *Create(Args &&...args)
+	{
+		if (freeList == nullptr)
+		{
+			Grow();
+		}
+
+		Slot *slot = freeList;
+		freeList = slot->next;
+		live++;
+
+		MemoryTracker::Record(tag, sizeof(T), false);
+		return new (slot->storage) T(std::forward<Args>(args)...);
+	}
+
+	void Destroy(T *object)
+	{
+		if (object == nullptr)
+		{
+			return;
+		}
+
+		object->~T();
+		Slot *slot = reinterpret_cast<Slot *>(object);
+		slot->next = freeList;
+		freeList = slot;
+		live--;
+	}
+
+	std::size_t Size() const { return live; }
+	std::size_t Capacity() const { return blocks.size() * BlockSize; }
+
+private:
+	union Slot
+	{
+		Slot *next;
+		alignas(T) std::byte storage[sizeof(T)];
+	};
+
+	void Grow()
+	{
+		MemoryTagScope scope(tag);
+		blocks.push_back(std::make_unique<Slot[]>(BlockSize));
+
+		Slot *block = blocks.back().get();
+		for (std::size_t i = 0; i < BlockSize; i++)
+		{
+			block[i].next = i + 1 < BlockSize ? &block[i + 1] : freeList;
+		}
+		freeList = block;
+	}
+
+private:
+	MemoryTag tag;
+	std::vector<std::unique_ptr<Slot[]>> blocks;
+	Slot *freeList = nullptr;
+	std::size_t live = 0;
+};
+
+// STL allocator that takes memory from a FrameArena. Deallocation is a
+// no-op, the memory comes back when the arena is reset, so containers using
+// it must not outlive the frame.
+template <typename T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+
+	explicit ArenaAllocator(FrameArena &arena) : arena(&arena) {}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+	T *allocate(std::size_t count)
+	{
+		return static_cast<T *>(arena->Allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	void deallocate(T *, std::size_t) {}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+
+private:
+	template <typename U>
+	friend class ArenaAllocator;
+
+	FrameArena *arena;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+// STL allocator for the general heap that attributes its allocations to Tag.
+template <typename T, MemoryTag Tag>
+class TaggedAllocator
+{
+public:
+	using value_type = T;
+
+	template <typename U>
+	struct rebind
+	{
+		using other = TaggedAllocator<U, Tag>;
+	};
+
+	TaggedAllocator() = default;
+
+	template <typename U>
+	TaggedAllocator(const TaggedAllocator<U, Tag> &) {}
+
+	T *allocate(std::size_t count)
+	{
+		MemoryTagScope scope(Tag);
+		return std::allocator<T>().allocate(count);
+	}
+
+	void deallocate(T *items, std::size_t count)
+	{
+		std::allocator<T>().deallocate(items, count);
+	}
+
+	template <typename U>
+	bool operator==(const TaggedAllocator<U, Tag> &) const { return true; }
+};
@@ -1,10 +1,21 @@
 #pragma once
 #include <d3d12.h>
-#include <DirectXMath.h>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
+#include "DeferredRelease.h"
+#include "DrawList.h"
+#include "UploadQueue.h"
+#include "Memory.h"
 #include "Utils.h"
+#include "VertexLayout.h"
 
-template <typename Vertex>
+// Vertex is what the GPU reads, Stored what mesh data holds. When they
+// differ SetData converts with ConvertVertices, so assets can keep full
+// precision while the vertex buffer uses a tighter layout.
+template <typename Vertex, typename Stored = Vertex>
 class Mesh
 {
 public:
@@ -18,49 +29,138 @@ public:
 	D3D12_INDEX_BUFFER_VIEW ibv;
 
 	ComPtr<ID3D12Resource> vertexBufferGPU = nullptr;
-	ComPtr<ID3D12Resource> vertexBufferUploader = nullptr;
-
 	ComPtr<ID3D12Resource> indexBufferGPU = nullptr;
-	ComPtr<ID3D12Resource> indexBufferUploader = nullptr;
 
 	UINT64 vbByteSize;
 	UINT64 ibByteSize;
 
+	// The copy that fills the buffers, see UploadQueue.
+	std::uint64_t uploadValue = 0;
+
 	//int cbufferIndex = 0;
 
 public:
 
-	void SetVertices(std::vector<Vertex> input)
+	void SetVertices(std::span<const Vertex> input)
 	{
-		vertices = input;
+		MemoryTagScope scope(MemoryTag::Mesh);
+		vertices.assign(input.begin(), input.end());
 		vbByteSize = vertices.size() * sizeof(Vertex);
 	}
 
-	void SetIndexes(std::vector<std::uint16_t> input)
+	void SetIndexes(std::span<const std::uint16_t> input)
 	{
-		indexes = input;
+		MemoryTagScope scope(MemoryTag::Mesh);
+		indexes.assign(input.begin(), input.end());
 		ibByteSize = indexes.size() * sizeof(std::uint16_t);
 	}
 
-	int GetIndexCount()
+	// Streamed mesh layout: vertex count and index count as uint32, then
+	// the vertices, then the indexes.
+	static std::vector<std::uint8_t> Pack(std::span<const Stored> vertices, std::span<const std::uint16_t> indexes)
+	{
+		const std::uint32_t counts[2] = { (std::uint32_t)vertices.size(), (std::uint32_t)indexes.size() };
+		std::vector<std::uint8_t> data(sizeof(counts) + vertices.size_bytes() + indexes.size_bytes());
+		std::memcpy(data.data(), counts, sizeof(counts));
+		std::memcpy(data.data() + sizeof(counts), vertices.data(), vertices.size_bytes());
+		std::memcpy(data.data() + sizeof(counts) + vertices.size_bytes(), indexes.data(), indexes.size_bytes());
+		return data;
+	}
+
+	// Reads what Pack wrote.
+	void SetData(std::span<const std::uint8_t> data)
+	{
+		std::uint32_t counts[2];
+		if (data.size() < sizeof(counts))
+		{
+			throw std::runtime_error("Mesh data is truncated.");
+		}
+		std::memcpy(counts, data.data(), sizeof(counts));
+
+		const std::size_t storedBytes = (std::size_t)counts[0] * sizeof(Stored);
+		const std::size_t indexBytes = (std::size_t)counts[1] * sizeof(std::uint16_t);
+		if (data.size() != sizeof(counts) + storedBytes + indexBytes)
+		{
+			throw std::runtime_error("Mesh data is truncated.");
+		}
+
+		// Copied out rather than reinterpreted, the data needn't be aligned.
+		MemoryTagScope scope(MemoryTag::Mesh);
+		vertices.resize(counts[0]);
+		indexes.resize(counts[1]);
+		const std::uint8_t *storedVertices = data.data() + sizeof(counts);
+		if constexpr (std::is_same_v<Vertex, Stored>)
+		{
+			std::memcpy(vertices.data(), storedVertices, storedBytes);
+		}
+		else
+		{
+			ConvertVertices<Vertex, Stored>(reinterpret_cast<const std::byte *>(storedVertices), counts[0], vertices.data());
+		}
+		std::memcpy(indexes.data(), storedVertices + storedBytes, indexBytes);
+		vbByteSize = vertices.size() * sizeof(Vertex);
+		ibByteSize = indexBytes;
+	}
+
+	// Streamed meshes sit empty in the pool until their data arrives.
+	bool Ready() const
+	{
+		return vertexBufferGPU != nullptr;
+	}
+
+	int GetIndexCount() const
 	{
 		return indexes.size();
 	}
 
-	void InitBuffers(ID3D12Device* device, ID3D12GraphicsCommandList* commandList)
+	// For indirect draws, valid once Ready.
+	GeometryView Geometry() const
+	{
+		return {
+			vbv.BufferLocation, vbv.SizeInBytes, vbv.StrideInBytes,
+			ibv.BufferLocation, ibv.SizeInBytes, (std::uint32_t)ibv.Format,
+			(std::uint32_t)GetIndexCount()
+		};
+	}
+
+	// Stages the vertices and indexes in one upload buffer and queues the
+	// copies on `uploads`. Whatever draws the mesh must wait for
+	// uploadValue first. The upload buffer is released when the copy is
+	// done.
+	void InitBuffers(ID3D12Device* device, UploadQueue &uploads)
 	{
-		vertexBufferGPU = Utils::CreateDefaultBuffer(device, commandList, vertices.data(), vbByteSize, vertexBufferUploader);
+		// Left in COMMON: the copy queue promotes them to COPY_DEST and the
+		// direct queue to vertex and index buffer reads.
+		vertexBufferGPU = Utils::CreateBuffer(device, D3D12_HEAP_TYPE_DEFAULT, vbByteSize, D3D12_RESOURCE_STATE_COMMON);
+		indexBufferGPU = Utils::CreateBuffer(device, D3D12_HEAP_TYPE_DEFAULT, ibByteSize, D3D12_RESOURCE_STATE_COMMON);
+		ComPtr<ID3D12Resource> uploader = Utils::CreateBuffer(device, D3D12_HEAP_TYPE_UPLOAD, vbByteSize + ibByteSize, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+		std::uint8_t *mapped = nullptr;
+		const D3D12_RANGE noRead = { 0, 0 };
+		DX_CALL(uploader->Map(0, &noRead, reinterpret_cast<void **>(&mapped)));
+		std::memcpy(mapped, vertices.data(), vbByteSize);
+		std::memcpy(mapped + vbByteSize, indexes.data(), ibByteSize);
+		uploader->Unmap(0, nullptr);
+
+		uploads.Copy({ vertexBufferGPU.Get(), 0, uploader.Get(), 0, vbByteSize });
+		uploadValue = uploads.Copy({ indexBufferGPU.Get(), 0, uploader.Get(), vbByteSize, ibByteSize });
+		uploads.Releases().PushRelease(uploader.Detach());
 
 		vbv.BufferLocation = vertexBufferGPU->GetGPUVirtualAddress();
 		vbv.StrideInBytes = sizeof(Vertex);
 		vbv.SizeInBytes = vbByteSize;
 
-
-		indexBufferGPU = Utils::CreateDefaultBuffer(device, commandList, indexes.data(), ibByteSize, indexBufferUploader);
-
 		ibv.BufferLocation = indexBufferGPU->GetGPUVirtualAddress();
 		ibv.Format = DXGI_FORMAT_R16_UINT;
 		ibv.SizeInBytes = ibByteSize;
 	}
 
+	// Before destroying a mesh that may have been drawn: its buffers are
+	// released once the GPU is done with them rather than right away.
+	void ReleaseBuffers(DeferredReleaseQueue &releases)
+	{
+		releases.PushRelease(vertexBufferGPU.Detach());
+		releases.PushRelease(indexBufferGPU.Detach());
+	}
+
 };
\ No newline at end of file
@@ -1,11 +1,37 @@
 #include "MyApp.h"
 #include "DXErrors.h"
 #include "d3dx12.h"
-#include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include "Clock.h"
 #include "Cube.h"
 
-namespace dx = DirectX;
+namespace math = bkmz::math;
+
+MyApp::~MyApp()
+{
+	SetPipelined(false);
+
+	// Loads in flight use this object, stop them before any of it goes.
+	streamer.Stop();
+
+	// The last frames may still be using these. ~dxApp waits for the GPU
+	// before deferredReleases goes, which is when they are released.
+	const std::vector<MeshHandle> meshHandles(meshes.Handles().begin(), meshes.Handles().end());
+	for (MeshHandle mesh : meshHandles)
+	{
+		DestroyMesh(mesh);
+	}
+	const std::vector<PipelineHandle> pipelineHandles(pipelines.Handles().begin(), pipelines.Handles().end());
+	for (PipelineHandle pipeline : pipelineHandles)
+	{
+		DestroyPipeline(pipelines, pipeline, deferredReleases);
+	}
+	indirectDrawBuffer.Release(deferredReleases);
+}
 
 void MyApp::Initialize()
 {
@@ -16,8 +42,14 @@ void MyApp::Initialize()
 	commandAlloc->Reset();
 	commandList->Reset(commandAlloc.Get(), nullptr);
 
+	// Objects count themselves against it before its PSO exists.
+	defaultMaterial = materials.Create();
 	CreateObjects();
+	CreateLights();
+	CreateParticles();
 	CreateMaterials();
+
+	PublishRenderState();
 	
 
 	commandList->Close();
@@ -29,105 +61,456 @@ void MyApp::Initialize()
 
 void MyApp::CreateMaterials()
 {
-	defaultMaterial.inputLayout = {
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
-		D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, offsetof(DefaultMaterial::Vertex, Color),
-		D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-	};
+	DefaultMaterial &material = *materials.Get(defaultMaterial);
+	material.inputLayout = InputLayout(DefaultMaterial::Vertex::Layout());
+
+	material.assets = &assets;
+	material.CreatePSO(device.Get(), backBufferFormat, depthStencilFormat, resources, pipelines, deferredReleases);
+
+	sceneBuffer.Create(device.Get(), material.objectCount);
+	objectDataIndex = resources.AddStructuredBuffer(sceneBuffer.Resource(), sceneBuffer.Capacity(), sizeof(DefaultMaterial::ObjectData));
+
+	lightBuffers.Create(device.Get(), resources, maxLights, lightClusters);
+
+	particleMaterial.assets = &assets;
+	particleMaterial.CreatePSO(device.Get(), backBufferFormat, depthStencilFormat, resources, pipelines, deferredReleases);
+	particleBuffer.Create(device.Get(), resources, particles->Capacity());
+}
+
+void MyApp::CreateLights()
+{
+	using namespace math;
+
+	if (stressScene)
+	{
+		lightStart = MakeStressLights(*stressScene);
+	}
+	else
+	{
+		// Two coloured point lights either side of the cube and a spot
+		// light above it.
+		lightStart = {
+			{ { -1.2f, 0.6f, -0.8f }, 4.0f, { 3.0f, 1.2f, 0.8f }, LightType::Point, { 0.0f, -1.0f, 0.0f }, -1.0f },
+			{ { 1.2f, -0.4f, -0.8f }, 4.0f, { 0.8f, 1.2f, 3.0f }, LightType::Point, { 0.0f, -1.0f, 0.0f }, -1.0f },
+			{ { 0.0f, 2.0f, 0.0f }, 5.0f, { 4.0f, 4.0f, 3.5f }, LightType::Spot, { 0.0f, -1.0f, 0.0f }, std::cos(0.5f) },
+		};
+	}
+	if (lightStart.size() > maxLights)
+	{
+		lightStart.resize(maxLights);
+	}
+	lights = lightStart;
+	lightTimeOrigin = Clock::Now();
+}
 
-	defaultMaterial.CreatePSO(device.Get(), backBufferFormat, depthStencilFormat, cbvSrvUavDescriptorSize);
+void MyApp::CreateParticles()
+{
+	if (stressScene)
+	{
+		// Room for the emitters' ups and downs.
+		particles.emplace(stressScene->particleCount + stressScene->particleCount / 2 + 1024);
+		particles->emitters = MakeStressEmitters(*stressScene);
+	}
+	else
+	{
+		// A small fountain below the cubes.
+		particles.emplace(1 << 14);
+		ParticleEmitter fountain;
+		fountain.position = { 0.0f, -1.0f, 3.0f };
+		fountain.rate = 2000.0f;
+		fountain.velocity = { 0.0f, 3.5f, 0.0f };
+		fountain.spread = 0.6f;
+		fountain.color = { 0.5f, 0.7f, 1.0f, 0.8f };
+		fountain.lifetime = 1.5f;
+		fountain.size = 0.02f;
+		particles->emitters.push_back(fountain);
+	}
+	lastParticleTime = Clock::Now();
 }
 
 void MyApp::CreateObjects()
 {
-	gameObjects.push_back({});
-	gameObjects.back().mesh = std::make_unique<Mesh<DefaultMaterial::Vertex>>(
-		Cube(device.Get(), commandList.Get(), &defaultMaterial)
-	);
+	if (stressScene)
+	{
+		const std::vector<std::uint8_t> bytes = CompileScene(MakeStressScene(*stressScene));
+		CreateObjects(SceneView(bytes));
+		return;
+	}
 
-	gameObjects.back().transform.position = { -1.0f, 0, 3.0f };
-	gameObjects.back().transform.rotation = { -(DirectX::XM_PIDIV4) / 1.5f, 0, 0, 0 };
+	const ArchiveEntry *entry = assets.Find(sceneAssetName);
+	if (!entry)
+	{
+		CreateCube({ -1.0f, 0, 3.0f });
+		CreateCube({ 1.0f, 0, 3.0f });
+		CreateCube({ 0.0f, 1.0f, 3.0f });
+		return;
+	}
 
-	gameObjects.push_back({});
-	gameObjects.back().mesh = std::make_unique<Mesh<DefaultMaterial::Vertex>>(
-		Cube(device.Get(), commandList.Get(), &defaultMaterial)
-	);
+	// Stored scenes are used straight from the mapping, compressed ones
+	// need a copy.
+	std::vector<std::uint8_t> decompressed;
+	std::span<const std::uint8_t> bytes = assets.View(*entry);
+	if (entry->compression != ArchiveCompression::None)
+	{
+		decompressed = assets.Read(sceneAssetName);
+		bytes = decompressed;
+	}
+	CreateObjects(SceneView(bytes));
+}
+
+void MyApp::CreateObjects(const SceneView &view)
+{
+	// Every material is drawn with the default one for now.
+	const std::vector<MaterialHandle> sceneMaterials(view.MaterialCount(), defaultMaterial);
+
+	// One streamed mesh per distinct name, requested by its first user.
+	std::vector<MeshHandle> sceneMeshes(view.MeshCount());
+	for (MeshHandle &mesh : sceneMeshes)
+	{
+		mesh = meshes.Create();
+	}
+
+	DefaultMaterial &material = *materials.Get(defaultMaterial);
+	const UINT firstObject = (UINT)material.objectCount;
+	const SceneGraph::NodeId first = sceneWorld.CreateObjects(view, sceneMeshes, firstObject, sceneMaterials);
+	material.objectCount += view.Size();
+
+	std::vector<bool> requested(view.MeshCount(), false);
+	for (std::uint32_t i = 0; i < view.Size(); i++)
+	{
+		const std::uint32_t mesh = view.Meshes()[i];
+		if (!requested[mesh])
+		{
+			requested[mesh] = true;
+			RequestMesh(sceneMeshes[mesh], std::string(view.MeshName(mesh)), first + i, view.Transforms()[i].position);
+		}
+	}
+}
+
+void MyApp::CreateCube(math::Float3 position)
+{
+	Transform transform;
+	transform.position = position;
+	transform.rotation = math::QuaternionRotationAxis({ 1.0f, 0.0f, 0.0f }, -math::piOver4 / 1.5f);
+
+	const UINT objectIndex = (UINT)materials.Get(defaultMaterial)->objectCount++;
+	const MeshHandle mesh = meshes.Create();
 
-	gameObjects.back().transform.position = { 1.0f, 0, 3.0f };
-	gameObjects.back().transform.rotation = { -(DirectX::XM_PIDIV4) / 1.5f, 0, 0, 0 };
+	const SceneGraph::NodeId node = sceneWorld.CreateObject(transform, mesh, objectIndex, defaultMaterial, 0.5f);
+	RequestMesh(mesh, Cube::assetName, node, position);
+}
 
-	gameObjects.push_back({});
-	gameObjects.back().mesh = std::make_unique<Mesh<DefaultMaterial::Vertex>>(
-		Cube(device.Get(), commandList.Get(), &defaultMaterial)
+void MyApp::RequestMesh(MeshHandle mesh, const std::string &name, SceneGraph::NodeId node, math::Float3 position)
+{
+	const float priority = MeshPriority(position, ViewProj());
+	const AssetStreamer::RequestId request = streamer.Load(
+		[this, name]()
+		{
+			if (assets.Contains(name))
+			{
+				return assets.Read(name);
+			}
+			if (name == Cube::assetName)
+			{
+				return Cube::Data();
+			}
+			throw std::runtime_error("Mesh " + name + " isn't in the asset archive.");
+		},
+		[this, mesh](AssetStreamer::Completion &&completion) { OnMeshLoaded(mesh, std::move(completion)); },
+		priority
 	);
+	pendingMeshes.push_back({ request, node, priority });
+}
+
+// Runs inside Draw, with the frame's command list open.
+void MyApp::OnMeshLoaded(MeshHandle handle, AssetStreamer::Completion &&completion)
+{
+	const auto pending = std::lower_bound(pendingMeshes.begin(), pendingMeshes.end(), completion.id,
+		[](const PendingMesh &pending, AssetStreamer::RequestId id) { return pending.request < id; });
+	if (pending != pendingMeshes.end() && pending->request == completion.id)
+	{
+		pending->done = true;
+	}
+
+	// Nothing to do if the mesh was destroyed while loading.
+	DefaultMesh *mesh = meshes.Get(handle);
+	if (mesh == nullptr)
+	{
+		return;
+	}
 
-	gameObjects.back().transform.position = { 0.0f, 1.0f, 3.0f };
-	gameObjects.back().transform.rotation = { -(DirectX::XM_PIDIV4) / 1.5f, 0, 0, 0 };
+	// One missing or broken asset shouldn't stop the app, it's drawn as a
+	// cube instead.
+	std::string error = completion.error;
+	if (error.empty())
+	{
+		try
+		{
+			mesh->SetData(completion.data);
+		}
+		catch (const std::exception &e)
+		{
+			error = e.what();
+		}
+	}
+	if (!error.empty())
+	{
+		OutputDebugStringA(("Unable to load mesh, drawing a cube instead: " + error + "\n").c_str());
+		mesh->SetData(Cube::Data());
+	}
+	mesh->InitBuffers(device.Get(), *uploads);
+
+	// Drawn from this frame on, so this frame waits for the copy, on the
+	// GPU and for nothing else.
+	RequireUpload(mesh->uploadValue);
+}
+
+void MyApp::DestroyMesh(MeshHandle handle)
+{
+	if (DefaultMesh *mesh = meshes.Get(handle))
+	{
+		mesh->ReleaseBuffers(deferredReleases);
+		meshes.Destroy(handle);
+	}
+}
+
+float MyApp::MeshPriority(math::Float3 position, const math::Float4x4 &viewProj) const
+{
+	// In front of the camera and inside the clip volume, with some slack
+	// for the object's size.
+	const float w = position.x * viewProj.m[0][3] + position.y * viewProj.m[1][3] + position.z * viewProj.m[2][3] + viewProj.m[3][3];
+	bool visible = false;
+	if (w > 0.0f)
+	{
+		const math::Float3 clip = math::TransformCoord(position, viewProj);
+		visible = std::fabs(clip.x) <= 1.2f && std::fabs(clip.y) <= 1.2f && clip.z <= 1.0f;
+	}
+
+	return StreamingPriority(math::Length(position - cameraPosition), visible);
+}
+
+void MyApp::FixedUpdate(float stepTime)
+{
+	sceneWorld.FixedUpdate(stepTime);
+}
+
+void MyApp::PublishRenderState()
+{
+	sceneWorld.PublishRenderState();
 }
 
-void MyApp::Update(float deltaTime)
+void MyApp::PrepareFrame(float alpha)
 {
-	using namespace dx;
+	using namespace math;
 
-	XMVECTOR pos = XMVectorSet(0.0f, 0.0f, -2.0f, 1.0f);
-	XMVECTOR target = XMVectorZero();
-	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-	XMMATRIX view = XMMatrixLookAtLH(pos, target, up);
+	const Float4x4 view = View();
+	const Float4x4 viewProj = ViewProj();
 
-	for (int i = 0; i < gameObjects.size(); i++)
+	// Only objects whose world matrix changed are uploaded again.
+	for (SceneGraph::NodeId node : sceneWorld.Prepare(alpha))
 	{
-		gameObjects[i].transform.rotation += { 0, deltaTime * 0.5f, 0, 0 };
+		WriteObjectData(node);
+	}
 
-		//XMMATRIX translation = XMMatrixTranslation(0, 0, 3.0f);
-		XMMATRIX translation = XMMatrixTranslationFromVector(gameObjects[i].transform.position);
-		XMMATRIX rotationYMatrix = XMMatrixRotationY(XMVectorGetY(gameObjects[i].transform.rotation));
-		XMMATRIX rotationXMatrix = XMMatrixRotationX(XMVectorGetX(gameObjects[i].transform.rotation));
+	// Whatever is nearest and on screen streams in first. Only priorities
+	// that changed noticeably are passed on, all in one go, gathered in the
+	// frame's scratch memory.
+	std::erase_if(pendingMeshes, [](const PendingMesh &pending) { return pending.done; });
+	FrameVector<AssetStreamer::PriorityUpdate> priorityUpdates{ ArenaAllocator<AssetStreamer::PriorityUpdate>(frameArena) };
+	priorityUpdates.reserve(pendingMeshes.size());
+	for (PendingMesh &pending : pendingMeshes)
+	{
+		const Float4x4 &world = sceneWorld.Scene().World(pending.node);
+		const float priority = MeshPriority({ world.m[3][0], world.m[3][1], world.m[3][2] }, viewProj);
+		if (std::fabs(priority - pending.priority) > pending.priority * priorityTolerance)
+		{
+			pending.priority = priority;
+			priorityUpdates.push_back({ pending.request, priority });
+		}
+	}
+	if (!priorityUpdates.empty())
+	{
+		streamer.SetPriorities(priorityUpdates);
+	}
 
-		XMMATRIX rotation = rotationYMatrix * rotationXMatrix;
+	AnimateStressLights(lightStart, (float)Clock::ToSeconds(Clock::Now() - lightTimeOrigin), lights);
+	lightClusters.SetProjection(fovY, AspectRatio(), nearZ, farZ);
+	lightClusters.Build(lights, view);
+	lightBuffers.Write(lights, lightClusters);
 
-		XMMATRIX world = rotation * translation; // local space to world space
-		//XMMATRIX view = XMMatrixIdentity(); // world space to camera space (move everything so camera is at 0,0,0 here)
+	// Long stalls aren't simulated in one step.
+	const std::int64_t now = Clock::Now();
+	const float particleTime = (std::min)((float)Clock::ToSeconds(now - lastParticleTime), 0.1f);
+	lastParticleTime = now;
+	particles->Update(particleTime, jobs);
+	particles->Sort(view, jobs);
+	particleCount = particleBuffer.Write(*particles, jobs);
 
-		XMMATRIX perspProj = XMMatrixPerspectiveFovLH(XM_PIDIV4, AspectRatio(), 0.1f, 1000.0f);
+	WritePassConstants(view, viewProj);
+}
 
-		XMMATRIX worldViewProj = world * view * perspProj;
+void MyApp::WritePassConstants(const math::Float4x4 &view, const math::Float4x4 &viewProj)
+{
+	using namespace math;
+
+	const ClusterGrid &grid = lightClusters.Grid();
+
+	DefaultMaterial::PassConstants passConstants = {};
+	passConstants.viewProj = Transpose(viewProj);
+	passConstants.viewDepth = { view.m[0][2], view.m[1][2], view.m[2][2], view.m[3][2] };
+	passConstants.clusterTileScale[0] = (float)grid.tilesX / width;
+	passConstants.clusterTileScale[1] = (float)grid.tilesY / height;
+	passConstants.clusterSliceScale = lightClusters.SliceScale();
+	passConstants.clusterSliceBias = lightClusters.SliceBias();
+	passConstants.clusterTilesX = grid.tilesX;
+	passConstants.clusterTilesY = grid.tilesY;
+	passConstants.clusterSlices = grid.slices;
+	passConstants.lightCount = (std::uint32_t)lights.size();
+	passConstants.lightsIndex = lightBuffers.LightsIndex();
+	passConstants.clusterRangesIndex = lightBuffers.RangesIndex();
+	passConstants.lightIndicesIndex = lightBuffers.IndicesIndex();
+	passConstants.ambient = lights.empty() ? Float3{ 1.0f, 1.0f, 1.0f } : Float3{ 0.15f, 0.15f, 0.15f };
+
+	// The camera lives in the pass constants, so moving it doesn't touch any
+	// object data.
+	if (std::memcmp(&passConstants, &lastPassConstants, sizeof(passConstants)) != 0)
+	{
+		lastPassConstants = passConstants;
+		for (DefaultMaterial &material : materials.Values())
+		{
+			memcpy(material.cbufferMappedData, &passConstants, sizeof(DefaultMaterial::PassConstants));
+		}
+
+		ParticleMaterial::PassConstants particleConstants = {};
+		particleConstants.viewProj = passConstants.viewProj;
+		particleConstants.cameraRight = { view.m[0][0], view.m[1][0], view.m[2][0] };
+		particleConstants.cameraUp = { view.m[0][1], view.m[1][1], view.m[2][1] };
+		memcpy(particleMaterial.cbufferMappedData, &particleConstants, sizeof(particleConstants));
+	}
+}
 
-		DefaultMaterial::ObjectConstants objConstants;
-		XMStoreFloat4x4(&objConstants.worldViewProj, XMMatrixTranspose(worldViewProj));
+math::Float4x4 MyApp::View() const
+{
+	return math::LookAtLH(cameraPosition, cameraTarget, { 0.0f, 1.0f, 0.0f });
+}
 
-		memcpy(defaultMaterial.cbufferMappedData + i * defaultMaterial.cbufferObjectByteSize, &objConstants, sizeof(DefaultMaterial::ObjectConstants));
+math::Float4x4 MyApp::ViewProj() const
+{
+	return View() * math::PerspectiveFovLH(fovY, AspectRatio(), nearZ, farZ);
+}
 
+void MyApp::WriteObjectData(SceneGraph::NodeId node)
+{
+	const std::uint32_t objectIndex = sceneWorld.ObjectIndex(node);
+	if (objectIndex == SceneWorld::noObject)
+	{
+		return;
 	}
+
+	DefaultMaterial::ObjectData data = {};
+	data.world = math::Transpose(sceneWorld.Scene().World(node));
+	data.materialIndex = 0;
+	sceneBuffer.Set(objectIndex, data);
 }
 
 void MyApp::CustomDraw()
 {
-	DrawWithMaterial(gameObjects, &defaultMaterial);
+	// Copies the object data changed by PrepareFrame before anything reads it.
+	sceneBuffer.RecordUploads(commandList.Get());
+
+	const SceneWorld::RenderState &state = sceneWorld.Current();
+	if (indirectDraws)
+	{
+		DrawIndirect(state);
+	}
+	else
+	{
+		for (MaterialHandle material : materials.Handles())
+		{
+			DrawWithMaterial(state, material);
+		}
+	}
+
+	DrawParticles();
+}
+
+void MyApp::BindMaterial(const Material &material)
+{
+	const Pipeline *pipeline = pipelines.Get(material.pipeline);
+	commandList->SetPipelineState(pipeline->state.Get());
+	commandList->SetGraphicsRootSignature(pipeline->rootSignature.Get());
+
+	const UINT indices[] = { material.passConstantsIndex, objectDataIndex };
+	commandList->SetGraphicsRoot32BitConstants(Material::drawConstantsParameter, _countof(indices), indices, Material::passConstantsIndexConstant);
+	commandList->SetGraphicsRootDescriptorTable(Material::resourceTableParameter, resources.TableStart());
+
+	commandList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
 
-void MyApp::DrawWithMaterial(const std::vector<GameObject> &objects, Material *material)
+void MyApp::DrawWithMaterial(const SceneWorld::RenderState &state, MaterialHandle material)
 {
-	commandList->SetPipelineState(material->PSO.Get());
-	commandList->SetGraphicsRootSignature(material->rootSignature.Get());
-	ID3D12DescriptorHeap *heaps[] = { material->cbvHeap.Get() };
-	commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+	BindMaterial(*materials.Get(material));
 
-	for (int i = 0; i < objects.size(); i++)
+	for (const auto &item : state.items)
 	{
-		auto hGPU = CD3DX12_GPU_DESCRIPTOR_HANDLE(
-			defaultMaterial.cbvHeap->GetGPUDescriptorHandleForHeapStart(),
-			i, // i
-			cbvSrvUavDescriptorSize
-		);
+		const auto *mesh = meshes.Get(item.mesh);
+		if (item.material != material || mesh == nullptr || !mesh->Ready())
+		{
+			continue;
+		}
 
-		commandList->SetGraphicsRootDescriptorTable(0, hGPU);
+		// The only per-draw binding.
+		commandList->SetGraphicsRoot32BitConstant(Material::drawConstantsParameter, item.objectIndex, Material::objectIndexConstant);
 
-		commandList->IASetVertexBuffers(0, 1, &objects[i].mesh->vbv);
-		commandList->IASetIndexBuffer(&objects[i].mesh->ibv);
-		commandList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		commandList->IASetVertexBuffers(0, 1, &mesh->vbv);
+		commandList->IASetIndexBuffer(&mesh->ibv);
 
+		commandList->DrawIndexedInstanced(mesh->GetIndexCount(), 1, 0, 0, 0);
+	}
+}
 
-		commandList->DrawIndexedInstanced(objects[i].mesh->GetIndexCount(), 1, 0, 0, 0);
+void MyApp::DrawIndirect(const SceneWorld::RenderState &state)
+{
+	drawList.Clear();
+	for (const auto &item : state.items)
+	{
+		// Gone, or not streamed in yet.
+		const auto *mesh = meshes.Get(item.mesh);
+		if (mesh == nullptr || !mesh->Ready() || !materials.IsValid(item.material))
+		{
+			continue;
+		}
+		// Buckets by material slot, which is small and dense.
+		drawList.Add(item.material.index, mesh->Geometry(), item.objectIndex);
 	}
+
+	// One ExecuteIndirect per material, however many objects use it.
+	for (const DrawList::Bucket &bucket : indirectDrawBuffer.Write(device.Get(), drawList, deferredReleases))
+	{
+		const Material &material = *materials.Get(materials.At(bucket.id));
+		BindMaterial(material);
+
+		commandList->ExecuteIndirect(
+			pipelines.Get(material.pipeline)->commandSignature.Get(),
+			bucket.count,
+			indirectDrawBuffer.Resource(),
+			IndirectDrawBuffer::Offset(bucket),
+			nullptr,
+			0
+		);
+	}
+}
+
+void MyApp::DrawParticles()
+{
+	if (particleCount == 0)
+	{
+		return;
+	}
+
+	// One instanced draw, the vertex shader pulls the instances from
+	// particleBuffer in place of object data.
+	BindMaterial(particleMaterial);
+	commandList->SetGraphicsRoot32BitConstant(Material::drawConstantsParameter, particleBuffer.Index(), Material::objectDataIndexConstant);
+	commandList->DrawInstanced(ParticleMaterial::verticesPerParticle, particleCount, 0, 0);
 }
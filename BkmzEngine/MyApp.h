@@ -2,32 +2,134 @@
 #include "dxApp.h"
 #include "Mesh.h"
 #include "DefaultMaterial.h"
-#include "GameObject.h"
+#include "SceneWorld.h"
+#include "SceneBuffer.h"
+#include "IndirectDrawBuffer.h"
+#include "JobSystem.h"
+#include "LightBuffers.h"
+#include "LightClusters.h"
+#include "ParticleBuffer.h"
+#include "ParticleMaterial.h"
+#include "ParticleSystem.h"
+#include "SceneFile.h"
+#include "StressScene.h"
+#include <optional>
 #include <vector>
 
 class MyApp : public dxApp
 {
 public:
 	MyApp(HWND hwnd, UINT width, UINT height) : dxApp(hwnd, width, height) {}
+	~MyApp();
 	
-	void Update(float deltaTime) override;
+	void FixedUpdate(float stepTime) override;
+	void PublishRenderState() override;
+	void PrepareFrame(float alpha) override;
+
+	// Submit every material's draws with one ExecuteIndirect instead of one
+	// set of API calls per draw.
+	bool indirectDraws = true;
+
+	// Before Initialize: draw a generated scene instead of the archive's,
+	// for measuring at scale, see StressScene.h.
+	std::optional<StressSceneOptions> stressScene;
 
 private:
+	void WriteObjectData(SceneGraph::NodeId node);
+	bkmz::math::Float4x4 View() const;
+	bkmz::math::Float4x4 ViewProj() const;
+	void WritePassConstants(const bkmz::math::Float4x4 &view, const bkmz::math::Float4x4 &viewProj);
+
+	// Streams in the named mesh for the empty one `mesh` refers to.
+	void RequestMesh(MeshHandle mesh, const std::string &name, SceneGraph::NodeId node, bkmz::math::Float3 position);
+	void OnMeshLoaded(MeshHandle mesh, AssetStreamer::Completion &&completion);
+	float MeshPriority(bkmz::math::Float3 position, const bkmz::math::Float4x4 &viewProj) const;
+
+	// Its buffers go to deferredReleases, the GPU may still be drawing it.
+	void DestroyMesh(MeshHandle mesh);
+
 	void CustomDraw();
-	void DrawWithMaterial(const std::vector<GameObject> &objects, Material *material);
+	void BindMaterial(const Material &material);
+	void DrawWithMaterial(const SceneWorld::RenderState &state, MaterialHandle material);
+	void DrawIndirect(const SceneWorld::RenderState &state);
+	void DrawParticles();
 
 public:
 	void Initialize() override;
 
 private:
 	void CreateMaterials();
+	void CreateLights();
+	void CreateParticles();
 	void CreateObjects();
+	void CreateObjects(const SceneView &view);
+	void CreateCube(bkmz::math::Float3 position);
 
 private:
 	static constexpr int vertexCount = 8;
 	static constexpr int indexCount = 6*6;
 	float rotationY = 0.0f;
 
-	DefaultMaterial defaultMaterial;
-	std::vector<GameObject> gameObjects;
+	// GPU resources, referred to by handle from components and snapshots.
+	// Destroying one makes every handle to it stale rather than dangling.
+	// Meshes sit empty until streamed in, see Mesh::Ready. Render side only.
+	HandlePool<DefaultMesh, MeshResource> meshes;
+	HandlePool<DefaultMaterial, MaterialResource> materials;
+	PipelinePool pipelines;
+	MaterialHandle defaultMaterial;
+
+	// Compiled scene (see SceneFile.h) loaded from the asset archive when
+	// it has one, in place of the built-in cubes.
+	static constexpr const char *sceneAssetName = "Scene.bscene";
+
+	// By request id, which only grows. Finished ones are only marked done,
+	// and dropped once a frame by PrepareFrame.
+	struct PendingMesh
+	{
+		AssetStreamer::RequestId request;
+		SceneGraph::NodeId node; // reprioritized from its position each frame
+		float priority;          // as last passed to the streamer
+		bool done = false;
+	};
+	std::vector<PendingMesh> pendingMeshes;
+
+	// Priorities are only passed on again once they moved by more than this
+	// fraction, nearby distances change the order little.
+	static constexpr float priorityTolerance = 0.05f;
+
+	bkmz::math::Float3 cameraPosition = { 0.0f, 0.0f, -2.0f };
+	bkmz::math::Float3 cameraTarget = { 0.0f, 0.0f, 0.0f };
+	static constexpr float fovY = bkmz::math::piOver4;
+	static constexpr float nearZ = 0.1f;
+	static constexpr float farZ = 1000.0f;
+
+	// Lights move every frame, from where they started (see
+	// AnimateStressLights), and are binned again every frame, see
+	// LightClusters. With none, everything draws unlit.
+	static constexpr UINT maxLights = 16384;
+	std::vector<Light> lightStart;
+	std::vector<Light> lights;
+	std::int64_t lightTimeOrigin = 0;
+	LightClusters lightClusters;
+	LightBuffers lightBuffers;
+
+	// Simulated, sorted and written out on the render side every frame, by
+	// the frame's own time, then drawn after everything opaque.
+	JobSystem jobs;
+	std::optional<ParticleSystem> particles;
+	ParticleMaterial particleMaterial;
+	ParticleBuffer particleBuffer;
+	std::uint32_t particleCount = 0; // written to particleBuffer this frame
+	std::int64_t lastParticleTime = 0;
+
+	// Entities, render snapshots and the scene graph. The object data in
+	// sceneBuffer stays on the GPU, and only the objects whose world matrix
+	// changed are uploaded again.
+	SceneWorld sceneWorld;
+	SceneBuffer<DefaultMaterial::ObjectData> sceneBuffer;
+	UINT objectDataIndex = ResourceRegistry::invalidIndex; // sceneBuffer's view
+	DefaultMaterial::PassConstants lastPassConstants = {};
+
+	DrawList drawList;
+	IndirectDrawBuffer indirectDrawBuffer;
 };
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+#include <d3d12.h>
+#include "Utils.h"
+#include "ParticleSystem.h"
+#include "ResourceRegistry.h"
+#include <algorithm>
+
+// The instances ParticleMaterial draws, rewritten every frame straight
+// into an upload heap buffer the vertex shader reads, like LightBuffers.
+// Sized for the particle system's capacity at Create, so the registry view
+// never changes; reused every frame, which relies on Draw waiting for the
+// GPU at the end of the frame.
+class ParticleBuffer
+{
+public:
+	~ParticleBuffer()
+	{
+		if (resource && mapped)
+		{
+			resource->Unmap(0, nullptr);
+		}
+	}
+
+	void Create(ID3D12Device *device, ResourceRegistry &resources, std::uint32_t capacity)
+	{
+		this->capacity = (std::max)(capacity, 1u);
+		resource = Utils::CreateBuffer(device, D3D12_HEAP_TYPE_UPLOAD, (UINT64)this->capacity * sizeof(ParticleInstance), D3D12_RESOURCE_STATE_GENERIC_READ);
+		DX_CALL(resource->Map(0, nullptr, reinterpret_cast<void **>(&mapped)));
+		index = resources.AddStructuredBuffer(resource.Get(), this->capacity, sizeof(ParticleInstance));
+	}
+
+	// Every live particle, back to front when `particles` was sorted. The
+	// chunks are written on the job system's threads; each writes its own
+	// contiguous range, which suits write-combined memory.
+	std::uint32_t Write(const ParticleSystem &particles, JobSystem &jobs)
+	{
+		if (particles.Size() > capacity)
+		{
+			return 0;
+		}
+		particles.WriteInstances(mapped, jobs);
+		return particles.Size();
+	}
+
+	// Registry index of the view.
+	UINT Index() const { return index; }
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+	ParticleInstance *mapped = nullptr;
+	std::uint32_t capacity = 0;
+	UINT index = ResourceRegistry::invalidIndex;
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include "Material.h"
+#include "Math.h"
+
+// Draws ParticleSystem's instances as camera facing quads, back to front,
+// alpha blended. Same root signature and registry as every other material:
+// the vertex shader pulls each instance from the structured buffer whose
+// registry index is in the draw constants' objectDataIndex, and there is
+// no vertex buffer.
+class ParticleMaterial : public Material
+{
+public:
+	ParticleMaterial()
+	{
+		vertexShaderName = L"ParticleVertexShader.cso";
+		pixelShaderName = L"ParticlePixelShader.cso";
+		alphaBlended = true;
+	}
+
+	// Two triangles per particle, DrawInstanced(verticesPerParticle, count).
+	static constexpr UINT verticesPerParticle = 6;
+
+	// PassConstants in ParticleVertexShader.hlsl. The camera's axes in world
+	// space, which the quads are spanned by.
+	struct PassConstants
+	{
+		bkmz::math::Float4x4 viewProj; // transposed
+		bkmz::math::Float3 cameraRight;
+		float padding0;
+		bkmz::math::Float3 cameraUp;
+		float padding1;
+	};
+
+	void CreatePSO(ID3D12Device *device, DXGI_FORMAT backBufferFormat,
+		DXGI_FORMAT depthStencilFormat, ResourceRegistry &resources, PipelinePool &pipelines, DeferredReleaseQueue &releases) override
+	{
+		Material::CreatePSO(device, backBufferFormat, depthStencilFormat, resources, pipelines, releases, sizeof(PassConstants));
+	}
+};
+
+static_assert(sizeof(ParticleMaterial::PassConstants) == 96);
@@ -0,0 +1,13 @@
+struct VertexOut
+{
+    float4 posH : SV_POSITION;
+    float4 color : COLOR;
+    float2 corner : TEXCOORD;
+};
+
+float4 PS(VertexOut pin) : SV_TARGET
+{
+    // A soft round spot instead of a square.
+    float falloff = saturate(1.0f - dot(pin.corner, pin.corner));
+    return float4(pin.color.rgb, pin.color.a * falloff * falloff);
+}
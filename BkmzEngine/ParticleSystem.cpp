@@ -0,0 +1,480 @@
+#include "ParticleSystem.h"
+#include "MathBatch.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace bkmz::math;
+
+namespace
+{
+	// Radix sort digits: two passes over 16 bit keys. Few buckets keep the
+	// scatter's writes in cache, which is what the sort's time goes on.
+	constexpr std::uint32_t digitBits = 8;
+	constexpr std::uint32_t digitCount = 1u << digitBits;
+	constexpr std::uint32_t sortPasses = 2;
+
+	// Particles are emitted from a counter, so random numbers come from
+	// hashing it rather than from a generator's state, which is what lets
+	// the SIMD and parallel versions produce the same particles.
+	std::uint32_t Hash(std::uint32_t x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	// [0, 1) from the high 24 bits.
+	float Unit(std::uint32_t hash)
+	{
+		return (float)(hash >> 8) * (1.0f / 16777216.0f);
+	}
+
+	std::uint32_t PackColor(Float4 color)
+	{
+		auto channel = [](float value) { return (std::uint32_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); };
+		return channel(color.x) | channel(color.y) << 8 | channel(color.z) << 16 | channel(color.w) << 24;
+	}
+
+	void ScalarIntegrate(const ParticleSystem::Streams &s, std::uint32_t begin, std::uint32_t end,
+		const ParticleSystem::Integration &integration, std::uint32_t *dead)
+	{
+		const float dt = integration.dt;
+		const Float3 g = integration.gravity;
+		std::uint32_t word = 0;
+		for (std::uint32_t i = begin; i < end; i++)
+		{
+			const float vx = (s.velocityX[i] + g.x * dt) * integration.damping;
+			const float vy = (s.velocityY[i] + g.y * dt) * integration.damping;
+			const float vz = (s.velocityZ[i] + g.z * dt) * integration.damping;
+			s.velocityX[i] = vx;
+			s.velocityY[i] = vy;
+			s.velocityZ[i] = vz;
+			s.positionX[i] += vx * dt;
+			s.positionY[i] += vy * dt;
+			s.positionZ[i] += vz * dt;
+
+			const float age = s.age[i] + dt;
+			s.age[i] = age;
+			if (!(age < s.lifetime[i]))
+			{
+				word |= 1u << ((i - begin) % 32);
+			}
+			if ((i - begin) % 32 == 31 || i + 1 == end)
+			{
+				dead[(i - begin) / 32] = word;
+				word = 0;
+			}
+		}
+	}
+
+	void ScalarEmit(const ParticleSystem::Streams &s, std::uint32_t begin, std::uint32_t end,
+		const ParticleSystem::Emission &emission)
+	{
+		for (std::uint32_t i = begin; i < end; i++)
+		{
+			const std::uint32_t n = (emission.sequence + (i - begin)) * 4;
+			s.positionX[i] = emission.position.x;
+			s.positionY[i] = emission.position.y;
+			s.positionZ[i] = emission.position.z;
+			s.velocityX[i] = emission.velocity.x + emission.spread * (Unit(Hash(n)) * 2.0f - 1.0f);
+			s.velocityY[i] = emission.velocity.y + emission.spread * (Unit(Hash(n + 1)) * 2.0f - 1.0f);
+			s.velocityZ[i] = emission.velocity.z + emission.spread * (Unit(Hash(n + 2)) * 2.0f - 1.0f);
+			s.age[i] = 0.0f;
+			s.lifetime[i] = emission.lifetime * (0.5f + Unit(Hash(n + 3)));
+			s.size[i] = emission.size;
+			s.color[i] = emission.color;
+		}
+	}
+
+	void ScalarDepths(const ParticleSystem::Streams &s, std::uint32_t begin, std::uint32_t end,
+		Float4 viewDepth, float *depths, float &nearest, float &farthest)
+	{
+		float low = std::numeric_limits<float>::infinity();
+		float high = -std::numeric_limits<float>::infinity();
+		for (std::uint32_t i = begin; i < end; i++)
+		{
+			const float depth = s.positionX[i] * viewDepth.x + s.positionY[i] * viewDepth.y + s.positionZ[i] * viewDepth.z + viewDepth.w;
+			depths[i] = depth;
+			low = (std::min)(low, depth);
+			high = (std::max)(high, depth);
+		}
+		nearest = low;
+		farthest = high;
+	}
+
+	void ScalarDepthKeys(const float *depths, std::uint32_t begin, std::uint32_t end,
+		float nearest, float scale, std::uint32_t *keys, std::uint32_t *indices)
+	{
+		for (std::uint32_t i = begin; i < end; i++)
+		{
+			const float quantized = (std::min)((depths[i] - nearest) * scale, (float)ParticleSystem::maxKey);
+			keys[i] = ParticleSystem::maxKey - (std::uint32_t)quantized;
+			indices[i] = i;
+		}
+	}
+
+	const ParticleSystem::Kernels scalarKernels = {
+		ScalarIntegrate,
+		ScalarEmit,
+		ScalarDepths,
+		ScalarDepthKeys,
+	};
+
+	const ParticleSystem::Kernels &ActiveKernels()
+	{
+		const ParticleSystem::Kernels *kernels = nullptr;
+		if (ActiveBackend() == SimdBackend::Avx2)
+		{
+			kernels = ParticleSystem::Avx2Kernels();
+		}
+		return kernels ? *kernels : scalarKernels;
+	}
+
+	// First index in [from, to) whose bit is set, or `to`.
+	std::uint32_t NextSet(const std::uint32_t *bits, std::uint32_t from, std::uint32_t to, std::uint32_t flip)
+	{
+		while (from < to)
+		{
+			const std::uint32_t word = (bits[from / 32] ^ flip) >> (from % 32);
+			if (word != 0)
+			{
+				return (std::min)(to, from + (std::uint32_t)std::countr_zero(word));
+			}
+			from = (from / 32 + 1) * 32;
+		}
+		return to;
+	}
+
+	// One past the last index in [from, to) whose bit is set, or `from`.
+	std::uint32_t PreviousSet(const std::uint32_t *bits, std::uint32_t from, std::uint32_t to, std::uint32_t flip)
+	{
+		while (to > from)
+		{
+			const std::uint32_t last = to - 1;
+			const std::uint32_t word = (bits[last / 32] ^ flip) << (31 - last % 32);
+			if (word != 0)
+			{
+				return (std::max)(from, to - (std::uint32_t)std::countl_zero(word));
+			}
+			to = last / 32 * 32;
+		}
+		return from;
+	}
+}
+
+ParticleSystem::ParticleSystem(std::uint32_t capacity)
+	: capacity(capacity)
+{
+	// Each stream starts on a 32 byte boundary from the first.
+	const std::size_t stride = ((std::size_t)capacity + 8 + 7) / 8 * 8;
+	floats.assign(stride * 9, 0.0f);
+	colors.assign(stride, 0);
+
+	float *next = floats.data();
+	for (float **stream : { &streams.positionX, &streams.positionY, &streams.positionZ,
+		&streams.velocityX, &streams.velocityY, &streams.velocityZ, &streams.age, &streams.lifetime, &streams.size })
+	{
+		*stream = next;
+		next += stride;
+	}
+	streams.color = colors.data();
+
+	dead.assign(capacity / 32 + 1, 0);
+	chunkLive.assign(JobSystem::ChunkCount(capacity, grain) + 1, 0);
+	depths.assign(stride, 0.0f);
+	chunkDepths.assign(((std::size_t)JobSystem::ChunkCount(capacity, sortGrain) + 1) * 2, 0.0f);
+	for (int i = 0; i < 2; i++)
+	{
+		keys[i].assign(stride, 0);
+		indices[i].assign(stride, 0);
+	}
+	histograms.assign(((std::size_t)JobSystem::ChunkCount(capacity, sortGrain) + 1) * digitCount, 0);
+}
+
+void ParticleSystem::Update(float dt, JobSystem &jobs)
+{
+	stats = {};
+	sorted = false;
+	Integrate(dt, jobs);
+	Emit(dt, jobs);
+	stats.live = size;
+}
+
+void ParticleSystem::Clear()
+{
+	size = 0;
+	sorted = false;
+	std::fill(emitterCarry.begin(), emitterCarry.end(), 0.0f);
+	stats = {};
+}
+
+void ParticleSystem::Integrate(float dt, JobSystem &jobs)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	const Kernels &kernels = ActiveKernels();
+	const Integration integration = { dt, std::exp(-drag * dt), gravity };
+
+	// Each chunk moves its own survivors to its front...
+	jobs.ParallelFor(size, grain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		kernels.integrate(streams, begin, end, integration, dead.data() + begin / 32);
+		chunkLive[begin / grain] = Compact(begin, end);
+	});
+
+	// ...then the holes left below the new size are filled from the
+	// survivors above it, which only moves about as many particles as died.
+	const std::uint32_t chunks = JobSystem::ChunkCount(size, grain);
+	auto chunkBegin = [](std::uint32_t chunk) { return chunk * grain; };
+	auto chunkEnd = [this](std::uint32_t chunk) { return (std::min)(size, (chunk + 1) * grain); };
+
+	std::uint32_t live = 0;
+	for (std::uint32_t chunk = 0; chunk < chunks; chunk++)
+	{
+		live += chunkLive[chunk];
+	}
+
+	std::uint32_t holeChunk = 0;
+	std::uint32_t hole = chunkLive[0];
+	std::uint32_t sourceChunk = chunks - 1;
+	std::uint32_t source = chunkBegin(sourceChunk) + chunkLive[sourceChunk];
+	while (true)
+	{
+		while (holeChunk < chunks && hole >= chunkEnd(holeChunk))
+		{
+			if (++holeChunk < chunks)
+			{
+				hole = chunkBegin(holeChunk) + chunkLive[holeChunk];
+			}
+		}
+		if (holeChunk == chunks || hole >= live)
+		{
+			break;
+		}
+		while (source == chunkBegin(sourceChunk))
+		{
+			sourceChunk--;
+			source = chunkBegin(sourceChunk) + chunkLive[sourceChunk];
+		}
+		Move(--source, hole++);
+	}
+
+	stats.killed = size - live;
+	size = live;
+}
+
+// Swap compaction within [begin, end) by integrate's dead bits: the first
+// dead particle takes the last live one, until they meet. Returns how many
+// are alive, all at the front now.
+std::uint32_t ParticleSystem::Compact(std::uint32_t begin, std::uint32_t end)
+{
+	const std::uint32_t *bits = dead.data() + begin / 32;
+	auto offset = [begin](std::uint32_t i) { return i - begin; };
+
+	std::uint32_t low = begin;
+	std::uint32_t high = end;
+	while (true)
+	{
+		low = begin + NextSet(bits, offset(low), offset(high), 0);
+		if (low == high)
+		{
+			break;
+		}
+		const std::uint32_t lastLive = begin + PreviousSet(bits, offset(low) + 1, offset(high), ~0u);
+		if (lastLive == low + 1)
+		{
+			// Nothing alive past the first dead particle.
+			high = low;
+			break;
+		}
+		Move(lastLive - 1, low);
+		high = lastLive - 1;
+		low++;
+	}
+	return high - begin;
+}
+
+void ParticleSystem::Move(std::uint32_t from, std::uint32_t to)
+{
+	streams.positionX[to] = streams.positionX[from];
+	streams.positionY[to] = streams.positionY[from];
+	streams.positionZ[to] = streams.positionZ[from];
+	streams.velocityX[to] = streams.velocityX[from];
+	streams.velocityY[to] = streams.velocityY[from];
+	streams.velocityZ[to] = streams.velocityZ[from];
+	streams.age[to] = streams.age[from];
+	streams.lifetime[to] = streams.lifetime[from];
+	streams.size[to] = streams.size[from];
+	streams.color[to] = streams.color[from];
+}
+
+void ParticleSystem::Emit(float dt, JobSystem &jobs)
+{
+	emitterCarry.resize(emitters.size(), 0.0f);
+
+	// Every emitter's share of this step, laid out after the live particles.
+	segments.clear();
+	std::uint32_t end = size;
+	for (std::size_t i = 0; i < emitters.size(); i++)
+	{
+		const ParticleEmitter &emitter = emitters[i];
+		const float owed = emitterCarry[i] + (std::max)(emitter.rate, 0.0f) * dt;
+		const std::uint32_t count = (std::uint32_t)(std::min)(owed, (float)capacity);
+		emitterCarry[i] = owed - count;
+
+		const std::uint32_t kept = (std::min)(count, capacity - end);
+		stats.dropped += count - kept;
+		if (kept != 0)
+		{
+			Emission emission;
+			emission.position = emitter.position;
+			emission.velocity = emitter.velocity;
+			emission.spread = emitter.spread;
+			emission.lifetime = emitter.lifetime;
+			emission.size = emitter.size;
+			emission.color = PackColor(emitter.color);
+			emission.sequence = sequence;
+			segments.push_back({ end, end + kept, emission });
+			end += kept;
+		}
+		sequence += count;
+	}
+
+	const Kernels &kernels = ActiveKernels();
+	const std::uint32_t first = size;
+	jobs.ParallelFor(end - first, grain, [&](std::uint32_t begin, std::uint32_t chunkEnd)
+	{
+		begin += first;
+		chunkEnd += first;
+		auto segment = std::upper_bound(segments.begin(), segments.end(), begin,
+			[](std::uint32_t index, const Segment &s) { return index < s.end; });
+		for (; segment != segments.end() && segment->begin < chunkEnd; ++segment)
+		{
+			const std::uint32_t from = (std::max)(begin, segment->begin);
+			Emission emission = segment->emission;
+			emission.sequence += from - segment->begin;
+			kernels.emit(streams, from, (std::min)(chunkEnd, segment->end), emission);
+		}
+	});
+
+	stats.emitted = end - first;
+	size = end;
+}
+
+void ParticleSystem::Sort(const Float4x4 &view, JobSystem &jobs)
+{
+	const Kernels &kernels = ActiveKernels();
+	const Float4 viewDepth = { view.m[0][2], view.m[1][2], view.m[2][2], view.m[3][2] };
+
+	const std::uint32_t chunks = JobSystem::ChunkCount(size, sortGrain);
+
+	// Keys are depths quantized over the range the particles span, so the
+	// 16 bits go where the particles are.
+	jobs.ParallelFor(size, sortGrain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		float *range = chunkDepths.data() + (std::size_t)(begin / sortGrain) * 2;
+		kernels.depths(streams, begin, end, viewDepth, depths.data(), range[0], range[1]);
+	});
+	float nearest = std::numeric_limits<float>::infinity();
+	float farthest = -std::numeric_limits<float>::infinity();
+	for (std::uint32_t chunk = 0; chunk < chunks; chunk++)
+	{
+		nearest = (std::min)(nearest, chunkDepths[chunk * 2]);
+		farthest = (std::max)(farthest, chunkDepths[chunk * 2 + 1]);
+	}
+	const float scale = farthest > nearest ? maxKey / (farthest - nearest) : 0.0f;
+
+	jobs.ParallelFor(size, sortGrain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		kernels.depthKeys(depths.data(), begin, end, nearest, scale, keys[0].data(), indices[0].data());
+	});
+
+	// Least significant digit first. Every chunk counts its digits, the
+	// counts are turned into where each chunk's run of each digit starts,
+	// and every chunk scatters its keys there, which keeps the sort stable.
+	int source = 0;
+	for (std::uint32_t pass = 0; pass < sortPasses && size > 1; pass++)
+	{
+		const std::uint32_t shift = pass * digitBits;
+		const std::uint32_t *sourceKeys = keys[source].data();
+
+		jobs.ParallelFor(size, sortGrain, [&](std::uint32_t begin, std::uint32_t end)
+		{
+			std::uint32_t *histogram = histograms.data() + (std::size_t)(begin / sortGrain) * digitCount;
+			std::fill(histogram, histogram + digitCount, 0u);
+			for (std::uint32_t i = begin; i < end; i++)
+			{
+				histogram[(sourceKeys[i] >> shift) & (digitCount - 1)]++;
+			}
+		});
+
+		// A pass where every key has the same digit, all particles at one
+		// depth for instance, would only copy.
+		const std::uint32_t firstDigit = (sourceKeys[0] >> shift) & (digitCount - 1);
+		std::uint32_t firstDigitCount = 0;
+		for (std::uint32_t chunk = 0; chunk < chunks; chunk++)
+		{
+			firstDigitCount += histograms[(std::size_t)chunk * digitCount + firstDigit];
+		}
+		if (firstDigitCount == size)
+		{
+			continue;
+		}
+
+		std::uint32_t offset = 0;
+		for (std::uint32_t digit = 0; digit < digitCount; digit++)
+		{
+			for (std::uint32_t chunk = 0; chunk < chunks; chunk++)
+			{
+				std::uint32_t &count = histograms[(std::size_t)chunk * digitCount + digit];
+				const std::uint32_t start = offset;
+				offset += count;
+				count = start;
+			}
+		}
+
+		const std::uint32_t *sourceIndices = indices[source].data();
+		std::uint32_t *targetKeys = keys[1 - source].data();
+		std::uint32_t *targetIndices = indices[1 - source].data();
+		jobs.ParallelFor(size, sortGrain, [&](std::uint32_t begin, std::uint32_t end)
+		{
+			std::uint32_t *cursor = histograms.data() + (std::size_t)(begin / sortGrain) * digitCount;
+			for (std::uint32_t i = begin; i < end; i++)
+			{
+				const std::uint32_t key = sourceKeys[i];
+				const std::uint32_t at = cursor[(key >> shift) & (digitCount - 1)]++;
+				targetKeys[at] = key;
+				targetIndices[at] = sourceIndices[i];
+			}
+		});
+		source = 1 - source;
+	}
+
+	order = indices[source].data();
+	sorted = true;
+}
+
+void ParticleSystem::WriteInstances(ParticleInstance *out, JobSystem &jobs) const
+{
+	const std::uint32_t *order = sorted ? this->order : nullptr;
+	jobs.ParallelFor(size, grain, [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (std::uint32_t i = begin; i < end; i++)
+		{
+			const std::uint32_t p = order ? order[i] : i;
+			ParticleInstance instance;
+			instance.position = { streams.positionX[p], streams.positionY[p], streams.positionZ[p] };
+			instance.size = streams.size[p];
+			instance.color = streams.color[p];
+			instance.fade = (std::max)(0.0f, 1.0f - streams.age[p] / streams.lifetime[p]);
+			out[i] = instance;
+		}
+	});
+}
@@ -0,0 +1,190 @@
+#pragma once
+#include "JobSystem.h"
+#include "Math.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Large numbers of short lived particles, simulated on the CPU and drawn as
+// camera facing quads with one instanced draw, see ParticleMaterial.
+//
+// Particles are kept as a structure of arrays, one array per component,
+// alive ones packed at the front. Update integrates them, removes the ones
+// past their lifetime by moving live ones from the back into the holes,
+// then appends what the emitters produced. Sort orders them back to front
+// for alpha blending with a radix sort on view depth, quantized to 16 bits
+// over the particles' own depth range, and WriteInstances
+// writes them out in that order. All three split their work into chunks on
+// a JobSystem, and the per-particle loops use AVX2 when bkmz::math has
+// picked it (the other backends run the scalar loops).
+//
+// Capacity is fixed up front so the GPU buffer behind WriteInstances can be
+// sized once; emission past it is dropped and counted.
+
+struct ParticleEmitter
+{
+	bkmz::math::Float3 position;
+	float rate = 0.0f;            // particles per second
+	bkmz::math::Float3 velocity;  // mean initial velocity
+	float spread = 0.0f;          // added to each velocity component, within +-spread
+	bkmz::math::Float4 color = { 1.0f, 1.0f, 1.0f, 1.0f };
+	float lifetime = 1.0f;        // mean, each particle lives 0.5 to 1.5 times this
+	float size = 0.1f;            // quad half width
+};
+
+// One particle as the vertex shader reads it, ParticleInstance in
+// ParticleVertexShader.hlsl.
+struct ParticleInstance
+{
+	bkmz::math::Float3 position;
+	float size;
+	std::uint32_t color; // RGBA8, red in the low byte
+	float fade;          // 1 when emitted, 0 at the end of its life
+};
+
+static_assert(sizeof(ParticleInstance) == 24);
+
+struct ParticleStats
+{
+	std::uint32_t live = 0;
+	std::uint32_t emitted = 0; // during the last Update
+	std::uint32_t killed = 0;
+	std::uint32_t dropped = 0; // emitted past capacity, left out
+};
+
+class ParticleSystem
+{
+public:
+	explicit ParticleSystem(std::uint32_t capacity);
+
+	// Emitters can be changed freely between updates.
+	std::vector<ParticleEmitter> emitters;
+	bkmz::math::Float3 gravity = { 0.0f, -9.8f, 0.0f };
+	float drag = 0.1f; // fraction of velocity lost per second
+
+	// Advances every particle by `dt` seconds, then emits.
+	void Update(float dt, JobSystem &jobs);
+
+	// Back to front as seen through `view`, a world to view transform such
+	// as LookAtLH's.
+	void Sort(const bkmz::math::Float4x4 &view, JobSystem &jobs);
+
+	// Size() instances in the order of the last Sort, or in storage order
+	// when there hasn't been one since the last Update.
+	void WriteInstances(ParticleInstance *out, JobSystem &jobs) const;
+
+	void Clear();
+
+	std::uint32_t Size() const { return size; }
+	std::uint32_t Capacity() const { return capacity; }
+	const ParticleStats &Stats() const { return stats; }
+
+	// Indices of live particles, back to front, after Sort.
+	std::span<const std::uint32_t> Order() const { return { order, sorted ? size : 0 }; }
+
+	// Work is split into chunks of this many particles, multiples of 32.
+	static constexpr std::uint32_t grain = 1 << 14;
+	static constexpr std::uint32_t sortGrain = 1 << 16;
+
+	// The rest is for the SIMD backends, ParticleSystem.cpp and
+	// ParticleSystemAvx2.cpp.
+
+	// The component arrays, each with room for 8 particles past capacity.
+	// Kernels may read and write past `end` only when that is past the
+	// last live particle, other chunks may be working there otherwise.
+	struct Streams
+	{
+		float *positionX, *positionY, *positionZ;
+		float *velocityX, *velocityY, *velocityZ;
+		float *age, *lifetime, *size;
+		std::uint32_t *color;
+	};
+
+	struct Integration
+	{
+		float dt;
+		float damping; // velocity scale for this step
+		bkmz::math::Float3 gravity;
+	};
+
+	// One emitter's particles. Particle i of them draws its random numbers
+	// from sequence + i, so the result doesn't depend on how emission is
+	// split up.
+	struct Emission
+	{
+		bkmz::math::Float3 position;
+		bkmz::math::Float3 velocity;
+		float spread;
+		float lifetime;
+		float size;
+		std::uint32_t color;
+		std::uint32_t sequence;
+	};
+
+	struct Kernels
+	{
+		// Integrates [begin, end), begin a multiple of 32, and sets bit
+		// i % 32 of dead[(i - begin) / 32] for every particle i that is past
+		// its lifetime afterwards.
+		void (*integrate)(const Streams &streams, std::uint32_t begin, std::uint32_t end,
+			const Integration &integration, std::uint32_t *dead);
+
+		// Fills [begin, end) with new particles, the one at begin being
+		// number emission.sequence.
+		void (*emit)(const Streams &streams, std::uint32_t begin, std::uint32_t end, const Emission &emission);
+
+		// View depth of [begin, end) to `depths`, and the smallest and
+		// largest of them.
+		void (*depths)(const Streams &streams, std::uint32_t begin, std::uint32_t end,
+			bkmz::math::Float4 viewDepth, float *depths, float &nearest, float &farthest);
+
+		// 16 bit radix sort keys for depths[begin, end): maxKey - (depth -
+		// nearest) * scale, clamped, so an ascending sort is back to front.
+		// Also writes indices[i] = i.
+		void (*depthKeys)(const float *depths, std::uint32_t begin, std::uint32_t end,
+			float nearest, float scale, std::uint32_t *keys, std::uint32_t *indices);
+	};
+
+	// nullptr when the backend isn't compiled in.
+	static const Kernels *Avx2Kernels();
+
+	static constexpr std::uint32_t maxKey = 0xffff;
+
+private:
+	struct Segment
+	{
+		std::uint32_t begin;
+		std::uint32_t end;
+		Emission emission;
+	};
+
+	void Integrate(float dt, JobSystem &jobs);
+	std::uint32_t Compact(std::uint32_t begin, std::uint32_t end);
+	void Emit(float dt, JobSystem &jobs);
+	void Move(std::uint32_t from, std::uint32_t to);
+
+	std::uint32_t capacity;
+	std::uint32_t size = 0;
+	Streams streams = {};
+	std::vector<float> floats;          // the float streams, back to back
+	std::vector<std::uint32_t> colors;
+
+	std::vector<std::uint32_t> dead;    // integrate's bits, one word per 32 particles
+	std::vector<std::uint32_t> chunkLive;
+
+	std::vector<float> emitterCarry;    // fractional particles owed, per emitter
+	std::vector<Segment> segments;
+	std::uint32_t sequence = 0;
+
+	// Radix sort buffers. `order` points at whichever index buffer the last
+	// pass wrote.
+	std::vector<float> depths;
+	std::vector<float> chunkDepths; // nearest and farthest per chunk
+	std::vector<std::uint32_t> keys[2];
+	std::vector<std::uint32_t> indices[2];
+	std::vector<std::uint32_t> histograms;
+	std::uint32_t *order = nullptr;
+	bool sorted = false;
+
+	ParticleStats stats;
+};
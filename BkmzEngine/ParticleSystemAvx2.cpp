@@ -0,0 +1,192 @@
+#include "ParticleSystem.h"
+
+// Built with -mavx2 -mfma on GCC and Clang, like MathBatchAvx2.cpp, and
+// only called once bkmz::math has found AVX2 on the CPU.
+
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(BKMZ_MATH_SCALAR_ONLY) && !defined(BKMZ_MATH_NO_AVX2)
+#include <immintrin.h>
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	// Eight particles at a time; the scalar versions in ParticleSystem.cpp
+	// say what each step means.
+
+	__m256i TailMask(std::uint32_t remaining)
+	{
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		return _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(std::min)(remaining, 8u)), lanes);
+	}
+
+	__m256i Hash(__m256i x)
+	{
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+		x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x7feb352du));
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+		x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x846ca68bu));
+		return _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+	}
+
+	__m256 Unit(__m256i hash)
+	{
+		return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(hash, 8)), _mm256_set1_ps(1.0f / 16777216.0f));
+	}
+
+	// mean + spread * (2u - 1), rounded like the scalar version.
+	__m256 Spread(__m256 mean, __m256 spread, __m256i hash)
+	{
+		const __m256 signedUnit = _mm256_sub_ps(_mm256_mul_ps(Unit(hash), _mm256_set1_ps(2.0f)), _mm256_set1_ps(1.0f));
+		return _mm256_add_ps(mean, _mm256_mul_ps(spread, signedUnit));
+	}
+
+	void Avx2Integrate(const ParticleSystem::Streams &s, std::uint32_t begin, std::uint32_t end,
+		const ParticleSystem::Integration &integration, std::uint32_t *dead)
+	{
+		const __m256 dt = _mm256_set1_ps(integration.dt);
+		const __m256 damping = _mm256_set1_ps(integration.damping);
+		const __m256 gx = _mm256_set1_ps(integration.gravity.x * integration.dt);
+		const __m256 gy = _mm256_set1_ps(integration.gravity.y * integration.dt);
+		const __m256 gz = _mm256_set1_ps(integration.gravity.z * integration.dt);
+
+		// Chunks end on multiples of 8 except at the last live particle, so
+		// whole vectors only run past `end` into free space.
+		for (std::uint32_t word = begin; word < end; word += 32)
+		{
+			std::uint32_t bits = 0;
+			for (std::uint32_t lane = 0; lane < 32 && word + lane < end; lane += 8)
+			{
+				const std::uint32_t i = word + lane;
+				const __m256 vx = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(s.velocityX + i), gx), damping);
+				const __m256 vy = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(s.velocityY + i), gy), damping);
+				const __m256 vz = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(s.velocityZ + i), gz), damping);
+				_mm256_storeu_ps(s.velocityX + i, vx);
+				_mm256_storeu_ps(s.velocityY + i, vy);
+				_mm256_storeu_ps(s.velocityZ + i, vz);
+				_mm256_storeu_ps(s.positionX + i, _mm256_fmadd_ps(vx, dt, _mm256_loadu_ps(s.positionX + i)));
+				_mm256_storeu_ps(s.positionY + i, _mm256_fmadd_ps(vy, dt, _mm256_loadu_ps(s.positionY + i)));
+				_mm256_storeu_ps(s.positionZ + i, _mm256_fmadd_ps(vz, dt, _mm256_loadu_ps(s.positionZ + i)));
+
+				const __m256 age = _mm256_add_ps(_mm256_loadu_ps(s.age + i), dt);
+				_mm256_storeu_ps(s.age + i, age);
+				const __m256 over = _mm256_cmp_ps(age, _mm256_loadu_ps(s.lifetime + i), _CMP_NLT_UQ);
+				bits |= (std::uint32_t)_mm256_movemask_ps(over) << lane;
+			}
+			if (end - word < 32)
+			{
+				bits &= (1u << (end - word)) - 1;
+			}
+			dead[(word - begin) / 32] = bits;
+		}
+	}
+
+	void Avx2Emit(const ParticleSystem::Streams &s, std::uint32_t begin, std::uint32_t end,
+		const ParticleSystem::Emission &emission)
+	{
+		const __m256 px = _mm256_set1_ps(emission.position.x);
+		const __m256 py = _mm256_set1_ps(emission.position.y);
+		const __m256 pz = _mm256_set1_ps(emission.position.z);
+		const __m256 vx = _mm256_set1_ps(emission.velocity.x);
+		const __m256 vy = _mm256_set1_ps(emission.velocity.y);
+		const __m256 vz = _mm256_set1_ps(emission.velocity.z);
+		const __m256 spread = _mm256_set1_ps(emission.spread);
+		const __m256 lifetime = _mm256_set1_ps(emission.lifetime);
+		const __m256 size = _mm256_set1_ps(emission.size);
+		const __m256i color = _mm256_set1_epi32((int)emission.color);
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+		// Emission lands next to other chunks' work, so the last vector is
+		// masked rather than run past `end`.
+		for (std::uint32_t i = begin; i < end; i += 8)
+		{
+			const __m256i mask = TailMask(end - i);
+			const __m256i number = _mm256_add_epi32(_mm256_set1_epi32((int)(emission.sequence + (i - begin))), lanes);
+			const __m256i n = _mm256_slli_epi32(number, 2);
+
+			_mm256_maskstore_ps(s.positionX + i, mask, px);
+			_mm256_maskstore_ps(s.positionY + i, mask, py);
+			_mm256_maskstore_ps(s.positionZ + i, mask, pz);
+			_mm256_maskstore_ps(s.velocityX + i, mask, Spread(vx, spread, Hash(n)));
+			_mm256_maskstore_ps(s.velocityY + i, mask, Spread(vy, spread, Hash(_mm256_add_epi32(n, _mm256_set1_epi32(1)))));
+			_mm256_maskstore_ps(s.velocityZ + i, mask, Spread(vz, spread, Hash(_mm256_add_epi32(n, _mm256_set1_epi32(2)))));
+			_mm256_maskstore_ps(s.age + i, mask, _mm256_setzero_ps());
+			const __m256 scale = _mm256_add_ps(_mm256_set1_ps(0.5f), Unit(Hash(_mm256_add_epi32(n, _mm256_set1_epi32(3)))));
+			_mm256_maskstore_ps(s.lifetime + i, mask, _mm256_mul_ps(lifetime, scale));
+			_mm256_maskstore_ps(s.size + i, mask, size);
+			_mm256_maskstore_epi32(reinterpret_cast<int *>(s.color + i), mask, color);
+		}
+	}
+
+	void Avx2Depths(const ParticleSystem::Streams &s, std::uint32_t begin, std::uint32_t end,
+		bkmz::math::Float4 viewDepth, float *depths, float &nearest, float &farthest)
+	{
+		const __m256 dx = _mm256_set1_ps(viewDepth.x);
+		const __m256 dy = _mm256_set1_ps(viewDepth.y);
+		const __m256 dz = _mm256_set1_ps(viewDepth.z);
+		const __m256 dw = _mm256_set1_ps(viewDepth.w);
+		const __m256 infinity = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+		const __m256 negativeInfinity = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+
+		__m256 low = infinity;
+		__m256 high = negativeInfinity;
+		for (std::uint32_t i = begin; i < end; i += 8)
+		{
+			const __m256i mask = TailMask(end - i);
+			const __m256 depth = _mm256_fmadd_ps(_mm256_loadu_ps(s.positionZ + i), dz,
+				_mm256_fmadd_ps(_mm256_loadu_ps(s.positionY + i), dy,
+				_mm256_fmadd_ps(_mm256_loadu_ps(s.positionX + i), dx, dw)));
+			_mm256_maskstore_ps(depths + i, mask, depth);
+
+			const __m256 inside = _mm256_castsi256_ps(mask);
+			low = _mm256_min_ps(low, _mm256_blendv_ps(infinity, depth, inside));
+			high = _mm256_max_ps(high, _mm256_blendv_ps(negativeInfinity, depth, inside));
+		}
+
+		alignas(32) float lows[8];
+		alignas(32) float highs[8];
+		_mm256_store_ps(lows, low);
+		_mm256_store_ps(highs, high);
+		nearest = *std::min_element(lows, lows + 8);
+		farthest = *std::max_element(highs, highs + 8);
+	}
+
+	void Avx2DepthKeys(const float *depths, std::uint32_t begin, std::uint32_t end,
+		float nearest, float scale, std::uint32_t *keys, std::uint32_t *indices)
+	{
+		const __m256 near = _mm256_set1_ps(nearest);
+		const __m256 factor = _mm256_set1_ps(scale);
+		const __m256 top = _mm256_set1_ps((float)ParticleSystem::maxKey);
+		const __m256i maxKey = _mm256_set1_epi32((int)ParticleSystem::maxKey);
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+		for (std::uint32_t i = begin; i < end; i += 8)
+		{
+			const __m256i mask = TailMask(end - i);
+			const __m256 quantized = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(depths + i), near), factor), top);
+			const __m256i key = _mm256_sub_epi32(maxKey, _mm256_cvttps_epi32(quantized));
+			_mm256_maskstore_epi32(reinterpret_cast<int *>(keys + i), mask, key);
+			_mm256_maskstore_epi32(reinterpret_cast<int *>(indices + i), mask, _mm256_add_epi32(_mm256_set1_epi32((int)i), lanes));
+		}
+	}
+
+	const ParticleSystem::Kernels kernels = {
+		Avx2Integrate,
+		Avx2Emit,
+		Avx2Depths,
+		Avx2DepthKeys,
+	};
+}
+
+const ParticleSystem::Kernels *ParticleSystem::Avx2Kernels()
+{
+	return &kernels;
+}
+
+#else
+
+const ParticleSystem::Kernels *ParticleSystem::Avx2Kernels()
+{
+	return nullptr;
+}
+
+#endif
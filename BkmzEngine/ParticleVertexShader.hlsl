@@ -0,0 +1,65 @@
+// Root constants, see Material. objectDataIndex is the particle buffer's
+// registry index for ParticleMaterial.
+cbuffer cbDraw : register(b0)
+{
+    uint objectIndex;
+    uint passConstantsIndex;
+    uint objectDataIndex;
+};
+
+// ParticleMaterial::PassConstants.
+struct PassConstants
+{
+    float4x4 viewProj;
+    float3 cameraRight;
+    float padding0;
+    float3 cameraUp;
+    float padding1;
+};
+
+// ParticleInstance in ParticleSystem.h.
+struct ParticleInstance
+{
+    float3 position;
+    float size;
+    uint color; // RGBA8, red in the low byte
+    float fade;
+};
+
+// The registry heap, see VertexShader.hlsl.
+ConstantBuffer<PassConstants> constantBuffers[] : register(b0, space1);
+StructuredBuffer<ParticleInstance> particleBuffers[] : register(t0, space2);
+
+struct VertexOut
+{
+    float4 posH : SV_POSITION;
+    float4 color : COLOR;
+    float2 corner : TEXCOORD;
+};
+
+// Two clockwise triangles, ParticleMaterial::verticesPerParticle.
+static const float2 corners[6] =
+{
+    float2(-1.0f, -1.0f), float2(-1.0f, 1.0f), float2(1.0f, 1.0f),
+    float2(-1.0f, -1.0f), float2(1.0f, 1.0f), float2(1.0f, -1.0f),
+};
+
+VertexOut VS(uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID)
+{
+    VertexOut vout;
+
+    // Instances are already back to front, see ParticleSystem::Sort.
+    ParticleInstance particle = particleBuffers[objectDataIndex][instanceId];
+    PassConstants pass = constantBuffers[passConstantsIndex];
+
+    float2 corner = corners[vertexId];
+    float3 posW = particle.position + (pass.cameraRight * corner.x + pass.cameraUp * corner.y) * particle.size;
+    vout.posH = mul(float4(posW, 1.0f), pass.viewProj);
+
+    uint4 bytes = uint4(particle.color, particle.color >> 8, particle.color >> 16, particle.color >> 24) & 0xff;
+    vout.color = float4(bytes) / 255.0f;
+    vout.color.a *= particle.fade;
+    vout.corner = corner;
+
+    return vout;
+}
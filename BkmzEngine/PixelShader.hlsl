@@ -1,10 +1,95 @@
+// Root constants, see Material.
+cbuffer cbDraw : register(b0)
+{
+    uint objectIndex;
+    uint passConstantsIndex;
+    uint objectDataIndex;
+};
+
+// DefaultMaterial::PassConstants.
+struct PassConstants
+{
+    float4x4 viewProj;
+    float4 viewDepth;
+    float2 clusterTileScale;
+    float clusterSliceScale;
+    float clusterSliceBias;
+    uint clusterTilesX;
+    uint clusterTilesY;
+    uint clusterSlices;
+    uint lightCount;
+    uint lightsIndex;
+    uint clusterRangesIndex;
+    uint lightIndicesIndex;
+    uint padding;
+    float3 ambient;
+    float padding2;
+};
+
+// Light in LightClusters.h.
+struct Light
+{
+    float3 position;
+    float range;
+    float3 color;
+    uint type; // 0 point, 1 spot
+    float3 direction;
+    float cosOuterAngle;
+};
+
+// The registry heap again, see VertexShader.hlsl and Material.
+ConstantBuffer<PassConstants> constantBuffers[] : register(b0, space1);
+StructuredBuffer<Light> lightBuffers[] : register(t0, space4);
+StructuredBuffer<uint> uintBuffers[] : register(t0, space5);
+
 struct VertexOut
 {
     float4 posH : SV_POSITION;
     float4 color : COLOR;
+    float3 posW : POSITION;
+    float depth : VIEWDEPTH;
 };
 
+float3 Shade(Light light, float3 posW, float3 normal)
+{
+    float3 toLight = light.position - posW;
+    float distanceSq = dot(toLight, toLight);
+    float3 l = toLight * rsqrt(max(distanceSq, 1e-8f));
+
+    // Inverse square, windowed to reach zero at the light's range.
+    float ratio = distanceSq / (light.range * light.range);
+    float window = saturate(1.0f - ratio * ratio);
+    float attenuation = window * window / (distanceSq + 1.0f);
+
+    if (light.type == 1)
+    {
+        float cosAngle = dot(-l, light.direction);
+        attenuation *= saturate((cosAngle - light.cosOuterAngle) * 10.0f);
+    }
+
+    return light.color * (saturate(dot(normal, l)) * attenuation);
+}
+
 float4 PS(VertexOut pin) : SV_TARGET
 {
-	return pin.color;
-}
\ No newline at end of file
+    PassConstants pass = constantBuffers[passConstantsIndex];
+
+    // Meshes carry no normals, faces are lit flat.
+    float3 normal = normalize(cross(ddx(pin.posW), ddy(pin.posW)));
+
+    // Only the lights binned into this pixel's cluster, see LightClusters.
+    uint2 tile = min(uint2(pin.posH.xy * pass.clusterTileScale), uint2(pass.clusterTilesX, pass.clusterTilesY) - 1);
+    uint slice = (uint)clamp(floor(log(pin.depth) * pass.clusterSliceScale + pass.clusterSliceBias), 0.0f, pass.clusterSlices - 1.0f);
+    uint cluster = (slice * pass.clusterTilesY + tile.y) * pass.clusterTilesX + tile.x;
+
+    float3 lighting = pass.ambient;
+    uint offset = uintBuffers[pass.clusterRangesIndex][cluster * 2];
+    uint count = uintBuffers[pass.clusterRangesIndex][cluster * 2 + 1];
+    for (uint i = 0; i < count; i++)
+    {
+        uint light = uintBuffers[pass.lightIndicesIndex][offset + i];
+        lighting += Shade(lightBuffers[pass.lightsIndex][light], pin.posW, normal);
+    }
+
+    return float4(pin.color.rgb * lighting, pin.color.a);
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include "HandlePool.h"
+
+// Handles to the renderer's resources, see HandlePool.h. The tags only
+// tell the handle types apart, so components and snapshots can hold these
+// without including anything D3D.
+struct MeshResource;
+struct MaterialResource;
+struct PipelineResource;
+
+using MeshHandle = Handle<MeshResource>;
+using MaterialHandle = Handle<MaterialResource>;
+using PipelineHandle = Handle<PipelineResource>;
@@ -0,0 +1,87 @@
+#include "ResourceRegistry.h"
+#include "DXErrors.h"
+#include "d3dx12.h"
+#include <stdexcept>
+
+void ResourceRegistry::Create(ID3D12Device *device, UINT capacity)
+{
+	this->device = device;
+	this->capacity = capacity;
+
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = capacity;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	heapDesc.NodeMask = 0;
+
+	DX_CALL(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(heap.GetAddressOf())));
+	descriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	nextIndex = 0;
+	freeIndices.clear();
+}
+
+UINT ResourceRegistry::AddConstantBuffer(D3D12_GPU_VIRTUAL_ADDRESS address, UINT byteSize)
+{
+	const UINT index = Allocate();
+
+	D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
+	cbvDesc.BufferLocation = address;
+	cbvDesc.SizeInBytes = byteSize;
+	device->CreateConstantBufferView(&cbvDesc, CpuHandle(index));
+
+	return index;
+}
+
+UINT ResourceRegistry::AddStructuredBuffer(ID3D12Resource *buffer, UINT elementCount, UINT stride)
+{
+	const UINT index = Allocate();
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = elementCount;
+	srvDesc.Buffer.StructureByteStride = stride;
+	srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
+	device->CreateShaderResourceView(buffer, &srvDesc, CpuHandle(index));
+
+	return index;
+}
+
+UINT ResourceRegistry::AddTexture(ID3D12Resource *texture, const D3D12_SHADER_RESOURCE_VIEW_DESC *desc)
+{
+	const UINT index = Allocate();
+	device->CreateShaderResourceView(texture, desc, CpuHandle(index));
+	return index;
+}
+
+void ResourceRegistry::Remove(UINT index)
+{
+	if (index != invalidIndex && index < nextIndex)
+	{
+		freeIndices.push_back(index);
+	}
+}
+
+UINT ResourceRegistry::Allocate()
+{
+	if (!freeIndices.empty())
+	{
+		const UINT index = freeIndices.back();
+		freeIndices.pop_back();
+		return index;
+	}
+
+	if (nextIndex == capacity)
+	{
+		throw std::runtime_error("Resource descriptor heap is full.");
+	}
+	return nextIndex++;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE ResourceRegistry::CpuHandle(UINT index) const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(heap->GetCPUDescriptorHandleForHeapStart(), index, descriptorSize);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <d3d12.h>
+#include <wrl.h>
+#include <vector>
+
+// The one shader visible CBV/SRV/UAV heap, shared by every material.
+//
+// Shaders see the whole heap through unbounded arrays (see Material's root
+// signature) and pick resources by index, so adding a resource never
+// changes a root signature: register it here and pass the index along,
+// usually as a root constant. An index stays the same for as long as the
+// resource is registered.
+class ResourceRegistry
+{
+public:
+	static constexpr UINT invalidIndex = ~0u;
+
+	void Create(ID3D12Device *device, UINT capacity);
+
+	UINT AddConstantBuffer(D3D12_GPU_VIRTUAL_ADDRESS address, UINT byteSize);
+	UINT AddStructuredBuffer(ID3D12Resource *buffer, UINT elementCount, UINT stride);
+
+	// With no desc, the view covers the whole texture in its own format.
+	UINT AddTexture(ID3D12Resource *texture, const D3D12_SHADER_RESOURCE_VIEW_DESC *desc = nullptr);
+
+	// The index may be handed out again by the next Add. Only call this once
+	// the GPU is done with everything that used the index.
+	void Remove(UINT index);
+
+	ID3D12DescriptorHeap *Heap() const { return heap.Get(); }
+	D3D12_GPU_DESCRIPTOR_HANDLE TableStart() const { return heap->GetGPUDescriptorHandleForHeapStart(); }
+
+	UINT Count() const { return nextIndex - (UINT)freeIndices.size(); }
+
+private:
+	UINT Allocate();
+	D3D12_CPU_DESCRIPTOR_HANDLE CpuHandle(UINT index) const;
+
+private:
+	ID3D12Device *device = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> heap;
+	UINT descriptorSize = 0;
+	UINT capacity = 0;
+
+	UINT nextIndex = 0;
+	std::vector<UINT> freeIndices;
+};
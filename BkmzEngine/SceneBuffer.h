@@ -0,0 +1,123 @@
+#pragma once
+#include <d3d12.h>
+#include "Utils.h"
+#include "TrackedBuffer.h"
+
+// Per-object data that stays on the GPU between frames, read by shaders as
+// a structured buffer.
+//
+// Set() only writes the CPU copy. RecordUploads() then copies the elements
+// that changed into a persistently mapped upload buffer and records one
+// CopyBufferRegion per run, so the bytes moved each frame follow the number
+// of changed objects rather than the total.
+template <typename T>
+class SceneBuffer
+{
+public:
+	~SceneBuffer()
+	{
+		if (uploader && mappedData)
+		{
+			uploader->Unmap(0, nullptr);
+			mappedData = nullptr;
+		}
+	}
+
+	void Create(ID3D12Device *device, UINT capacity)
+	{
+		objects.Resize(capacity);
+
+		const UINT64 byteSize = (UINT64)(std::max)(capacity, 1u) * sizeof(T);
+
+		CD3DX12_HEAP_PROPERTIES defaultHeap(D3D12_HEAP_TYPE_DEFAULT);
+		auto desc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+		DX_CALL(device->CreateCommittedResource(
+			&defaultHeap,
+			D3D12_HEAP_FLAG_NONE,
+			&desc,
+			D3D12_RESOURCE_STATE_COMMON,
+			nullptr,
+			IID_PPV_ARGS(&buffer)
+		));
+		state = D3D12_RESOURCE_STATE_COMMON;
+
+		// Gather never stages more than every element once.
+		CD3DX12_HEAP_PROPERTIES uploadHeap(D3D12_HEAP_TYPE_UPLOAD);
+		DX_CALL(device->CreateCommittedResource(
+			&uploadHeap,
+			D3D12_HEAP_FLAG_NONE,
+			&desc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&uploader)
+		));
+
+		DX_CALL(uploader->Map(0, nullptr, reinterpret_cast<void **>(&mappedData)));
+	}
+
+	void Set(UINT index, const T &value)
+	{
+		objects.Set(index, value);
+	}
+
+	const T &Get(UINT index) const
+	{
+		return objects[index];
+	}
+
+	// Records the copies for everything Set since the last call and returns
+	// the number of bytes uploaded. The upload buffer is reused every frame,
+	// which relies on Draw waiting for the GPU at the end of the frame.
+	UINT64 RecordUploads(ID3D12GraphicsCommandList *commandList)
+	{
+		if (objects.PendingCount() == 0)
+		{
+			return 0;
+		}
+
+		const auto runs = objects.Gather(mappedData);
+
+		Transition(commandList, D3D12_RESOURCE_STATE_COPY_DEST);
+
+		UINT64 bytes = 0;
+		for (const UploadRun &run : runs)
+		{
+			commandList->CopyBufferRegion(
+				buffer.Get(), (UINT64)run.first * sizeof(T),
+				uploader.Get(), (UINT64)run.stagingFirst * sizeof(T),
+				(UINT64)run.count * sizeof(T)
+			);
+			bytes += (UINT64)run.count * sizeof(T);
+		}
+
+		Transition(commandList, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		return bytes;
+	}
+
+	// For a structured buffer view, see ResourceRegistry.
+	ID3D12Resource *Resource() const
+	{
+		return buffer.Get();
+	}
+
+	UINT Capacity() const
+	{
+		return objects.Size();
+	}
+
+private:
+	void Transition(ID3D12GraphicsCommandList *commandList, D3D12_RESOURCE_STATES to)
+	{
+		auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(buffer.Get(), state, to);
+		commandList->ResourceBarrier(1, &barrier);
+		state = to;
+	}
+
+private:
+	TrackedBuffer<T> objects;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+	Microsoft::WRL::ComPtr<ID3D12Resource> uploader;
+	T *mappedData = nullptr;
+	D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON;
+};
@@ -0,0 +1,385 @@
+#include "SceneFile.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace bkmz::math;
+
+namespace
+{
+	std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	std::uint32_t FindOrAdd(std::vector<std::string> &names, std::string_view name)
+	{
+		// Scenes reference few distinct names, and mostly the same one as
+		// the object before.
+		for (std::size_t i = names.size(); i-- > 0;)
+		{
+			if (names[i] == name)
+			{
+				return (std::uint32_t)i;
+			}
+		}
+		names.emplace_back(name);
+		return (std::uint32_t)(names.size() - 1);
+	}
+
+	// Whitespace separated words of one line.
+	class Tokens
+	{
+	public:
+		Tokens(std::string_view line, std::size_t lineNumber) : line(line), lineNumber(lineNumber) {}
+
+		bool Done()
+		{
+			SkipSpace();
+			return line.empty();
+		}
+
+		std::string_view Word()
+		{
+			SkipSpace();
+			std::size_t end = 0;
+			while (end < line.size() && !IsSpace(line[end]))
+			{
+				end++;
+			}
+			if (end == 0)
+			{
+				Fail("more values expected");
+			}
+			const std::string_view word = line.substr(0, end);
+			line.remove_prefix(end);
+			return word;
+		}
+
+		bool NextIsNumber()
+		{
+			SkipSpace();
+			return !line.empty() && (std::isdigit((unsigned char)line[0]) || line[0] == '-' || line[0] == '+' || line[0] == '.');
+		}
+
+		float Float()
+		{
+			const std::string_view word = Word();
+			const std::string_view digits = word[0] == '+' ? word.substr(1) : word;
+			float value;
+			const auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+			if (error != std::errc() || end != digits.data() + digits.size())
+			{
+				Fail("not a number: " + std::string(word));
+			}
+			return value;
+		}
+
+		std::uint32_t Index()
+		{
+			const std::string_view word = Word();
+			std::uint32_t value;
+			const auto [end, error] = std::from_chars(word.data(), word.data() + word.size(), value);
+			if (error != std::errc() || end != word.data() + word.size())
+			{
+				Fail("not an index: " + std::string(word));
+			}
+			return value;
+		}
+
+		[[noreturn]] void Fail(const std::string &message) const
+		{
+			throw std::runtime_error("Scene line " + std::to_string(lineNumber) + ": " + message);
+		}
+
+	private:
+		static bool IsSpace(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		void SkipSpace()
+		{
+			while (!line.empty() && IsSpace(line[0]))
+			{
+				line.remove_prefix(1);
+			}
+		}
+
+	private:
+		std::string_view line;
+		std::size_t lineNumber;
+	};
+
+	void ParseObject(SceneDescription &scene, Tokens &tokens)
+	{
+		const std::string_view mesh = tokens.Word();
+		const std::string_view material = tokens.Word();
+
+		Transform local;
+		std::uint32_t parent = SceneDescription::noParent;
+		float spin = 0.0f;
+		while (!tokens.Done())
+		{
+			const std::string_view key = tokens.Word();
+			if (key == "position")
+			{
+				local.position.x = tokens.Float();
+				local.position.y = tokens.Float();
+				local.position.z = tokens.Float();
+			}
+			else if (key == "rotation")
+			{
+				constexpr float toRadians = pi / 180.0f;
+				const float pitch = tokens.Float() * toRadians;
+				const float yaw = tokens.Float() * toRadians;
+				const float roll = tokens.Float() * toRadians;
+				local.rotation = QuaternionRotationRollPitchYaw(pitch, yaw, roll);
+			}
+			else if (key == "scale")
+			{
+				local.scale.x = tokens.Float();
+				if (tokens.NextIsNumber())
+				{
+					local.scale.y = tokens.Float();
+					local.scale.z = tokens.Float();
+				}
+				else
+				{
+					local.scale.y = local.scale.z = local.scale.x;
+				}
+			}
+			else if (key == "spin")
+			{
+				spin = tokens.Float() * (pi / 180.0f);
+			}
+			else if (key == "parent")
+			{
+				parent = tokens.Index();
+				if (parent >= scene.Size())
+				{
+					tokens.Fail("a parent must be an earlier object");
+				}
+			}
+			else
+			{
+				tokens.Fail("unknown object property " + std::string(key));
+			}
+		}
+
+		scene.Add(local, mesh, material, parent, spin);
+	}
+}
+
+std::uint32_t SceneDescription::Add(const Transform &local, std::string_view mesh, std::string_view material, std::uint32_t parent, float spin)
+{
+	if (parent != noParent && parent >= Size())
+	{
+		throw std::runtime_error("Scene object parent must be added first.");
+	}
+
+	transforms.push_back(local);
+	parents.push_back(parent);
+	meshes.push_back(FindOrAdd(meshNames, mesh));
+	materials.push_back(FindOrAdd(materialNames, material));
+	spins.push_back(spin);
+	return Size() - 1;
+}
+
+SceneDescription ParseSceneText(std::string_view text)
+{
+	SceneDescription scene;
+	std::size_t lineNumber = 0;
+	while (!text.empty())
+	{
+		const std::size_t end = (std::min)(text.find('\n'), text.size());
+		std::string_view line = text.substr(0, end);
+		text.remove_prefix((std::min)(end + 1, text.size()));
+		lineNumber++;
+
+		line = line.substr(0, line.find('#'));
+		Tokens tokens(line, lineNumber);
+		if (tokens.Done())
+		{
+			continue;
+		}
+
+		const std::string_view keyword = tokens.Word();
+		if (keyword == "object")
+		{
+			ParseObject(scene, tokens);
+		}
+		else
+		{
+			tokens.Fail("unknown keyword " + std::string(keyword));
+		}
+	}
+	return scene;
+}
+
+SceneDescription LoadSceneText(const std::string &path)
+{
+	const std::vector<std::uint8_t> text = File::ReadAll(path);
+	return ParseSceneText({ reinterpret_cast<const char *>(text.data()), text.size() });
+}
+
+std::vector<std::uint8_t> CompileScene(const SceneDescription &scene)
+{
+	const std::uint32_t count = scene.Size();
+
+	std::vector<std::uint32_t> depths(count);
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		const std::uint32_t parent = scene.parents[i];
+		depths[i] = parent == SceneDescription::noParent ? 0 : depths[parent] + 1;
+	}
+
+	std::vector<std::uint32_t> order(count);
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&depths](std::uint32_t a, std::uint32_t b)
+	{
+		return depths[a] < depths[b];
+	});
+
+	std::vector<std::uint32_t> newIndex(count);
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		newIndex[order[i]] = i;
+	}
+
+	std::string names;
+	std::vector<std::uint32_t> nameOffsets;
+	for (const auto *list : { &scene.meshNames, &scene.materialNames })
+	{
+		for (const std::string &name : *list)
+		{
+			nameOffsets.push_back((std::uint32_t)names.size());
+			names += name;
+		}
+	}
+	nameOffsets.push_back((std::uint32_t)names.size());
+
+	SceneFileHeader header = {};
+	header.magic = SceneFileHeader::magicValue;
+	header.version = SceneFileHeader::currentVersion;
+	header.objectCount = count;
+	header.meshCount = (std::uint32_t)scene.meshNames.size();
+	header.materialCount = (std::uint32_t)scene.materialNames.size();
+	header.namesSize = (std::uint32_t)names.size();
+	header.transformsOffset = AlignUp(sizeof(header), 16);
+	header.parentsOffset = AlignUp(header.transformsOffset + (std::uint64_t)count * sizeof(Transform), 16);
+	header.meshesOffset = AlignUp(header.parentsOffset + (std::uint64_t)count * 4, 16);
+	header.materialsOffset = AlignUp(header.meshesOffset + (std::uint64_t)count * 4, 16);
+	header.spinsOffset = AlignUp(header.materialsOffset + (std::uint64_t)count * 4, 16);
+	header.nameOffsetsOffset = AlignUp(header.spinsOffset + (std::uint64_t)count * 4, 16);
+	header.namesOffset = header.nameOffsetsOffset + nameOffsets.size() * 4;
+	header.fileSize = header.namesOffset + names.size();
+
+	std::vector<std::uint8_t> bytes((std::size_t)header.fileSize, 0);
+	std::memcpy(bytes.data(), &header, sizeof(header));
+
+	auto *transforms = reinterpret_cast<Transform *>(bytes.data() + header.transformsOffset);
+	auto *parents = reinterpret_cast<std::uint32_t *>(bytes.data() + header.parentsOffset);
+	auto *meshes = reinterpret_cast<std::uint32_t *>(bytes.data() + header.meshesOffset);
+	auto *materials = reinterpret_cast<std::uint32_t *>(bytes.data() + header.materialsOffset);
+	auto *spins = reinterpret_cast<float *>(bytes.data() + header.spinsOffset);
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		const std::uint32_t from = order[i];
+		const std::uint32_t parent = scene.parents[from];
+		transforms[i] = scene.transforms[from];
+		parents[i] = parent == SceneDescription::noParent ? parent : newIndex[parent];
+		meshes[i] = scene.meshes[from];
+		materials[i] = scene.materials[from];
+		spins[i] = scene.spins[from];
+	}
+
+	std::memcpy(bytes.data() + header.nameOffsetsOffset, nameOffsets.data(), nameOffsets.size() * 4);
+	std::memcpy(bytes.data() + header.namesOffset, names.data(), names.size());
+	return bytes;
+}
+
+void WriteCompiledScene(const SceneDescription &scene, const std::string &path)
+{
+	const std::vector<std::uint8_t> bytes = CompileScene(scene);
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char *>(bytes.data()), (std::streamsize)bytes.size());
+	if (!out.flush())
+	{
+		throw std::runtime_error("Can't write " + path);
+	}
+}
+
+SceneView::SceneView(std::span<const std::uint8_t> bytes)
+{
+	SceneFileHeader header;
+	if (bytes.size() < sizeof(header))
+	{
+		throw std::runtime_error("Not a compiled scene.");
+	}
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	if (header.magic != SceneFileHeader::magicValue || header.version != SceneFileHeader::currentVersion)
+	{
+		throw std::runtime_error("Not a compiled scene, or one from another version.");
+	}
+
+	const std::uint64_t count = header.objectCount;
+	const std::uint64_t nameCount = (std::uint64_t)header.meshCount + header.materialCount + 1;
+	auto fits = [&bytes](std::uint64_t offset, std::uint64_t size)
+	{
+		return offset % 4 == 0 && offset <= bytes.size() && size <= bytes.size() - offset;
+	};
+	if (header.fileSize != bytes.size() ||
+		!fits(header.transformsOffset, count * sizeof(Transform)) ||
+		!fits(header.parentsOffset, count * 4) ||
+		!fits(header.meshesOffset, count * 4) ||
+		!fits(header.materialsOffset, count * 4) ||
+		!fits(header.spinsOffset, count * 4) ||
+		!fits(header.nameOffsetsOffset, nameCount * 4) ||
+		!fits(header.namesOffset, header.namesSize))
+	{
+		throw std::runtime_error("Compiled scene is damaged.");
+	}
+
+	const std::uint8_t *data = bytes.data();
+	transforms = { reinterpret_cast<const Transform *>(data + header.transformsOffset), (std::size_t)count };
+	parents = { reinterpret_cast<const std::uint32_t *>(data + header.parentsOffset), (std::size_t)count };
+	meshes = { reinterpret_cast<const std::uint32_t *>(data + header.meshesOffset), (std::size_t)count };
+	materials = { reinterpret_cast<const std::uint32_t *>(data + header.materialsOffset), (std::size_t)count };
+	spins = { reinterpret_cast<const float *>(data + header.spinsOffset), (std::size_t)count };
+	nameOffsets = { reinterpret_cast<const std::uint32_t *>(data + header.nameOffsetsOffset), (std::size_t)nameCount };
+	names = reinterpret_cast<const char *>(data + header.namesOffset);
+	meshCount = header.meshCount;
+	materialCount = header.materialCount;
+
+	// Flags are accumulated rather than branched on, keeping the pass as
+	// fast as streaming the arrays through the cache.
+	bool bad = nameOffsets.back() > header.namesSize || !std::is_sorted(nameOffsets.begin(), nameOffsets.end());
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		bad |= (parents[i] >= i) & (parents[i] != SceneDescription::noParent);
+		bad |= meshes[i] >= meshCount;
+		bad |= materials[i] >= materialCount;
+	}
+	if (bad)
+	{
+		throw std::runtime_error("Compiled scene is damaged.");
+	}
+}
+
+std::string_view SceneView::Name(std::uint32_t index) const
+{
+	return { names + nameOffsets[index], nameOffsets[index + 1] - nameOffsets[index] };
+}
+
+SceneFile::SceneFile(const std::string &path)
+	: file(path)
+{
+	view = SceneView(file.Bytes());
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "FileIo.h"
+#include "Transform.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Scene description: objects with a local transform, an optional parent,
+// a mesh and a material, the last two by name, and a spin for objects the
+// simulation turns.
+//
+// The text form is for editing by hand, one object per line:
+//
+//   # comment
+//   object <mesh> <material> [position x y z] [rotation pitch yaw roll]
+//          [scale s | scale x y z] [parent <object>] [spin <speed>]
+//
+// Rotations are in degrees, applied like QuaternionRotationRollPitchYaw.
+// Spin is around the Y axis in degrees per second, objects without one are
+// static.
+// A parent is the 0-based index of an earlier object line.
+//
+// The compiled form (see CompileScene) holds the same data as flat arrays
+// that are used in place from a memory mapping, see SceneView.
+struct SceneDescription
+{
+	static constexpr std::uint32_t noParent = ~0u;
+
+	// By object, parents always come before their children.
+	std::vector<Transform> transforms;
+	std::vector<std::uint32_t> parents;
+	std::vector<std::uint32_t> meshes;    // into meshNames
+	std::vector<std::uint32_t> materials; // into materialNames
+	std::vector<float> spins;             // radians per second, 0 if static
+
+	std::vector<std::string> meshNames;
+	std::vector<std::string> materialNames;
+
+	std::uint32_t Size() const { return (std::uint32_t)transforms.size(); }
+
+	// Returns the object's index. Names are added on first use.
+	std::uint32_t Add(const Transform &local, std::string_view mesh, std::string_view material, std::uint32_t parent = noParent, float spin = 0.0f);
+};
+
+// Throws with the line number on malformed input.
+SceneDescription ParseSceneText(std::string_view text);
+SceneDescription LoadSceneText(const std::string &path);
+
+// Objects are reordered by depth, roots first, which is the order
+// SceneGraph keeps them in, so loading never has to sort.
+std::vector<std::uint8_t> CompileScene(const SceneDescription &scene);
+void WriteCompiledScene(const SceneDescription &scene, const std::string &path);
+
+struct SceneFileHeader
+{
+	static constexpr std::uint32_t magicValue = 0x43534b42; // "BKSC"
+	static constexpr std::uint32_t currentVersion = 2;
+
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint32_t objectCount;
+	std::uint32_t meshCount;
+	std::uint32_t materialCount;
+	std::uint32_t namesSize;
+	std::uint64_t fileSize;
+	// Byte offsets of the arrays, each 16 byte aligned.
+	std::uint64_t transformsOffset;
+	std::uint64_t parentsOffset;
+	std::uint64_t meshesOffset;
+	std::uint64_t materialsOffset;
+	std::uint64_t spinsOffset;
+	std::uint64_t nameOffsetsOffset; // meshCount + materialCount + 1 of them
+	std::uint64_t namesOffset;
+};
+
+static_assert(sizeof(Transform) == 40, "Transform is stored as is in compiled scenes.");
+
+// A compiled scene. Doesn't own the bytes, which must outlive it.
+class SceneView
+{
+public:
+	SceneView() = default;
+
+	// Validates every index once, so users can trust them. Throws on
+	// damaged data.
+	explicit SceneView(std::span<const std::uint8_t> bytes);
+
+	std::uint32_t Size() const { return (std::uint32_t)transforms.size(); }
+
+	std::span<const Transform> Transforms() const { return transforms; }
+	std::span<const std::uint32_t> Parents() const { return parents; }
+	std::span<const std::uint32_t> Meshes() const { return meshes; }
+	std::span<const std::uint32_t> Materials() const { return materials; }
+	std::span<const float> Spins() const { return spins; }
+
+	std::uint32_t MeshCount() const { return meshCount; }
+	std::uint32_t MaterialCount() const { return materialCount; }
+	std::string_view MeshName(std::uint32_t mesh) const { return Name(mesh); }
+	std::string_view MaterialName(std::uint32_t material) const { return Name(meshCount + material); }
+
+private:
+	std::string_view Name(std::uint32_t index) const;
+
+private:
+	std::span<const Transform> transforms;
+	std::span<const std::uint32_t> parents;
+	std::span<const std::uint32_t> meshes;
+	std::span<const std::uint32_t> materials;
+	std::span<const float> spins;
+	std::span<const std::uint32_t> nameOffsets;
+	const char *names = nullptr;
+	std::uint32_t meshCount = 0;
+	std::uint32_t materialCount = 0;
+};
+
+// A compiled scene file, mapped into memory.
+class SceneFile
+{
+public:
+	SceneFile() = default;
+	explicit SceneFile(const std::string &path);
+
+	const SceneView &View() const { return view; }
+
+private:
+	MappedFile file;
+	SceneView view;
+};
@@ -0,0 +1,351 @@
+#include "SceneGraph.h"
+#include <algorithm>
+#include <type_traits>
+#include <stdexcept>
+
+using namespace bkmz::math;
+
+SceneGraph::NodeId SceneGraph::Create(const Transform &local, NodeId parent)
+{
+	std::uint32_t parentIndex = noIndex;
+	if (parent != noNode)
+	{
+		parentIndex = IndexOf(parent);
+		if (parentIndex == noIndex)
+		{
+			throw std::runtime_error("Scene node parent doesn't exist.");
+		}
+	}
+
+	NodeId id;
+	if (!freeIds.empty())
+	{
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+	else
+	{
+		id = (NodeId)slots.size();
+		slots.push_back(noIndex);
+	}
+
+	const std::uint32_t depth = parentIndex == noIndex ? 0 : depths[parentIndex] + 1;
+	if (!depths.empty() && depth < depths.back())
+	{
+		needsRebuild = true;
+	}
+
+	const std::uint32_t index = (std::uint32_t)ids.size();
+	slots[id] = index;
+	ids.push_back(id);
+	parents.push_back(parentIndex);
+	depths.push_back(depth);
+	locals.push_back(local);
+	worlds.push_back(Float4x4::Identity());
+	dirty.push_back(0);
+	moved.push_back(0);
+	MarkDirty(index);
+	return id;
+}
+
+SceneGraph::NodeId SceneGraph::CreateBatch(std::span<const Transform> locals, std::span<const std::uint32_t> parents)
+{
+	const std::uint32_t count = (std::uint32_t)locals.size();
+	if (parents.size() != count)
+	{
+		throw std::runtime_error("Scene node batch needs a parent for every node.");
+	}
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		if (parents[i] != noNode && parents[i] >= i)
+		{
+			throw std::runtime_error("Scene node parent doesn't come before the node.");
+		}
+	}
+
+	// Fresh ids rather than recycled ones, so the batch stays one range.
+	const NodeId first = (NodeId)slots.size();
+	const std::uint32_t base = (std::uint32_t)ids.size();
+	if (count == 0)
+	{
+		return first;
+	}
+
+	slots.resize(slots.size() + count);
+	ids.resize(base + count);
+	this->parents.resize(base + count);
+	depths.resize(base + count);
+	this->locals.insert(this->locals.end(), locals.begin(), locals.end());
+	worlds.resize(base + count, Float4x4::Identity());
+	dirty.resize(base + count, 1);
+	moved.resize(base + count, 0);
+
+	std::uint32_t previousDepth = base == 0 ? 0 : depths[base - 1];
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		const std::uint32_t index = base + i;
+		const std::uint32_t parent = parents[i] == noNode ? noIndex : base + parents[i];
+		const std::uint32_t depth = parent == noIndex ? 0 : depths[parent] + 1;
+		if (depth < previousDepth)
+		{
+			needsRebuild = true;
+		}
+		previousDepth = depth;
+
+		slots[first + i] = index;
+		ids[index] = first + i;
+		this->parents[index] = parent;
+		depths[index] = depth;
+	}
+
+	firstDirty = (std::min)(firstDirty, base);
+	return first;
+}
+
+void SceneGraph::Destroy(NodeId node)
+{
+	if (!IsAlive(node))
+	{
+		return;
+	}
+
+	// Descendants are found in one pass below, which needs parents to come
+	// before their children. Only reparenting breaks that.
+	if (orderBroken)
+	{
+		Rebuild();
+	}
+
+	const std::uint32_t index = IndexOf(node);
+	ids[index] = noNode;
+	slots[node] = noIndex;
+	freeIds.push_back(node);
+
+	for (std::uint32_t i = index + 1; i < ids.size(); i++)
+	{
+		if (ids[i] != noNode && parents[i] != noIndex && ids[parents[i]] == noNode)
+		{
+			slots[ids[i]] = noIndex;
+			freeIds.push_back(ids[i]);
+			ids[i] = noNode;
+		}
+	}
+
+	needsRebuild = true;
+}
+
+void SceneGraph::Clear()
+{
+	ids.clear();
+	parents.clear();
+	depths.clear();
+	locals.clear();
+	worlds.clear();
+	dirty.clear();
+	moved.clear();
+	slots.clear();
+	freeIds.clear();
+	changed.clear();
+	firstDirty = noIndex;
+	needsRebuild = false;
+	orderBroken = false;
+}
+
+void SceneGraph::SetParent(NodeId node, NodeId parent)
+{
+	const std::uint32_t index = IndexOf(node);
+	if (index == noIndex)
+	{
+		return;
+	}
+
+	std::uint32_t parentIndex = noIndex;
+	if (parent != noNode)
+	{
+		parentIndex = IndexOf(parent);
+		if (parentIndex == noIndex || parent == node || IsDescendant(parent, node))
+		{
+			throw std::runtime_error("Invalid scene node parent.");
+		}
+	}
+
+	parents[index] = parentIndex;
+	needsRebuild = true;
+	orderBroken = true;
+	MarkDirty(index);
+}
+
+void SceneGraph::SetLocal(NodeId node, const Transform &local)
+{
+	const std::uint32_t index = IndexOf(node);
+	if (index == noIndex)
+	{
+		return;
+	}
+
+	locals[index] = local;
+	MarkDirty(index);
+}
+
+bool SceneGraph::IsAlive(NodeId node) const
+{
+	return IndexOf(node) != noIndex;
+}
+
+SceneGraph::NodeId SceneGraph::Parent(NodeId node) const
+{
+	const std::uint32_t index = IndexOf(node);
+	if (index == noIndex || parents[index] == noIndex)
+	{
+		return noNode;
+	}
+	return ids[parents[index]];
+}
+
+const Transform &SceneGraph::Local(NodeId node) const
+{
+	return locals[IndexOf(node)];
+}
+
+const Float4x4 &SceneGraph::World(NodeId node) const
+{
+	return worlds[IndexOf(node)];
+}
+
+const std::vector<SceneGraph::NodeId> &SceneGraph::Update()
+{
+	if (needsRebuild)
+	{
+		Rebuild();
+	}
+
+	changed.clear();
+	if (firstDirty == noIndex)
+	{
+		return changed;
+	}
+
+	// Nothing before the first dirty node can change, and since parents come
+	// first, a node only needs its parent's moved flag to know whether it's
+	// affected by a change further up.
+	const std::uint32_t count = (std::uint32_t)ids.size();
+	for (std::uint32_t i = firstDirty; i < count; i++)
+	{
+		const std::uint32_t parent = parents[i];
+		if (!dirty[i] && (parent == noIndex || !moved[parent]))
+		{
+			continue;
+		}
+
+		dirty[i] = 0;
+		moved[i] = 1;
+
+		const Float4x4 local = locals[i].Matrix();
+		worlds[i] = parent == noIndex ? local : Multiply(local, worlds[parent]);
+		changed.push_back(ids[i]);
+	}
+
+	// Leave moved all clear for the next Update.
+	for (NodeId id : changed)
+	{
+		moved[slots[id]] = 0;
+	}
+
+	firstDirty = noIndex;
+	return changed;
+}
+
+std::uint32_t SceneGraph::IndexOf(NodeId node) const
+{
+	return node < slots.size() ? slots[node] : noIndex;
+}
+
+bool SceneGraph::IsDescendant(NodeId node, NodeId ancestor) const
+{
+	const std::uint32_t ancestorIndex = IndexOf(ancestor);
+	for (std::uint32_t i = parents[IndexOf(node)]; i != noIndex; i = parents[i])
+	{
+		if (i == ancestorIndex)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void SceneGraph::MarkDirty(std::uint32_t index)
+{
+	dirty[index] = 1;
+	firstDirty = (std::min)(firstDirty, index);
+}
+
+void SceneGraph::Rebuild()
+{
+	const std::uint32_t count = (std::uint32_t)ids.size();
+
+	// Depths from scratch, parents may currently come after their children.
+	std::vector<std::uint32_t> order;
+	order.reserve(count);
+	for (std::uint32_t i = 0; i < count; i++)
+	{
+		if (ids[i] == noNode)
+		{
+			continue;
+		}
+
+		std::uint32_t depth = 0;
+		for (std::uint32_t p = parents[i]; p != noIndex; p = parents[p])
+		{
+			depth++;
+		}
+		depths[i] = depth;
+		order.push_back(i);
+	}
+
+	std::stable_sort(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b)
+	{
+		return depths[a] < depths[b];
+	});
+
+	std::vector<std::uint32_t> newIndex(count, noIndex);
+	for (std::uint32_t i = 0; i < order.size(); i++)
+	{
+		newIndex[order[i]] = i;
+	}
+
+	auto permute = [&order](auto &values)
+	{
+		std::remove_reference_t<decltype(values)> sorted;
+		sorted.reserve(order.size());
+		for (std::uint32_t i : order)
+		{
+			sorted.push_back(values[i]);
+		}
+		values.swap(sorted);
+	};
+
+	permute(ids);
+	permute(parents);
+	permute(depths);
+	permute(locals);
+	permute(worlds);
+	permute(dirty);
+	moved.assign(order.size(), 0);
+
+	firstDirty = noIndex;
+	for (std::uint32_t i = 0; i < order.size(); i++)
+	{
+		if (parents[i] != noIndex)
+		{
+			parents[i] = newIndex[parents[i]];
+		}
+		slots[ids[i]] = i;
+		if (dirty[i])
+		{
+			firstDirty = (std::min)(firstDirty, i);
+		}
+	}
+
+	needsRebuild = false;
+	orderBroken = false;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "Math.h"
+#include "Transform.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Parent/child transform hierarchy.
+//
+// Nodes live in flat arrays sorted by depth, so every parent comes before
+// its children and Update() is a single forward pass. SetLocal() only
+// flags a node; Update() recomputes the world matrices of flagged nodes and
+// everything below them, and reports which nodes changed so callers can
+// re-upload just those. A frame where nothing moved costs nothing.
+//
+// Node ids are stable, the dense position of a node can change whenever
+// the hierarchy is restructured.
+class SceneGraph
+{
+public:
+	using NodeId = std::uint32_t;
+	static constexpr NodeId noNode = ~NodeId(0);
+
+	NodeId Create(const Transform &local, NodeId parent = noNode);
+
+	// Creates locals.size() nodes with consecutive ids and returns the first.
+	// parents[i] is the index of node i's parent within the batch, which
+	// must come before it, or noNode for a root. When the batch is depth
+	// sorted and the graph was empty, the arrays are appended as they are.
+	NodeId CreateBatch(std::span<const Transform> locals, std::span<const std::uint32_t> parents);
+
+	// Destroys the node and all of its descendants.
+	void Destroy(NodeId node);
+
+	// Destroys every node, keeping the memory for the next scene.
+	void Clear();
+
+	// Moves the node, with its subtree, under `parent` (or to the root with
+	// noNode). The local transform is kept, so the world transform changes.
+	void SetParent(NodeId node, NodeId parent);
+
+	void SetLocal(NodeId node, const Transform &local);
+
+	bool IsAlive(NodeId node) const;
+	NodeId Parent(NodeId node) const;
+	const Transform &Local(NodeId node) const;
+
+	// As of the last Update().
+	const bkmz::math::Float4x4 &World(NodeId node) const;
+
+	// Brings world matrices up to date and returns the nodes whose world
+	// matrix changed, valid until the next Update().
+	const std::vector<NodeId> &Update();
+
+	const std::vector<NodeId> &Changed() const { return changed; }
+	std::size_t Size() const { return ids.size(); }
+
+private:
+	static constexpr std::uint32_t noIndex = ~std::uint32_t(0);
+
+	std::uint32_t IndexOf(NodeId node) const;
+	bool IsDescendant(NodeId node, NodeId ancestor) const;
+	void MarkDirty(std::uint32_t index);
+
+	// Re-sorts the arrays by depth after SetParent/Destroy, and drops
+	// destroyed nodes.
+	void Rebuild();
+
+private:
+	// Dense, depth sorted, all indexed alike.
+	std::vector<NodeId> ids;
+	std::vector<std::uint32_t> parents; // dense index, noIndex for roots
+	std::vector<std::uint32_t> depths;
+	std::vector<Transform> locals;
+	std::vector<bkmz::math::Float4x4> worlds;
+	std::vector<std::uint8_t> dirty; // local transform changed
+	std::vector<std::uint8_t> moved; // world changed in the running Update
+
+	// NodeId -> dense index, noIndex when free.
+	std::vector<std::uint32_t> slots;
+	std::vector<NodeId> freeIds;
+
+	std::uint32_t firstDirty = noIndex;
+	bool needsRebuild = false; // not depth sorted, or has destroyed nodes
+	bool orderBroken = false;  // a parent may come after its children
+	std::vector<NodeId> changed;
+};
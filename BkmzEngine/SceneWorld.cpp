@@ -0,0 +1,110 @@
+#include "SceneWorld.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace math = bkmz::math;
+
+SceneGraph::NodeId SceneWorld::CreateObject(const Transform &local, MeshHandle mesh, std::uint32_t objectIndex, MaterialHandle material, float spin)
+{
+	const SceneGraph::NodeId node = scene.Create(local);
+	SetObject(node, objectIndex);
+
+	if (spin != 0.0f)
+	{
+		world.Create(local, PreviousTransform{ local }, Spin{ spin }, SceneNode{ node }, MeshRenderer{ mesh, objectIndex, material });
+	}
+	else
+	{
+		world.Create(local, PreviousTransform{ local }, SceneNode{ node }, MeshRenderer{ mesh, objectIndex, material });
+	}
+	entityCount++;
+	return node;
+}
+
+SceneGraph::NodeId SceneWorld::CreateObjects(const SceneView &view, std::span<const MeshHandle> meshes, std::uint32_t firstObject, std::span<const MaterialHandle> materials)
+{
+	if (meshes.size() < view.MeshCount() || materials.size() < view.MaterialCount())
+	{
+		throw std::runtime_error("Every scene mesh and material needs a handle.");
+	}
+
+	const SceneGraph::NodeId first = scene.CreateBatch(view.Transforms(), view.Parents());
+	nodeObjects.resize((std::max)(nodeObjects.size(), (std::size_t)first + view.Size()), noObject);
+
+	for (std::uint32_t i = 0; i < view.Size(); i++)
+	{
+		const SceneGraph::NodeId node = first + i;
+		const std::uint32_t objectIndex = firstObject + i;
+		const MeshRenderer renderer{ meshes[view.Meshes()[i]], objectIndex, materials[view.Materials()[i]] };
+		const Transform &local = view.Transforms()[i];
+		nodeObjects[node] = objectIndex;
+
+		if (view.Spins()[i] != 0.0f)
+		{
+			world.Create(local, PreviousTransform{ local }, Spin{ view.Spins()[i] }, SceneNode{ node }, renderer);
+		}
+		else
+		{
+			world.Create(local, PreviousTransform{ local }, SceneNode{ node }, renderer);
+		}
+	}
+	entityCount += view.Size();
+	return first;
+}
+
+void SceneWorld::FixedUpdate(float stepTime)
+{
+	spinQuery.ForEach([stepTime](Transform &transform, PreviousTransform &previous, const Spin &spin)
+	{
+		previous.value = transform;
+		const math::Quaternion step = math::QuaternionRotationAxis({ 0.0f, 1.0f, 0.0f }, stepTime * spin.speed);
+		transform.rotation = math::Normalize(math::Multiply(step, transform.rotation));
+	});
+
+	// Structural changes recorded by the systems above.
+	commands.Playback(world);
+}
+
+void SceneWorld::PublishRenderState()
+{
+	RenderState &state = renderStates.WriteBuffer();
+	state.items.clear();
+
+	renderQuery.ForEach([&state](const Transform &transform, const PreviousTransform &previous, const SceneNode &node, const MeshRenderer &renderer)
+	{
+		state.items.push_back({ previous.value, transform, node.id, renderer.mesh, renderer.objectIndex, renderer.material });
+	});
+
+	renderStates.Publish();
+}
+
+const std::vector<SceneGraph::NodeId> &SceneWorld::Prepare(float alpha)
+{
+	renderStates.Acquire();
+	const RenderState &state = renderStates.ReadBuffer();
+
+	// Only entities that moved since they were last drawn touch the scene
+	// graph, so Update() only recomputes them and their children.
+	for (const auto &item : state.items)
+	{
+		const Transform local = item.previous == item.current
+			? item.current
+			: Transform::Lerp(item.previous, item.current, alpha);
+
+		if (!(local == scene.Local(item.node)))
+		{
+			scene.SetLocal(item.node, local);
+		}
+	}
+
+	return scene.Update();
+}
+
+void SceneWorld::SetObject(SceneGraph::NodeId node, std::uint32_t objectIndex)
+{
+	if (nodeObjects.size() <= node)
+	{
+		nodeObjects.resize(node + 1, noObject);
+	}
+	nodeObjects[node] = objectIndex;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "Components.h"
+#include "Ecs.h"
+#include "SceneFile.h"
+#include "SceneGraph.h"
+#include "TripleBuffer.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// The CPU side of a frame: the simulated entities, the snapshots handed
+// from the simulation to the renderer, and the render side scene graph.
+//
+// MyApp owns one and only adds what needs D3D: meshes, uploads and draws.
+// With no graphics API dependency here, BkmzHeadless drives the same code
+// without a device.
+//
+// FixedUpdate and PublishRenderState are the simulation side and may run
+// on the simulation thread; Prepare and Current are the render side.
+class SceneWorld
+{
+public:
+	static constexpr std::uint32_t noObject = ~0u;
+
+	// Everything the render side needs from the simulation, copied out after
+	// each simulation step so drawing never reads the live world.
+	struct RenderState
+	{
+		struct Item
+		{
+			Transform previous;
+			Transform current;
+			SceneGraph::NodeId node;
+			MeshHandle mesh;
+			std::uint32_t objectIndex;
+			MaterialHandle material;
+		};
+
+		std::vector<Item> items;
+	};
+
+	// A spin of 0 makes a static object. Returns its scene node.
+	SceneGraph::NodeId CreateObject(const Transform &local, MeshHandle mesh, std::uint32_t objectIndex, MaterialHandle material, float spin = 0.0f);
+
+	// Adds every object of a compiled scene, with consecutive object
+	// indices from firstObject. Object i uses meshes[its mesh in the scene]
+	// and materials[its material in the scene]. Returns the first node, the
+	// others follow in order.
+	SceneGraph::NodeId CreateObjects(const SceneView &view, std::span<const MeshHandle> meshes, std::uint32_t firstObject, std::span<const MaterialHandle> materials);
+
+	// Simulation side: advances by one fixed step, then snapshots the
+	// result for the renderer.
+	void FixedUpdate(float stepTime);
+	void PublishRenderState();
+
+	// Render side: picks up the newest snapshot, blends each object alpha of
+	// the way from its previous to its current transform and updates the
+	// scene graph. Returns the nodes whose world matrix changed, valid
+	// until the next call.
+	const std::vector<SceneGraph::NodeId> &Prepare(float alpha);
+
+	// The snapshot the last Prepare used.
+	const RenderState &Current() const { return renderStates.ReadBuffer(); }
+
+	const SceneGraph &Scene() const { return scene; }
+
+	// The object shown by `node`, or noObject.
+	std::uint32_t ObjectIndex(SceneGraph::NodeId node) const
+	{
+		return node < nodeObjects.size() ? nodeObjects[node] : noObject;
+	}
+
+	std::uint32_t EntityCount() const { return entityCount; }
+
+private:
+	void SetObject(SceneGraph::NodeId node, std::uint32_t objectIndex);
+
+private:
+	// Simulation side once initialization is done.
+	bkmz::ecs::World world;
+	bkmz::ecs::CommandBuffer commands;
+	bkmz::ecs::Query<Transform, PreviousTransform, Spin> spinQuery{ world };
+	bkmz::ecs::Query<const Transform, const PreviousTransform, const SceneNode, const MeshRenderer> renderQuery{ world };
+	std::uint32_t entityCount = 0;
+
+	TripleBuffer<RenderState> renderStates;
+
+	// Render side.
+	SceneGraph scene;
+	std::vector<std::uint32_t> nodeObjects; // by node id, noObject if not drawn
+};
@@ -0,0 +1,216 @@
+#include "StressScene.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace bkmz::math;
+
+namespace
+{
+	constexpr float spacing = 2.0f;
+	constexpr std::uint32_t childrenPerRoot = 3;
+
+	class StressBuilder
+	{
+	public:
+		StressBuilder(const StressSceneOptions &options)
+			: options(options), random(options.seed)
+		{
+			for (std::uint32_t i = 0; i < (std::max)(options.materialCount, 1u); i++)
+			{
+				materialNames.push_back("Stress" + std::to_string(i));
+			}
+		}
+
+		bool Full() const
+		{
+			return scene.Size() >= options.objectCount;
+		}
+
+		std::uint32_t Add(const Transform &local, bool dynamic, std::uint32_t parent = SceneDescription::noParent)
+		{
+			const std::string &material = materialNames[scene.Size() % materialNames.size()];
+			const float spin = dynamic ? Uniform(0.25f, 2.0f) : 0.0f;
+			return scene.Add(local, "Cube.mesh", material, parent, spin);
+		}
+
+		bool RandomDynamic()
+		{
+			return Uniform(0.0f, 1.0f) < options.dynamicFraction;
+		}
+
+		// Floor grid of `count` objects centered on the origin, at height y.
+		void Grid(std::uint32_t count, float y, bool dynamicAllowed)
+		{
+			const std::uint32_t side = (std::uint32_t)std::ceil(std::sqrt((double)count));
+			const float offset = (float)(side - 1) * spacing * 0.5f;
+			for (std::uint32_t i = 0; i < count && !Full(); i++)
+			{
+				Transform local;
+				local.position = { (float)(i % side) * spacing - offset, y, (float)(i / side) * spacing - offset };
+				Add(local, dynamicAllowed && RandomDynamic());
+			}
+		}
+
+		// Roots around random centers with children orbiting them, until
+		// the scene is full.
+		void Clusters(float y, float dynamicFraction)
+		{
+			const std::uint32_t remaining = options.objectCount - scene.Size();
+			const std::uint32_t clusterCount = (std::max)(remaining / 256, 1u);
+			const float extent = std::sqrt((float)options.objectCount) * spacing * 0.5f;
+
+			std::vector<Float3> centers(clusterCount);
+			for (Float3 &center : centers)
+			{
+				center = { Uniform(-extent, extent), y + Uniform(0.0f, extent * 0.25f), Uniform(-extent, extent) };
+			}
+
+			for (std::uint32_t i = 0; !Full(); i++)
+			{
+				const Float3 &center = centers[i % clusterCount];
+				Transform root;
+				root.position = center + Float3{ Uniform(-8.0f, 8.0f), Uniform(-8.0f, 8.0f), Uniform(-8.0f, 8.0f) };
+				root.rotation = QuaternionRotationAxis({ 0.0f, 1.0f, 0.0f }, Uniform(-pi, pi));
+				const bool dynamic = Uniform(0.0f, 1.0f) < dynamicFraction;
+				const std::uint32_t parent = Add(root, dynamic);
+
+				for (std::uint32_t child = 0; child < childrenPerRoot && !Full(); child++)
+				{
+					Transform local;
+					local.position = { 1.5f * std::cos(child * 2.1f), 0.5f, 1.5f * std::sin(child * 2.1f) };
+					local.scale = { 0.4f, 0.4f, 0.4f };
+					Add(local, dynamic && RandomDynamic(), parent);
+				}
+			}
+		}
+
+		float Uniform(float low, float high)
+		{
+			return std::uniform_real_distribution<float>(low, high)(random);
+		}
+
+		const StressSceneOptions &options;
+		std::mt19937 random;
+		std::vector<std::string> materialNames;
+		SceneDescription scene;
+	};
+}
+
+SceneDescription MakeStressScene(const StressSceneOptions &options)
+{
+	StressBuilder builder(options);
+	switch (options.layout)
+	{
+	case StressSceneOptions::Layout::Grid:
+		builder.Grid(options.objectCount, 0.0f, true);
+		break;
+	case StressSceneOptions::Layout::Clusters:
+		builder.Clusters(0.0f, options.dynamicFraction);
+		break;
+	case StressSceneOptions::Layout::Mixed:
+	{
+		// Static floor, and the clusters above it hold every dynamic object.
+		const std::uint32_t dynamicCount = (std::uint32_t)(options.objectCount * options.dynamicFraction);
+		builder.Grid(options.objectCount - dynamicCount, -2.0f, false);
+		builder.Clusters(2.0f, 1.0f);
+		break;
+	}
+	}
+	return std::move(builder.scene);
+}
+
+std::vector<Light> MakeStressLights(const StressSceneOptions &options)
+{
+	std::mt19937 random(options.seed + 1);
+	auto uniform = [&random](float low, float high) { return std::uniform_real_distribution<float>(low, high)(random); };
+
+	const float extent = std::sqrt((float)options.objectCount) * spacing * 0.5f;
+	std::vector<Light> lights(options.lightCount);
+	for (std::uint32_t i = 0; i < options.lightCount; i++)
+	{
+		Light &light = lights[i];
+		light.position = { uniform(-extent, extent), uniform(1.0f, 6.0f), uniform(-extent, extent) };
+		light.range = uniform(3.0f, 10.0f);
+		light.color = Float3{ uniform(0.2f, 1.0f), uniform(0.2f, 1.0f), uniform(0.2f, 1.0f) } * uniform(4.0f, 12.0f);
+		if (i % 4 == 3)
+		{
+			// Pointing mostly down at the objects.
+			light.type = LightType::Spot;
+			light.direction = Normalize(Float3{ uniform(-0.5f, 0.5f), -1.0f, uniform(-0.5f, 0.5f) });
+			light.cosOuterAngle = std::cos(uniform(0.3f, 0.8f));
+		}
+		else
+		{
+			light.type = LightType::Point;
+			light.direction = { 0.0f, -1.0f, 0.0f };
+			light.cosOuterAngle = -1.0f;
+		}
+	}
+	return lights;
+}
+
+void AnimateStressLights(std::span<const Light> start, float time, std::span<Light> lights)
+{
+	for (std::size_t i = 0; i < start.size(); i++)
+	{
+		const float angle = time * (0.5f + (i % 7) * 0.1f) + (float)i;
+		lights[i].position = start[i].position + Float3{ 1.5f * std::cos(angle), 0.0f, 1.5f * std::sin(angle) };
+	}
+}
+
+std::vector<ParticleEmitter> MakeStressEmitters(const StressSceneOptions &options)
+{
+	if (options.particleCount == 0)
+	{
+		return {};
+	}
+
+	std::mt19937 random(options.seed + 2);
+	auto uniform = [&random](float low, float high) { return std::uniform_real_distribution<float>(low, high)(random); };
+
+	constexpr float lifetime = 2.0f;
+	const float extent = std::sqrt((float)options.objectCount) * spacing * 0.5f;
+	const std::uint32_t count = (options.particleCount + 16383) / 16384;
+	std::vector<ParticleEmitter> emitters(count);
+	for (ParticleEmitter &emitter : emitters)
+	{
+		emitter.position = { uniform(-extent, extent), uniform(0.5f, 2.0f), uniform(-extent, extent) };
+		emitter.rate = (float)options.particleCount / lifetime / count;
+		emitter.velocity = { 0.0f, uniform(4.0f, 8.0f), 0.0f };
+		emitter.spread = 1.5f;
+		emitter.color = { uniform(0.5f, 1.0f), uniform(0.5f, 1.0f), uniform(0.5f, 1.0f), 0.6f };
+		emitter.lifetime = lifetime;
+		emitter.size = 0.05f;
+	}
+	return emitters;
+}
+
+StressSceneOptions::Layout ParseStressLayout(std::string_view name)
+{
+	for (auto layout : { StressSceneOptions::Layout::Grid, StressSceneOptions::Layout::Clusters, StressSceneOptions::Layout::Mixed })
+	{
+		if (name == StressLayoutName(layout))
+		{
+			return layout;
+		}
+	}
+	throw std::runtime_error("Unknown stress scene layout " + std::string(name) + ", expected grid, clusters or mixed.");
+}
+
+const char *StressLayoutName(StressSceneOptions::Layout layout)
+{
+	switch (layout)
+	{
+	case StressSceneOptions::Layout::Grid:
+		return "grid";
+	case StressSceneOptions::Layout::Clusters:
+		return "clusters";
+	case StressSceneOptions::Layout::Mixed:
+		return "mixed";
+	}
+	return "unknown";
+}
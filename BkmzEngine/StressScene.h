@@ -0,0 +1,52 @@
+#pragma once
+#include "LightClusters.h"
+#include "ParticleSystem.h"
+#include "SceneFile.h"
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Procedural scenes for measuring the engine at 10k to 1M objects.
+//
+// Grid lays objects out on a flat square grid. Clusters scatters them
+// around random centers, each with a few children per root. Mixed is a
+// static grid floor with dynamic clusters above it. dynamicFraction of the
+// objects spin, the rest are static, and materials are spread evenly over
+// materialCount names. Every object uses Cube.mesh, which the app always
+// has. lightCount lights, a quarter of them spot lights, are scattered over
+// the same area just above the objects, and particle emitters among them
+// keep about particleCount particles alive. The same options always give
+// the same scene.
+struct StressSceneOptions
+{
+	enum class Layout
+	{
+		Grid,
+		Clusters,
+		Mixed,
+	};
+
+	Layout layout = Layout::Grid;
+	std::uint32_t objectCount = 10000;
+	std::uint32_t materialCount = 1;
+	float dynamicFraction = 0.1f;
+	std::uint32_t lightCount = 0;
+	std::uint32_t particleCount = 0;
+	std::uint32_t seed = 1;
+};
+
+SceneDescription MakeStressScene(const StressSceneOptions &options);
+std::vector<Light> MakeStressLights(const StressSceneOptions &options);
+
+// Moves the lights MakeStressLights made on small circles around where they
+// started, to where they are `time` seconds in. `lights` is as long as
+// `start`.
+void AnimateStressLights(std::span<const Light> start, float time, std::span<Light> lights);
+
+// Fountains spread over the scene, one per 16384 particles.
+std::vector<ParticleEmitter> MakeStressEmitters(const StressSceneOptions &options);
+
+// "grid", "clusters" or "mixed". Throws on anything else.
+StressSceneOptions::Layout ParseStressLayout(std::string_view name);
+const char *StressLayoutName(StressSceneOptions::Layout layout);
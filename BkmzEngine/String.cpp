@@ -1,28 +1,611 @@
 #include "String.h"
+#include "MathBatch.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(BKMZ_MATH_SCALAR_ONLY)
+#define BKMZ_STRING_SSE2 1
+#include <emmintrin.h>
+#endif
 
 namespace bkmz::utl
 {
-	std::wstring ToWide(const std::string &narrow)
+	namespace
+	{
+		std::size_t ScalarBlocks(const char *, std::size_t, void *) { return 0; }
+		std::size_t ScalarNarrowBlocks(const void *, std::size_t, char *) { return 0; }
+		std::size_t ScalarAsciiPrefix(const char *, std::size_t) { return 0; }
+		std::size_t ScalarCountUtf8(const char *, std::size_t, std::size_t &, std::size_t &) { return 0; }
+
+		// Converts nothing in blocks, everything goes through the scalar
+		// loops below.
+		const detail::StringKernels scalarKernels = {
+			ScalarBlocks,
+			ScalarBlocks,
+			ScalarNarrowBlocks,
+			ScalarNarrowBlocks,
+			ScalarAsciiPrefix,
+			ScalarCountUtf8,
+		};
+
+#if defined(BKMZ_STRING_SSE2)
+		// SSE2 is part of x64, so these need no CPU check.
+		std::size_t Sse2WidenAscii16(const char *in, std::size_t count, void *out)
+		{
+			auto *dst = static_cast<std::uint16_t *>(out);
+			const __m128i zero = _mm_setzero_si128();
+			std::size_t i = 0;
+			for (; i + 16 <= count; i += 16)
+			{
+				const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+				if (_mm_movemask_epi8(bytes) != 0)
+				{
+					break;
+				}
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_unpacklo_epi8(bytes, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), _mm_unpackhi_epi8(bytes, zero));
+			}
+			return i;
+		}
+
+		std::size_t Sse2WidenAscii32(const char *in, std::size_t count, void *out)
+		{
+			auto *dst = static_cast<std::uint32_t *>(out);
+			const __m128i zero = _mm_setzero_si128();
+			std::size_t i = 0;
+			for (; i + 16 <= count; i += 16)
+			{
+				const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+				if (_mm_movemask_epi8(bytes) != 0)
+				{
+					break;
+				}
+				const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+				const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_unpacklo_epi16(low, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 4), _mm_unpackhi_epi16(low, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), _mm_unpacklo_epi16(high, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 12), _mm_unpackhi_epi16(high, zero));
+			}
+			return i;
+		}
+
+		std::size_t Sse2NarrowAscii16(const void *in, std::size_t count, char *out)
+		{
+			const auto *src = static_cast<const std::uint16_t *>(in);
+			const __m128i nonAscii = _mm_set1_epi16((short)0xff80);
+			std::size_t i = 0;
+			for (; i + 16 <= count; i += 16)
+			{
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 8));
+				const __m128i high = _mm_and_si128(_mm_or_si128(a, b), nonAscii);
+				if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xffff)
+				{
+					break;
+				}
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(a, b));
+			}
+			return i;
+		}
+
+		std::size_t Sse2NarrowAscii32(const void *in, std::size_t count, char *out)
+		{
+			const auto *src = static_cast<const std::uint32_t *>(in);
+			const __m128i nonAscii = _mm_set1_epi32((int)0xffffff80);
+			std::size_t i = 0;
+			for (; i + 16 <= count; i += 16)
+			{
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 4));
+				const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 8));
+				const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 12));
+				const __m128i high = _mm_and_si128(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)), nonAscii);
+				if (_mm_movemask_epi8(_mm_cmpeq_epi32(high, _mm_setzero_si128())) != 0xffff)
+				{
+					break;
+				}
+				const __m128i ab = _mm_packs_epi32(a, b);
+				const __m128i cd = _mm_packs_epi32(c, d);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(ab, cd));
+			}
+			return i;
+		}
+
+		std::size_t Sse2AsciiPrefix(const char *in, std::size_t count)
+		{
+			std::size_t i = 0;
+			for (; i + 16 <= count; i += 16)
+			{
+				if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i))) != 0)
+				{
+					break;
+				}
+			}
+			return i;
+		}
+
+		std::size_t Sse2CountUtf8(const char *in, std::size_t count, std::size_t &leads, std::size_t &fourByteLeads)
+		{
+			// As signed bytes, continuation bytes 0x80-0xbf are -128..-65 and
+			// 4-byte leads 0xf0-0xff are -16..-1.
+			const __m128i continuationLimit = _mm_set1_epi8(-64);
+			const __m128i fourByteLimit = _mm_set1_epi8(-17);
+			const __m128i zero = _mm_setzero_si128();
+			std::size_t i = 0;
+			for (; i + 16 <= count; i += 16)
+			{
+				const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+				const unsigned continuation = (unsigned)_mm_movemask_epi8(_mm_cmplt_epi8(bytes, continuationLimit));
+				const __m128i four = _mm_and_si128(_mm_cmpgt_epi8(bytes, fourByteLimit), _mm_cmplt_epi8(bytes, zero));
+				leads += 16 - std::popcount(continuation);
+				fourByteLeads += std::popcount((unsigned)_mm_movemask_epi8(four));
+			}
+			return i;
+		}
+
+		const detail::StringKernels sse2Kernels = {
+			Sse2WidenAscii16,
+			Sse2WidenAscii32,
+			Sse2NarrowAscii16,
+			Sse2NarrowAscii32,
+			Sse2AsciiPrefix,
+			Sse2CountUtf8,
+		};
+#endif
+
+		const detail::StringKernels &Kernels()
+		{
+			const detail::StringKernels *kernels = nullptr;
+			switch (bkmz::math::ActiveBackend())
+			{
+			case bkmz::math::SimdBackend::Avx2:
+				kernels = detail::Avx2StringKernels();
+				break;
+			case bkmz::math::SimdBackend::Sse4:
+				kernels = detail::Sse2StringKernels();
+				break;
+			default:
+				break;
+			}
+			return kernels ? *kernels : scalarKernels;
+		}
+
+		bool IsContinuation(unsigned char byte)
+		{
+			return (byte & 0xc0) == 0x80;
+		}
+
+		// Decodes the code point starting at in[0], with size > 0 bytes
+		// available. Returns its length in bytes, or 0 if it is invalid.
+		std::size_t DecodeUtf8(const unsigned char *in, std::size_t size, char32_t &codePoint)
+		{
+			const unsigned char lead = in[0];
+			if (lead < 0x80)
+			{
+				codePoint = lead;
+				return 1;
+			}
+			if (lead < 0xc2)
+			{
+				return 0; // continuation byte, or an overlong 2-byte form
+			}
+			if (lead < 0xe0)
+			{
+				if (size < 2 || !IsContinuation(in[1]))
+				{
+					return 0;
+				}
+				codePoint = ((char32_t)(lead & 0x1f) << 6) | (in[1] & 0x3f);
+				return 2;
+			}
+			if (lead < 0xf0)
+			{
+				// E0 needs A0 or more to not be overlong, ED below A0 to not be
+				// a surrogate.
+				const unsigned char low = lead == 0xe0 ? 0xa0 : 0x80;
+				const unsigned char high = lead == 0xed ? 0x9f : 0xbf;
+				if (size < 3 || in[1] < low || in[1] > high || !IsContinuation(in[2]))
+				{
+					return 0;
+				}
+				codePoint = ((char32_t)(lead & 0x0f) << 12) | ((char32_t)(in[1] & 0x3f) << 6) | (in[2] & 0x3f);
+				return 3;
+			}
+			if (lead < 0xf5)
+			{
+				// F0 needs 90 or more to not be overlong, F4 below 90 to stay
+				// within U+10FFFF.
+				const unsigned char low = lead == 0xf0 ? 0x90 : 0x80;
+				const unsigned char high = lead == 0xf4 ? 0x8f : 0xbf;
+				if (size < 4 || in[1] < low || in[1] > high || !IsContinuation(in[2]) || !IsContinuation(in[3]))
+				{
+					return 0;
+				}
+				codePoint = ((char32_t)(lead & 0x07) << 18) | ((char32_t)(in[1] & 0x3f) << 12) |
+					((char32_t)(in[2] & 0x3f) << 6) | (in[3] & 0x3f);
+				return 4;
+			}
+			return 0;
+		}
+
+		std::size_t Utf8Size(char32_t codePoint)
+		{
+			return codePoint < 0x80 ? 1 : codePoint < 0x800 ? 2 : codePoint < 0x10000 ? 3 : 4;
+		}
+
+		void EncodeUtf8(char32_t codePoint, char *out)
+		{
+			if (codePoint < 0x80)
+			{
+				out[0] = (char)codePoint;
+			}
+			else if (codePoint < 0x800)
+			{
+				out[0] = (char)(0xc0 | (codePoint >> 6));
+				out[1] = (char)(0x80 | (codePoint & 0x3f));
+			}
+			else if (codePoint < 0x10000)
+			{
+				out[0] = (char)(0xe0 | (codePoint >> 12));
+				out[1] = (char)(0x80 | ((codePoint >> 6) & 0x3f));
+				out[2] = (char)(0x80 | (codePoint & 0x3f));
+			}
+			else
+			{
+				out[0] = (char)(0xf0 | (codePoint >> 18));
+				out[1] = (char)(0x80 | ((codePoint >> 12) & 0x3f));
+				out[2] = (char)(0x80 | ((codePoint >> 6) & 0x3f));
+				out[3] = (char)(0x80 | (codePoint & 0x3f));
+			}
+		}
+
+		bool IsSurrogate(char32_t unit)
+		{
+			return unit >= 0xd800 && unit <= 0xdfff;
+		}
+
+		// Mixed-script text has many short ASCII runs, a space or a digit
+		// between words, where calling a SIMD kernel costs more than it
+		// saves. Runs are copied here first and only handed to the kernel
+		// once they are this long.
+		constexpr std::size_t shortRun = 16;
+
+		// Copies ASCII units up to shortRun or count, whichever is less, and
+		// returns how many.
+		template <typename In, typename Out>
+		std::size_t CopyShortRun(const In *in, std::size_t count, Out *out)
+		{
+			const std::size_t end = (std::min)(count, shortRun);
+			std::size_t i = 0;
+			for (; i < end && (char32_t)in[i] < 0x80; i++)
+			{
+				out[i] = (Out)in[i];
+			}
+			return i;
+		}
+
+		// Unit is char16_t, char32_t or a wchar_t of the same size.
+		template <typename Unit>
+		TranscodeResult FromUtf8(std::string_view in, Unit *out, std::size_t capacity)
+		{
+			const detail::StringKernels &kernels = Kernels();
+			const auto *bytes = reinterpret_cast<const unsigned char *>(in.data());
+			const std::size_t size = in.size();
+			std::size_t i = 0;
+			std::size_t o = 0;
+			while (i < size)
+			{
+				if (bytes[i] < 0x80)
+				{
+					const std::size_t run = CopyShortRun(bytes + i, (std::min)(size - i, capacity - o), out + o);
+					i += run;
+					o += run;
+					if (run == shortRun)
+					{
+						const std::size_t count = (std::min)(size - i, capacity - o);
+						const std::size_t done = sizeof(Unit) == 2
+							? kernels.widenAscii16(in.data() + i, count, out + o)
+							: kernels.widenAscii32(in.data() + i, count, out + o);
+						i += done;
+						o += done;
+					}
+					for (; i < size && bytes[i] < 0x80; i++, o++)
+					{
+						if (o == capacity)
+						{
+							return { i, o, TranscodeError::OutputTooSmall };
+						}
+						out[o] = (Unit)bytes[i];
+					}
+					continue;
+				}
+
+				char32_t codePoint;
+				const std::size_t length = DecodeUtf8(bytes + i, size - i, codePoint);
+				if (length == 0)
+				{
+					return { i, o, TranscodeError::InvalidInput };
+				}
+
+				const std::size_t units = sizeof(Unit) == 2 && codePoint >= 0x10000 ? 2 : 1;
+				if (capacity - o < units)
+				{
+					return { i, o, TranscodeError::OutputTooSmall };
+				}
+				if (units == 2)
+				{
+					codePoint -= 0x10000;
+					out[o++] = (Unit)(0xd800 + (codePoint >> 10));
+					out[o++] = (Unit)(0xdc00 + (codePoint & 0x3ff));
+				}
+				else
+				{
+					out[o++] = (Unit)codePoint;
+				}
+				i += length;
+			}
+			return { i, o, TranscodeError::None };
+		}
+
+		template <typename Unit>
+		TranscodeResult ToUtf8Units(const Unit *in, std::size_t size, char *out, std::size_t capacity)
+		{
+			const detail::StringKernels &kernels = Kernels();
+			std::size_t i = 0;
+			std::size_t o = 0;
+			while (i < size)
+			{
+				if ((char32_t)in[i] < 0x80)
+				{
+					const std::size_t run = CopyShortRun(in + i, (std::min)(size - i, capacity - o), out + o);
+					i += run;
+					o += run;
+					if (run == shortRun)
+					{
+						const std::size_t count = (std::min)(size - i, capacity - o);
+						const std::size_t done = sizeof(Unit) == 2
+							? kernels.narrowAscii16(in + i, count, out + o)
+							: kernels.narrowAscii32(in + i, count, out + o);
+						i += done;
+						o += done;
+					}
+					for (; i < size && (char32_t)in[i] < 0x80; i++, o++)
+					{
+						if (o == capacity)
+						{
+							return { i, o, TranscodeError::OutputTooSmall };
+						}
+						out[o] = (char)in[i];
+					}
+					continue;
+				}
+
+				char32_t codePoint = (char32_t)in[i];
+				std::size_t length = 1;
+				if (sizeof(Unit) == 2 && codePoint >= 0xd800 && codePoint <= 0xdbff &&
+					i + 1 < size && (char32_t)in[i + 1] >= 0xdc00 && (char32_t)in[i + 1] <= 0xdfff)
+				{
+					codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + ((char32_t)in[i + 1] - 0xdc00);
+					length = 2;
+				}
+				else if (IsSurrogate(codePoint) || codePoint > 0x10ffff)
+				{
+					return { i, o, TranscodeError::InvalidInput };
+				}
+
+				const std::size_t bytes = Utf8Size(codePoint);
+				if (capacity - o < bytes)
+				{
+					return { i, o, TranscodeError::OutputTooSmall };
+				}
+				EncodeUtf8(codePoint, out + o);
+				o += bytes;
+				i += length;
+			}
+			return { i, o, TranscodeError::None };
+		}
+
+		template <typename Unit>
+		std::size_t Utf8LengthOf(const Unit *in, std::size_t size)
+		{
+			std::size_t length = 0;
+			for (std::size_t i = 0; i < size; i++)
+			{
+				const char32_t unit = (char32_t)in[i];
+				// A surrogate pair is 4 bytes, 2 for each half.
+				length += unit < 0x80 ? 1 : unit < 0x800 ? 2 : IsSurrogate(unit) && sizeof(Unit) == 2 ? 2 : unit < 0x10000 ? 3 : 4;
+			}
+			return length;
+		}
+
+		// Code points, plus one more for each that needs a surrogate pair
+		// when fourByteUnits is 2.
+		std::size_t LengthFromUtf8(std::string_view utf8, std::size_t fourByteUnits)
+		{
+			std::size_t leads = 0;
+			std::size_t fourByteLeads = 0;
+			std::size_t i = Kernels().countUtf8(utf8.data(), utf8.size(), leads, fourByteLeads);
+			for (; i < utf8.size(); i++)
+			{
+				const unsigned char byte = (unsigned char)utf8[i];
+				leads += !IsContinuation(byte);
+				fourByteLeads += byte >= 0xf0;
+			}
+			return leads + fourByteLeads * (fourByteUnits - 1);
+		}
+
+		template <typename Result, typename F>
+		Result Convert(std::size_t length, F &&convert, const char *what)
+		{
+			Result result;
+			result.resize(length);
+			const TranscodeResult converted = convert(result.data(), result.size());
+			if (!converted.Ok())
+			{
+				throw std::runtime_error(std::string("Invalid ") + what + " text.");
+			}
+			result.resize(converted.written);
+			return result;
+		}
+	}
+
+	namespace detail
+	{
+		const StringKernels *Sse2StringKernels()
+		{
+#if defined(BKMZ_STRING_SSE2)
+			return &sse2Kernels;
+#else
+			return nullptr;
+#endif
+		}
+	}
+
+	bool IsValidUtf8(std::string_view utf8)
+	{
+		const auto *bytes = reinterpret_cast<const unsigned char *>(utf8.data());
+		const detail::StringKernels &kernels = Kernels();
+		std::size_t i = 0;
+		while (i < utf8.size())
+		{
+			if (bytes[i] < 0x80)
+			{
+				const std::size_t end = (std::min)(utf8.size(), i + shortRun);
+				for (; i < end && bytes[i] < 0x80; i++)
+				{
+				}
+				if (i == end)
+				{
+					i += kernels.asciiPrefix(utf8.data() + i, utf8.size() - i);
+				}
+				for (; i < utf8.size() && bytes[i] < 0x80; i++)
+				{
+				}
+				continue;
+			}
+			char32_t codePoint;
+			const std::size_t length = DecodeUtf8(bytes + i, utf8.size() - i, codePoint);
+			if (length == 0)
+			{
+				return false;
+			}
+			i += length;
+		}
+		return true;
+	}
+
+	bool IsValidUtf16(std::u16string_view utf16)
 	{
-		std::wstring wide;
-		wide.resize(narrow.size() + 1);
-		size_t actual;
-		mbstowcs_s(&actual, wide.data(), wide.size(), narrow.c_str(), _TRUNCATE);
-		if (actual > 0)
+		for (std::size_t i = 0; i < utf16.size(); i++)
 		{
-			wide.resize(actual - 1);
-			return wide;
+			if (utf16[i] >= 0xd800 && utf16[i] <= 0xdbff && i + 1 < utf16.size() && utf16[i + 1] >= 0xdc00 && utf16[i + 1] <= 0xdfff)
+			{
+				i++;
+			}
+			else if (IsSurrogate(utf16[i]))
+			{
+				return false;
+			}
 		}
-		return {};
+		return true;
+	}
+
+	std::size_t Utf16Length(std::string_view utf8)
+	{
+		return LengthFromUtf8(utf8, 2);
+	}
+
+	std::size_t Utf32Length(std::string_view utf8)
+	{
+		return LengthFromUtf8(utf8, 1);
+	}
+
+	std::size_t Utf8Length(std::u16string_view utf16)
+	{
+		return Utf8LengthOf(utf16.data(), utf16.size());
+	}
+
+	std::size_t Utf8Length(std::u32string_view utf32)
+	{
+		return Utf8LengthOf(utf32.data(), utf32.size());
+	}
+
+	TranscodeResult Utf8ToUtf16(std::string_view in, std::span<char16_t> out)
+	{
+		return FromUtf8(in, out.data(), out.size());
+	}
+
+	TranscodeResult Utf8ToUtf32(std::string_view in, std::span<char32_t> out)
+	{
+		return FromUtf8(in, out.data(), out.size());
+	}
+
+	TranscodeResult Utf16ToUtf8(std::u16string_view in, std::span<char> out)
+	{
+		return ToUtf8Units(in.data(), in.size(), out.data(), out.size());
+	}
+
+	TranscodeResult Utf32ToUtf8(std::u32string_view in, std::span<char> out)
+	{
+		return ToUtf8Units(in.data(), in.size(), out.data(), out.size());
+	}
+
+	std::u16string ToUtf16(std::string_view utf8)
+	{
+		return Convert<std::u16string>(Utf16Length(utf8),
+			[utf8](char16_t *out, std::size_t size) { return FromUtf8(utf8, out, size); }, "UTF-8");
+	}
+
+	std::u32string ToUtf32(std::string_view utf8)
+	{
+		return Convert<std::u32string>(Utf32Length(utf8),
+			[utf8](char32_t *out, std::size_t size) { return FromUtf8(utf8, out, size); }, "UTF-8");
+	}
+
+	std::string ToUtf8(std::u16string_view utf16)
+	{
+		return Convert<std::string>(Utf8Length(utf16),
+			[utf16](char *out, std::size_t size) { return ToUtf8Units(utf16.data(), utf16.size(), out, size); }, "UTF-16");
+	}
+
+	std::string ToUtf8(std::u32string_view utf32)
+	{
+		return Convert<std::string>(Utf8Length(utf32),
+			[utf32](char *out, std::size_t size) { return ToUtf8Units(utf32.data(), utf32.size(), out, size); }, "UTF-32");
+	}
+
+	std::size_t WideLength(std::string_view utf8)
+	{
+		return LengthFromUtf8(utf8, sizeof(wchar_t) == 2 ? 2 : 1);
+	}
+
+	std::size_t Utf8Length(std::wstring_view wide)
+	{
+		return Utf8LengthOf(wide.data(), wide.size());
+	}
+
+	TranscodeResult Utf8ToWide(std::string_view in, std::span<wchar_t> out)
+	{
+		return FromUtf8(in, out.data(), out.size());
+	}
+
+	TranscodeResult WideToUtf8(std::wstring_view in, std::span<char> out)
+	{
+		return ToUtf8Units(in.data(), in.size(), out.data(), out.size());
+	}
+
+	std::wstring ToWide(std::string_view utf8)
+	{
+		return Convert<std::wstring>(WideLength(utf8),
+			[utf8](wchar_t *out, std::size_t size) { return FromUtf8(utf8, out, size); }, "UTF-8");
 	}
 
-	std::string ToNarrow(const std::wstring &wide)
+	std::string ToNarrow(std::wstring_view wide)
 	{
-		std::string narrow;
-		narrow.resize(wide.size() * 2);
-		size_t actual;
-		wcstombs_s(&actual, narrow.data(), narrow.size(), wide.c_str(), _TRUNCATE);
-		narrow.resize(actual - 1);
-		return narrow;
+		return Convert<std::string>(Utf8Length(wide),
+			[wide](char *out, std::size_t size) { return ToUtf8Units(wide.data(), wide.size(), out, size); }, "wide");
 	}
-}
\ No newline at end of file
+}
@@ -1,8 +1,90 @@
 #pragma once
+#include <cstddef>
+#include <span>
 #include <string>
+#include <string_view>
 
+// Unicode transcoding between UTF-8, UTF-16 and UTF-32, independent of the
+// C locale. Narrow strings in the engine are UTF-8; wchar_t is UTF-16 on
+// Windows and UTF-32 elsewhere, ToWide/ToNarrow pick the right one.
+//
+// Input is validated: overlong forms, surrogates in UTF-8 or UTF-32,
+// unpaired surrogates in UTF-16 and code points past U+10FFFF are errors.
+// Runs of ASCII are converted 16 or 32 code units at a time with SSE2 or
+// AVX2, following bkmz::math's active SIMD backend (see MathBatch.h).
 namespace bkmz::utl
 {
-	std::wstring ToWide(const std::string &narrow);
-	std::string ToNarrow(const std::wstring &wide);
-}
\ No newline at end of file
+	enum class TranscodeError
+	{
+		None,
+		InvalidInput,   // at input position `read`
+		OutputTooSmall, // everything before `read` was converted
+	};
+
+	struct TranscodeResult
+	{
+		std::size_t read = 0;    // input code units consumed
+		std::size_t written = 0; // output code units written
+		TranscodeError error = TranscodeError::None;
+
+		bool Ok() const { return error == TranscodeError::None; }
+	};
+
+	bool IsValidUtf8(std::string_view utf8);
+	bool IsValidUtf16(std::u16string_view utf16);
+
+	// Exact output lengths in code units for valid input, so the output can
+	// be sized before converting. Don't validate; for invalid input the
+	// conversion reports the error.
+	std::size_t Utf16Length(std::string_view utf8);
+	std::size_t Utf32Length(std::string_view utf8);
+	std::size_t Utf8Length(std::u16string_view utf16);
+	std::size_t Utf8Length(std::u32string_view utf32);
+
+	// Convert into caller-provided storage, never allocating. Stop at the
+	// first invalid code point or when `out` is full.
+	TranscodeResult Utf8ToUtf16(std::string_view in, std::span<char16_t> out);
+	TranscodeResult Utf8ToUtf32(std::string_view in, std::span<char32_t> out);
+	TranscodeResult Utf16ToUtf8(std::u16string_view in, std::span<char> out);
+	TranscodeResult Utf32ToUtf8(std::u32string_view in, std::span<char> out);
+
+	// Allocate exactly the converted length. Throw std::runtime_error on
+	// invalid input.
+	std::u16string ToUtf16(std::string_view utf8);
+	std::u32string ToUtf32(std::string_view utf8);
+	std::string ToUtf8(std::u16string_view utf16);
+	std::string ToUtf8(std::u32string_view utf32);
+
+	// The same for wchar_t, for Win32 APIs and paths.
+	std::size_t WideLength(std::string_view utf8);
+	std::size_t Utf8Length(std::wstring_view wide);
+	TranscodeResult Utf8ToWide(std::string_view in, std::span<wchar_t> out);
+	TranscodeResult WideToUtf8(std::wstring_view in, std::span<char> out);
+	std::wstring ToWide(std::string_view utf8);
+	std::string ToNarrow(std::wstring_view wide);
+
+	namespace detail
+	{
+		// Converts whole blocks of ASCII from the start of the input and
+		// returns how many code units that was, stopping at the first block
+		// that isn't all ASCII. The 16 and 32 bit sides are char16_t and
+		// char32_t sized units, or wchar_t of that size.
+		struct StringKernels
+		{
+			std::size_t (*widenAscii16)(const char *in, std::size_t count, void *out);
+			std::size_t (*widenAscii32)(const char *in, std::size_t count, void *out);
+			std::size_t (*narrowAscii16)(const void *in, std::size_t count, char *out);
+			std::size_t (*narrowAscii32)(const void *in, std::size_t count, char *out);
+			std::size_t (*asciiPrefix)(const char *in, std::size_t count);
+
+			// For the whole blocks at the start of `in`: the bytes that start
+			// a code point, and those that start a 4-byte one. Returns the
+			// number of bytes counted.
+			std::size_t (*countUtf8)(const char *in, std::size_t count, std::size_t &leads, std::size_t &fourByteLeads);
+		};
+
+		// nullptr when not compiled in.
+		const StringKernels *Sse2StringKernels();
+		const StringKernels *Avx2StringKernels();
+	}
+}
@@ -0,0 +1,156 @@
+#include "String.h"
+
+// Built with -mavx2 on GCC and Clang, like MathBatchAvx2.cpp, and only
+// called once bkmz::math has found AVX2 on the CPU.
+
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(BKMZ_MATH_SCALAR_ONLY) && !defined(BKMZ_MATH_NO_AVX2)
+#include <immintrin.h>
+#include <bit>
+#include <cstdint>
+
+namespace bkmz::utl
+{
+	namespace
+	{
+		std::size_t Avx2WidenAscii16(const char *in, std::size_t count, void *out)
+		{
+			auto *dst = static_cast<std::uint16_t *>(out);
+			std::size_t i = 0;
+			for (; i + 32 <= count; i += 32)
+			{
+				const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+				if (_mm256_movemask_epi8(bytes) != 0)
+				{
+					break;
+				}
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)));
+			}
+			return i;
+		}
+
+		std::size_t Avx2WidenAscii32(const char *in, std::size_t count, void *out)
+		{
+			auto *dst = static_cast<std::uint32_t *>(out);
+			std::size_t i = 0;
+			for (; i + 32 <= count; i += 32)
+			{
+				const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+				if (_mm256_movemask_epi8(bytes) != 0)
+				{
+					break;
+				}
+				const __m128i low = _mm256_castsi256_si128(bytes);
+				const __m128i high = _mm256_extracti128_si256(bytes, 1);
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_cvtepu8_epi32(low));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 16), _mm256_cvtepu8_epi32(high));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)));
+			}
+			return i;
+		}
+
+		std::size_t Avx2NarrowAscii16(const void *in, std::size_t count, char *out)
+		{
+			const auto *src = static_cast<const std::uint16_t *>(in);
+			const __m256i nonAscii = _mm256_set1_epi16((short)0xff80);
+			std::size_t i = 0;
+			for (; i + 32 <= count; i += 32)
+			{
+				const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+				const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 16));
+				if (!_mm256_testz_si256(_mm256_or_si256(a, b), nonAscii))
+				{
+					break;
+				}
+				// The pack works within 128-bit lanes, the permute puts the
+				// 8-byte groups back in order.
+				const __m256i packed = _mm256_packus_epi16(a, b);
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+			}
+			return i;
+		}
+
+		std::size_t Avx2NarrowAscii32(const void *in, std::size_t count, char *out)
+		{
+			const auto *src = static_cast<const std::uint32_t *>(in);
+			const __m256i nonAscii = _mm256_set1_epi32((int)0xffffff80);
+			const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+			std::size_t i = 0;
+			for (; i + 32 <= count; i += 32)
+			{
+				const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+				const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 8));
+				const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 16));
+				const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 24));
+				if (!_mm256_testz_si256(_mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d)), nonAscii))
+				{
+					break;
+				}
+				const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_permutevar8x32_epi32(packed, order));
+			}
+			return i;
+		}
+
+		std::size_t Avx2AsciiPrefix(const char *in, std::size_t count)
+		{
+			std::size_t i = 0;
+			for (; i + 32 <= count; i += 32)
+			{
+				if (_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i))) != 0)
+				{
+					break;
+				}
+			}
+			return i;
+		}
+
+		std::size_t Avx2CountUtf8(const char *in, std::size_t count, std::size_t &leads, std::size_t &fourByteLeads)
+		{
+			// See Sse2CountUtf8.
+			const __m256i continuationLimit = _mm256_set1_epi8(-64);
+			const __m256i fourByteLimit = _mm256_set1_epi8(-17);
+			const __m256i zero = _mm256_setzero_si256();
+			std::size_t i = 0;
+			for (; i + 32 <= count; i += 32)
+			{
+				const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+				const unsigned continuation = (unsigned)_mm256_movemask_epi8(_mm256_cmpgt_epi8(continuationLimit, bytes));
+				const __m256i four = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, fourByteLimit), _mm256_cmpgt_epi8(zero, bytes));
+				leads += 32 - std::popcount(continuation);
+				fourByteLeads += std::popcount((unsigned)_mm256_movemask_epi8(four));
+			}
+			return i;
+		}
+
+		const detail::StringKernels kernels = {
+			Avx2WidenAscii16,
+			Avx2WidenAscii32,
+			Avx2NarrowAscii16,
+			Avx2NarrowAscii32,
+			Avx2AsciiPrefix,
+			Avx2CountUtf8,
+		};
+	}
+
+	namespace detail
+	{
+		const StringKernels *Avx2StringKernels()
+		{
+			return &kernels;
+		}
+	}
+}
+
+#else
+
+namespace bkmz::utl::detail
+{
+	const StringKernels *Avx2StringKernels()
+	{
+		return nullptr;
+	}
+}
+
+#endif
@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// A contiguous run of elements to copy from the staging area into the
+// destination buffer.
+struct UploadRun
+{
+	std::uint32_t first;        // first destination element
+	std::uint32_t count;
+	std::uint32_t stagingFirst; // where the run starts in the staging area
+};
+
+// CPU copy of an array that also lives on the GPU, remembering which
+// elements were set since the last upload.
+//
+// Gather() packs just those elements into a staging area, grouped into runs
+// of neighbouring elements, so each run is a single copy on the GPU side.
+// Runs closer together than maxGap are merged, re-sending the unchanged
+// elements in between: a few extra bytes are cheaper than another copy
+// command.
+template <typename T>
+class TrackedBuffer
+{
+public:
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	// Everything is uploaded by the next Gather() after a resize.
+	void Resize(std::uint32_t size)
+	{
+		values.resize(size);
+		changed.assign(size, 0);
+		dirty.clear();
+		MarkAll();
+	}
+
+	std::uint32_t Size() const
+	{
+		return (std::uint32_t)values.size();
+	}
+
+	const T &operator[](std::uint32_t index) const
+	{
+		return values[index];
+	}
+
+	void Set(std::uint32_t index, const T &value)
+	{
+		values[index] = value;
+		if (!changed[index])
+		{
+			changed[index] = 1;
+			dirty.push_back(index);
+		}
+	}
+
+	void MarkAll()
+	{
+		for (std::uint32_t i = 0; i < Size(); i++)
+		{
+			if (!changed[i])
+			{
+				changed[i] = 1;
+				dirty.push_back(i);
+			}
+		}
+	}
+
+	// Elements set since the last Gather().
+	std::uint32_t PendingCount() const
+	{
+		return (std::uint32_t)dirty.size();
+	}
+
+	// Copies the pending elements to `staging`, which must have room for
+	// Size() elements, and returns where each run goes. The runs are valid
+	// until the next Gather().
+	std::span<const UploadRun> Gather(T *staging, std::uint32_t maxGap = 4)
+	{
+		runs.clear();
+		if (dirty.empty())
+		{
+			return runs;
+		}
+
+		// Sorting is only worth it while few elements changed, past that a
+		// scan over the flags gives the same sorted list for less.
+		if (dirty.size() * 8 > values.size())
+		{
+			dirty.clear();
+			for (std::uint32_t i = 0; i < Size(); i++)
+			{
+				if (changed[i])
+				{
+					dirty.push_back(i);
+				}
+			}
+		}
+		else
+		{
+			std::sort(dirty.begin(), dirty.end());
+		}
+
+		for (std::uint32_t index : dirty)
+		{
+			changed[index] = 0;
+			if (!runs.empty() && index - (runs.back().first + runs.back().count) <= maxGap)
+			{
+				runs.back().count = index + 1 - runs.back().first;
+			}
+			else
+			{
+				const std::uint32_t stagingFirst = runs.empty() ? 0 : runs.back().stagingFirst + runs.back().count;
+				runs.push_back({ index, 1, stagingFirst });
+			}
+		}
+		dirty.clear();
+
+		for (const UploadRun &run : runs)
+		{
+			std::memcpy(staging + run.stagingFirst, values.data() + run.first, run.count * sizeof(T));
+		}
+		return runs;
+	}
+
+private:
+	std::vector<T> values;
+	std::vector<std::uint8_t> changed;
+	std::vector<std::uint32_t> dirty; // indices of the set changed flags
+	std::vector<UploadRun> runs;
+};
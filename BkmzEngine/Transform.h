@@ -1,11 +1,29 @@
 #pragma once
-#include "d3d12.h"
-#include <DirectXMath.h>
+#include "Math.h"
 
+// Local position, rotation and scale. Applied as scale, then rotation, then
+// translation.
 class Transform
 {
 public:
-	DirectX::XMVECTOR position = { 0 };
-	DirectX::XMVECTOR rotation = { 0 };
-	DirectX::XMVECTOR scale = { 0 };
-};
\ No newline at end of file
+	bkmz::math::Float3 position = { 0.0f, 0.0f, 0.0f };
+	bkmz::math::Quaternion rotation;
+	bkmz::math::Float3 scale = { 1.0f, 1.0f, 1.0f };
+
+	bool operator==(const Transform &) const = default;
+
+	bkmz::math::Float4x4 Matrix() const
+	{
+		return bkmz::math::AffineTransformation(scale, rotation, position);
+	}
+
+	// Blends between two simulation states for rendering.
+	static Transform Lerp(const Transform &from, const Transform &to, float t)
+	{
+		Transform result;
+		result.position = bkmz::math::Lerp(from.position, to.position, t);
+		result.rotation = bkmz::math::Nlerp(from.rotation, to.rotation, t);
+		result.scale = bkmz::math::Lerp(from.scale, to.scale, t);
+		return result;
+	}
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer exchange of whole snapshots.
+//
+// The producer always owns one slot to write into and the consumer one slot
+// to read from. The third slot sits in between and is swapped with either
+// side by a single atomic exchange, so neither thread ever waits on the
+// other and a published snapshot stays immutable while the consumer holds
+// it. If the producer publishes twice before the consumer looks, the older
+// snapshot is simply overwritten.
+template <typename T>
+class TripleBuffer
+{
+public:
+	// Producer side: the slot to fill before calling Publish().
+	T &WriteBuffer()
+	{
+		return slots[writeIndex];
+	}
+
+	void Publish()
+	{
+		const std::uint8_t previous = shared.exchange(writeIndex | freshBit, std::memory_order_acq_rel);
+		writeIndex = previous & indexMask;
+	}
+
+	// Consumer side: picks up the newest published snapshot, if there is one
+	// the consumer hasn't seen yet. Returns false if ReadBuffer() is unchanged.
+	bool Acquire()
+	{
+		if ((shared.load(std::memory_order_relaxed) & freshBit) == 0)
+		{
+			return false;
+		}
+
+		const std::uint8_t previous = shared.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = previous & indexMask;
+		return true;
+	}
+
+	const T &ReadBuffer() const
+	{
+		return slots[readIndex];
+	}
+
+private:
+	static constexpr std::uint8_t indexMask = 0x3;
+	static constexpr std::uint8_t freshBit = 0x4;
+
+	T slots[3];
+
+	// Keep the indices on separate cache lines so the two threads don't
+	// false-share.
+	alignas(64) std::atomic<std::uint8_t> shared{ 1 };
+	alignas(64) std::uint8_t writeIndex = 0;
+	alignas(64) std::uint8_t readIndex = 2;
+};
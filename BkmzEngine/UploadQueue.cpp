@@ -0,0 +1,81 @@
+#include "UploadQueue.h"
+#include <algorithm>
+#include <stdexcept>
+
+UploadQueue::UploadQueue(CopyQueueBackend &backend, std::uint32_t allocatorCount, std::uint32_t batchSize)
+	: backend(backend), batchSize((std::max)(batchSize, 1u)), allocatorValues((std::max)(allocatorCount, 1u), 0)
+{
+	batch.reserve(this->batchSize);
+}
+
+UploadQueue::~UploadQueue()
+{
+	Wait(Flush());
+	releases.ReleaseAll();
+}
+
+std::uint64_t UploadQueue::Copy(const CopyCommand &copy)
+{
+	const std::uint64_t value = nextValue;
+	batch.push_back(copy);
+	stats.copies++;
+	stats.bytes += copy.size;
+	if (batch.size() >= batchSize)
+	{
+		Flush();
+	}
+	return value;
+}
+
+std::uint64_t UploadQueue::Flush()
+{
+	if (batch.empty())
+	{
+		return SubmittedValue();
+	}
+
+	// The allocator's previous batch must have run before it is reset.
+	const std::uint32_t allocator = nextAllocator;
+	nextAllocator = (nextAllocator + 1) % (std::uint32_t)allocatorValues.size();
+	if (!IsComplete(allocatorValues[allocator]))
+	{
+		Poll();
+		if (!IsComplete(allocatorValues[allocator]))
+		{
+			stats.allocatorWaits++;
+			backend.Wait(allocatorValues[allocator]);
+			Poll();
+		}
+	}
+
+	const std::uint64_t value = nextValue++;
+	backend.Submit(allocator, batch, value);
+	allocatorValues[allocator] = value;
+	releases.SetNextFenceValue(nextValue);
+	batch.clear();
+	stats.batches++;
+	return value;
+}
+
+void UploadQueue::Poll()
+{
+	completedValue = (std::max)(completedValue, backend.CompletedValue());
+	releases.Collect(completedValue);
+}
+
+void UploadQueue::Wait(std::uint64_t fenceValue)
+{
+	if (fenceValue > nextValue || (fenceValue == nextValue && batch.empty()))
+	{
+		throw std::runtime_error("Waiting for an upload that was never queued.");
+	}
+	if (fenceValue == nextValue)
+	{
+		Flush();
+	}
+	if (!IsComplete(fenceValue))
+	{
+		backend.Wait(fenceValue);
+	}
+	Poll();
+}
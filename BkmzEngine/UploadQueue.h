@@ -0,0 +1,108 @@
+#pragma once
+#include "DeferredRelease.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Uploads on a copy queue of their own, so they overlap rendering instead
+// of being recorded on the frame's command list and waited for.
+//
+// Copies are batched: many small ones go out in one submission, which
+// signals the copy fence with the batch's value. Each batch records into
+// one of a few allocators, reused once the fence says its last batch is
+// done. Users keep the value Copy returned and check IsComplete before
+// using the destination, or make the direct queue wait for exactly that
+// value; nothing waits for uploads it doesn't need.
+//
+// The graphics API sits behind CopyQueueBackend (D3D12CopyQueue in
+// CopyQueue.h), so the timeline runs the same against a stand-in.
+
+// Bytes from an upload buffer into a default buffer. The resources are
+// opaque here, ID3D12Resource for D3D12CopyQueue.
+struct CopyCommand
+{
+	void *destination;
+	std::uint64_t destinationOffset;
+	void *source;
+	std::uint64_t sourceOffset;
+	std::uint64_t size;
+};
+
+class CopyQueueBackend
+{
+public:
+	virtual ~CopyQueueBackend() = default;
+
+	// Records `copies` with allocator `allocator`, whose previous batch is
+	// complete, submits them and signals fenceValue once they have run.
+	virtual void Submit(std::uint32_t allocator, std::span<const CopyCommand> copies, std::uint64_t fenceValue) = 0;
+
+	// The highest value signalled so far.
+	virtual std::uint64_t CompletedValue() = 0;
+
+	// Blocks until fenceValue has been signalled.
+	virtual void Wait(std::uint64_t fenceValue) = 0;
+};
+
+struct UploadQueueStats
+{
+	std::uint64_t copies = 0;
+	std::uint64_t bytes = 0;
+	std::uint64_t batches = 0;
+	std::uint64_t allocatorWaits = 0; // submissions that had to wait for an allocator
+};
+
+// Not thread safe, the render thread owns it.
+class UploadQueue
+{
+public:
+	static constexpr std::uint32_t defaultAllocatorCount = 3;
+	static constexpr std::uint32_t defaultBatchSize = 256;
+
+	explicit UploadQueue(CopyQueueBackend &backend, std::uint32_t allocatorCount = defaultAllocatorCount,
+		std::uint32_t batchSize = defaultBatchSize);
+
+	// Blocks until every batch has run.
+	~UploadQueue();
+
+	// Queues a copy and returns the fence value after which it is done.
+	// Submits by itself when the batch is full.
+	std::uint64_t Copy(const CopyCommand &copy);
+
+	// Submits the open batch, if it has anything. Call once per frame, after
+	// the frame's copies. Returns the value of the last batch.
+	std::uint64_t Flush();
+
+	// Reads the fence once. IsComplete and the releases go by that value.
+	void Poll();
+
+	bool IsComplete(std::uint64_t fenceValue) const { return fenceValue <= completedValue; }
+
+	// Blocks until fenceValue is complete, submitting it first if needed.
+	void Wait(std::uint64_t fenceValue);
+
+	// The value the open batch will signal, and that of the last one
+	// submitted.
+	std::uint64_t NextValue() const { return nextValue; }
+	std::uint64_t SubmittedValue() const { return nextValue - 1; }
+
+	// Staging buffers are pushed here with the value of their copy, they are
+	// released once Poll sees it complete.
+	DeferredReleaseQueue &Releases() { return releases; }
+
+	const UploadQueueStats &Stats() const { return stats; }
+
+private:
+	CopyQueueBackend &backend;
+	std::uint32_t batchSize;
+
+	std::vector<CopyCommand> batch;
+	std::vector<std::uint64_t> allocatorValues; // last value recorded with each
+	std::uint32_t nextAllocator = 0;
+
+	std::uint64_t nextValue = 1;
+	std::uint64_t completedValue = 0;
+
+	DeferredReleaseQueue releases;
+	UploadQueueStats stats;
+};
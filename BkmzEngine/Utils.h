@@ -3,6 +3,7 @@
 #include "d3d12.h"
 #include "d3dx12.h"
 #include "DXErrors.h"
+#include "ConstantBuffer.h"
 
 class Utils
 {
@@ -78,19 +79,28 @@ public:
 		return defaultBuffer;
 	}
 
+	static Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(
+		ID3D12Device *device,
+		D3D12_HEAP_TYPE heapType,
+		UINT64 byteSize,
+		D3D12_RESOURCE_STATES initialState)
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+		CD3DX12_HEAP_PROPERTIES heapProps(heapType);
+		auto desc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+		DX_CALL(device->CreateCommittedResource(
+			&heapProps,
+			D3D12_HEAP_FLAG_NONE,
+			&desc,
+			initialState,
+			nullptr,
+			IID_PPV_ARGS(buffer.GetAddressOf()))
+		);
+		return buffer;
+	}
+
 	static inline UINT CalcConstantBufferByteSize(UINT byteSize)
 	{
-		// Constant buffers must be a multiple of the minimum hardware
-		// allocation size (usually 256 bytes). So round up to nearest
-		// multiple of 256. We do this by adding 255 and then masking off
-		// the lower 2 bytes which store all bits < 256.
-		// Example: Suppose byteSize = 300.
-		// (300 + 255) & ~255
-		// 555 & ~255
-		// 0x022B & ~0x00ff
-		// 0x022B & 0xff00
-		// 0x0200
-		// 512
-		return (byteSize + 255) & ~255;
+		return bkmz::utl::ConstantBufferByteSize(byteSize);
 	}
 };
\ No newline at end of file
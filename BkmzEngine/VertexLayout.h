@@ -0,0 +1,323 @@
+#pragma once
+#include "Math.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(BKMZ_MATH_SCALAR_ONLY)
+#define BKMZ_VERTEX_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Vertex layouts described once, at compile time, next to the vertex
+// struct:
+//
+//   struct Vertex
+//   {
+//       bkmz::math::Float3 position;
+//       Unorm8x4 color;
+//
+//       static constexpr auto Layout()
+//       {
+//           return MakeVertexLayout<Vertex>(
+//               BKMZ_VERTEX_ATTRIBUTE(Vertex, position, "POSITION"),
+//               BKMZ_VERTEX_ATTRIBUTE(Vertex, color, "COLOR"));
+//       }
+//   };
+//
+// Formats come from the member types, offsets from offsetof, so the
+// layout can't drift from the struct. From it come the D3D12 input layout
+// (InputLayout in Material.h), compile time checks against a shader's
+// input signature (LayoutSatisfies), and ConvertVertices, which converts
+// between two vertex structs by semantic with a loop specialised for each
+// pair of formats. No graphics API here, DXGI formats are plain numbers.
+
+// Four bytes a shader reads as a float4 in [0, 1].
+struct Unorm8x4
+{
+	std::uint8_t x, y, z, w;
+
+	bool operator==(const Unorm8x4 &) const = default;
+};
+
+enum class VertexFormat : std::uint8_t
+{
+	Float,
+	Float3,
+	Float4,
+	Unorm8x4
+};
+
+constexpr std::uint32_t VertexFormatSize(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::Float: return 4;
+	case VertexFormat::Float3: return 12;
+	case VertexFormat::Float4: return 16;
+	case VertexFormat::Unorm8x4: return 4;
+	}
+	return 0;
+}
+
+// Components the shader sees, all of them floats.
+constexpr std::uint32_t VertexFormatComponents(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::Float: return 1;
+	case VertexFormat::Float3: return 3;
+	case VertexFormat::Float4: return 4;
+	case VertexFormat::Unorm8x4: return 4;
+	}
+	return 0;
+}
+
+// The DXGI_FORMAT.
+constexpr std::uint32_t VertexFormatDxgi(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::Float: return 41;    // DXGI_FORMAT_R32_FLOAT
+	case VertexFormat::Float3: return 6;    // DXGI_FORMAT_R32G32B32_FLOAT
+	case VertexFormat::Float4: return 2;    // DXGI_FORMAT_R32G32B32A32_FLOAT
+	case VertexFormat::Unorm8x4: return 28; // DXGI_FORMAT_R8G8B8A8_UNORM
+	}
+	return 0;
+}
+
+// Only these member types can be attributes.
+template <typename T>
+struct VertexFormatOf;
+
+template <> struct VertexFormatOf<float> { static constexpr VertexFormat value = VertexFormat::Float; };
+template <> struct VertexFormatOf<bkmz::math::Float3> { static constexpr VertexFormat value = VertexFormat::Float3; };
+template <> struct VertexFormatOf<bkmz::math::Float4> { static constexpr VertexFormat value = VertexFormat::Float4; };
+template <> struct VertexFormatOf<Unorm8x4> { static constexpr VertexFormat value = VertexFormat::Unorm8x4; };
+
+struct VertexAttribute
+{
+	std::string_view semantic;
+	std::uint32_t semanticIndex;
+	VertexFormat format;
+	std::uint32_t offset;
+};
+
+#define BKMZ_VERTEX_ATTRIBUTE(Vertex, member, semantic) \
+	VertexAttribute{ semantic, 0, VertexFormatOf<decltype(Vertex::member)>::value, (std::uint32_t)offsetof(Vertex, member) }
+
+template <std::size_t N>
+struct VertexLayout
+{
+	std::array<VertexAttribute, N> attributes;
+	std::uint32_t stride;
+
+	// Index into attributes, or N.
+	constexpr std::size_t Find(std::string_view semantic, std::uint32_t semanticIndex = 0) const
+	{
+		for (std::size_t i = 0; i < N; i++)
+		{
+			if (attributes[i].semantic == semantic && attributes[i].semanticIndex == semanticIndex)
+			{
+				return i;
+			}
+		}
+		return N;
+	}
+};
+
+// Rejects, by failing constant evaluation, attributes that overlap, run
+// past the vertex or repeat a semantic.
+template <typename Vertex, typename... Attributes>
+constexpr VertexLayout<sizeof...(Attributes)> MakeVertexLayout(const Attributes &...attributes)
+{
+	constexpr std::size_t count = sizeof...(Attributes);
+	const VertexLayout<count> layout = { { attributes... }, (std::uint32_t)sizeof(Vertex) };
+	for (std::size_t i = 0; i < count; i++)
+	{
+		const VertexAttribute &a = layout.attributes[i];
+		if (a.offset + VertexFormatSize(a.format) > layout.stride)
+		{
+			throw "Vertex attribute runs past the end of the vertex.";
+		}
+		for (std::size_t j = 0; j < i; j++)
+		{
+			const VertexAttribute &b = layout.attributes[j];
+			if (a.semantic == b.semantic && a.semanticIndex == b.semanticIndex)
+			{
+				throw "Vertex semantic used twice.";
+			}
+			if (a.offset < b.offset + VertexFormatSize(b.format) && b.offset < a.offset + VertexFormatSize(a.format))
+			{
+				throw "Vertex attributes overlap.";
+			}
+		}
+	}
+	return layout;
+}
+
+// One input of a vertex shader's signature, as declared in the HLSL.
+struct ShaderInput
+{
+	std::string_view semantic;
+	std::uint32_t semanticIndex;
+	std::uint32_t components;
+};
+
+// True if the layout feeds every input of the signature. An attribute may
+// have fewer components than the input, the input assembler fills in the
+// rest, but every input needs an attribute.
+template <std::size_t N, std::size_t M>
+constexpr bool LayoutSatisfies(const VertexLayout<N> &layout, const std::array<ShaderInput, M> &signature)
+{
+	for (const ShaderInput &input : signature)
+	{
+		const std::size_t found = layout.Find(input.semantic, input.semanticIndex);
+		if (found == N || input.components == 0 || input.components > 4)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+namespace detail
+{
+	// Converts one attribute of `count` vertices. Strides are compile time
+	// constants, so each pair of formats gets its own tight loop.
+	template <VertexFormat From, VertexFormat To, std::size_t SourceStride, std::size_t DestStride>
+	struct AttributeConverter
+	{
+		static void Convert(const std::byte *source, std::byte *dest, std::size_t count)
+		{
+			static_assert(From == To, "No conversion between these vertex formats.");
+			constexpr std::size_t size = VertexFormatSize(From);
+			for (std::size_t i = 0; i < count; i++)
+			{
+				std::memcpy(dest + i * DestStride, source + i * SourceStride, size);
+			}
+		}
+	};
+
+	template <std::size_t SourceStride, std::size_t DestStride>
+	struct AttributeConverter<VertexFormat::Float3, VertexFormat::Float4, SourceStride, DestStride>
+	{
+		static void Convert(const std::byte *source, std::byte *dest, std::size_t count)
+		{
+			for (std::size_t i = 0; i < count; i++)
+			{
+				float value[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+				std::memcpy(value, source + i * SourceStride, 12);
+				std::memcpy(dest + i * DestStride, value, 16);
+			}
+		}
+	};
+
+	template <std::size_t SourceStride, std::size_t DestStride>
+	struct AttributeConverter<VertexFormat::Float4, VertexFormat::Float3, SourceStride, DestStride>
+	{
+		static void Convert(const std::byte *source, std::byte *dest, std::size_t count)
+		{
+			for (std::size_t i = 0; i < count; i++)
+			{
+				std::memcpy(dest + i * DestStride, source + i * SourceStride, 12);
+			}
+		}
+	};
+
+	inline std::uint8_t ToUnorm8(float value)
+	{
+		// Written so that NaN goes to 0, as in the SSE2 path.
+		const float clamped = !(value > 0.0f) ? 0.0f : value > 1.0f ? 1.0f : value;
+		return (std::uint8_t)(clamped * 255.0f + 0.5f);
+	}
+
+	template <std::size_t SourceStride, std::size_t DestStride>
+	struct AttributeConverter<VertexFormat::Float4, VertexFormat::Unorm8x4, SourceStride, DestStride>
+	{
+		static void Convert(const std::byte *source, std::byte *dest, std::size_t count)
+		{
+			std::size_t i = 0;
+#if defined(BKMZ_VERTEX_SSE2)
+			// Four vertices at a time: clamp, scale and round sixteen floats,
+			// then narrow them to bytes with saturating packs.
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 scale = _mm_set1_ps(255.0f);
+			const __m128 half = _mm_set1_ps(0.5f);
+			auto load = [&](std::size_t vertex)
+			{
+				const __m128 value = _mm_loadu_ps(reinterpret_cast<const float *>(source + vertex * SourceStride));
+				return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(value, zero), one), scale), half));
+			};
+			for (; count - i >= 4; i += 4)
+			{
+				const __m128i low = _mm_packs_epi32(load(i), load(i + 1));
+				const __m128i high = _mm_packs_epi32(load(i + 2), load(i + 3));
+				alignas(16) std::uint32_t packed[4];
+				_mm_store_si128(reinterpret_cast<__m128i *>(packed), _mm_packus_epi16(low, high));
+				for (std::size_t j = 0; j < 4; j++)
+				{
+					std::memcpy(dest + (i + j) * DestStride, &packed[j], 4);
+				}
+			}
+#endif
+			source += i * SourceStride;
+			dest += i * DestStride;
+			for (; i < count; i++, source += SourceStride, dest += DestStride)
+			{
+				float value[4];
+				std::memcpy(value, source, 16);
+				const Unorm8x4 packed = { ToUnorm8(value[0]), ToUnorm8(value[1]), ToUnorm8(value[2]), ToUnorm8(value[3]) };
+				std::memcpy(dest, &packed, 4);
+			}
+		}
+	};
+
+	template <std::size_t SourceStride, std::size_t DestStride>
+	struct AttributeConverter<VertexFormat::Unorm8x4, VertexFormat::Float4, SourceStride, DestStride>
+	{
+		static void Convert(const std::byte *source, std::byte *dest, std::size_t count)
+		{
+			for (std::size_t i = 0; i < count; i++)
+			{
+				Unorm8x4 packed;
+				std::memcpy(&packed, source + i * SourceStride, 4);
+				const float value[4] = { packed.x / 255.0f, packed.y / 255.0f, packed.z / 255.0f, packed.w / 255.0f };
+				std::memcpy(dest + i * DestStride, value, 16);
+			}
+		}
+	};
+
+	template <typename To, typename From, std::size_t... Is>
+	void ConvertAttributes(const std::byte *source, std::byte *dest, std::size_t count, std::index_sequence<Is...>)
+	{
+		constexpr auto to = To::Layout();
+		constexpr auto from = From::Layout();
+		(
+			[&]()
+			{
+				constexpr VertexAttribute target = to.attributes[Is];
+				constexpr std::size_t found = from.Find(target.semantic, target.semanticIndex);
+				static_assert(found < from.attributes.size(), "The source vertex lacks an attribute of the destination.");
+				constexpr VertexAttribute origin = from.attributes[found < from.attributes.size() ? found : 0];
+				AttributeConverter<origin.format, target.format, sizeof(From), sizeof(To)>::Convert(
+					source + origin.offset, dest + target.offset, count);
+			}(),
+			...);
+	}
+}
+
+// Converts `count` vertices from From's layout to To's, attribute by
+// attribute, matching them by semantic. `source` needn't be aligned, it is
+// usually straight from a file. Attributes of From that To lacks are
+// dropped; padding in To is left alone.
+template <typename To, typename From>
+void ConvertVertices(const std::byte *source, std::size_t count, To *dest)
+{
+	constexpr std::size_t attributeCount = To::Layout().attributes.size();
+	detail::ConvertAttributes<To, From>(source, reinterpret_cast<std::byte *>(dest), count, std::make_index_sequence<attributeCount>());
+}
@@ -1,8 +1,30 @@
-cbuffer cbPerObject : register(b0)
+// Root constants, see Material. Everything else is found through the
+// registry indices in here.
+cbuffer cbDraw : register(b0)
 {
-    float4x4 worldViewProj;
+    uint objectIndex;
+    uint passConstantsIndex;
+    uint objectDataIndex;
 };
 
+// DefaultMaterial::PassConstants, only what the vertex shader needs of it.
+struct PassConstants
+{
+    float4x4 viewProj;
+    float4 viewDepth;
+};
+
+struct ObjectData
+{
+    float4x4 world;
+    uint materialIndex;
+    uint3 padding;
+};
+
+// The whole ResourceRegistry heap, one view per resource kind.
+ConstantBuffer<PassConstants> constantBuffers[] : register(b0, space1);
+StructuredBuffer<ObjectData> objectBuffers[] : register(t0, space2);
+
 struct VertexIn
 {
     float3 posL : POSITION;
@@ -13,15 +35,26 @@ struct VertexOut
 {
     float4 posH : SV_POSITION;
     float4 color : COLOR;
+    float3 posW : POSITION;
+    float depth : VIEWDEPTH; // view space
 };
 
 VertexOut VS(VertexIn vin)
 {
     VertexOut vout;
-    // Transform to homogeneous clip space.
-    vout.posH = mul(float4(vin.posL, 1.0f), worldViewProj);
     
-    //vout.posH = float4(vin.posL, 1.0f);
+    // Persistent per-object data, only changed entries are uploaded each frame.
+    ObjectData object = objectBuffers[objectDataIndex][objectIndex];
+    PassConstants pass = constantBuffers[passConstantsIndex];
+
+    // Transform to world space, then to homogeneous clip space.
+    float4 posW = mul(float4(vin.posL, 1.0f), object.world);
+    vout.posH = mul(posW, pass.viewProj);
+
+    // For lighting and for finding the pixel's light cluster.
+    vout.posW = posW.xyz;
+    vout.depth = dot(posW, pass.viewDepth);
+    
     // Just pass vertex color into the pixel shader.
     vout.color = vin.color;
     
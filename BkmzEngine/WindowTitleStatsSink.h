@@ -0,0 +1,28 @@
+#pragma once
+#include <Windows.h>
+#include "FrameStats.h"
+
+// Shows the latest frame stats report in the window caption bar.
+class WindowTitleStatsSink : public FrameStatsSink
+{
+public:
+	explicit WindowTitleStatsSink(HWND hwnd) : hwnd(hwnd) {}
+
+	void Write(const FrameStatsReport &r) override
+	{
+		if (r.summary)
+		{
+			return;
+		}
+
+		wchar_t windowText[256];
+		swprintf_s(windowText,
+			L" fps: %.1f  p50: %.2fms  p95: %.2fms  p99: %.2fms  max: %.2fms  stutters: %u  cpu: %.2fms  gpu wait: %.2fms  heap: %.1f  streaming max: %.2fms",
+			r.fps, r.p50Ms, r.p95Ms, r.p99Ms, r.maxMs, r.stutterCount, r.cpuMs, r.gpuWaitMs, r.heapAllocations, r.streamingMaxMs);
+
+		SetWindowText(hwnd, windowText);
+	}
+
+private:
+	HWND hwnd;
+};
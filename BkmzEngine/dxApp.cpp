@@ -1,7 +1,11 @@
 #include "dxApp.h"
 #include "DXErrors.h"
 #include "d3dx12.h"
+#include "Clock.h"
+#include "FramePacer.h"
 #include <d3dcompiler.h>
+#include <algorithm>
+#include <filesystem>
 
 void dxApp::Initialize()
 {
@@ -11,6 +15,8 @@ void dxApp::Initialize()
 	CreateFence();
 	GetDescriptorSizes();
 	CreateCommandObjects();
+	copyQueue = std::make_unique<D3D12CopyQueue>(device.Get());
+	uploads = std::make_unique<UploadQueue>(*copyQueue);
 	CreateSwapChain();
 	CreateDescriptorHeaps();
 	CreateRTV();
@@ -21,6 +27,14 @@ void dxApp::Initialize()
 	//FlushCommandQueue();
 }
 
+void dxApp::OpenAssets(const std::string &path)
+{
+	if (std::filesystem::exists(path))
+	{
+		assets = Archive(path);
+	}
+}
+
 D3D12_CPU_DESCRIPTOR_HANDLE dxApp::CurrentBackBufferView() const
 {
 	// CD3DX12 constructor to offset to the RTV of the current back buffer.
@@ -46,6 +60,7 @@ void dxApp::FlushCommandQueue()
 	// set until the GPU finishes processing all the commands prior to
 	// this Signal().
 	DX_CALL(commandQueue->Signal(fence.Get(), currentFence));
+	deferredReleases.SetNextFenceValue(currentFence + 1);
 
 	// Wait until the GPU has completed commands up to this fence point.
 	if (fence->GetCompletedValue() < currentFence)
@@ -62,37 +77,82 @@ void dxApp::FlushCommandQueue()
 }
 
 
-float dxApp::AspectRatio() const
+void dxApp::RequireUpload(std::uint64_t uploadValue)
 {
-	return static_cast<float>(width) / height;
+	requiredUpload = (std::max)(requiredUpload, uploadValue);
+}
+
+void dxApp::Tick(float deltaTime)
+{
+	if (simulationThread.joinable())
+	{
+		// The simulation thread publishes on its own schedule, blend towards
+		// the newest state by how long ago it arrived.
+		const std::int64_t published = lastPublishTime.load(std::memory_order_acquire);
+		const float sincePublish = (float)Clock::ToSeconds(Clock::Now() - published);
+		PrepareFrame((std::min)(sincePublish / simulation.stepTime, 1.0f));
+		return;
+	}
+
+	const int steps = simulation.Advance(deltaTime);
+	for (int i = 0; i < steps; i++)
+	{
+		FixedUpdate(simulation.stepTime);
+	}
+
+	if (steps > 0)
+	{
+		PublishRenderState();
+	}
+
+	PrepareFrame(simulation.Alpha());
+}
+
+void dxApp::SetPipelined(bool enabled)
+{
+	if (enabled == simulationThread.joinable())
+	{
+		return;
+	}
+
+	if (enabled)
+	{
+		simulationRunning = true;
+		simulationThread = std::thread([this]() { SimulationThread(); });
+	}
+	else
+	{
+		simulationRunning = false;
+		simulationThread.join();
+	}
 }
 
-void dxApp::CalculateFrameStats(float timerTotalTime)
+void dxApp::SimulationThread()
 {
-	// Code computes the average frames per second, and also the
-	// average time it takes to render one frame. These stats
-	// are appended to the window caption bar.
-	frameCnt++;
+	FramePacer pacer;
+	pacer.SetTargetFrameRate(1.0 / simulation.stepTime);
 
-	// Compute averages over one second period.
-	if ((timerTotalTime - timeElapsed) >= 1.0f)
+	while (simulationRunning.load(std::memory_order_relaxed))
 	{
-		float fps = (float)frameCnt; // fps = frameCnt / 1
-		float mspf = 1000.0f / fps;
-
-		std::wstring fpsStr = std::to_wstring(fps);
-		std::wstring mspfStr = std::to_wstring(mspf);
-		std::wstring windowText = 
-			L" fps: " + fpsStr +
-			L" mspf: " + mspfStr;
-
-		SetWindowText(hwnd, windowText.c_str());
-		// Reset for next average.
-		frameCnt = 0;
-		timeElapsed += 1.0f;
+		FixedUpdate(simulation.stepTime);
+		PublishRenderState();
+		lastPublishTime.store(Clock::Now(), std::memory_order_release);
+
+		pacer.Wait();
 	}
 }
 
+float dxApp::AspectRatio() const
+{
+	return static_cast<float>(width) / height;
+}
+
+void dxApp::CalculateFrameStats(float frameTime)
+{
+	const MemoryFrameStats memory = MemoryTracker::EndFrame();
+	frameStats.Record({ frameTime, gpuWaitTime, memory.heap.allocations, memory.heap.bytes, streamingFrame.time, streamingFrame.bytes, memory.tags });
+}
+
 void dxApp::EnableDebugLayer()
 {
 #if defined(DEBUG) || defined(_DEBUG)
@@ -126,6 +186,19 @@ void dxApp::CreateDevice()
 			IID_PPV_ARGS(&device))
 		);
 	}
+
+	// The bindless root signature (Material::CreatePSO) has unbounded CBV,
+	// SRV and UAV ranges over the whole registry heap, which only tier 3
+	// allows. Tier 1 and 2 hardware would fail much later with an opaque
+	// root signature error, so say so up front.
+	D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+	DX_CALL(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options)));
+	if (options.ResourceBindingTier < D3D12_RESOURCE_BINDING_TIER_3)
+	{
+		const wchar_t *msg = L"This GPU only supports resource binding tier 1 or 2. BkmzEngine binds resources bindlessly and needs tier 3.";
+		MessageBoxW(nullptr, msg, L"DX12 Error", MB_OK | MB_ICONERROR);
+		throw std::runtime_error("D3D12 resource binding tier 3 is required.");
+	}
 }
 
 void dxApp::CreateFence()
@@ -218,6 +291,8 @@ void dxApp::CreateDescriptorHeaps()
 		&dsvHeapDesc,
 		IID_PPV_ARGS(dsvHeap.GetAddressOf()))
 	);
+
+	resources.Create(device.Get(), resourceDescriptorCount);
 }
 
 void dxApp::CreateRTV()
@@ -319,6 +394,10 @@ void dxApp::SetViewport()
 
 void dxApp::Draw()
 {
+	// Whatever the GPU has finished with since the last frame.
+	deferredReleases.Collect(fence->GetCompletedValue());
+	uploads->Poll();
+
 	// Reuse the memory associated with command recording.
 	// We can only reset when the associated command lists have finished
 	// execution on the GPU.
@@ -333,6 +412,10 @@ void dxApp::Draw()
 	commandList->RSSetViewports(1, &viewport);
 	commandList->RSSetScissorRects(1, &scissorRect);
 
+	// The only shader visible heap, see ResourceRegistry.
+	ID3D12DescriptorHeap *heaps[] = { resources.Heap() };
+	commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+
 	// Indicate a state transition on the resource usage.
 	auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
 		CurrentBackBuffer(),
@@ -359,6 +442,8 @@ void dxApp::Draw()
 		DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH |
 		D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
+	streamingFrame = streamer.Update(streamingBudget);
+
 	customDraw();
 
 	// Indicate a state transition on the resource usage.
@@ -373,6 +458,15 @@ void dxApp::Draw()
 	// Done recording commands.
 	DX_CALL(commandList->Close());
 
+	// Copies queued while recording go out before the frame, and the frame
+	// only waits for the ones it said it needs.
+	uploads->Flush();
+	if (requiredUpload > waitedUpload)
+	{
+		DX_CALL(commandQueue->Wait(copyQueue->Fence(), requiredUpload));
+		waitedUpload = requiredUpload;
+	}
+
 	// Add the command list to the queue for execution.
 	ID3D12CommandList *cmdsLists[] = { commandList.Get() };
 	commandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
@@ -384,8 +478,11 @@ void dxApp::Draw()
 	// Wait until frame commands are complete. This waiting is
 	// inefficient and is done for simplicity. Later we will show how to
 	// organize our rendering code so we do not have to wait per frame.
+	FrameTimer gpuWaitTimer;
 	FlushCommandQueue();
+	gpuWaitTime = gpuWaitTimer.Mark();
 
+	frameArena.Reset();
 }
 
 void dxApp::ExecuteCommands()
@@ -3,9 +3,19 @@
 #include <wrl.h>
 #include <dxgi1_6.h>
 #include "FrameTimer.h"
-#include <DirectXMath.h>
+#include "FrameStats.h"
+#include "FixedTimestep.h"
+#include "Memory.h"
+#include "ResourceRegistry.h"
+#include "AssetStreamer.h"
+#include "Archive.h"
+#include "DeferredRelease.h"
+#include "CopyQueue.h"
 #include <string>
 #include <functional>
+#include <memory>
+#include <atomic>
+#include <thread>
 
 using Microsoft::WRL::ComPtr;
 
@@ -23,7 +33,30 @@ public:
 	}
 
 	virtual void Initialize();
-	virtual void Update(float deltaTime) = 0;
+
+	// Runs as many fixed simulation steps as deltaTime covers, then prepares
+	// the frame for drawing. In pipelined mode the steps run on the
+	// simulation thread instead and this only prepares the frame.
+	void Tick(float deltaTime);
+
+	// Moves FixedUpdate/PublishRenderState to a separate thread, so the next
+	// simulation step overlaps with recording the current frame. Derived
+	// classes must turn this off before they are destroyed.
+	void SetPipelined(bool enabled);
+
+	// Advances the simulation by exactly one step of simulation.stepTime.
+	// May run on the simulation thread, so it must not touch D3D objects.
+	virtual void FixedUpdate(float stepTime) = 0;
+
+	// Snapshots whatever the renderer needs from the simulation state. Runs
+	// right after FixedUpdate, on the same thread.
+	virtual void PublishRenderState() = 0;
+
+	// Called once per rendered frame on the main thread. alpha in [0, 1] is
+	// how far the frame lies between the previous and the current simulation
+	// state of the newest snapshot.
+	virtual void PrepareFrame(float alpha) = 0;
+
 	void Draw();
 	float AspectRatio() const;
 
@@ -32,14 +65,45 @@ public:
 		return swapChainBuffer[currBackBuffer].Get();
 	}
 
-	void CalculateFrameStats(float timerTotalTime);
+	// Feeds one frame into frameStats, splitting it into CPU time and the
+	// time Draw spent waiting for the GPU, along with the allocations
+	// counted since the previous call, in all and by tag, and what
+	// streaming cost the frame.
+	void CalculateFrameStats(float frameTime);
 
 	UINT CalcConstantBufferByteSize(UINT byteSize);
 
 public:
 	FrameTimer timer;
+	FrameStats frameStats;
+	FixedTimestep simulation;
+
+	// Scratch memory for data that only lives until the end of the frame,
+	// reset at the end of Draw.
+	FrameArena frameArena;
+
+	// Packed assets, see BkmzPack. Anything not in the archive, or every
+	// asset when there is no archive, is loaded from loose files.
+	Archive assets;
+
+	// Finished loads are handed out at the start of Draw, while the command
+	// list is open, so their callbacks can record uploads. At most
+	// streamingBudget bytes per frame, beyond the first load. Declared after
+	// assets, which loads read from, so its workers are joined first.
+	AssetStreamer streamer;
+	std::uint64_t streamingBudget = 4ull << 20;
+
+	// Before Initialize. A missing archive isn't an error.
+	void OpenAssets(const std::string &path);
+
+	// GPU objects dropped while the GPU may still use them, released at the
+	// start of a later Draw once the fence has passed them, or at shutdown
+	// after the final flush. Push from any thread.
+	DeferredReleaseQueue deferredReleases;
 
 private:
+	void SimulationThread();
+
 	void EnableDebugLayer();
 	void CreateDXGIFactory();
 	void CreateDevice();
@@ -58,6 +122,10 @@ protected:
 	D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilView() const;
 	void FlushCommandQueue();
 
+	// The frame's command list waits on the copy queue for this upload, see
+	// UploadQueue. Uploads nothing asked for are never waited on.
+	void RequireUpload(std::uint64_t uploadValue);
+
 	ComPtr<ID3DBlob> LoadShader(const std::wstring &filename);
 
 protected:
@@ -75,6 +143,7 @@ protected:
 	DXGI_FORMAT backBufferFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
 	DXGI_FORMAT depthStencilFormat = DXGI_FORMAT_D16_UNORM;
 	static constexpr UINT swapChainBufferCount = 2;
+	static constexpr UINT resourceDescriptorCount = 4096;
 	int currBackBuffer = 0;
 	D3D12_VIEWPORT viewport;
 	D3D12_RECT scissorRect;
@@ -97,10 +166,24 @@ protected:
 	ComPtr<ID3D12DescriptorHeap> rtvHeap;
 	ComPtr<ID3D12DescriptorHeap> dsvHeap;
 
+	// Every CBV/SRV/UAV shaders use, bound once per frame by Draw.
+	ResourceRegistry resources;
+
 	ComPtr<ID3D12Resource> swapChainBuffer[swapChainBufferCount];
 	ComPtr<ID3D12Resource> depthStencilBuffer;
 
+	// Buffer uploads, on their own queue. Draw polls at the start of the
+	// frame and submits what the frame queued before its own commands.
+	std::unique_ptr<D3D12CopyQueue> copyQueue;
+	std::unique_ptr<UploadQueue> uploads;
+
 private:
-	int frameCnt = 0;
-	float timeElapsed = 0.0f;
+	float gpuWaitTime = 0.0f;
+	std::uint64_t requiredUpload = 0;
+	std::uint64_t waitedUpload = 0;
+	StreamingFrameStats streamingFrame;
+
+	std::thread simulationThread;
+	std::atomic<bool> simulationRunning = false;
+	std::atomic<std::int64_t> lastPublishTime = 0;
 };
\ No newline at end of file
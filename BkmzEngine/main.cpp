@@ -1,5 +1,169 @@
 #include <Windows.h>
+#include <shellapi.h>
+#include <cstdio>
+#include <optional>
 #include "MyApp.h"
+#include "FramePacer.h"
+#include "Memory.h"
+#include "String.h"
+#include "StressScene.h"
+#include "WindowTitleStatsSink.h"
+
+struct LaunchOptions
+{
+    bool statsStdout = false;
+    std::string statsCsvPath;
+    std::string statsJsonPath;
+    double fpsCap = 0.0; // 0 = uncapped
+    double simRate = 60.0;
+    bool pipelined = false;
+    bool expectNoAlloc = false;
+    bool directDraws = false;
+    double streamBudgetKb = 0.0; // 0 = engine default
+    std::string assetsPath = "Assets.pak";
+    std::optional<StressSceneOptions> stressScene;
+    std::uint64_t frameLimit = 0; // 0 = run until closed
+};
+
+// --stats-stdout, --stats-csv <path>, --stats-json <path>: extra frame stats
+//   sinks for benchmark runs, the caption bar is always used.
+// --fps-cap <n>: pace frames to n per second instead of busy looping.
+// --sim-rate <n>: fixed simulation steps per second, independent of the
+//   frame rate.
+// --pipelined: run the simulation on its own thread, overlapping with
+//   frame recording.
+// --expect-no-alloc: check that Tick and Draw don't touch the general
+//   heap once the first frames are done. Frames that do are logged and the
+//   exit code is 3. Needs BKMZ_TRACK_ALLOCATIONS.
+// --direct-draws: issue one draw call per object instead of one
+//   ExecuteIndirect per material.
+// --stream-budget <KiB>: most streamed asset data to hand to the renderer
+//   per frame.
+// --assets <path>: asset archive to load from, Assets.pak by default. Loose
+//   files are used for whatever isn't in it.
+// --stress <grid|clusters|mixed>: draw a generated scene instead, with
+//   --stress-count <n> objects (10000 by default), --stress-dynamic <f> of
+//   them moving, --stress-materials <n> material names,
+//   --stress-lights <n> dynamic lights and --stress-particles <n> live
+//   particles.
+// --frames <n>: quit after n frames, for automated runs.
+LaunchOptions ParseCommandLine()
+{
+    LaunchOptions options;
+
+    int argc = 0;
+    LPWSTR *argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (argv == nullptr)
+    {
+        return options;
+    }
+
+    // Any of the --stress options turns the stress scene on.
+    auto stress = [&options]() -> StressSceneOptions &
+    {
+        if (!options.stressScene)
+        {
+            options.stressScene.emplace();
+        }
+        return *options.stressScene;
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::wstring arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == L"--stats-stdout")
+        {
+            options.statsStdout = true;
+        }
+        else if (arg == L"--stats-csv" && hasValue)
+        {
+            options.statsCsvPath = bkmz::utl::ToNarrow(argv[++i]);
+        }
+        else if (arg == L"--stats-json" && hasValue)
+        {
+            options.statsJsonPath = bkmz::utl::ToNarrow(argv[++i]);
+        }
+        else if (arg == L"--fps-cap" && hasValue)
+        {
+            options.fpsCap = _wtof(argv[++i]);
+        }
+        else if (arg == L"--sim-rate" && hasValue)
+        {
+            options.simRate = _wtof(argv[++i]);
+        }
+        else if (arg == L"--pipelined")
+        {
+            options.pipelined = true;
+        }
+        else if (arg == L"--expect-no-alloc")
+        {
+            options.expectNoAlloc = true;
+        }
+        else if (arg == L"--direct-draws")
+        {
+            options.directDraws = true;
+        }
+        else if (arg == L"--stream-budget" && hasValue)
+        {
+            options.streamBudgetKb = _wtof(argv[++i]);
+        }
+        else if (arg == L"--assets" && hasValue)
+        {
+            options.assetsPath = bkmz::utl::ToNarrow(argv[++i]);
+        }
+        else if (arg == L"--stress" && hasValue)
+        {
+            stress().layout = ParseStressLayout(bkmz::utl::ToNarrow(argv[++i]));
+        }
+        else if (arg == L"--stress-count" && hasValue)
+        {
+            stress().objectCount = (std::uint32_t)_wtoi(argv[++i]);
+        }
+        else if (arg == L"--stress-dynamic" && hasValue)
+        {
+            stress().dynamicFraction = (float)_wtof(argv[++i]);
+        }
+        else if (arg == L"--stress-materials" && hasValue)
+        {
+            stress().materialCount = (std::uint32_t)_wtoi(argv[++i]);
+        }
+        else if (arg == L"--stress-lights" && hasValue)
+        {
+            stress().lightCount = (std::uint32_t)_wtoi(argv[++i]);
+        }
+        else if (arg == L"--stress-particles" && hasValue)
+        {
+            stress().particleCount = (std::uint32_t)_wtoi(argv[++i]);
+        }
+        else if (arg == L"--frames" && hasValue)
+        {
+            options.frameLimit = (std::uint64_t)_wtoi64(argv[++i]);
+        }
+    }
+
+    LocalFree(argv);
+    return options;
+}
+
+void AddFrameStatsSinks(FrameStats &stats, HWND hwnd, const LaunchOptions &options)
+{
+    stats.AddSink(std::make_unique<WindowTitleStatsSink>(hwnd));
+
+    if (options.statsStdout)
+    {
+        stats.AddSink(std::make_unique<StdoutStatsSink>());
+    }
+    if (!options.statsCsvPath.empty())
+    {
+        stats.AddSink(std::make_unique<CsvStatsSink>(options.statsCsvPath));
+    }
+    if (!options.statsJsonPath.empty())
+    {
+        stats.AddSink(std::make_unique<JsonStatsSink>(options.statsJsonPath));
+    }
+}
 
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
@@ -29,6 +193,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 #pragma warning(disable: 28251) // Inconsistent annotation for 'wWinMain': this instance has no annotations.
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow)
 {
+    const LaunchOptions options = ParseCommandLine();
 
 	// Register the window class.
 	const wchar_t CLASS_NAME[] = L"Sample Window Class";
@@ -66,11 +231,40 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 
     MyApp app(hwnd, windowWidth, windowHeight);
 
+    app.OpenAssets(options.assetsPath);
+    app.stressScene = options.stressScene;
     app.Initialize();
+    if (options.simRate > 0.0)
+    {
+        app.simulation.SetRate((float)options.simRate);
+    }
+    app.SetPipelined(options.pipelined);
+    app.indirectDraws = !options.directDraws;
+    if (options.streamBudgetKb > 0.0)
+    {
+        app.streamingBudget = (std::uint64_t)(options.streamBudgetKb * 1024.0);
+    }
 
 	ShowWindow(hwnd, nCmdShow);
 
-    FrameTimer performanceTimer;
+    AddFrameStatsSinks(app.frameStats, hwnd, options);
+
+    FramePacer pacer;
+    pacer.SetTargetFrameRate(options.fpsCap);
+
+    // Don't count initialization as the first frame.
+    app.timer.Mark();
+
+    // Containers reach their working size during the first frames.
+    const std::uint64_t allocationWarmupFrames = 16;
+    std::uint64_t frameIndex = 0;
+    std::uint64_t framesDrawn = 0;
+    std::uint64_t allocatingFrames = 0;
+
+    if (options.expectNoAlloc && !MemoryTracker::enabled)
+    {
+        OutputDebugStringA("--expect-no-alloc checks nothing without BKMZ_TRACK_ALLOCATIONS.\n");
+    }
 
     MSG msg = { };
 
@@ -84,10 +278,46 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 
         float deltaTime = app.timer.Mark();
 
+        app.CalculateFrameStats(deltaTime);
 
-        app.CalculateFrameStats(performanceTimer.Peek());
-        app.Update(deltaTime);
+        std::optional<HeapAllocationGuard> noAllocGuard;
+        if (options.expectNoAlloc && frameIndex++ >= allocationWarmupFrames)
+        {
+            noAllocGuard.emplace();
+        }
+
+        app.Tick(deltaTime);
         app.Draw();
+
+        // Checked here rather than left to the guard's assert, which
+        // release builds compile out.
+        if (noAllocGuard && noAllocGuard->Allocations() != 0)
+        {
+            allocatingFrames++;
+            char message[96];
+            std::snprintf(message, sizeof(message), "Frame %llu made %llu heap allocations.\n",
+                (unsigned long long)frameIndex, (unsigned long long)noAllocGuard->Allocations());
+            OutputDebugStringA(message);
+        }
+        noAllocGuard.reset();
+
+        pacer.Wait();
+
+        if (options.frameLimit != 0 && ++framesDrawn >= options.frameLimit)
+        {
+            break;
+        }
+    }
+
+    app.SetPipelined(false);
+    app.frameStats.Finish();
+
+    if (allocatingFrames != 0)
+    {
+        char message[96];
+        std::snprintf(message, sizeof(message), "%llu frames allocated from the heap.\n", (unsigned long long)allocatingFrames);
+        OutputDebugStringA(message);
+        return 3;
     }
 
 	return 0;
@@ -0,0 +1,459 @@
+#include "Broadphase.h"
+#include "Clock.h"
+#include "DrawList.h"
+#include "FixedTimestep.h"
+#include "JobSystem.h"
+#include "LightClusters.h"
+#include "Memory.h"
+#include "ParticleSystem.h"
+#include "SceneWorld.h"
+#include "StressScene.h"
+#include "TrackedBuffer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Usage: BkmzHeadless [--layout grid|clusters|mixed] [--count <objects>]
+//                     [--dynamic <fraction>] [--materials <n>] [--frames <n>]
+//                     [--lights <n>] [--particles <n>] [--broadphase sap|grid]
+//                     [--frame-rate <hz>] [--sim-rate <hz>]
+//                     [--scene <file.bscene>] [--json <path>]
+//
+// Runs MyApp's frame on the CPU without a window or device: the same
+// SceneWorld simulates, snapshots and prepares a stress scene (see
+// StressScene.h) or a compiled scene, object data goes through the same
+// TrackedBuffer gather as SceneBuffer and draws are packed by DrawList,
+// but the GPU side is a null backend that drops the uploads and draws.
+// Stress lights are animated and binned by LightClusters, and stress
+// particles simulated, sorted and written out on a JobSystem, as seen from
+// a fixed camera above the scene. With --broadphase, every drawn object is
+// also a Broadphase body, moved whenever its node changes, as if every
+// mesh were the unit cube.
+// Frames advance by a fixed 1/frame-rate, so runs are repeatable.
+//
+// Prints, and with --json writes, per-stage CPU timings and memory peaks,
+// for comparing releases.
+
+namespace
+{
+	// Same layout as DefaultMaterial::ObjectData.
+	struct ObjectData
+	{
+		bkmz::math::Float4x4 world;
+		std::uint32_t materialIndex;
+		std::uint32_t padding[3];
+	};
+
+	struct Options
+	{
+		StressSceneOptions stress;
+		std::string scenePath;
+		std::string jsonPath;
+		bool collide = false;
+		BroadphaseMethod broadphase = BroadphaseMethod::SweepAndPrune;
+		std::uint32_t frames = 600;
+		float frameRate = 60.0f;
+		float simRate = 60.0f;
+	};
+
+	enum Stage
+	{
+		Simulate,  // FixedUpdate steps and PublishRenderState
+		Prepare,   // interpolation and scene graph update
+		Objects,   // object data for the changed nodes, and the upload gather
+		Draws,     // draw list build and packing
+		Lights,    // light animation and clustering
+		Particles, // particle update, sort and instance writes
+		Collide,   // broadphase body updates and pair search
+		Frame,     // all of the above
+		StageCount
+	};
+
+	const char *const stageNames[StageCount] = { "simulate", "prepare", "objects", "draws", "lights", "particles", "collide", "frame" };
+
+	struct StageSummary
+	{
+		double meanMs = 0.0;
+		double p50Ms = 0.0;
+		double p95Ms = 0.0;
+		double maxMs = 0.0;
+	};
+
+	StageSummary Summarize(std::vector<double> times)
+	{
+		StageSummary summary;
+		if (times.empty())
+		{
+			return summary;
+		}
+		std::sort(times.begin(), times.end());
+		auto at = [&times](double p) { return times[(std::size_t)(p * (times.size() - 1) + 0.5)] * 1e3; };
+		summary.meanMs = std::accumulate(times.begin(), times.end(), 0.0) / times.size() * 1e3;
+		summary.p50Ms = at(0.5);
+		summary.p95Ms = at(0.95);
+		summary.maxMs = times.back() * 1e3;
+		return summary;
+	}
+
+	Options ParseOptions(int argc, char **argv)
+	{
+		Options options;
+		options.stress.objectCount = 100000;
+		for (int i = 1; i < argc; i++)
+		{
+			const bool hasValue = i + 1 < argc;
+			if (std::strcmp(argv[i], "--layout") == 0 && hasValue)
+			{
+				options.stress.layout = ParseStressLayout(argv[++i]);
+			}
+			else if (std::strcmp(argv[i], "--count") == 0 && hasValue)
+			{
+				options.stress.objectCount = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if (std::strcmp(argv[i], "--dynamic") == 0 && hasValue)
+			{
+				options.stress.dynamicFraction = (float)std::atof(argv[++i]);
+			}
+			else if (std::strcmp(argv[i], "--materials") == 0 && hasValue)
+			{
+				options.stress.materialCount = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if (std::strcmp(argv[i], "--frames") == 0 && hasValue)
+			{
+				options.frames = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if (std::strcmp(argv[i], "--lights") == 0 && hasValue)
+			{
+				options.stress.lightCount = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if (std::strcmp(argv[i], "--particles") == 0 && hasValue)
+			{
+				options.stress.particleCount = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if (std::strcmp(argv[i], "--broadphase") == 0 && hasValue)
+			{
+				const std::string method = argv[++i];
+				if (method != "sap" && method != "grid")
+				{
+					throw std::runtime_error("Unknown broadphase " + method);
+				}
+				options.collide = true;
+				options.broadphase = method == "grid" ? BroadphaseMethod::Grid : BroadphaseMethod::SweepAndPrune;
+			}
+			else if (std::strcmp(argv[i], "--frame-rate") == 0 && hasValue)
+			{
+				options.frameRate = (float)std::atof(argv[++i]);
+			}
+			else if (std::strcmp(argv[i], "--sim-rate") == 0 && hasValue)
+			{
+				options.simRate = (float)std::atof(argv[++i]);
+			}
+			else if (std::strcmp(argv[i], "--scene") == 0 && hasValue)
+			{
+				options.scenePath = argv[++i];
+			}
+			else if (std::strcmp(argv[i], "--json") == 0 && hasValue)
+			{
+				options.jsonPath = argv[++i];
+			}
+			else
+			{
+				throw std::runtime_error(std::string("Unknown option ") + argv[i]);
+			}
+		}
+		if (options.frameRate <= 0.0f || options.simRate <= 0.0f)
+		{
+			throw std::runtime_error("Frame and simulation rates must be positive.");
+		}
+		return options;
+	}
+
+	// Mesh geometry as the renderer would have it once streamed in.
+	GeometryView NullGeometry(std::uint32_t mesh)
+	{
+		GeometryView geometry = {};
+		geometry.vertexBufferLocation = 0x10000ull * (mesh + 1);
+		geometry.vertexBufferSize = 8 * 16;
+		geometry.vertexStride = 16;
+		geometry.indexBufferLocation = geometry.vertexBufferLocation + 0x8000;
+		geometry.indexBufferSize = 36 * 2;
+		geometry.indexFormat = 57; // DXGI_FORMAT_R16_UINT
+		geometry.indexCount = 36;
+		return geometry;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		const Options options = ParseOptions(argc, argv);
+
+		const std::int64_t loadStart = Clock::Now();
+		std::vector<std::uint8_t> bytes;
+		SceneFile file;
+		SceneView view;
+		if (options.scenePath.empty())
+		{
+			bytes = CompileScene(MakeStressScene(options.stress));
+			view = SceneView(bytes);
+		}
+		else
+		{
+			file = SceneFile(options.scenePath);
+			view = file.View();
+		}
+
+		// Resource pools as MyApp keeps them, with every mesh already loaded.
+		// A material is only its scene index here.
+		HandlePool<GeometryView, MeshResource> geometry;
+		HandlePool<std::uint32_t, MaterialResource> materials;
+		std::vector<MeshHandle> meshHandles;
+		std::vector<MaterialHandle> materialHandles;
+		for (std::uint32_t i = 0; i < view.MeshCount(); i++)
+		{
+			meshHandles.push_back(geometry.Create(NullGeometry(i)));
+		}
+		for (std::uint32_t i = 0; i < view.MaterialCount(); i++)
+		{
+			materialHandles.push_back(materials.Create(i));
+		}
+
+		SceneWorld sceneWorld;
+		sceneWorld.CreateObjects(view, meshHandles, 0, materialHandles);
+		sceneWorld.PublishRenderState();
+		const double loadSeconds = Clock::ToSeconds(Clock::Now() - loadStart);
+
+		TrackedBuffer<ObjectData> objects;
+		objects.Resize((std::max)(view.Size(), 1u));
+		std::vector<ObjectData> staging(objects.Size());
+		DrawList drawList;
+		std::vector<IndirectDrawCommand> indirect;
+
+		const std::vector<Light> lightStart = MakeStressLights(options.stress);
+		std::vector<Light> lights = lightStart;
+		LightClusters lightClusters;
+		lightClusters.SetProjection(bkmz::math::piOver4, 16.0f / 9.0f, 0.1f, 1000.0f);
+		const bkmz::math::Float4x4 camera = bkmz::math::LookAtLH({ 0.0f, 12.0f, -24.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+		std::uint64_t lightIndices = 0;
+
+		JobSystem jobs;
+		ParticleSystem particles(options.stress.particleCount + options.stress.particleCount / 2 + 1024);
+		particles.emitters = MakeStressEmitters(options.stress);
+		std::vector<ParticleInstance> particleInstances(particles.Capacity());
+		std::uint64_t particlesDrawn = 0;
+
+		Broadphase broadphase(options.broadphase);
+		const Aabb cube = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f } };
+		constexpr Broadphase::BodyId noBody = ~0u;
+		std::vector<Broadphase::BodyId> nodeBodies;
+		std::uint64_t pairCount = 0;
+
+		FixedTimestep simulation;
+		simulation.SetRate(options.simRate);
+		const float frameTime = 1.0f / options.frameRate;
+
+		std::vector<double> times[StageCount];
+		for (auto &stage : times)
+		{
+			stage.reserve(options.frames);
+		}
+		std::uint64_t uploadedBytes = 0;
+		std::uint64_t drawCount = 0;
+		std::uint64_t peakFrameHeapBytes = 0;
+		MemoryTagCounters tagTotals = {};
+		MemoryTracker::EndFrame();
+
+		for (std::uint32_t frame = 0; frame < options.frames; frame++)
+		{
+			const std::int64_t start = Clock::Now();
+
+			const int steps = simulation.Advance(frameTime);
+			for (int i = 0; i < steps; i++)
+			{
+				sceneWorld.FixedUpdate(simulation.stepTime);
+			}
+			if (steps > 0)
+			{
+				sceneWorld.PublishRenderState();
+			}
+			const std::int64_t simulated = Clock::Now();
+
+			const std::vector<SceneGraph::NodeId> &changed = sceneWorld.Prepare(simulation.Alpha());
+			const std::int64_t prepared = Clock::Now();
+
+			for (SceneGraph::NodeId node : changed)
+			{
+				ObjectData data = {};
+				data.world = bkmz::math::Transpose(sceneWorld.Scene().World(node));
+				objects.Set(sceneWorld.ObjectIndex(node), data);
+			}
+			for (const UploadRun &run : objects.Gather(staging.data()))
+			{
+				uploadedBytes += (std::uint64_t)run.count * sizeof(ObjectData);
+			}
+			const std::int64_t written = Clock::Now();
+
+			drawList.Clear();
+			for (const auto &item : sceneWorld.Current().items)
+			{
+				if (const GeometryView *mesh = geometry.Get(item.mesh))
+				{
+					drawList.Add(item.material.index, *mesh, item.objectIndex);
+				}
+			}
+			indirect.resize(drawList.Count());
+			drawList.Pack(indirect.data());
+			drawCount += drawList.Count();
+			const std::int64_t drawn = Clock::Now();
+
+			AnimateStressLights(lightStart, frame * frameTime, lights);
+			lightClusters.Build(lights, camera);
+			lightIndices += lightClusters.Stats().indices;
+			const std::int64_t lit = Clock::Now();
+
+			particles.Update(frameTime, jobs);
+			particles.Sort(camera, jobs);
+			particles.WriteInstances(particleInstances.data(), jobs);
+			particlesDrawn += particles.Size();
+			const std::int64_t simulatedParticles = Clock::Now();
+
+			if (options.collide)
+			{
+				for (SceneGraph::NodeId node : changed)
+				{
+					if (sceneWorld.ObjectIndex(node) == SceneWorld::noObject)
+					{
+						continue;
+					}
+					if (node >= nodeBodies.size())
+					{
+						nodeBodies.resize(node + 1, noBody);
+					}
+					const Aabb bounds = TransformAabb(cube, sceneWorld.Scene().World(node));
+					if (nodeBodies[node] == noBody)
+					{
+						nodeBodies[node] = broadphase.Add(bounds);
+					}
+					else
+					{
+						broadphase.Move(nodeBodies[node], bounds);
+					}
+				}
+				broadphase.Update(jobs);
+				pairCount += broadphase.Stats().pairs;
+			}
+			const std::int64_t end = Clock::Now();
+
+			times[Simulate].push_back(Clock::ToSeconds(simulated - start));
+			times[Prepare].push_back(Clock::ToSeconds(prepared - simulated));
+			times[Objects].push_back(Clock::ToSeconds(written - prepared));
+			times[Draws].push_back(Clock::ToSeconds(drawn - written));
+			times[Lights].push_back(Clock::ToSeconds(lit - drawn));
+			times[Particles].push_back(Clock::ToSeconds(simulatedParticles - lit));
+			times[Collide].push_back(Clock::ToSeconds(end - simulatedParticles));
+			times[Frame].push_back(Clock::ToSeconds(end - start));
+
+			const MemoryFrameStats memory = MemoryTracker::EndFrame();
+			peakFrameHeapBytes = (std::max)(peakFrameHeapBytes, memory.heap.bytes);
+			for (std::size_t tag = 0; tag < memoryTagCount; tag++)
+			{
+				tagTotals[tag].allocations += memory.tags[tag].allocations;
+				tagTotals[tag].bytes += memory.tags[tag].bytes;
+			}
+		}
+
+		StageSummary summaries[StageCount];
+		for (int stage = 0; stage < StageCount; stage++)
+		{
+			summaries[stage] = Summarize(times[stage]);
+		}
+		const std::uint64_t peakResident = MemoryTracker::PeakResidentBytes();
+		const double frames = (std::max)(options.frames, 1u);
+
+		std::printf("%u objects, %u entities, %u frames, load %.1f ms\n", view.Size(), sceneWorld.EntityCount(), options.frames, loadSeconds * 1e3);
+		std::printf("%-10s %10s %10s %10s %10s\n", "stage", "mean ms", "p50 ms", "p95 ms", "max ms");
+		for (int stage = 0; stage < StageCount; stage++)
+		{
+			const StageSummary &s = summaries[stage];
+			std::printf("%-10s %10.3f %10.3f %10.3f %10.3f\n", stageNames[stage], s.meanMs, s.p50Ms, s.p95Ms, s.maxMs);
+		}
+		std::printf("uploaded %.1f KiB/frame, %.0f draws/frame, peak resident %.1f MiB\n",
+			uploadedBytes / frames / 1024.0, drawCount / frames, peakResident / (1024.0 * 1024.0));
+		if (!lights.empty())
+		{
+			std::printf("%zu lights, %.0f light indices/frame\n", lights.size(), lightIndices / frames);
+		}
+		if (!particles.emitters.empty())
+		{
+			std::printf("%.0f particles/frame on %u threads\n", particlesDrawn / frames, jobs.ThreadCount());
+		}
+		if (options.collide)
+		{
+			std::printf("%u bodies, %.0f broadphase pairs/frame\n", broadphase.Size(), pairCount / frames);
+		}
+		if (MemoryTracker::enabled)
+		{
+			std::printf("peak heap bytes allocated in one frame: %llu\n", (unsigned long long)peakFrameHeapBytes);
+		}
+		for (std::size_t tag = 0; tag < memoryTagCount; tag++)
+		{
+			if (tagTotals[tag].allocations != 0)
+			{
+				std::printf("%-10s %.1f allocs/frame, %.0f bytes/frame\n", MemoryTagName((MemoryTag)tag),
+					tagTotals[tag].allocations / frames, tagTotals[tag].bytes / frames);
+			}
+		}
+
+		if (!options.jsonPath.empty())
+		{
+			std::ofstream out(options.jsonPath, std::ios::trunc);
+			out << "{\n  \"scene\": \"" << (options.scenePath.empty() ? StressLayoutName(options.stress.layout) : "file") << "\""
+				<< ",\n  \"objects\": " << view.Size()
+				<< ",\n  \"frames\": " << options.frames
+				<< ",\n  \"load_ms\": " << loadSeconds * 1e3
+				<< ",\n  \"stages\": {";
+			for (int stage = 0; stage < StageCount; stage++)
+			{
+				const StageSummary &s = summaries[stage];
+				out << (stage == 0 ? "\n" : ",\n")
+					<< "    \"" << stageNames[stage] << "\": { \"mean_ms\": " << s.meanMs << ", \"p50_ms\": " << s.p50Ms
+					<< ", \"p95_ms\": " << s.p95Ms << ", \"max_ms\": " << s.maxMs << " }";
+			}
+			out << "\n  },\n  \"uploaded_bytes_per_frame\": " << uploadedBytes / frames
+				<< ",\n  \"draws_per_frame\": " << drawCount / frames
+				<< ",\n  \"lights\": " << lights.size()
+				<< ",\n  \"light_indices_per_frame\": " << lightIndices / frames
+				<< ",\n  \"particles_per_frame\": " << particlesDrawn / frames
+				<< ",\n  \"bodies\": " << broadphase.Size()
+				<< ",\n  \"pairs_per_frame\": " << pairCount / frames
+				<< ",\n  \"peak_resident_bytes\": " << peakResident
+				<< ",\n  \"peak_frame_heap_bytes\": " << (MemoryTracker::enabled ? (double)peakFrameHeapBytes : -1.0)
+				<< ",\n  \"tags\": {";
+			for (std::size_t tag = 0; tag < memoryTagCount; tag++)
+			{
+				out << (tag == 0 ? "\n" : ",\n")
+					<< "    \"" << MemoryTagName((MemoryTag)tag) << "\": { \"allocs_per_frame\": " << tagTotals[tag].allocations / frames
+					<< ", \"bytes_per_frame\": " << tagTotals[tag].bytes / frames << " }";
+			}
+			out << "\n  }\n}\n";
+			if (!out.flush())
+			{
+				throw std::runtime_error("Can't write " + options.jsonPath);
+			}
+		}
+	}
+	catch (const std::exception &error)
+	{
+		std::fprintf(stderr, "BkmzHeadless: %s\n", error.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,95 @@
+#include "Archive.h"
+#include "FileIo.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	void Usage()
+	{
+		std::fprintf(stderr,
+			"Usage: BkmzPack [--store] [--align <bytes>] <archive> <file or directory>...\n"
+			"Packs the files into an asset archive. Files in a directory are named by\n"
+			"their path relative to it, with forward slashes; single files by their\n"
+			"file name.\n"
+			"  --store          don't compress anything\n"
+			"  --align <bytes>  blob alignment, a power of two (default 64, 4096 for\n"
+			"                   direct I/O)\n");
+	}
+
+	void AddFile(ArchiveWriter &writer, const fs::path &path, const std::string &name, ArchiveCompression compression)
+	{
+		writer.Add(name, File::ReadAll(path.string()), compression);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	ArchiveCompression compression = ArchiveCompression::Lz4;
+	std::uint32_t alignment = 64;
+	std::vector<std::string> paths;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--store") == 0)
+		{
+			compression = ArchiveCompression::None;
+		}
+		else if (std::strcmp(argv[i], "--align") == 0 && i + 1 < argc)
+		{
+			alignment = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else
+		{
+			paths.push_back(argv[i]);
+		}
+	}
+
+	if (paths.size() < 2)
+	{
+		Usage();
+		return 1;
+	}
+
+	try
+	{
+		ArchiveWriter writer(alignment);
+		for (std::size_t i = 1; i < paths.size(); i++)
+		{
+			const fs::path input = paths[i];
+			if (!fs::is_directory(input))
+			{
+				AddFile(writer, input, input.filename().generic_string(), compression);
+				continue;
+			}
+
+			for (const auto &entry : fs::recursive_directory_iterator(input))
+			{
+				if (entry.is_regular_file())
+				{
+					AddFile(writer, entry.path(), fs::relative(entry.path(), input).generic_string(), compression);
+				}
+			}
+		}
+
+		const ArchiveWriter::Stats stats = writer.Write(paths[0]);
+		std::printf("%s: %u assets, %u after deduplication, %llu bytes stored for %llu (%.1f%%), %llu byte file\n",
+			paths[0].c_str(), stats.entries, stats.blobs,
+			(unsigned long long)stats.storedBytes, (unsigned long long)stats.rawBytes,
+			stats.rawBytes ? 100.0 * (double)stats.storedBytes / (double)stats.rawBytes : 100.0,
+			(unsigned long long)stats.fileSize);
+	}
+	catch (const std::exception &error)
+	{
+		std::fprintf(stderr, "BkmzPack: %s\n", error.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,47 @@
+#include "SceneFile.h"
+#include "StressScene.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+
+// Usage: BkmzScene <input.scene> <output.bscene>
+//        BkmzScene --stress <grid|clusters|mixed> <objects> <output.bscene>
+// Compiles a text scene for the engine, see SceneFile.h, or writes a
+// generated stress scene, see StressScene.h.
+int main(int argc, char **argv)
+{
+	const bool stress = argc == 5 && std::strcmp(argv[1], "--stress") == 0;
+	if (argc != 3 && !stress)
+	{
+		std::fprintf(stderr, "Usage: BkmzScene <input.scene> <output.bscene>\n");
+		std::fprintf(stderr, "       BkmzScene --stress <grid|clusters|mixed> <objects> <output.bscene>\n");
+		return 1;
+	}
+
+	try
+	{
+		SceneDescription scene;
+		const char *output = argv[argc - 1];
+		if (stress)
+		{
+			StressSceneOptions options;
+			options.layout = ParseStressLayout(argv[2]);
+			options.objectCount = (std::uint32_t)std::strtoul(argv[3], nullptr, 10);
+			scene = MakeStressScene(options);
+		}
+		else
+		{
+			scene = LoadSceneText(argv[1]);
+		}
+		WriteCompiledScene(scene, output);
+		std::printf("%s: %u objects, %zu meshes, %zu materials\n",
+			output, scene.Size(), scene.meshNames.size(), scene.materialNames.size());
+	}
+	catch (const std::exception &error)
+	{
+		std::fprintf(stderr, "BkmzScene: %s\n", error.what());
+		return 1;
+	}
+	return 0;
+}